@@ -0,0 +1,32 @@
+#include "content_stream.h"
+#include <benchmark/benchmark.h>
+#include <string>
+
+namespace {
+
+// Something like the text heavy page content the extractor spends its time in
+const std::string &page_content() {
+  static const std::string text = [] {
+    std::string content = "BT /F1 10 Tf 12 TL\n";
+    for (int i = 0; i < 5000; ++i) {
+      content += "1 0 0 1 72 " + std::to_string(720 - i % 700) + " Tm ";
+      content += "[(Line) -250 (of) -250 (text) 120.5 (here)] TJ T*\n";
+    }
+    content += "ET\n";
+    return content;
+  }();
+  return text;
+}
+
+void BM_ContentLexer(benchmark::State &state) {
+  for (auto _ : state) {
+    ContentLexer lex(page_content());
+    size_t operands = 0;
+    lex.for_each([&](const ContentOp &op) { operands += op.count; });
+    benchmark::DoNotOptimize(operands);
+  }
+  state.SetBytesProcessed(state.iterations() * page_content().size());
+}
+BENCHMARK(BM_ContentLexer);
+
+} // namespace
@@ -0,0 +1,263 @@
+#include "inflate_backend.h"
+#include "pdf_parser.h"
+#include "range_reader.h"
+#include "session.h"
+#include "thread_pool.h"
+#include "utility.h"
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Decompression and whole document parsing. The documents are generated so
+ * the numbers do not depend on whatever PDFs happen to be lying around: a page
+ * tree over pages that each have a deflated content stream, a font dict, and
+ * some annotations, with a classic xref table at the end. That is roughly the
+ * mix of objects in a text heavy report.
+ *
+ * PDFCLI_ASSET_DIR is set by the build to test/assets so the raven can be
+ * found from any working directory.
+ */
+
+namespace {
+
+std::string deflate_text(const std::string &text) {
+  std::vector<char> bytes = deflate_buffer(text, 6);
+  return std::string(bytes.begin(), bytes.end());
+}
+
+std::string page_text(size_t page) {
+  std::string content = "BT /F1 10 Tf 12 TL 72 720 Td\n";
+  for (int line = 0; line < 40; ++line)
+    content += "(Page " + std::to_string(page) + " line " +
+               std::to_string(line) + " of the generated corpus) Tj T*\n";
+  return content + "ET\n";
+}
+
+// A document with the given number of pages, about 5 objects per page
+std::string make_document(size_t pages) {
+  std::string data = "%PDF-1.7\n";
+  std::vector<size_t> offsets;
+  auto add = [&](const std::string &body) {
+    offsets.push_back(data.size());
+    data += std::to_string(offsets.size()) + " 0 obj\n" + body + "\nendobj\n";
+  };
+
+  add("<< /Type /Catalog /Pages 2 0 R >>");
+  std::string kids;
+  for (size_t i = 0; i < pages; ++i)
+    kids += std::to_string(4 + i * 4) + " 0 R ";
+  add("<< /Type /Pages /Count " + std::to_string(pages) + " /Kids [" + kids +
+      "] /MediaBox [0 0 612 792] >>");
+  add("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>");
+  for (size_t i = 0; i < pages; ++i) {
+    size_t page = 4 + i * 4;
+    add("<< /Type /Page /Parent 2 0 R /Resources << /Font << /F1 3 0 R >> >> "
+        "/Contents " +
+        std::to_string(page + 1) + " 0 R /Annots [" +
+        std::to_string(page + 2) + " 0 R " + std::to_string(page + 3) +
+        " 0 R] >>");
+    std::string payload = deflate_text(page_text(i));
+    add("<< /Filter /FlateDecode /Length " + std::to_string(payload.size()) +
+        " >>\nstream\n" + payload + "\nendstream");
+    for (int a = 0; a < 2; ++a)
+      add("<< /Type /Annot /Subtype /Link /Rect [72 " +
+          std::to_string(700 - a * 20) + " 200 " +
+          std::to_string(712 - a * 20) + "] /Border [0 0 0] >>");
+  }
+
+  size_t xref = data.size();
+  data += "xref\n0 " + std::to_string(offsets.size() + 1) + "\n";
+  data += "0000000000 65535 f\r\n";
+  for (size_t offset : offsets) {
+    char line[32];
+    std::snprintf(line, sizeof(line), "%010zu 00000 n\r\n", offset);
+    data += line;
+  }
+  data += "trailer\n<< /Size " + std::to_string(offsets.size() + 1) +
+          " /Root 1 0 R >>\nstartxref\n" + std::to_string(xref) +
+          "\n%%EOF\n";
+  return data;
+}
+
+const std::string &corpus() {
+  static const std::string data = make_document(2000);
+  return data;
+}
+
+std::string raven() {
+  std::ifstream is(std::string(PDFCLI_ASSET_DIR) + "/the_raven.gz",
+                   std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(is), {});
+}
+
+// Decompression ///////////////////////////////////////////////////////////////
+
+// Deflated text of the given size, repetitive enough to compress like a
+// content stream does
+std::string compressed_of_size(size_t size) {
+  std::string text;
+  for (size_t i = 0; text.size() < size; ++i)
+    text += "BT 72 " + std::to_string(720 - i % 700) + " Td (line " +
+            std::to_string(i) + ") Tj ET\n";
+  text.resize(size);
+  return deflate_text(text);
+}
+
+void BM_InflateStream(benchmark::State &state) {
+  std::string compressed = compressed_of_size(state.range(0));
+  std::istringstream is(compressed);
+  size_t out = 0;
+  for (auto _ : state) {
+    std::vector<char> bytes = util::inflate_stream(is, compressed.size());
+    out = bytes.size();
+    benchmark::DoNotOptimize(bytes.data());
+  }
+  state.SetBytesProcessed(state.iterations() * out);
+}
+BENCHMARK(BM_InflateStream)->RangeMultiplier(8)->Range(1 << 10, 8 << 20);
+
+// The raven wrapped in a one stream document so naive_inflate has a pdf
+void BM_NaiveInflateRaven(benchmark::State &state) {
+  std::string payload = raven();
+  if (payload.empty()) {
+    state.SkipWithError("the_raven.gz is missing");
+    return;
+  }
+  std::string data = "%PDF-1.7\n1 0 obj\n<< /Filter /FlateDecode /Length " +
+                     std::to_string(payload.size()) + " >>\nstream\n" +
+                     payload + "\nendstream\nendobj\n%%EOF\n";
+  PdfParser parser(data);
+  for (auto _ : state) {
+    std::string out = parser.naive_inflate();
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_NaiveInflateRaven);
+
+void BM_InflateDocument(benchmark::State &state) {
+  for (auto _ : state) {
+    PdfParser parser(corpus());
+    std::ostringstream os;
+    parser.inflate_to(os);
+    benchmark::DoNotOptimize(os.tellp());
+  }
+  state.SetBytesProcessed(state.iterations() * corpus().size());
+}
+BENCHMARK(BM_InflateDocument)->Unit(benchmark::kMillisecond);
+
+// Whole documents /////////////////////////////////////////////////////////////
+
+void BM_LoadXref(benchmark::State &state) {
+  for (auto _ : state) {
+    PdfParser parser(corpus());
+    benchmark::DoNotOptimize(parser.xref().size());
+  }
+  state.SetBytesProcessed(state.iterations() * corpus().size());
+}
+BENCHMARK(BM_LoadXref)->Unit(benchmark::kMillisecond);
+
+// Every object one at a time through the xref and the object cache
+void BM_GetEveryObject(benchmark::State &state) {
+  for (auto _ : state) {
+    PdfParser parser(corpus());
+    size_t loaded = 0;
+    for (size_t num = 1; num < parser.xref().size(); ++num)
+      loaded += parser.get_object(num) != nullptr;
+    benchmark::DoNotOptimize(loaded);
+  }
+  state.SetBytesProcessed(state.iterations() * corpus().size());
+}
+BENCHMARK(BM_GetEveryObject)->Unit(benchmark::kMillisecond);
+
+void BM_ParseAll(benchmark::State &state) {
+  ThreadPool pool(state.range(0));
+  for (auto _ : state) {
+    PdfParser parser(corpus());
+    ObjectTable table = parser.parse_all(pool);
+    benchmark::DoNotOptimize(table.size());
+  }
+  state.SetBytesProcessed(state.iterations() * corpus().size());
+}
+BENCHMARK(BM_ParseAll)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Opening small documents one after another and reading their text, the
+// way a service handles requests. The session keeps its memory blocks and
+// pool between documents, the plain version starts from scratch every time.
+const std::string &small_document() {
+  static const std::string data = make_document(3);
+  return data;
+}
+
+void BM_OpenSmallDocuments(benchmark::State &state) {
+  for (auto _ : state) {
+    PdfParser parser(small_document());
+    ThreadPool pool(1);
+    std::ostringstream os;
+    extract_text(parser, os, pool);
+    benchmark::DoNotOptimize(os.tellp());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OpenSmallDocuments);
+
+void BM_SessionSmallDocuments(benchmark::State &state) {
+  Session::Options options;
+  options.threads = 1;
+  Session session(options);
+  for (auto _ : state) {
+    Document doc = session.view(small_document());
+    std::ostringstream os;
+    doc.extract_text(os);
+    benchmark::DoNotOptimize(os.tellp());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SessionSmallDocuments);
+
+// Ranged reads //////////////////////////////////////////////////////////////
+
+// Network storage, more or less. Every batch waits one round trip no matter
+// how many ranges are in it.
+class SlowReader : public RangeReader {
+public:
+  explicit SlowReader(std::string_view bytes) : data(bytes) {}
+  uint64_t size() const override { return data.size(); }
+  void read(const std::vector<ReadRequest> &requests) override {
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    for (const ReadRequest &request : requests)
+      data.copy(request.dest, request.length, request.offset);
+  }
+
+private:
+  std::string_view data;
+};
+
+// The text of one page out of the middle of the corpus, read through a
+// source that has nothing yet. Batches is how many round trips it took.
+void BM_RangedPageText(benchmark::State &state) {
+  size_t batches = 0;
+  for (auto _ : state) {
+    RangedSource source(std::make_unique<SlowReader>(corpus()));
+    PdfParser parser(source);
+    std::ostringstream os;
+    extract_text(parser, os, PageRange::parse("1000"));
+    benchmark::DoNotOptimize(os.tellp());
+    batches = source.batches();
+  }
+  state.counters["batches"] = batches;
+}
+BENCHMARK(BM_RangedPageText)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
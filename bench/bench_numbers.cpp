@@ -0,0 +1,113 @@
+#include "lexer.h"
+#include "utility.h"
+#include <benchmark/benchmark.h>
+#include <sstream>
+#include <string>
+
+/* Content streams are mostly numbers, so this compares the old way of reading
+ * them off an istream with the lexer's one pass kernel. The istream version
+ * does what parse_pdf_num_ref_or_top_level used to, try an int first and if a
+ * point follows seek back and read the whole thing again as a double.
+ */
+
+namespace {
+
+std::string content_numbers(size_t lines) {
+  std::string text;
+  for (size_t i = 0; i < lines; ++i) {
+    text += std::to_string(i % 612) + " " + std::to_string(i % 792) + ".25 ";
+    text += "-.5 0.002 " + std::to_string(i) + " 12.75\n";
+  }
+  return text;
+}
+
+const std::string &numbers() {
+  static const std::string text = content_numbers(10000);
+  return text;
+}
+
+void BM_IstreamNumbers(benchmark::State &state) {
+  for (auto _ : state) {
+    std::istringstream is(numbers());
+    double sum = 0;
+    while (true) {
+      auto start = is.tellg();
+      int64_t i;
+      if (!(is >> i)) {
+        is.clear();
+        is.seekg(start);
+        double d;
+        if (!(is >> d))
+          break;
+        sum += d;
+      } else if (is.peek() == '.') {
+        is.seekg(start);
+        double d;
+        is >> d;
+        sum += d;
+      } else {
+        sum += i;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(state.iterations() * numbers().size());
+}
+BENCHMARK(BM_IstreamNumbers);
+
+void BM_LexerNumbers(benchmark::State &state) {
+  for (auto _ : state) {
+    PdfLexer lex(numbers());
+    double sum = 0;
+    for (PdfToken token = lex.next(); token.type != PdfTokenType::End;
+         token = lex.next())
+      sum += token.type == PdfTokenType::Int ? token.integer : token.real;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(state.iterations() * numbers().size());
+}
+BENCHMARK(BM_LexerNumbers);
+
+// The istream helpers the older parsing code still goes through
+void BM_UtilParseNumbers(benchmark::State &state) {
+  for (auto _ : state) {
+    std::istringstream is(numbers());
+    double sum = 0;
+    while (true) {
+      is >> std::ws;
+      if (is.peek() == EOF)
+        break;
+      // Every line is int real real real int real
+      int64_t i;
+      double d;
+      if (!util::parse_int(is, &i))
+        break;
+      sum += i;
+      for (int n = 0; n < 3 && util::parse_double(is, &d); ++n)
+        sum += d;
+      if (!util::parse_int(is, &i) || !util::parse_double(is, &d))
+        break;
+      sum += i + d;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(state.iterations() * numbers().size());
+}
+BENCHMARK(BM_UtilParseNumbers);
+
+void BM_ScanPdfNumber(benchmark::State &state) {
+  const char *texts[] = {"612", "792.25", "-.5", "0.002", "12.75"};
+  for (auto _ : state) {
+    util::PdfNumber number;
+    for (const char *text : texts) {
+      util::scan_pdf_number(text, number);
+      benchmark::DoNotOptimize(number);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * std::size(texts));
+}
+BENCHMARK(BM_ScanPdfNumber);
+
+} // namespace
+
+BENCHMARK_MAIN();
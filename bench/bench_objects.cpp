@@ -0,0 +1,177 @@
+#include "arena.h"
+#include "char_scan.h"
+#include "lexer.h"
+#include "pdf_value.h"
+#include "utility.h"
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* The DOM parser on the shapes that stress it most. Wide dicts and arrays are
+ * what object streams and big /Kids and /Widths arrays look like, deep ones
+ * are the worst case for the recursion and for the containers that are still
+ * open while their children parse. Each is parsed with and without an arena,
+ * since the heap version is what the older code paths still use, and the wide
+ * ones into a PdfGraph too, which is what PdfParser::parse_all builds.
+ *
+ * The lexing ones run the tokens of a wide dict through each character
+ * scanner the cpu has, once as written and once indented the way pretty
+ * printed files are, where the whitespace runs are long.
+ */
+
+namespace {
+
+std::string wide_dict(int64_t pairs) {
+  std::string text = "<<";
+  for (int64_t i = 0; i < pairs; ++i) {
+    text += " /Key" + std::to_string(i % 50) + "_" + std::to_string(i) + " ";
+    switch (i % 4) {
+    case 0:
+      text += std::to_string(i) + " 0 R";
+      break;
+    case 1:
+      text += "(a string value)";
+      break;
+    case 2:
+      text += std::to_string(i) + ".5";
+      break;
+    default:
+      text += "/AName";
+    }
+  }
+  return text + " >>";
+}
+
+std::string wide_array(int64_t items) {
+  std::string text = "[";
+  for (int64_t i = 0; i < items; ++i)
+    text += " " + std::to_string(i * 7 % 1000);
+  return text + " ]";
+}
+
+std::string deep_dict(int64_t depth) {
+  std::string text;
+  for (int64_t i = 0; i < depth; ++i)
+    text += "<< /Kid ";
+  text += "null";
+  for (int64_t i = 0; i < depth; ++i)
+    text += " /Count " + std::to_string(i) + " >>";
+  return text;
+}
+
+std::string deep_array(int64_t depth) {
+  return std::string(depth, '[') + "1" + std::string(depth, ']');
+}
+
+void parse_heap(benchmark::State &state, const std::string &text) {
+  for (auto _ : state) {
+    PdfLexer lex(text);
+    std::unique_ptr<util::PdfObj> obj(util::parse_pdf_obj(lex));
+    benchmark::DoNotOptimize(obj.get());
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+void parse_arena(benchmark::State &state, const std::string &text) {
+  Arena arena;
+  for (auto _ : state) {
+    PdfLexer lex(text);
+    benchmark::DoNotOptimize(util::parse_pdf_obj(lex, &arena));
+    arena.release();
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+void parse_graph(benchmark::State &state, const std::string &text) {
+  PdfGraph graph;
+  for (auto _ : state) {
+    PdfLexer lex(text);
+    benchmark::DoNotOptimize(graph.parse(lex));
+    graph.clear();
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+void BM_ParseWideDict(benchmark::State &state) {
+  parse_heap(state, wide_dict(state.range(0)));
+}
+BENCHMARK(BM_ParseWideDict)->Range(16, 16 << 10);
+
+void BM_ParseWideDictArena(benchmark::State &state) {
+  parse_arena(state, wide_dict(state.range(0)));
+}
+BENCHMARK(BM_ParseWideDictArena)->Range(16, 16 << 10);
+
+void BM_ParseWideDictGraph(benchmark::State &state) {
+  parse_graph(state, wide_dict(state.range(0)));
+}
+BENCHMARK(BM_ParseWideDictGraph)->Range(16, 16 << 10);
+
+void BM_ParseWideArray(benchmark::State &state) {
+  parse_heap(state, wide_array(state.range(0)));
+}
+BENCHMARK(BM_ParseWideArray)->Range(16, 64 << 10);
+
+void BM_ParseWideArrayArena(benchmark::State &state) {
+  parse_arena(state, wide_array(state.range(0)));
+}
+BENCHMARK(BM_ParseWideArrayArena)->Range(16, 64 << 10);
+
+void BM_ParseWideArrayGraph(benchmark::State &state) {
+  parse_graph(state, wide_array(state.range(0)));
+}
+BENCHMARK(BM_ParseWideArrayGraph)->Range(16, 64 << 10);
+
+// Deep enough to matter but well inside PdfEventParser::MAX_NESTING_DEPTH
+void BM_ParseDeepDict(benchmark::State &state) {
+  parse_heap(state, deep_dict(state.range(0)));
+}
+BENCHMARK(BM_ParseDeepDict)->Range(8, 256);
+
+void BM_ParseDeepArray(benchmark::State &state) {
+  parse_heap(state, deep_array(state.range(0)));
+}
+BENCHMARK(BM_ParseDeepArray)->Range(8, 256);
+
+void lex_with_scanner(benchmark::State &state, const std::string &text) {
+  std::vector<const util::CharScanner *> scanners = util::char_scanners();
+  if (static_cast<size_t>(state.range(0)) >= scanners.size()) {
+    state.SkipWithError("No such scanner on this cpu");
+    return;
+  }
+  std::string start = util::char_scanner().name;
+  util::use_char_scanner(scanners[state.range(0)]->name);
+  state.SetLabel(scanners[state.range(0)]->name);
+  for (auto _ : state) {
+    PdfLexer lex(text);
+    size_t tokens = 0;
+    while (lex.next().type != PdfTokenType::End)
+      ++tokens;
+    benchmark::DoNotOptimize(tokens);
+  }
+  util::use_char_scanner(start);
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+void BM_LexWideDict(benchmark::State &state) {
+  static const std::string text = wide_dict(4096);
+  lex_with_scanner(state, text);
+}
+BENCHMARK(BM_LexWideDict)->DenseRange(0, 3);
+
+void BM_LexIndentedDict(benchmark::State &state) {
+  static const std::string text = [] {
+    std::string indented;
+    for (char ch : wide_dict(4096)) {
+      if (ch == '/')
+        indented += "\n                ";
+      indented += ch;
+    }
+    return indented;
+  }();
+  lex_with_scanner(state, text);
+}
+BENCHMARK(BM_LexIndentedDict)->DenseRange(0, 3);
+
+} // namespace
@@ -0,0 +1,56 @@
+#ifndef PDF_ARENA_H
+#define PDF_ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <string_view>
+
+/* A monotonic bump allocator that owns everything parsed from a document.
+ * Parsing a big page tree or content stream with new and delete means
+ * millions of tiny allocations, and then freeing them all again one child at a
+ * time in the object destructors. Objects made in an arena just bump a pointer
+ * in a big block, and when the arena goes away all of the blocks are dropped
+ * in one go without running any destructors.
+ *
+ * That only works because everything an arena object holds also lives in the
+ * arena. The containers in the object types use std::pmr so their storage can
+ * come from the arena, and names and strings are views into the arena or the
+ * input rather than owned std::strings. Deleting an arena object is allowed but
+ * does not free anything, see PdfObj::operator delete.
+ *
+ * It is also a std::pmr::memory_resource so it can be handed to any pmr
+ * container directly. It is not thread safe, use one per thread.
+ *
+ * The blocks come from the upstream resource, the heap by default. Giving it a
+ * pool resource instead means released blocks go back to the pool and the
+ * next arena reuses them, which is how a Session keeps memory warm between
+ * documents.
+ */
+class Arena : public std::pmr::memory_resource {
+public:
+  Arena(size_t initial_block_size = 64 * 1024,
+        std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  // Copy bytes into the arena and return a view of the copy
+  std::string_view copy(std::string_view bytes);
+
+  // Total bytes handed out since creation or the last release
+  size_t bytes_used() const { return used; }
+
+  // Drop every block at once. Anything made in the arena is gone after this.
+  void release();
+
+protected:
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override;
+
+private:
+  std::pmr::monotonic_buffer_resource pool;
+  size_t used = 0;
+};
+
+#endif
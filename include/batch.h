@@ -0,0 +1,67 @@
+#ifndef PDF_BATCH_H
+#define PDF_BATCH_H
+
+#include "thread_pool.h"
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class PdfParser;
+
+/* Running one command over a lot of documents. Starting a process for each of
+ * tens of thousands of small files spends more time on startup than on the
+ * files, so batch mode opens every document in one process and works on
+ * several at once on a shared pool. The pool threads, the pooled inflate
+ * states, and the name table are set up once and reused for every file.
+ *
+ * Each document is handled start to finish by one task on the pool, doing its
+ * own work on that thread, since a small file is not worth splitting up.
+ * Output either goes to a file per document, or is collected per document and
+ * written to one stream in the order the paths were given. Only a few
+ * documents per thread are in flight at once, so the collected output that is
+ * waiting its turn stays bounded no matter how many files there are.
+ */
+
+struct BatchOptions {
+  // Write each document's output to a file in this directory named after the
+  // document plus the extension, instead of to the batch's output stream.
+  // Documents with the same name in different directories overwrite each
+  // other.
+  std::string output_dir;
+  std::string extension;
+  // How many documents each pool thread can have in flight
+  size_t files_per_thread = 4;
+  // Read each document through a RangedSource instead of mapping it
+  bool ranged = false;
+};
+
+struct BatchResult {
+  size_t done = 0;
+  size_t failed = 0;
+};
+
+// What to do with one open document. It runs on a pool thread and should do
+// all of its work on that thread.
+using DocumentTask = std::function<void(
+    PdfParser &parser, const std::string &path, std::ostream &os)>;
+
+// Open every path and run the task on it. When the output goes to out, each
+// document's output is preceded by a "==> path <==" line. A document that
+// fails has "pdfcli: path: message" written to err and the batch carries on.
+BatchResult run_batch(const std::vector<std::string> &paths,
+                      const DocumentTask &task, ThreadPool &pool,
+                      std::ostream &out, std::ostream &err,
+                      const BatchOptions &options = BatchOptions());
+
+// Expand the paths that have glob characters in them, in sorted order. A
+// pattern that matches nothing is kept as it is, so it fails like a missing
+// file would. Quoting the pattern gets around the shell's argument limit.
+std::vector<std::string> expand_paths(const std::vector<std::string> &patterns);
+
+// Read paths one per line, skipping blank lines
+std::vector<std::string> read_path_list(std::istream &is);
+
+#endif
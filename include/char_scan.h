@@ -0,0 +1,89 @@
+#ifndef PDF_CHAR_SCAN_H
+#define PDF_CHAR_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/* The character classes of pdf syntax and scanners that find the end of a
+ * run of one class many bytes at a time. Every token the lexer reads starts
+ * by skipping whitespace and most of them end by finding the next delimiter,
+ * so in a file full of dicts and arrays these two loops are a big part of
+ * the time spent lexing.
+ *
+ * Each scanner compares 16 or 32 bytes at once against the class table and
+ * takes the first byte that does not belong to the run from the mask. The
+ * best version the cpu has is picked once at startup, AVX2 if it is there,
+ * otherwise SSE2 on x86 and NEON on ARM, and a byte at a time loop anywhere
+ * else. They all give the same answers.
+ */
+
+namespace util {
+
+enum CharClass : uint8_t { REGULAR = 0, WHITESPACE = 1, DELIMITER = 2 };
+
+struct CharTable {
+  uint8_t classes[256] = {};
+  constexpr CharTable() {
+    for (char ch : std::string_view("\0\t\n\f\r ", 6))
+      classes[static_cast<unsigned char>(ch)] = WHITESPACE;
+    for (char ch : std::string_view("()<>[]{}/%"))
+      classes[static_cast<unsigned char>(ch)] = DELIMITER;
+  }
+};
+
+inline constexpr CharTable CHAR_TABLE;
+
+inline uint8_t char_class(char ch) {
+  return CHAR_TABLE.classes[static_cast<unsigned char>(ch)];
+}
+
+// One set of scanners. Each returns the first byte at or after p that ends
+// the run it looks for, or end.
+struct CharScanner {
+  const char *name;
+  // First byte that is not whitespace
+  const char *(*skip_whitespace)(const char *p, const char *end);
+  // First whitespace or delimiter, the end of a name, number, or keyword
+  const char *(*find_delimiter)(const char *p, const char *end);
+  // First byte a name can not hold as it is: a delimiter, #, or anything
+  // outside ! to ~, which all have to be written as #xx
+  const char *(*find_name_escape)(const char *p, const char *end);
+};
+
+namespace detail {
+// Starts out as the byte at a time scanner and is set to the best one for the
+// cpu during static initialization
+extern const CharScanner *active_scanner;
+} // namespace detail
+
+// Every scanner this build and cpu can run, the byte at a time one first
+std::vector<const CharScanner *> char_scanners();
+// The one in use
+const CharScanner &char_scanner();
+// Use the scanner with this name instead, for benchmarks and tests. Returns
+// false if there is none by that name. Not safe while other threads lex.
+bool use_char_scanner(std::string_view name);
+
+// The common case is a run of one byte or none, like the single space
+// between a key and its value, so that is checked before calling the scanner
+inline const char *skip_pdf_whitespace(const char *p, const char *end) {
+  if (p == end || char_class(*p) != WHITESPACE)
+    return p;
+  if (p + 1 == end || char_class(p[1]) != WHITESPACE)
+    return p + 1;
+  return detail::active_scanner->skip_whitespace(p + 2, end);
+}
+
+inline const char *find_pdf_delimiter(const char *p, const char *end) {
+  return detail::active_scanner->find_delimiter(p, end);
+}
+
+inline const char *find_name_escape(const char *p, const char *end) {
+  return detail::active_scanner->find_name_escape(p, end);
+}
+
+} // namespace util
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef PDF_CONTENT_STREAM_H
+#define PDF_CONTENT_STREAM_H
+
+#include "lexer.h"
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+/* Tokenizer for decoded page content streams. Content is not the object
+ * syntax, it is a list of operands followed by an operator, like
+ *   BT /F1 12 Tf 72 712 Td (Hello) Tj ET
+ * so parse_pdf_obj gives up on the first operator. This reads the operands of
+ * each operator onto one stack that is reused for the whole stream and hands
+ * back the operator with a view of its operands, so nothing is allocated once
+ * the stack has grown to the biggest operator in the stream.
+ *
+ * Operands are the lexer's tokens and point into the buffer. An array or dict
+ * operand, like the array of TJ, shows up as its delimiter tokens with the
+ * tokens inside them in between. true, false and null are operands even
+ * though the lexer calls them keywords.
+ *
+ * Inline images, BI dict ID data EI, come back as a single BI operation whose
+ * operands are the tokens of the dict and whose image is the data. The data
+ * can be binary and can contain EI, so when the dict says how long the data is
+ * it is skipped by that length, and only otherwise found by searching for EI.
+ */
+struct ContentOp {
+  std::string_view op; // the operator
+  const PdfToken *operands = nullptr;
+  size_t count = 0;
+  std::string_view image; // the data of an inline image, for BI only
+  size_t offset = 0;      // position of the operator in the buffer
+
+  const PdfToken *begin() const { return operands; }
+  const PdfToken *end() const { return operands + count; }
+  const PdfToken &operator[](size_t i) const { return operands[i]; }
+
+  // The value of an int or real operand. Throws std::runtime_error if it is
+  // missing or not a number.
+  double number(size_t i) const;
+};
+
+class ContentLexer {
+public:
+  // A lexer over decoded content that is not owned
+  ContentLexer(std::string_view data);
+
+  // Read the next operation. Returns false at the end of the content, and
+  // throws std::runtime_error on malformed input. The operation is only valid
+  // until the next call.
+  bool next(ContentOp &op);
+
+  // Call the visitor with every operation left in the content
+  template <typename Visitor> void for_each(Visitor &&visitor) {
+    ContentOp op;
+    while (next(op))
+      visitor(static_cast<const ContentOp &>(op));
+  }
+
+  size_t position() const { return lex.position(); }
+
+private:
+  void read_inline_image(ContentOp &op);
+  size_t inline_image_length() const;
+
+  PdfLexer lex;
+  std::vector<PdfToken> stack;
+};
+
+#endif
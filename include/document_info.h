@@ -0,0 +1,35 @@
+#ifndef PDF_DOCUMENT_INFO_H
+#define PDF_DOCUMENT_INFO_H
+
+#include <ostream>
+#include <string>
+#include <string_view>
+
+class PdfParser;
+
+/* Summaries of a document for the info and objects commands. Both write plain
+ * lines of text that are easy to grep or to split on spaces, one fact or one
+ * object per line.
+ */
+
+// Write the version, size, object and page counts, whether it is encrypted,
+// and the text entries of the /Info dict as "key: value" lines. A broken
+// page tree is reported as unknown pages rather than failing.
+void write_info(PdfParser &parser, std::ostream &os);
+
+// Write one line for every object in the xref, in object number order:
+//   num gen offset=1234 dict /Page
+//   num 0 objstm=12:3 dict /Font
+// with where the object is, what kind of object it is, and its /Type if it
+// has one. Objects that fail to load say damaged instead of a kind.
+void list_objects(PdfParser &parser, std::ostream &os);
+
+// The version in the %PDF-x.y header, or an empty view if there is none
+std::string_view header_version(std::string_view data);
+
+// A pdf text string as UTF-8. Strings with a UTF-16BE byte order mark are
+// converted, anything else is taken as latin-1, which is close enough to
+// PDFDocEncoding for the letters people actually put in titles.
+std::string text_string_utf8(std::string_view bytes);
+
+#endif
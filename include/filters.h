@@ -0,0 +1,118 @@
+#ifndef PDF_FILTERS_H
+#define PDF_FILTERS_H
+
+#include "inflate_backend.h"
+#include "utility.h"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/* Stream filters as a chain of push based stages. Each stage decodes whatever
+ * bytes are written to it and pushes its output on to the next stage as soon
+ * as its fixed size output buffer fills up, so a chain of Flate and a PNG
+ * predictor, or ASCII85 and Flate, never holds more than a chunk or a row of
+ * any intermediate result at once. The last stage writes into a ByteSink,
+ * which can collect the bytes or send them anywhere else.
+ *
+ * A chain is built from the /Filter and /DecodeParms of a stream dict and can
+ * be used to decode any number of streams with the same filters, its stages
+ * and buffers are reset and reused each time.
+ *
+ * Image only filters like /DCTDecode are not decoded, building a chain for
+ * them throws std::runtime_error.
+ */
+
+namespace util {
+
+// Somewhere for decoded bytes to go
+class ByteSink {
+public:
+  virtual ~ByteSink() = default;
+  virtual void write(const char *data, size_t size) = 0;
+  // Called once after the last write
+  virtual void finish() {}
+};
+
+// Appends everything to a vector
+class VectorSink : public ByteSink {
+public:
+  VectorSink(std::vector<char> &out) : out(out) {}
+  void write(const char *data, size_t size) override {
+    out.insert(out.end(), data, data + size);
+  }
+
+private:
+  std::vector<char> &out;
+};
+
+// One filter in a chain. finish flushes anything buffered and then finishes
+// the next sink.
+class FilterStage : public ByteSink {
+public:
+  FilterStage();
+  void set_next(ByteSink *sink) { next = sink; }
+  // Forget any state from the last stream
+  virtual void reset() { used = 0; }
+  void finish() override;
+
+protected:
+  // Buffer one output byte, or a run of them
+  void put(char ch) {
+    out[used++] = ch;
+    if (used == out.size())
+      flush();
+  }
+  void put(const char *data, size_t size);
+  void flush();
+
+  std::vector<char> out;
+  size_t used = 0;
+  ByteSink *next = nullptr;
+};
+
+// Make the stage for one filter name, with its decode params which may be
+// null. Predictors are not a filter of their own, see make_predictor.
+// Throws std::runtime_error for filters that are not supported.
+std::unique_ptr<FilterStage> make_filter(const PdfName &filter,
+                                         const PdfDict *params);
+
+// The stage for the /Predictor in decode params, or null if there is none
+std::unique_ptr<FilterStage> make_predictor(const PdfDict *params);
+
+class FilterChain {
+public:
+  // The chain for the /Filter and /DecodeParms in a stream dict. With no
+  // /Filter the chain is empty and passes the bytes through.
+  static FilterChain for_dict(const PdfDict &dict);
+
+  void add(std::unique_ptr<FilterStage> stage);
+  size_t size() const { return stages.size(); }
+
+  // Push all of data through the chain into sink, then finish the sink
+  void decode(std::string_view data, ByteSink &sink);
+
+private:
+  std::vector<std::unique_ptr<FilterStage>> stages;
+};
+
+// Decode the payload of a stream through the filters named in its /Filter,
+// using its /DecodeParms. Throws std::runtime_error for anything it cannot
+// decode.
+std::vector<char> decode_stream(const PdfStream &stream);
+
+// A guess at how big a stream will be once decoded, for reserving space. Uses
+// /DL when it is there and otherwise the size of the encoded data.
+size_t decoded_size_hint(const PdfDict &dict, size_t encoded_size);
+
+// Inflate a complete zlib stream held in memory
+std::vector<char> inflate_bytes(std::string_view data);
+
+// Undo a PNG (10-15) or TIFF (2) predictor using the /Colors,
+// /BitsPerComponent, and /Columns from the decode params, which may be null.
+std::vector<char> unpredict(const std::vector<char> &data,
+                            const PdfDict *params);
+
+} // namespace util
+
+#endif
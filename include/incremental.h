@@ -0,0 +1,91 @@
+#ifndef PDF_INCREMENTAL_H
+#define PDF_INCREMENTAL_H
+
+#include "object_cache.h"
+#include "utility.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+class PdfParser;
+
+/* Incremental updates. A pdf is changed by appending the objects that changed,
+ * a new xref section for just those objects, and a trailer whose /Prev points
+ * at the section before it, so a signed and annotated document is the
+ * original file followed by one of these deltas per revision.
+ *
+ * Revisions can be listed without parsing any objects, only the xref sections
+ * themselves, and the objects of a revision are all in its own bytes. The
+ * writer goes the other way and appends a new revision to a document without
+ * touching anything that is already there.
+ */
+
+struct Revision {
+  size_t xref_offset = 0; // where its xref section starts
+  size_t start = 0;       // first byte of the revision, 0 for the original
+  size_t end = 0;         // one past its %%EOF
+  std::vector<int64_t> changed; // objects written in this revision, in order
+  std::vector<int64_t> freed;   // objects deleted in this revision, in order
+};
+
+// Every revision of a document, newest first, following the /Prev chain from
+// the last startxref. Throws std::runtime_error like XrefTable::load.
+std::vector<Revision> find_revisions(std::string_view data);
+
+// Only the newest revision, reading nothing but the last xref section
+Revision latest_revision(std::string_view data);
+
+// Load the objects a revision wrote, as that revision wrote them. Each one is
+// read at the offset the revision's own xref section gives. Objects that are
+// still the current version go through the parser and its cache, older
+// versions that a later revision replaced or freed are parsed on their own and
+// not cached. For the newest revision nothing before the previous %%EOF is
+// parsed. Throws std::runtime_error if an object is not where its section
+// says.
+std::vector<ObjectCache::ObjPtr> revision_objects(PdfParser &parser,
+                                                  const Revision &revision);
+
+/* Collects changes to a document and writes them as one new revision. The
+ * output is only the bytes to append to the original file, with offsets that
+ * count from the start of the original.
+ *
+ * The new section is always a classic xref table. Its trailer keeps the
+ * catalog, info, id and encryption of the document, and /Prev points at the
+ * last section, whichever kind that was.
+ */
+class IncrementalWriter {
+public:
+  // The parser's document is the one being updated and has to outlive this
+  IncrementalWriter(PdfParser &parser);
+
+  // Set object num to a new value, replacing whatever it was
+  void set(int64_t num, std::unique_ptr<util::PdfObj> obj, int64_t gen = 0);
+  // Add a new object and return the number it was given
+  int64_t add(std::unique_ptr<util::PdfObj> obj);
+  // Delete an object. It throws out_of_range for a number the document and
+  // the update do not have.
+  void remove(int64_t num);
+
+  // Number of objects changed so far
+  size_t size() const { return changes.size(); }
+
+  // Write the update. Appending it to the original bytes gives the new file.
+  // Nothing is written when there are no changes.
+  void write(std::ostream &os) const;
+
+private:
+  struct Change {
+    int64_t gen = 0;
+    std::unique_ptr<util::PdfObj> obj; // null when the object is removed
+  };
+
+  PdfParser &parser;
+  std::string_view data;
+  std::map<int64_t, Change> changes;
+  int64_t next_num;
+};
+
+#endif
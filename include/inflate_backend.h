@@ -0,0 +1,123 @@
+#ifndef PDF_INFLATE_BACKEND_H
+#define PDF_INFLATE_BACKEND_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+/* One inflate state from whichever deflate library the project was built
+ * with. By default that is zlib, configuring with -DPDFCLI_ZLIB_NG=ON uses the
+ * native zlib-ng api instead, which is a lot faster at inflating. Everything
+ * that inflates goes through this so the choice is made in one place.
+ *
+ * A state can be reset and reused for any number of streams, which saves
+ * setting up zlib's window for each one.
+ */
+class InflateState {
+public:
+  enum Status {
+    Ok,        // made progress, call again with more input or output space
+    StreamEnd, // the end of the deflate data was reached
+    Error,     // the data is not valid deflate data
+  };
+
+  InflateState();
+  ~InflateState();
+  InflateState(const InflateState &) = delete;
+  InflateState &operator=(const InflateState &) = delete;
+
+  // Get ready for a new stream
+  void reset();
+
+  // Inflate from in into out. in is moved past what was consumed and produced
+  // is set to how many bytes were written to out.
+  Status inflate(std::string_view &in, char *out, size_t out_size,
+                 size_t &produced);
+
+  // The name of the library in use, for messages and stats
+  static const char *backend_name();
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl;
+};
+
+/* Setting up an inflate state allocates zlib's 32KB window and its tables,
+ * which for a document with tens of thousands of small content streams costs
+ * about as much as inflating them. The pool keeps contexts that have already
+ * been set up, each with a pair of I/O buffers, and hands them out to be reset
+ * and reused rather than made again.
+ *
+ * It is safe to use from any thread. A lease goes back to the pool when it is
+ * destroyed, unless the pool already holds max_idle contexts, in which case it
+ * is freed.
+ */
+class InflatePool {
+public:
+  static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+  static constexpr size_t DEFAULT_MAX_IDLE = 64;
+
+  struct Context {
+    InflateState state;
+    std::vector<char> in;
+    std::vector<char> out;
+  };
+
+  class Lease {
+  public:
+    Lease(InflatePool *pool, std::unique_ptr<Context> context)
+        : pool(pool), context(std::move(context)) {}
+    Lease(Lease &&other) = default;
+    Lease &operator=(Lease &&other) = delete;
+    ~Lease();
+
+    Context &operator*() const { return *context; }
+    Context *operator->() const { return context.get(); }
+
+  private:
+    InflatePool *pool;
+    std::unique_ptr<Context> context;
+  };
+
+  // The process wide pool
+  static InflatePool &global();
+
+  InflatePool(size_t buffer_size = DEFAULT_BUFFER_SIZE,
+              size_t max_idle = DEFAULT_MAX_IDLE);
+  InflatePool(const InflatePool &) = delete;
+  InflatePool &operator=(const InflatePool &) = delete;
+
+  // A context that has been reset and is ready for a new stream, with in and
+  // out buffers of buffer_size bytes
+  Lease acquire();
+
+  // Make sure at least count contexts are idle, up to the idle limit, so the
+  // first streams do not pay for setting them up
+  void reserve(size_t count);
+
+  // Size of the buffers in contexts handed out from now on. Bigger buffers
+  // mean fewer calls into zlib for big streams.
+  void set_buffer_size(size_t bytes);
+  size_t buffer_size() const;
+
+  // Contexts waiting to be reused, and contexts made since the pool started
+  size_t idle() const;
+  size_t created() const;
+
+private:
+  void release(std::unique_ptr<Context> context);
+
+  mutable std::mutex mutex;
+  std::vector<std::unique_ptr<Context>> contexts;
+  size_t buffer_bytes;
+  size_t max_idle;
+  size_t created_count = 0;
+};
+
+// Deflate a whole buffer into a zlib stream at a level from 0 to 9, with the
+// same library the inflate states use. Throws std::runtime_error on failure.
+std::vector<char> deflate_buffer(std::string_view data, int level);
+
+#endif
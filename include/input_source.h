@@ -0,0 +1,84 @@
+#ifndef PDF_INPUT_SOURCE_H
+#define PDF_INPUT_SOURCE_H
+
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* A read-only view of all the bytes in a document. Reading a PDF into a
+ * string and then copying it again into a vector means holding the file in
+ * memory at least twice before parsing even starts. This maps the file
+ * instead, so the OS pages it in as the parser touches it and nothing is
+ * copied. Things that cannot be mapped, like pipes or stdin, fall back to
+ * reading into a buffer the source owns. Either way the parser only ever sees
+ * a contiguous span of bytes that lives as long as the source does.
+ */
+class InputSource {
+public:
+  // Map the file read-only, or read it if it cannot be mapped.
+  // Throws std::ios_base::failure if the file cannot be opened or read.
+  static InputSource open(const std::string &filename);
+
+  // Read everything left in a stream into a buffer owned by the source.
+  static InputSource read(std::istream &is);
+
+  // Wrap bytes owned by someone else. They must outlive the source.
+  static InputSource view(std::string_view bytes);
+
+  InputSource(InputSource &&other) noexcept;
+  InputSource &operator=(InputSource &&other) noexcept;
+  InputSource(const InputSource &) = delete;
+  InputSource &operator=(const InputSource &) = delete;
+  ~InputSource();
+
+  std::string_view bytes() const { return std::string_view(start, length); }
+  const char *data() const { return start; }
+  size_t size() const { return length; }
+  bool is_mapped() const { return mapping != nullptr; }
+
+private:
+  InputSource() = default;
+  void unmap();
+
+  const char *start = nullptr;
+  size_t length = 0;
+  void *mapping = nullptr;
+  std::vector<char> buffer;
+};
+
+/* A streambuf over a span of bytes so the istream based parsing functions can
+ * read straight out of an InputSource without copying it into a stringstream.
+ * It also lets a parser that knows it is reading from memory grab a view of
+ * the bytes ahead of the read position, which is how stream payloads can refer
+ * into the mapping instead of being copied out of it.
+ */
+class SpanStreamBuf : public std::streambuf {
+public:
+  SpanStreamBuf(std::string_view bytes);
+
+  // The bytes from the current read position to the end of the span
+  std::string_view remaining() const;
+  // Move the read position forward, clamped to the end of the span
+  void advance(size_t n);
+  // Offset of the read position from the start of the span
+  size_t position() const;
+
+protected:
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override;
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+};
+
+// An istream that owns its SpanStreamBuf
+class SpanStream : public std::istream {
+public:
+  SpanStream(std::string_view bytes);
+  SpanStreamBuf &span() { return buf; }
+
+private:
+  SpanStreamBuf buf;
+};
+
+#endif
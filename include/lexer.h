@@ -0,0 +1,154 @@
+#ifndef PDF_LEXER_H
+#define PDF_LEXER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/* Tokenizer for the PDF object syntax that works on a contiguous buffer. The
+ * istream functions in utility.cpp read one char at a time through the stream
+ * machinery, which is where most of the parse time went. This walks a pointer
+ * over the bytes instead and hands back typed tokens that are views into the
+ * buffer, so nothing is allocated or copied while tokenizing. Strings come
+ * back raw, with their escapes still in place, and can be decoded with the
+ * helpers below if they are actually needed.
+ *
+ * Character classes follow the spec: whitespace is NUL, tab, LF, FF, CR and
+ * space, delimiters are ( ) < > [ ] { } / %, and everything else is a regular
+ * character that can be part of a name, number, or keyword. Comments are
+ * skipped like whitespace.
+ */
+
+enum class PdfTokenType {
+  End,       // no more input
+  Name,      // /Name, text includes the /
+  Int,       // 123 -4 +5
+  Real,      // 1.5 -.002 4.
+  String,    // (literal), text is the raw bytes between the parens
+  HexString, // <48656C6C6F>, text is the raw digits between the brackets
+  Keyword,   // true false null obj endobj stream R and content operators
+  Delimiter, // [ ] << >> { }
+};
+
+struct PdfToken {
+  PdfTokenType type = PdfTokenType::End;
+  std::string_view text;
+  int64_t integer = 0;
+  double real = 0;
+  size_t offset = 0; // position of the token in the buffer
+
+  bool is(PdfTokenType t, std::string_view s) const {
+    return type == t && text == s;
+  }
+  bool is_keyword(std::string_view s) const {
+    return is(PdfTokenType::Keyword, s);
+  }
+  bool is_delimiter(std::string_view s) const {
+    return is(PdfTokenType::Delimiter, s);
+  }
+};
+
+class PdfLexer {
+public:
+  // A lexer over a buffer that is not owned. When stable is true the bytes
+  // outlive anything parsed from them, so parsed objects are allowed to keep
+  // views into the buffer rather than copying out of it.
+  PdfLexer(const char *data, size_t size, bool stable = true);
+  PdfLexer(std::string_view data, bool stable = true);
+
+  // Read the next token. Throws std::runtime_error on malformed input.
+  PdfToken next();
+  // Read the next token without consuming it
+  PdfToken peek();
+
+  // Skip whitespace and comments
+  void skip_whitespace();
+
+  // Read the data of a stream. Expects the next token to be the stream
+  // keyword and leaves the lexer after endstream. The view does not include
+  // the end of line markers around the data. When length is given and the
+  // data really does end there with an endstream after it, the payload is
+  // sliced out directly, which is the only correct way to read binary data
+  // that happens to contain the bytes "endstream". Otherwise it falls back to
+  // searching for the keyword.
+  std::string_view stream_payload(int64_t length = -1);
+
+  // Looks up the value of an indirect /Length, or returns -1 if it can not.
+  // The object parser uses it when a stream dict has /Length N G R.
+  using LengthResolver = std::function<int64_t(int64_t num, int64_t gen)>;
+  void set_length_resolver(LengthResolver resolver) {
+    length_resolver = std::move(resolver);
+  }
+  int64_t resolve_length(int64_t num, int64_t gen) const {
+    return length_resolver ? length_resolver(num, gen) : -1;
+  }
+
+  size_t position() const { return cur - begin; }
+  void seek(size_t pos) { cur = begin + (pos < size() ? pos : size()); }
+  size_t size() const { return end - begin; }
+  bool at_end() const { return cur >= end; }
+  bool stable() const { return bytes_are_stable; }
+  std::string_view remaining() const {
+    return std::string_view(cur, end - cur);
+  }
+  std::string_view buffer() const {
+    return std::string_view(begin, end - begin);
+  }
+
+private:
+  // A short piece of the input to show in error messages
+  std::string_view context(const char *from) const;
+
+  const char *begin;
+  const char *cur;
+  const char *end;
+  bool bytes_are_stable;
+  LengthResolver length_resolver;
+};
+
+namespace util {
+
+// Character classes from the spec, using a table rather than the locale
+// dependent ctype functions.
+bool is_pdf_whitespace(char ch);
+bool is_pdf_delimiter(char ch);
+bool is_pdf_regular(char ch);
+
+struct PdfNumber {
+  bool is_int = false;
+  int64_t integer = 0;
+  double real = 0;
+};
+
+// Convert the whole of text as a pdf number in one pass, telling ints and
+// reals apart by whether there is a point, so forms like .5 -.002 and 5. all
+// work. Reals with up to 15 or so digits are converted exactly by the kernel,
+// longer ones and ints that overflow go to std::from_chars as a double.
+// Returns false if text is not a number.
+bool scan_pdf_number(std::string_view text, PdfNumber &number);
+
+// Position of the first match of needle in haystack, or npos. This uses the C
+// library's memmem where there is one, which is vectorised in glibc, and is
+// what the endstream search runs on when a stream has no usable /Length.
+size_t find_bytes(std::string_view haystack, std::string_view needle);
+
+// Decode the raw text of a literal string token, handling the escapes
+// \n \r \t \b \f \( \) \\ \ddd and backslash line continuations.
+std::string decode_literal_string(std::string_view raw);
+// Decode the raw text of a hex string token. Whitespace is ignored and a
+// missing final digit is taken as 0.
+std::string decode_hex_string(std::string_view raw);
+
+// Decode the #xx escapes in the raw text of a name token, so /A#20B is the
+// name "/A B". A # that is not followed by two hex digits is kept as it is.
+std::string decode_name(std::string_view raw);
+// Whether a name, including its /, has bytes that have to be written as #xx
+bool name_needs_escapes(std::string_view name);
+// The text to write for a name, with delimiters, #, and anything outside of
+// ! to ~ after the / written as #xx. The inverse of decode_name.
+std::string encode_name(std::string_view name);
+
+} // namespace util
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef PDF_NAMES_H
+#define PDF_NAMES_H
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/* Interned pdf names. Real documents use the same few hundred names millions
+ * of times, so every name is mapped to a small integer atom the first time it
+ * is seen and then compared and looked up by that integer. The table is global
+ * and pre-seeded with the well known names below, which get fixed atoms that
+ * are known at compile time, so code can ask a dict for atom::Length without
+ * touching the table at all.
+ *
+ * Names are stored with their leading / so the text of an atom can be used
+ * anywhere a PdfName's data was used before. The text of an atom never moves,
+ * which also means two names are equal exactly when their text pointers are.
+ *
+ * The table only ever grows. That is fine for the names real documents use,
+ * but a document full of unique names will keep them for the life of the
+ * process.
+ */
+
+using PdfAtom = uint32_t;
+
+// X macro of the names that get fixed atoms, in atom order
+#define PDF_WELL_KNOWN_NAMES(X)                                                \
+  X(Type)                                                                      \
+  X(Subtype)                                                                   \
+  X(Length)                                                                    \
+  X(Filter)                                                                    \
+  X(DecodeParms)                                                               \
+  X(DL)                                                                        \
+  X(F)                                                                         \
+  X(N)                                                                         \
+  X(First)                                                                     \
+  X(Extends)                                                                   \
+  X(W)                                                                         \
+  X(Index)                                                                     \
+  X(Size)                                                                      \
+  X(Prev)                                                                      \
+  X(Root)                                                                      \
+  X(Info)                                                                      \
+  X(ID)                                                                        \
+  X(Encrypt)                                                                   \
+  X(XRefStm)                                                                   \
+  X(XRef)                                                                      \
+  X(ObjStm)                                                                    \
+  X(Catalog)                                                                   \
+  X(Pages)                                                                     \
+  X(Page)                                                                      \
+  X(Kids)                                                                      \
+  X(Parent)                                                                    \
+  X(Count)                                                                     \
+  X(Resources)                                                                 \
+  X(MediaBox)                                                                  \
+  X(CropBox)                                                                   \
+  X(Rotate)                                                                    \
+  X(Contents)                                                                  \
+  X(Annots)                                                                    \
+  X(Font)                                                                      \
+  X(BaseFont)                                                                  \
+  X(Encoding)                                                                  \
+  X(Differences)                                                               \
+  X(ToUnicode)                                                                 \
+  X(FontDescriptor)                                                            \
+  X(DescendantFonts)                                                           \
+  X(FirstChar)                                                                 \
+  X(LastChar)                                                                  \
+  X(Widths)                                                                    \
+  X(XObject)                                                                   \
+  X(Image)                                                                     \
+  X(Form)                                                                      \
+  X(Width)                                                                     \
+  X(Height)                                                                    \
+  X(BitsPerComponent)                                                          \
+  X(ColorSpace)                                                                \
+  X(ExtGState)                                                                 \
+  X(Pattern)                                                                   \
+  X(Shading)                                                                   \
+  X(ProcSet)                                                                   \
+  X(Metadata)                                                                  \
+  X(Predictor)                                                                 \
+  X(Colors)                                                                    \
+  X(Columns)                                                                   \
+  X(EarlyChange)                                                               \
+  X(FlateDecode)                                                               \
+  X(LZWDecode)                                                                 \
+  X(ASCIIHexDecode)                                                            \
+  X(ASCII85Decode)                                                             \
+  X(RunLengthDecode)                                                           \
+  X(DCTDecode)                                                                 \
+  X(Outlines)                                                                  \
+  X(Names)                                                                     \
+  X(Title)                                                                     \
+  X(Author)                                                                    \
+  X(Producer)                                                                  \
+  X(Creator)                                                                   \
+  X(CreationDate)                                                              \
+  X(ModDate)
+
+namespace atom {
+enum : PdfAtom {
+#define PDF_NAME_ATOM(name) name,
+  PDF_WELL_KNOWN_NAMES(PDF_NAME_ATOM)
+#undef PDF_NAME_ATOM
+      WELL_KNOWN_COUNT
+};
+} // namespace atom
+
+// The text of the well known names, indexed by atom
+inline constexpr std::string_view WELL_KNOWN_NAMES[] = {
+#define PDF_NAME_TEXT(name) "/" #name,
+    PDF_WELL_KNOWN_NAMES(PDF_NAME_TEXT)
+#undef PDF_NAME_TEXT
+};
+
+// Find the atom of a well known name at compile time, or WELL_KNOWN_COUNT if
+// the name is not one of them.
+constexpr PdfAtom well_known_atom(std::string_view name) {
+  for (PdfAtom i = 0; i < atom::WELL_KNOWN_COUNT; ++i) {
+    if (WELL_KNOWN_NAMES[i] == name)
+      return i;
+  }
+  return atom::WELL_KNOWN_COUNT;
+}
+
+class NameTable {
+public:
+  // The process wide table, safe to use from any thread
+  static NameTable &global();
+
+  NameTable();
+  NameTable(const NameTable &) = delete;
+  NameTable &operator=(const NameTable &) = delete;
+
+  static constexpr PdfAtom NO_ATOM = UINT32_MAX;
+
+  // Atom for a name including its /, adding it if it is new. Optionally
+  // returns the interned text too, to save a second lookup.
+  PdfAtom intern(std::string_view name, std::string_view *text = nullptr);
+  // Atom for a name that is already in the table, or NO_ATOM
+  PdfAtom find(std::string_view name) const;
+  // Text of an atom, including the /. The view is valid forever.
+  std::string_view text(PdfAtom atom) const;
+  size_t size() const;
+
+private:
+  mutable std::shared_mutex mutex;
+  std::deque<std::string> storage; // deque so the strings never move
+  std::deque<std::string_view> texts;
+  std::unordered_map<std::string_view, PdfAtom> atoms;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef PDF_OBJECT_CACHE_H
+#define PDF_OBJECT_CACHE_H
+
+#include "arena.h"
+#include "utility.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+/* A bounded cache of parsed indirect objects, keyed by object number. Code
+ * that follows references keeps coming back to the same few shared objects
+ * like fonts and color spaces, but most of a document is only looked at once,
+ * so keeping everything would cost as much memory as parsing everything.
+ *
+ * Each cached object lives in its own small Arena so evicting it gives all of
+ * its memory back at once. Objects are handed out as shared pointers that keep
+ * their arena alive, so an object that gets evicted while someone is still
+ * using it stays valid until they let it go. The budget only counts what the
+ * cache itself is holding on to.
+ *
+ * When the cache goes over its budget the least recently used objects are
+ * dropped first. It is not thread safe.
+ */
+class ObjectCache {
+public:
+  using ObjPtr = std::shared_ptr<const util::PdfTopLevel>;
+
+  static constexpr size_t DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+  ObjectCache(size_t budget = DEFAULT_BUDGET);
+  ObjectCache(const ObjectCache &) = delete;
+  ObjectCache &operator=(const ObjectCache &) = delete;
+
+  // The cached object or null, marks it as recently used
+  ObjPtr get(int64_t num);
+
+  // Take ownership of an object and the arena it was parsed into, returning the
+  // shared pointer for it. Replaces anything already cached under num. An
+  // object bigger than the whole budget is returned but not kept.
+  ObjPtr put(int64_t num, std::unique_ptr<Arena> arena,
+             const util::PdfTopLevel *obj);
+
+  // Drop one object or every object
+  void erase(int64_t num);
+  void clear();
+
+  // Change the budget, evicting straight away if it went down
+  void set_budget(size_t bytes);
+  size_t budget() const { return max_bytes; }
+
+  // Bytes and objects currently held
+  size_t bytes() const { return used_bytes; }
+  size_t size() const { return index.size(); }
+
+  // Lookups that found an object, lookups that did not, and objects evicted
+  size_t hits() const { return hit_count; }
+  size_t misses() const { return miss_count; }
+  size_t evictions() const { return eviction_count; }
+
+private:
+  struct Entry {
+    int64_t num;
+    size_t bytes;
+    std::unique_ptr<Arena> arena;
+    const util::PdfTopLevel *obj;
+  };
+  using EntryPtr = std::shared_ptr<Entry>;
+
+  static ObjPtr share(const EntryPtr &entry);
+  void evict(size_t target);
+
+  size_t max_bytes;
+  size_t used_bytes = 0;
+  size_t hit_count = 0;
+  size_t miss_count = 0;
+  size_t eviction_count = 0;
+  std::list<EntryPtr> lru; // most recently used at the front
+  std::unordered_map<int64_t, std::list<EntryPtr>::iterator> index;
+};
+
+#endif
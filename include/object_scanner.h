@@ -0,0 +1,84 @@
+#ifndef PDF_OBJECT_SCANNER_H
+#define PDF_OBJECT_SCANNER_H
+
+#include "arena.h"
+#include "utility.h"
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+
+/* Walks a document from start to end and yields each N G obj ... endobj it
+ * finds, without looking at the xref at all. This is the way to read a file
+ * whose xref is broken or missing, and it works on files of any size because
+ * only one object is ever held at a time. Each object is parsed into an arena
+ * that is emptied before the next one, so an object is only valid until the
+ * scanner moves on.
+ *
+ * Anything between objects that is not an object, like the xref table, the
+ * trailer, or junk, is skipped by searching for the next obj keyword with an
+ * object and generation number before it. An object that fails to parse is
+ * counted and skipped the same way, so one damaged object does not stop the
+ * scan.
+ *
+ * It can be used as a range:
+ *   for (const util::PdfTopLevel &obj : ObjectScanner(data)) ...
+ */
+class ObjectScanner {
+public:
+  ObjectScanner(std::string_view data);
+  ObjectScanner(const ObjectScanner &) = delete;
+  ObjectScanner &operator=(const ObjectScanner &) = delete;
+
+  // The next object, or null at the end of the data. The object is owned by
+  // the scanner and goes away on the next call.
+  const util::PdfTopLevel *next();
+
+  // Byte offset where the last object returned started
+  size_t offset() const { return last_offset; }
+  // Objects that looked like objects but could not be parsed
+  size_t errors() const { return error_count; }
+
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = util::PdfTopLevel;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const util::PdfTopLevel *;
+    using reference = const util::PdfTopLevel &;
+
+    iterator() = default;
+    explicit iterator(ObjectScanner *s) : scanner(s) { ++*this; }
+
+    reference operator*() const { return *current; }
+    pointer operator->() const { return current; }
+    iterator &operator++() {
+      current = scanner->next();
+      if (current == nullptr)
+        scanner = nullptr;
+      return *this;
+    }
+    bool operator==(const iterator &other) const {
+      return scanner == other.scanner;
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+  private:
+    ObjectScanner *scanner = nullptr;
+    const util::PdfTopLevel *current = nullptr;
+  };
+
+  iterator begin() { return iterator(this); }
+  iterator end() { return iterator(); }
+
+private:
+  // Find where the next N G obj starts at or after from
+  bool find_object(size_t from, size_t &start) const;
+
+  std::string_view data;
+  size_t pos = 0;
+  size_t last_offset = 0;
+  size_t error_count = 0;
+  Arena arena;
+};
+
+#endif
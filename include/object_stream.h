@@ -0,0 +1,51 @@
+#ifndef PDF_OBJECT_STREAM_H
+#define PDF_OBJECT_STREAM_H
+
+#include "arena.h"
+#include "pdf_value.h"
+#include "utility.h"
+#include <cstdint>
+#include <vector>
+
+/* The decoded contents of an object stream, a stream with /Type /ObjStm that
+ * packs a lot of small indirect objects together so they can be compressed.
+ * The stream starts with /N pairs of object number and offset, and the offsets
+ * count from /First. The objects themselves are written without the N G obj
+ * and endobj around them, and they can not be streams.
+ *
+ * Decoding the stream is the expensive part, so it is done once up front and
+ * the objects are parsed out of the decoded bytes as they are asked for.
+ */
+class ObjectStream {
+public:
+  // Decode the stream and read its header. Throws std::runtime_error if it is
+  // not an object stream or the header does not make sense.
+  ObjectStream(const util::PdfStream &stream);
+
+  // Number of objects in the stream
+  size_t size() const { return numbers.size(); }
+
+  // Object number of the object at an index
+  int64_t number(size_t index) const { return numbers.at(index); }
+
+  // Index of an object number, or -1 if it is not in this stream
+  int64_t find(int64_t num) const;
+
+  // Parse the object at an index into the arena, wrapped in a PdfTopLevel with
+  // generation 0. Strings are always copied, so the result does not depend on
+  // this object staying around.
+  util::PdfTopLevel *parse(size_t index, Arena &arena) const;
+  // The same object as a value in the graph, without the PdfTopLevel. Strings
+  // are copied into the graph for the same reason.
+  PdfValue parse(size_t index, PdfGraph &graph) const;
+
+  // Bytes of decoded data held
+  size_t bytes() const { return decoded.size(); }
+
+private:
+  std::vector<char> decoded;
+  std::vector<int64_t> numbers;
+  std::vector<size_t> offsets; // from the start of decoded, already past First
+};
+
+#endif
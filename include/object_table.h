@@ -0,0 +1,66 @@
+#ifndef PDF_OBJECT_TABLE_H
+#define PDF_OBJECT_TABLE_H
+
+#include "pdf_value.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/* Every indirect object of a document, indexed by object number. This is what
+ * PdfParser::parse_all builds. Unlike the ObjectCache nothing is ever evicted,
+ * the table holds the whole document until it goes away.
+ *
+ * The objects are parsed in parallel, each worker into its own PdfGraph, so
+ * the table keeps all of those graphs alive rather than having one of its own.
+ * Each object is a compact PdfValue in one of them, use the graph to read it
+ * or PdfGraph::to_obj for code that wants a PdfObj. Objects are only read
+ * after they are added, so it is safe to share a finished table between
+ * threads.
+ */
+class ObjectTable {
+public:
+  // One indirect object. Its value and everything in it lives in graph.
+  struct Object {
+    int64_t num = -1;
+    int64_t gen = 0;
+    const PdfGraph *graph = nullptr;
+    PdfValue value;
+  };
+
+  ObjectTable() = default;
+  ObjectTable(ObjectTable &&) = default;
+  ObjectTable &operator=(ObjectTable &&) = default;
+
+  // The object with the given number, or null if there is none
+  const Object *get(int64_t num) const {
+    return num >= 0 && static_cast<size_t>(num) < objects.size() &&
+                   objects[num].graph != nullptr
+               ? &objects[num]
+               : nullptr;
+  }
+
+  // Number of objects held
+  size_t size() const { return count; }
+
+  // Object numbers that are in the xref but could not be parsed, in order
+  const std::vector<int64_t> &damaged() const { return failed; }
+
+  // Every slot indexed by object number, empty ones have a null graph
+  const std::vector<Object> &all() const { return objects; }
+
+  // Take ownership of a graph whose objects are about to be added
+  void keep(std::unique_ptr<PdfGraph> graph);
+  // Add an object, replacing anything already under its number
+  void add(const Object &obj);
+  void add_damaged(int64_t num) { failed.push_back(num); }
+  // Put the damaged list in order once every worker has reported
+  void sort_damaged();
+
+private:
+  std::vector<std::unique_ptr<PdfGraph>> graphs;
+  std::vector<Object> objects;
+  std::vector<int64_t> failed;
+  size_t count = 0;
+};
+
+#endif
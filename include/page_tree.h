@@ -0,0 +1,92 @@
+#ifndef PDF_PAGE_TREE_H
+#define PDF_PAGE_TREE_H
+
+#include "object_cache.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+class PdfParser;
+
+/* The pages of a document in order. The catalog's /Pages is a tree of /Pages
+ * nodes whose /Kids are more nodes or /Page leaves, and the order of the
+ * leaves is the order of the pages.
+ *
+ * Nothing is walked up front. Every node says how many pages are under it in
+ * /Count, so finding page N means reading the kids of one node per level and
+ * skipping whole subtrees by their counts, without ever loading what is below
+ * them. Getting page 4000 of a 5000 page document touches a few dozen objects
+ * instead of every earlier page. A node with a missing or broken /Count is
+ * counted by walking it instead. A node that is reached twice, by a loop or
+ * by two parents sharing it, is an error rather than being walked again.
+ *
+ * The first time a node is gone through, the running total of its kids'
+ * counts is kept, so every later page under it is a binary search instead of
+ * going through the kids again. Reading the pages of a flat /Kids in order
+ * costs one pass over the kids in all, not one per page.
+ *
+ * Some page attributes can be set on any node above a page and are inherited
+ * by every page below it. The Page that comes back has them already resolved.
+ *
+ * When the parser was given a page index, say from a sidecar file, the tree
+ * is not descended at all. The page is loaded by its number and the inherited
+ * values are found by following /Parent up from it instead.
+ */
+class PageTree {
+public:
+  using ObjHandle = std::shared_ptr<const util::PdfObj>;
+
+  struct Page {
+    ObjectCache::ObjPtr obj; // the page object itself
+    // The page's own values, or the ones inherited from the nearest node
+    // above that has them. Null when no node has them.
+    ObjHandle resources;
+    ObjHandle media_box;
+    ObjHandle crop_box;
+    ObjHandle rotate;
+
+    const util::PdfDict &dict() const;
+  };
+
+  // Find the page tree of the parser's document. Throws std::runtime_error if
+  // there is no catalog or page tree.
+  PageTree(PdfParser &parser);
+
+  // Number of pages, from the /Count of the root node
+  size_t count() const { return total; }
+
+  // The page at a zero based index. Throws std::out_of_range past the last
+  // page and std::runtime_error if the tree is broken on the way down. Not
+  // safe to call from more than one thread at once, like the parser.
+  Page page(size_t index) const;
+
+  // The object number of every page in order, found by walking the whole
+  // tree. This is what goes in a page index.
+  std::vector<int64_t> page_numbers() const;
+
+private:
+  struct Inherited;
+  // The kids of a node and the number of pages up to and including each one
+  struct Kids {
+    std::vector<std::pair<int64_t, int64_t>> refs;
+    std::vector<size_t> ends;
+  };
+  const Kids &kids_of(const ObjectCache::ObjPtr &node, int depth) const;
+  size_t node_count(const ObjectCache::ObjPtr &node, int depth,
+                    std::unordered_set<int64_t> &seen) const;
+  Page indexed_page(size_t index) const;
+  void collect(const ObjectCache::ObjPtr &node, int depth,
+               std::unordered_set<int64_t> &seen,
+               std::vector<int64_t> &nums) const;
+
+  PdfParser &parser;
+  ObjectCache::ObjPtr root;
+  size_t total = 0;
+  // Filled in as page goes down through nodes, by object number
+  mutable std::unordered_map<int64_t, Kids> kids_cache;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef PDF_EVENTS_H
+#define PDF_EVENTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+class PdfLexer;
+struct PdfToken;
+
+/* An event based way to parse objects, like SAX for xml. Instead of building
+ * a tree the parser calls a handler as it reads each part of an object, so a
+ * handler that only cares about a few dicts never allocates anything for the
+ * rest. The DOM parser, util::parse_pdf_obj, is itself just a handler that
+ * builds PdfObjs from the events.
+ *
+ * A dict is begin_dict, then a key and a value for each entry, then end_dict.
+ * When the dict turns out to be the dict of a stream, begin_stream comes
+ * instead of end_dict, followed by the payload in one or more stream_data
+ * chunks and end_stream. An indirect object N G obj ... endobj wraps its value
+ * in begin_object and end_object.
+ *
+ * Every view handed to a handler points into the lexer's buffer and is only
+ * valid as long as that buffer is. Names have their #xx escapes decoded, the
+ * ones that had any are interned and valid forever. Strings are raw, with
+ * their escapes still in place, see util::decode_literal_string and
+ * util::decode_hex_string.
+ */
+class PdfEventHandler {
+public:
+  virtual ~PdfEventHandler() = default;
+
+  virtual void null_value() {}
+  virtual void bool_value(bool) {}
+  virtual void int_value(int64_t) {}
+  virtual void real_value(double) {}
+  virtual void name_value(std::string_view) {} // includes the /
+  virtual void string_value(std::string_view, bool /* hex */) {}
+  virtual void ref_value(int64_t /* num */, int64_t /* gen */) {}
+
+  virtual void begin_array() {}
+  virtual void end_array() {}
+
+  virtual void begin_dict() {}
+  virtual void key(std::string_view) {} // includes the /
+  virtual void end_dict() {}
+
+  virtual void begin_stream() {}
+  virtual void stream_data(std::string_view) {}
+  virtual void end_stream() {}
+
+  virtual void begin_object(int64_t /* num */, int64_t /* gen */) {}
+  virtual void end_object() {}
+};
+
+class PdfEventParser {
+public:
+  // Stream payloads are handed out in chunks of at most this many bytes
+  static constexpr size_t STREAM_CHUNK_SIZE = 64 * 1024;
+  // Arrays, dicts and objects inside each other deeper than this are an
+  // error. The parser recurses once per level, and so does freeing the tree
+  // built from it, so a file of nothing but [ would run off the stack.
+  static constexpr size_t MAX_NESTING_DEPTH = 512;
+
+  PdfEventParser(PdfLexer &lex);
+
+  // Read the next object and send its events to the handler. Throws
+  // std::runtime_error on bad syntax or nesting past MAX_NESTING_DEPTH, after
+  // whatever events came before it.
+  void parse_object(PdfEventHandler &handler);
+
+  // The same for an object whose first token has already been read
+  void parse_token(const PdfToken &token, PdfEventHandler &handler);
+
+  // The rest of an array or dict after its [ or << has been read. Streams are
+  // only looked for after a dict when allow_stream is true.
+  void parse_array_body(PdfEventHandler &handler);
+  void parse_dict_body(PdfEventHandler &handler, bool allow_stream = true);
+
+private:
+  struct Nested;
+  void parse_int(const PdfToken &num, PdfEventHandler &handler);
+  void parse_stream(int64_t length, PdfEventHandler &handler);
+
+  PdfLexer &lex;
+  size_t depth = 0; // arrays, dicts and objects open right now
+  // The last int or ref value, which is how a dict finds its /Length
+  int64_t last_int = -1;
+  bool last_was_ref = false;
+  int64_t last_ref_gen = 0;
+};
+
+#endif
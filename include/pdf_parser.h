@@ -1,7 +1,22 @@
 #ifndef PDF_PARSER_H
 #define PDF_PARSER_H
 
+#include "arena.h"
+#include "input_source.h"
+#include "object_cache.h"
+#include "object_stream.h"
+#include "object_table.h"
+#include "range_reader.h"
+#include "thread_pool.h"
+#include "utility.h"
+#include "xref.h"
+#include <list>
+#include <memory>
+#include <ostream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 /* I want to experiment with PDFs, they seem pretty cool underneath. This class
@@ -15,19 +30,164 @@
  * used to decompress a stream on the fly from a file stream without having to
  * read the whole PDF into memory. I think I will try to setup the parser to
  * work with an input stream instead of a string.
+ *
+ * The parser now works on a span of bytes rather than a string, so it can
+ * read straight out of a memory mapped InputSource. It does not own the bytes
+ * and the source must outlive it.
+ *
+ * Objects can also be loaded one at a time through the cross reference index,
+ * so a single object can be read without parsing the rest of the file.
+ *
+ * Given a RangedSource the bytes are read as they are needed instead of all
+ * being there up front. The xref is read from the end of the file, and each
+ * object is fetched before it is parsed, taken to run from its offset to the
+ * next offset the xref knows about. Anything that works on the whole document
+ * at once fetches all of it first. If an object does not parse out of what
+ * was fetched for it, the rest of the file is read and it is tried again, so a
+ * ranged parse gives the same results as any other, only with fewer reads.
  */
 class PdfParser {
 public:
-  // Initialize the parser with a reference to the string of bytes.
-  PdfParser(const std::string &data);
+  // Initialize the parser with a view of the bytes of a document.
+  PdfParser(std::string_view data);
+  PdfParser(const InputSource &source);
+  // The same, with the parser's arenas taking their blocks from memory, which
+  // must outlive the parser and be thread safe if parse_all is used. The
+  // graphs of a table from parse_all use it too, so it must outlive those.
+  PdfParser(std::string_view data, std::pmr::memory_resource *memory,
+            size_t cache_budget = ObjectCache::DEFAULT_BUDGET);
+  // Read the document through a ranged source, which must outlive the parser
+  PdfParser(RangedSource &source,
+            std::pmr::memory_resource *memory = std::pmr::new_delete_resource(),
+            size_t cache_budget = ObjectCache::DEFAULT_BUDGET);
 
   // A simple way to decode the streams in a pdf that uses deflate compression.
   // For now it is a way to allow me to better inspect an actual pdf in full
   // without the compression, but before I build the full parser.
+  // It builds the whole result in memory, use inflate_to for big files.
   std::string naive_inflate();
 
+  // Write the document to os with every deflate stream decompressed, as it
+  // goes. It uses one pooled zlib state and its fixed size buffers, so memory
+  // use does not grow with the size of the document or of any one stream.
+  // Streams that are not deflate data are written as they are.
+  void inflate_to(std::ostream &os);
+
+  // The same output as inflate_to, but the streams are inflated on a thread
+  // pool while the bytes between them are written in order. Memory grows with
+  // the number of threads and the size of the streams in flight instead of
+  // being constant. Threads of 0 uses every core.
+  void parallel_inflate_to(std::ostream &os, size_t threads = 0);
+  void parallel_inflate_to(std::ostream &os, ThreadPool &pool);
+
+  // Parse the object that starts at the given byte offset. The result is owned
+  // by the parser's arena.
+  util::PdfObj *parse_at(size_t offset);
+
+  // The cross reference index, loaded the first time it is needed. Throws
+  // std::runtime_error if the document has no usable xref.
+  const XrefTable &xref();
+
+  // Use an index that was loaded from somewhere else, like a sidecar file,
+  // instead of reading the xref from the document. The page object numbers
+  // are optional, when they are given PageTree finds pages by looking them up
+  // instead of walking down the tree. Anything already cached is dropped, since
+  // it was loaded through the old index.
+  void use_index(XrefTable table, std::vector<int64_t> pages = {});
+
+  // The page object numbers given to use_index, in page order. Empty when the
+  // pages are not known up front.
+  const std::vector<int64_t> &page_index() const { return pages; }
+
+  // Load an indirect object by number through the xref. Returns null if the
+  // object is missing or free, or its generation does not match. Loaded
+  // objects are kept in the parser's object cache, and the pointer stays valid
+  // for as long as it is held even if the cache drops the object.
+  ObjectCache::ObjPtr get_object(int64_t num, int64_t gen = 0);
+
+  // Follow a reference to the object it points at, loading it if needed. If
+  // obj is not a reference it is returned as is, without taking ownership of
+  // it. Returns null for a reference to a missing object, which the spec says
+  // should be treated as null.
+  std::shared_ptr<const util::PdfObj> resolve(const util::PdfObj *obj);
+
+  // The decoded object stream with the given object number, decoding it the
+  // first time it is asked for. Throws std::runtime_error if that object is
+  // not an object stream.
+  std::shared_ptr<const ObjectStream> object_stream(int64_t num);
+
+  // Parse every object in the xref at once on a thread pool and return them
+  // all. The objects in the file are split by offset into ranges that are
+  // parsed in parallel, each into its own graph, and then the object streams
+  // are unpacked in parallel too. Objects that fail to parse are listed as
+  // damaged instead of stopping the parse. This does not touch the object
+  // cache. Threads of 0 uses every core.
+  ObjectTable parse_all(size_t threads = 0);
+  ObjectTable parse_all(ThreadPool &pool);
+
+  // Fetch these objects from a ranged source in one batch so loading them
+  // afterwards does not wait on each one in turn. Objects in object streams
+  // fetch their stream. Does nothing for any other source.
+  void prefetch(const std::vector<int64_t> &nums);
+
+  // Fetch the objects and everything they refer to, a batch for each level of
+  // references, so a page and its resources, fonts, and content streams take
+  // a few round trips instead of one per object. /Parent is not followed and
+  // other pages that are referred to are not gone into, so the closure of a
+  // page stays that page's. Does nothing for any other source.
+  void prefetch_closure(const std::vector<int64_t> &roots);
+
+  // The bytes of the document. With a ranged source only the parts that have
+  // been fetched are there, use fetch_bytes or fetch_all before reading them.
+  std::string_view bytes() const { return data; }
+  std::string_view fetch_bytes(uint64_t offset, uint64_t length);
+  void fetch_all();
+
+  // The source the parser reads through, or null if it has all the bytes
+  RangedSource *ranged_source() const { return ranged; }
+
+  // The cache used by get_object. Its budget can be changed at any time.
+  ObjectCache &cache() { return objects; }
+  // Bytes of decoded object streams held, which share the cache's budget
+  size_t object_stream_bytes() const { return stream_bytes; }
+
 protected:
-  const std::string &data;
+  // Where a stream's payload starts and where its endstream is
+  struct StreamSpan {
+    size_t start;
+    size_t end;
+  };
+  // Every stream payload in the document in order. The objects the xref
+  // lists are parsed to find them, so a stream keyword only counts right
+  // after a dict and the payload is sliced by its /Length.
+  std::vector<StreamSpan> stream_spans();
+
+  ObjectCache::ObjPtr load_compressed(int64_t num, const XrefEntry &entry);
+  int64_t indirect_length(int64_t num, int64_t gen);
+  // Where the object starting at offset ends, as far as the xref can tell
+  uint64_t object_end(uint64_t offset);
+  void fetch_object(uint64_t offset);
+
+  std::string_view data;
+  RangedSource *ranged = nullptr;
+  // Every object and section offset in the xref and the end of the file, in
+  // order. Built the first time a ranged parser needs to bound an object.
+  std::vector<uint64_t> boundaries;
+  std::pmr::memory_resource *memory;
+  Arena arena;
+  std::unique_ptr<XrefTable> xref_table;
+  std::vector<int64_t> pages;
+  ObjectCache objects;
+  // Decoded object streams are kept so that each one is only inflated once no
+  // matter how many objects come out of it. Their bytes count against the
+  // cache budget along with the objects, and the least recently used are
+  // dropped once the two together go over it.
+  using StreamEntry = std::pair<int64_t, std::shared_ptr<const ObjectStream>>;
+  std::list<StreamEntry> stream_lru;
+  std::unordered_map<int64_t, std::list<StreamEntry>::iterator> streams;
+  size_t stream_bytes = 0;
+  // Objects part way through loading, to catch loops through /Length refs
+  std::unordered_set<int64_t> loading;
 };
 
 #endif
@@ -0,0 +1,175 @@
+#ifndef PDF_VALUE_H
+#define PDF_VALUE_H
+
+#include "arena.h"
+#include "utility.h"
+#include <cstdint>
+#include <memory_resource>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+class PdfLexer;
+
+/* A compact value type for pdf objects. The PdfObj classes each live in their
+ * own allocation, so walking a big object tree is mostly pointer chasing. A
+ * PdfValue is a 16 byte tagged union instead. Scalars are stored inline, names
+ * are a pointer and a length into the NameTable, strings are a pointer and a
+ * length into the input or the graph's arena, and arrays and dicts refer to a
+ * contiguous run of child values in the PdfGraph that owns them.
+ *
+ * Dict children are stored as alternating key and value. A stream refers to a
+ * run of two values, its dict and its payload as a string, and an indirect
+ * object N G obj to a run of two as well, N as an int and then its value, with
+ * G kept inline like the generation of a ref.
+ *
+ * Comparing, writing, and visiting all switch on the tag.
+ */
+struct PdfValue {
+  util::PdfType type = util::PdfType::Null;
+  uint16_t gen = 0;  // generation of a ref or an indirect object
+  uint32_t size = 0; // bytes of text, items of an array, or pairs of a dict
+  union {
+    bool boolean;
+    int64_t integer; // int value or the object number of a ref
+    double real;
+    const char *text; // name or string bytes
+    uint64_t first;   // index of the first child in the graph
+  };
+
+  PdfValue() : integer(0) {}
+
+  std::string_view str() const { return std::string_view(text, size); }
+};
+
+static_assert(sizeof(PdfValue) == 16, "PdfValue should stay 16 bytes");
+
+// Views handed to visitors so they can tell the kinds apart by overload
+struct PdfRefValue {
+  int64_t num;
+  uint16_t gen;
+};
+struct PdfNameValue {
+  std::string_view data;
+};
+struct PdfStringValue {
+  std::string_view data;
+};
+struct PdfArrayValue {
+  const PdfValue *items;
+  size_t size;
+  const PdfValue *begin() const { return items; }
+  const PdfValue *end() const { return items + size; }
+};
+struct PdfDictValue {
+  const PdfValue *items; // key, value, key, value ...
+  size_t size;           // number of pairs
+  const PdfValue &key(size_t i) const { return items[2 * i]; }
+  const PdfValue &value(size_t i) const { return items[2 * i + 1]; }
+};
+struct PdfStreamValue {
+  const PdfValue &dict;
+  std::string_view payload;
+};
+struct PdfObjectValue {
+  int64_t num;
+  uint16_t gen;
+  const PdfValue &value;
+};
+
+/* Owns the children of any values parsed into it. Values stay valid until the
+ * graph is cleared or destroyed. Strings and stream payloads borrow from the
+ * input when the lexer says the input is stable, otherwise they are copied
+ * into the graph's arena. Names are always interned.
+ *
+ * The graph is built from PdfEventParser events like the PdfObj trees are, so
+ * it takes the same syntax and has the same nesting limit. Node storage and
+ * the arena both come from the memory resource given, so a parser can keep a
+ * whole document's graphs in its own memory.
+ */
+class PdfGraph {
+public:
+  PdfGraph(size_t arena_size = 16 * 1024,
+           std::pmr::memory_resource *memory = std::pmr::new_delete_resource());
+
+  // Parse the next object from the lexer, including N G obj ... endobj.
+  // Throws std::runtime_error like util::parse_pdf_obj, and a generation over
+  // 65535 is an error too.
+  PdfValue parse(PdfLexer &lex);
+
+  // Children of an array, dict, stream, or indirect object value. Asking for
+  // the wrong kind gives an empty array or dict, or a null value.
+  PdfArrayValue array(const PdfValue &v) const;
+  PdfDictValue dict(const PdfValue &v) const;
+  PdfStreamValue stream(const PdfValue &v) const;
+  PdfObjectValue object(const PdfValue &v) const;
+
+  // Look up a key in a dict or the dict of a stream, key includes the /.
+  // Returns null if it is missing. When a key is repeated the last one wins,
+  // like it does in a PdfDict. Names in a graph are interned, so looking up by
+  // atom only compares pointers.
+  const PdfValue *find(const PdfValue &dict, std::string_view key) const;
+  const PdfValue *find(const PdfValue &dict, PdfAtom key) const;
+
+  // Call the visitor with the value as one of bool, int64_t, double,
+  // nullptr_t, or one of the view structs above.
+  template <typename Visitor>
+  decltype(auto) visit(const PdfValue &v, Visitor &&visitor) const {
+    switch (v.type) {
+    case util::PdfType::Bool:
+      return visitor(v.boolean);
+    case util::PdfType::Int:
+      return visitor(v.integer);
+    case util::PdfType::Real:
+      return visitor(v.real);
+    case util::PdfType::Name:
+      return visitor(PdfNameValue{v.str()});
+    case util::PdfType::String:
+      return visitor(PdfStringValue{v.str()});
+    case util::PdfType::Ref:
+      return visitor(PdfRefValue{v.integer, v.gen});
+    case util::PdfType::Array:
+      return visitor(array(v));
+    case util::PdfType::Dict:
+      return visitor(dict(v));
+    case util::PdfType::Stream:
+      return visitor(stream(v));
+    case util::PdfType::TopLevel:
+      return visitor(object(v));
+    default:
+      return visitor(nullptr);
+    }
+  }
+
+  // Write a value in the same syntax as PdfObj::write, except that dicts keep
+  // the order they were parsed in.
+  void write(std::ostream &os, const PdfValue &v) const;
+
+  // Build the equivalent heap allocated PdfObj tree, for code that still
+  // works with the class hierarchy. The caller owns the result, and it does
+  // not borrow anything from the graph.
+  util::PdfObj *to_obj(const PdfValue &v) const;
+
+  // Number of child values stored
+  size_t node_count() const { return nodes.size(); }
+
+  // Forget every value parsed so far but keep the node storage for reuse
+  void clear();
+
+private:
+  class Builder;
+  PdfValue close_children(util::PdfType type, size_t mark, uint32_t size);
+
+  std::pmr::vector<PdfValue> nodes;
+  // Children of containers still being parsed, moved to nodes as each one
+  // closes so every container's children end up next to each other
+  std::pmr::vector<PdfValue> scratch;
+  Arena strings;
+};
+
+// Deep comparison of two values, which can be in different graphs. Dict keys
+// can be in any order.
+bool values_equal(const PdfGraph &ga, const PdfValue &a, const PdfGraph &gb,
+                  const PdfValue &b);
+
+#endif
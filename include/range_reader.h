@@ -0,0 +1,163 @@
+#ifndef PDF_RANGE_READER_H
+#define PDF_RANGE_READER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Reading a document in pieces from somewhere slow. Mapping a file is the
+ * right thing when it is on a local disk, but on network storage every page
+ * fault the parser takes is a round trip, and the parser jumps all over the
+ * file following the xref. A hundred objects scattered around is a hundred
+ * round trips one after the other.
+ *
+ * A RangeReader is the backend, it only knows how to read byte ranges of one
+ * document. It is handed a whole batch of ranges at once so a backend that
+ * can have reads in flight together gets to, and the batch costs about one
+ * round trip instead of one per range. Shipped here are a plain pread one and
+ * an io_uring one for files. Anything else that can read ranges plugs in the
+ * same way, an HTTP backend would answer size with the Content-Length of a
+ * HEAD and read with Range requests, several ranges to a request or several
+ * requests on their own connections.
+ *
+ * A RangedSource sits on top of a backend and looks like any other source to
+ * the parser, one span with every byte of the document in it. The span is
+ * reserved up front, but a block of it is only read the first time something
+ * asks for it with fetch. Until then it is zeros. The parser knows from the
+ * xref where each object starts and ends, so it fetches an object's bytes
+ * before it parses it, and prefetch_closure on the parser fetches everything
+ * a page needs in a batch per level of references. Whole document work like
+ * parse_all or inflate_to fetches the lot first, which the io_uring backend
+ * still does as many reads at once.
+ */
+
+struct ByteRange {
+  uint64_t offset = 0;
+  uint64_t length = 0;
+};
+
+// One read of a batch, into memory owned by the caller
+struct ReadRequest {
+  uint64_t offset;
+  size_t length;
+  char *dest;
+};
+
+class RangeReader {
+public:
+  virtual ~RangeReader() = default;
+
+  // Size of the whole document in bytes
+  virtual uint64_t size() const = 0;
+
+  // Fill every request in the batch. A backend should have as many of them
+  // in flight at once as it can. Requests never reach past size. Throws
+  // std::ios_base::failure if any of them can not be read in full.
+  virtual void read(const std::vector<ReadRequest> &requests) = 0;
+};
+
+// Reads with pread, one request after another. Works anywhere.
+class FileRangeReader : public RangeReader {
+public:
+  // Throws std::ios_base::failure if the file can not be opened
+  explicit FileRangeReader(const std::string &path);
+  ~FileRangeReader() override;
+  FileRangeReader(const FileRangeReader &) = delete;
+  FileRangeReader &operator=(const FileRangeReader &) = delete;
+
+  uint64_t size() const override { return length; }
+  void read(const std::vector<ReadRequest> &requests) override;
+
+private:
+  int fd = -1;
+  uint64_t length = 0;
+};
+
+#ifdef __linux__
+/* Reads through an io_uring ring so a whole batch is in flight at once. It
+ * talks to the kernel with the raw system calls, there is no liburing
+ * dependency. Up to the queue depth of reads are submitted together and
+ * refilled as they complete, and a short read is sent again for the rest.
+ */
+class UringRangeReader : public RangeReader {
+public:
+  // Null when the kernel has no io_uring or it is not allowed, like under
+  // some seccomp profiles. Throws std::ios_base::failure if the file can not
+  // be opened.
+  static std::unique_ptr<UringRangeReader> open(const std::string &path,
+                                                unsigned depth = 32);
+  ~UringRangeReader() override;
+  UringRangeReader(const UringRangeReader &) = delete;
+  UringRangeReader &operator=(const UringRangeReader &) = delete;
+
+  uint64_t size() const override { return length; }
+  void read(const std::vector<ReadRequest> &requests) override;
+
+private:
+  struct Ring;
+  UringRangeReader(int fd, uint64_t length, std::unique_ptr<Ring> ring);
+
+  int fd = -1;
+  uint64_t length = 0;
+  std::unique_ptr<Ring> ring;
+};
+#endif
+
+// The io_uring reader when it can be set up, pread otherwise. Throws
+// std::ios_base::failure if the file can not be opened.
+std::unique_ptr<RangeReader> open_range_reader(const std::string &path);
+
+class RangedSource {
+public:
+  // The span is cut into blocks of this size and each block is read once
+  static const size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+  explicit RangedSource(std::unique_ptr<RangeReader> reader,
+                        size_t block_size = DEFAULT_BLOCK_SIZE);
+  ~RangedSource();
+  // The parser holds on to the span and the source, so it can not move
+  RangedSource(const RangedSource &) = delete;
+  RangedSource &operator=(const RangedSource &) = delete;
+
+  // Every byte of the document, only meaningful where it has been fetched
+  std::string_view bytes() const { return std::string_view(start, length); }
+  size_t size() const { return length; }
+
+  // Make sure every byte of the ranges is in the span, reading the blocks
+  // that are not yet in one batch. Parts of a range past the end are
+  // ignored. Safe to call from any thread.
+  void fetch(const std::vector<ByteRange> &ranges);
+  void fetch(uint64_t offset, uint64_t length) { fetch({{offset, length}}); }
+  void fetch_all() { fetch(0, length); }
+
+  // Whether the bytes are already in the span
+  bool has(uint64_t offset, uint64_t length) const;
+  bool complete() const { return missing.load() == 0; }
+
+  // Bytes read from the backend so far, and how many batches it took
+  uint64_t bytes_fetched() const { return fetched.load(); }
+  size_t batches() const { return batch_count.load(); }
+
+private:
+  std::unique_ptr<RangeReader> reader;
+  size_t block_size;
+  char *start = nullptr;
+  size_t length = 0;
+  bool mapped = false;
+  // One flag per block, set once the block has been read. They are read
+  // without the lock, so a block seen as loaded has its bytes visible.
+  std::unique_ptr<std::atomic<bool>[]> loaded;
+  size_t block_count = 0;
+  std::atomic<size_t> missing{0};
+  std::atomic<uint64_t> fetched{0};
+  std::atomic<size_t> batch_count{0};
+  // Only one batch is read at a time so a block is never read twice
+  std::mutex reading;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef PDF_REWRITER_H
+#define PDF_REWRITER_H
+
+#include "thread_pool.h"
+#include <cstddef>
+#include <ostream>
+
+class PdfParser;
+
+struct RewriteOptions {
+  // Deflate level from 0 to 9 to compress streams with, or -1 to write them
+  // as they are. Streams with no filter are deflated and ones that are only
+  // deflated are inflated and deflated again, but either way the new data is
+  // only kept when it is smaller. Streams with any other filter, like images,
+  // are left alone.
+  int compress_level = -1;
+  // Pack every object that can be into object streams, and index the file
+  // with an xref stream instead of a table
+  bool object_streams = false;
+  size_t objects_per_stream = 200;
+};
+
+/* Write a document back out as a new, clean pdf. Every object in the xref is
+ * loaded and written in object number order, including the ones packed in
+ * object streams, which come out as plain objects. The object streams and
+ * xref streams themselves are left out, and a single classic xref table and
+ * trailer are generated for the new offsets, so any incremental updates are
+ * flattened into one revision.
+ *
+ * Objects that can not be parsed are dropped and marked free rather than
+ * stopping the rewrite. Throws std::runtime_error if the document has no
+ * usable xref.
+ *
+ * The options make the file smaller, see RewriteOptions. Encrypted documents
+ * are rewritten without either option, since their streams and strings can
+ * not be re-encoded without the key. This version does all of the work on the
+ * calling thread.
+ */
+void rewrite_document(PdfParser &parser, std::ostream &os,
+                      const RewriteOptions &options = RewriteOptions());
+
+// The same, but streams are compressed on the pool, a few per thread at a
+// time, and written in order.
+void rewrite_document(PdfParser &parser, std::ostream &os, ThreadPool &pool,
+                      const RewriteOptions &options);
+
+#endif
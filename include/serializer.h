@@ -0,0 +1,82 @@
+#ifndef PDF_SERIALIZER_H
+#define PDF_SERIALIZER_H
+
+#include "utility.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+class PdfGraph;
+struct PdfValue;
+
+/* Writes pdf objects out through one big reusable buffer. Writing an object
+ * tree straight to an ostream is a virtual call and a trip through the stream
+ * machinery for every token, and numbers went through the locale on top of
+ * that. This formats numbers with to_chars into the buffer and only hands the
+ * stream whole buffers, or the payload of a big stream in one write.
+ *
+ * The syntax is the same as PdfObj::write, which is now just this, so dicts
+ * are written with their keys in name order and reals never use an exponent.
+ * Keep one serializer around for a whole document to reuse its buffer. It
+ * counts every byte it has taken, so offset() is the position in the output,
+ * which is what an xref needs.
+ */
+class PdfSerializer {
+public:
+  static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+  PdfSerializer(std::ostream &os, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+  PdfSerializer(const PdfSerializer &) = delete;
+  PdfSerializer &operator=(const PdfSerializer &) = delete;
+  // Flushes whatever is still buffered
+  ~PdfSerializer();
+
+  void write(const util::PdfObj &obj);
+  // A value from a graph, see PdfGraph::write
+  void write(const PdfGraph &graph, const PdfValue &value);
+
+  // Write a stream made of dict and a different payload, like a stream that
+  // has been encoded again. /Length is written as the size of the payload, and
+  // when filter is given it replaces /Filter. The dict is not changed.
+  void write_stream(const util::PdfDict &dict, std::string_view payload,
+                    const util::PdfObj *filter = nullptr);
+
+  // Pieces of syntax, for writing the parts of a file that are not objects
+  void raw(std::string_view bytes);
+  void put(char ch) {
+    if (buffer.size() == capacity)
+      flush();
+    buffer.push_back(ch);
+  }
+  void integer(int64_t value);
+  void real(double value);
+  // An integer padded with zeros to width digits, like xref table offsets
+  void padded(uint64_t value, int width);
+
+  // Bytes taken so far, whether or not they have been flushed
+  size_t offset() const { return flushed + buffer.size(); }
+
+  // Hand everything buffered to the stream
+  void flush();
+
+private:
+  void write_string(std::string_view data);
+  // Names are stored decoded, so any #xx escapes are put back here
+  void write_name(std::string_view name);
+  void write_dict(const util::PdfDict &dict);
+  // Sort and write the pairs pushed since base, then pop them. Does not close
+  // the dict.
+  void write_pairs(size_t base);
+
+  std::ostream &os;
+  size_t capacity;
+  size_t flushed = 0;
+  std::vector<char> buffer;
+  // Sorted dict pairs, shared by nested dicts as a stack so writing does not
+  // allocate once it has grown
+  std::vector<const util::PdfNameMap::value_type *> pairs;
+};
+
+#endif
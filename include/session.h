@@ -0,0 +1,135 @@
+#ifndef PDF_SESSION_H
+#define PDF_SESSION_H
+
+#include "input_source.h"
+#include "object_cache.h"
+#include "page_tree.h"
+#include "pdf_parser.h"
+#include "rewriter.h"
+#include "text_extract.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <memory_resource>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* The entry point for using the library from a long running program. A
+ * service that answers thousands of requests a second should not start
+ * threads, set up zlib, or grow fresh arenas from the heap for every one of
+ * them. A Session holds all of that and hands out Documents that are cheap
+ * to open and close:
+ *
+ *   Session session;
+ *   Document doc = session.open("report.pdf");
+ *   doc.extract_text(std::cout);
+ *
+ * What the session keeps between documents:
+ *   - a thread pool that the documents share for their parallel work
+ *   - a pool of memory blocks that every document's arenas take their blocks
+ *     from and give them back to, so a steady stream of documents stops
+ *     touching the heap once the pool has grown to fit them
+ *   - inflate contexts reserved up front in the process wide InflatePool,
+ *     one per thread, so the first streams do not set up zlib
+ *   - the name table, which is process wide and keeps every name it has seen
+ *
+ * A Session is thread safe, any thread can open documents at the same time.
+ * A Document is not, use each one from one thread at a time. Every document
+ * must be closed or destroyed before its session is.
+ *
+ * Document operations spread their work over the session's pool, unless
+ * they are called from one of the pool's own threads, in which case they run
+ * inline so a task can not end up waiting on the pool it is running on.
+ */
+
+class Session;
+
+class Document {
+public:
+  Document(Document &&other) noexcept;
+  // Closes this document first if it is open
+  Document &operator=(Document &&other) noexcept;
+  Document(const Document &) = delete;
+  Document &operator=(const Document &) = delete;
+  ~Document();
+
+  // The parser for anything the operations below do not cover
+  PdfParser &parser();
+  std::string_view bytes() const;
+
+  // The page tree, found the first time it is needed. Throws
+  // std::runtime_error if the document has none.
+  const PageTree &pages();
+  size_t page_count() { return pages().count(); }
+
+  // Pages that could not be read are written empty and come back here
+  std::vector<PageError> extract_text(std::ostream &os,
+                                      const PageRange &range = PageRange());
+  void inflate(std::ostream &os);
+  void rewrite(std::ostream &os, const RewriteOptions &options = {});
+  void info(std::ostream &os);
+  void objects(std::ostream &os);
+
+  // Give everything back to the session now instead of at destruction. The
+  // document can not be used after this.
+  void close();
+  bool is_open() const { return state != nullptr; }
+
+private:
+  friend class Session;
+  struct State;
+  Document(Session *session, std::unique_ptr<State> state);
+  ThreadPool *pool_for_work();
+  State &open_state() const;
+
+  Session *session = nullptr;
+  std::unique_ptr<State> state;
+};
+
+class Session {
+public:
+  struct Options {
+    // Threads in the shared pool, 0 for one per core
+    size_t threads = 0;
+    // Object cache budget of each document
+    size_t cache_budget = ObjectCache::DEFAULT_BUDGET;
+    // Keep a sidecar index next to files opened by path, see sidecar.h
+    bool sidecars = false;
+  };
+
+  Session();
+  explicit Session(const Options &options);
+  Session(const Session &) = delete;
+  Session &operator=(const Session &) = delete;
+  ~Session();
+
+  // Open a document from a file, mapping it if it can. Throws
+  // std::ios_base::failure if it can not be read.
+  Document open(const std::string &path);
+  // Read a whole document from a stream
+  Document open(std::istream &is);
+  // Use bytes owned by the caller, which must outlive the document
+  Document view(std::string_view bytes);
+
+  ThreadPool &pool() { return workers; }
+  std::pmr::memory_resource *memory() { return &blocks; }
+  const Options &options() const { return settings; }
+  // Documents opened and not closed yet
+  size_t open_documents() const { return open_count.load(); }
+
+private:
+  friend class Document;
+  // Path is where the bytes came from, or empty when there is no file
+  Document adopt(InputSource source, const std::string &path);
+
+  Options settings;
+  std::pmr::synchronized_pool_resource blocks;
+  ThreadPool workers;
+  std::atomic<size_t> open_count{0};
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef PDF_SIDECAR_H
+#define PDF_SIDECAR_H
+
+#include "range_reader.h"
+#include "xref.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class PdfParser;
+
+/* A saved parse index for a document, kept in a small file next to it. Opening
+ * a big PDF means finding startxref, reading every xref section back through
+ * the /Prev chain, and walking the page tree before the first page can be
+ * read. None of that changes unless the file does, so the sidecar keeps the
+ * results and the next open just maps them back in.
+ *
+ * The file is a fixed header followed by flat arrays, so loading is a bounds
+ * check and a copy rather than a parse:
+ *
+ *   header     magic, version, byte order, the FileStamp, and array sizes
+ *   entries    one 16 byte record per object number, the merged xref. The
+ *              compressed entries are also the object stream index, they say
+ *              which stream and which slot each packed object is in.
+ *   sections   the offset of every xref section, newest first
+ *   pages      the object number of every page in order
+ *   trailer    the merged trailer dict written as pdf syntax
+ *
+ * The numbers are stored in the byte order of the machine that wrote them. A
+ * sidecar from a machine with a different order just looks stale and gets
+ * rebuilt, which is much simpler than swapping everything.
+ *
+ * A sidecar is tied to one version of the file by its size, its modification
+ * time, and a hash of samples of its content. If any of them changes the
+ * sidecar is ignored and rebuilt.
+ */
+
+// Identifies one version of a file's content
+struct FileStamp {
+  uint64_t size = 0;
+  int64_t mtime = 0; // nanoseconds since the epoch
+  uint64_t hash = 0;
+
+  bool operator==(const FileStamp &other) const {
+    return size == other.size && mtime == other.mtime && hash == other.hash;
+  }
+  bool operator!=(const FileStamp &other) const { return !(*this == other); }
+
+  // Stamp the file at path whose bytes are data. Throws std::ios_base::failure
+  // if the file cannot be stat'ed.
+  static FileStamp of(const std::string &path, std::string_view data);
+};
+
+// A hash of the content that only reads parts of big files. Small files are
+// hashed whole, big ones by their head, tail, and evenly spaced blocks in
+// between, so stamping a huge file stays fast. It will miss a change that
+// touches none of the samples and keeps the size, but the mtime catches that
+// in practice.
+uint64_t sample_hash(std::string_view data);
+// The byte ranges sample_hash reads from a file of this size, so a ranged
+// source can fetch just those
+std::vector<ByteRange> sample_ranges(uint64_t size);
+
+class SidecarIndex {
+public:
+  static constexpr uint32_t FORMAT_VERSION = 1;
+
+  // Where the sidecar of a document goes, the document path plus a suffix
+  static std::string path_for(const std::string &document);
+
+  // Index the parser's document. A document whose page tree is broken still
+  // gets an index, just without the pages.
+  static SidecarIndex build(PdfParser &parser, const FileStamp &stamp);
+
+  // Read a sidecar. Returns nothing if the file is missing, is not a sidecar,
+  // has another version, is cut short, or was made for another stamp.
+  static std::optional<SidecarIndex> load(const std::string &path,
+                                          const FileStamp &stamp);
+
+  // Write the sidecar to path. It is written beside it and renamed into
+  // place so a reader never sees half a file. Throws std::ios_base::failure
+  // if it cannot be written.
+  void save(const std::string &path) const;
+
+  // Hand the index to the parser so it never reads the xref from the file
+  void apply(PdfParser &parser) const;
+
+  const FileStamp &stamp() const { return file_stamp; }
+  const std::vector<XrefEntry> &entries() const { return xref_entries; }
+  const std::vector<int64_t> &pages() const { return page_nums; }
+
+private:
+  FileStamp file_stamp;
+  std::vector<XrefEntry> xref_entries;
+  std::vector<size_t> sections;
+  std::vector<int64_t> page_nums;
+  std::string trailer;
+};
+
+// Open the document at path through its sidecar. A sidecar that is current is
+// applied to the parser. Otherwise the index is built from the document and
+// saved for next time. Failing to save is not an error, the document still
+// opens, it just does not get faster next time. Returns true when an existing
+// sidecar was used. An empty sidecar path means SidecarIndex::path_for.
+bool open_with_sidecar(PdfParser &parser, const std::string &path,
+                       const std::string &sidecar = "");
+
+#endif
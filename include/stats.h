@@ -0,0 +1,130 @@
+#ifndef PDF_STATS_H
+#define PDF_STATS_H
+
+#include "utility.h"
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/* Where a slow parse spends its time. The major phases are timed by scopes
+ * and a few counters are bumped along the way, and pdfcli --stats prints the
+ * totals when it is done.
+ *
+ * Everything goes through the PDF_STATS_ macros below. When the build is
+ * configured with PDFCLI_STATS off they expand to nothing, so a release build
+ * without stats has no trace of them. When stats are built in but were not
+ * turned on with enable, each one is a single relaxed load and a branch. Only
+ * after enable do the scopes read the clock and the counters do atomic adds.
+ *
+ * The times are inclusive and add up across threads. A decode that writes its
+ * output as it goes counts that time under both phases, and eight threads
+ * parsing for a second report eight seconds of object parse. They say where
+ * the work went, not how long the run took.
+ */
+
+namespace stats {
+
+enum class Phase : uint8_t {
+  XrefLoad,
+  ObjectParse,
+  FilterDecode,
+  OutputWrite,
+  RangeFetch, // waiting on a ranged source, see range_reader.h
+  COUNT,
+};
+
+enum class Counter : uint8_t {
+  BytesRead,     // document bytes mapped or read in
+  BytesInflated, // bytes produced by inflate
+  CacheHits,
+  CacheMisses,
+  RangeReads, // read requests sent to a range backend
+  COUNT,
+};
+
+// Objects are counted by type, one slot for each util::PdfType
+const size_t OBJECT_TYPES = static_cast<size_t>(util::PdfType::TopLevel) + 1;
+
+// Start or stop collecting, for the whole process
+void enable(bool on = true);
+bool enabled();
+// Zero everything collected so far
+void reset();
+
+void add(Counter counter, uint64_t n = 1);
+void add_object(util::PdfType type);
+void add_time(Phase phase, uint64_t nanoseconds);
+
+struct Snapshot {
+  uint64_t calls[static_cast<size_t>(Phase::COUNT)] = {};
+  uint64_t nanoseconds[static_cast<size_t>(Phase::COUNT)] = {};
+  uint64_t counters[static_cast<size_t>(Counter::COUNT)] = {};
+  uint64_t objects[OBJECT_TYPES] = {};
+
+  uint64_t calls_of(Phase p) const { return calls[static_cast<size_t>(p)]; }
+  uint64_t count_of(Counter c) const {
+    return counters[static_cast<size_t>(c)];
+  }
+  uint64_t objects_of(util::PdfType t) const {
+    return objects[static_cast<size_t>(t)];
+  }
+};
+
+// Everything collected so far. Other threads can still be adding while this
+// reads, so take it once the work is done.
+Snapshot snapshot();
+
+// Print a snapshot as an aligned table, or as a JSON object
+void write_table(std::ostream &os, const Snapshot &snap);
+void write_json(std::ostream &os, const Snapshot &snap);
+
+const char *phase_name(Phase phase);
+const char *counter_name(Counter counter);
+
+// Times its phase from construction to destruction when stats are on
+class Scope {
+public:
+  explicit Scope(Phase p) : phase(p), on(enabled()) {
+    if (on)
+      start = std::chrono::steady_clock::now();
+  }
+  ~Scope() {
+    if (on)
+      add_time(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count());
+  }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  Phase phase;
+  bool on;
+  std::chrono::steady_clock::time_point start;
+};
+
+} // namespace stats
+
+#define PDF_STATS_CONCAT_(a, b) a##b
+#define PDF_STATS_CONCAT(a, b) PDF_STATS_CONCAT_(a, b)
+
+#ifdef PDFCLI_STATS
+#define PDF_STATS_SCOPE(phase)                                                 \
+  stats::Scope PDF_STATS_CONCAT(stats_scope_, __LINE__)(stats::Phase::phase)
+#define PDF_STATS_ADD(counter, n)                                              \
+  do {                                                                         \
+    if (stats::enabled())                                                      \
+      stats::add(stats::Counter::counter, n);                                  \
+  } while (false)
+#define PDF_STATS_OBJECT(type)                                                 \
+  do {                                                                         \
+    if (stats::enabled())                                                      \
+      stats::add_object(type);                                                 \
+  } while (false)
+#else
+#define PDF_STATS_SCOPE(phase) static_cast<void>(0)
+#define PDF_STATS_ADD(counter, n) static_cast<void>(0)
+#define PDF_STATS_OBJECT(type) static_cast<void>(0)
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef PDF_TEXT_EXTRACT_H
+#define PDF_TEXT_EXTRACT_H
+
+#include "thread_pool.h"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class PdfParser;
+
+/* Pull the text out of a document's pages. The content of each page is
+ * decoded and run through the ContentLexer, and the strings shown by Tj, TJ,
+ * ' and " are written out, with a new line whenever the text moves down and a
+ * space for the big gaps in a TJ array.
+ *
+ * Strings are written as their raw bytes. Font encodings and ToUnicode maps
+ * are not applied yet, so this only reads well for simple fonts that use a
+ * latin encoding.
+ */
+
+// A set of one based pages given like 1-3,7,10- where a range without an end
+// goes to the last page
+class PageRange {
+public:
+  // Every page
+  PageRange();
+
+  // Throws std::runtime_error if the spec does not make sense
+  static PageRange parse(std::string_view spec);
+
+  // The ranges as zero based [first, last] pairs, in the order given. last is
+  // SIZE_MAX for a range that runs to the end.
+  const std::vector<std::pair<size_t, size_t>> &ranges() const {
+    return spans;
+  }
+
+private:
+  std::vector<std::pair<size_t, size_t>> spans;
+};
+
+// The text of decoded content stream bytes
+std::string content_text(std::string_view content);
+
+// A page whose content could not be read, say a stream that would not
+// decode. page is one based.
+struct PageError {
+  size_t page;
+  std::string message;
+};
+
+// Write the text of the pages in range to os, each page followed by a form
+// feed. Pages are decoded and extracted on the pool, but only a few per thread
+// at a time, and written in page order as soon as each one is done, so memory
+// does not grow with the number of pages. Pages outside the range are never
+// loaded.
+//
+// A page whose content fails to decode or lex is written as an empty page and
+// listed in what comes back, and the pages after it carry on. A broken page
+// tree still throws std::runtime_error.
+std::vector<PageError> extract_text(PdfParser &parser, std::ostream &os,
+                                    ThreadPool &pool,
+                                    const PageRange &range = PageRange());
+
+// The same on the calling thread, one page at a time. This is for callers
+// that are already running on a pool, like batch mode, where waiting on the
+// pool from inside one of its tasks could deadlock.
+std::vector<PageError> extract_text(PdfParser &parser, std::ostream &os,
+                                    const PageRange &range = PageRange());
+
+#endif
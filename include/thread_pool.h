@@ -0,0 +1,77 @@
+#ifndef PDF_THREAD_POOL_H
+#define PDF_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/* A fixed set of worker threads with a task queue for each. Work that is
+ * submitted from outside the pool is spread over the queues round robin, and
+ * work submitted from inside a task goes on that worker's own queue. A worker
+ * takes the newest task from its own queue, and when that is empty it steals
+ * the oldest task from someone else's, so a few big tasks landing on one queue
+ * do not leave the other threads sitting idle.
+ *
+ * Tasks should not wait on the futures of other tasks, with few threads that
+ * can deadlock. The destructor finishes every task that was submitted before
+ * joining the threads.
+ */
+class ThreadPool {
+public:
+  // Start the given number of threads, or default_threads() for 0
+  explicit ThreadPool(size_t threads = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // One per core, or 1 if the number of cores is unknown
+  static size_t default_threads();
+
+  size_t size() const { return workers.size(); }
+
+  // Whether the calling thread is one of this pool's workers. Code that might
+  // be running in a task can check this and do its work inline instead of
+  // waiting on the pool.
+  bool in_worker() const;
+
+  // Run f on the pool. Anything it throws comes out of the future's get.
+  template <typename F>
+  std::future<std::invoke_result_t<std::decay_t<F>>> submit(F &&f) {
+    using Result = std::invoke_result_t<std::decay_t<F>>;
+    // std::function needs something copyable, a packaged_task is not
+    auto task =
+        std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+    std::future<Result> result = task->get_future();
+    push([task]() { (*task)(); });
+    return result;
+  }
+
+private:
+  using Task = std::function<void()>;
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void push(Task task);
+  bool pop(size_t index, Task &task);
+  void run(size_t index);
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+  std::mutex wake_mutex;
+  std::condition_variable wake;
+  std::atomic<size_t> pending{0}; // tasks queued but not taken yet
+  std::atomic<size_t> next_queue{0};
+  bool stopping = false;
+};
+
+#endif
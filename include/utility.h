@@ -1,12 +1,21 @@
 #ifndef PDF_UTILITY_H
 #define PDF_UTILITY_H
 
+#include "names.h"
+#include <algorithm>
 #include <iomanip>
 #include <ios>
 #include <istream>
 #include <map>
+#include <memory_resource>
+#include <string>
+#include <string_view>
 #include <vector>
 
+class Arena;
+class PdfLexer;
+class SpanStreamBuf;
+
 namespace util {
 
 // return the size in bytes of the stream from the current position.
@@ -18,206 +27,249 @@ std::vector<char> slurp_bytes(const std::string &filename);
 
 // decompress a given number of bytes in an input stream
 // restores the current position in the stream
-std::vector<char> inflate_stream(std::istream &is, std::streamoff);
+// size_hint is the expected decompressed size, like a stream's /DL, and is
+// used to reserve the output up front. 0 guesses from the compressed size.
+std::vector<char> inflate_stream(std::istream &is, std::streamoff size,
+                                 size_t size_hint = 0);
 
 // Object Prototypes //////////////////////////////////////////////////////////
 
+class PdfObj;
+
+// Write an object in pdf syntax through a PdfSerializer, see serializer.h.
+// Every PdfObj::write is this.
+void write_obj(std::ostream &os, const PdfObj &obj);
+
+// The kind of each pdf object, so as<T>() and operator== can check a tag
+// instead of doing a dynamic_cast
+enum class PdfType : uint8_t {
+  Null,
+  Bool,
+  Int,
+  Real,
+  Name,
+  String,
+  Ref,
+  Array,
+  Dict,
+  Stream,
+  TopLevel,
+};
+
+// Lower case name of a type for printing, like dict or top_level
+const char *type_name(PdfType type);
+
 // I am going to prototype some types and parsing functions in here to keep
 // experimentation simple. I will move them to proper files and classes and
 // make them more robust when things stabalize a bit.
 
-// Abstract class for all pdf objects, keeping everything public for now until
+// Base class for all pdf objects, keeping everything public for now until
 // things are more settled and I can make them more robust without having to
 // change them right after and do a lot of work twice.
+//
+// Objects can be made on the heap with new as usual, or in an Arena with
+// new (arena) T(...). Either kind can be deleted, but deleting an arena object
+// only runs its destructor and the memory goes back when the arena is
+// released. A small header in front of each object records which it was.
+//
+// Every object carries a type tag so comparing and casting objects does not
+// need a dynamic_cast. Use as<T>() to get a typed pointer or null.
 class PdfObj {
 public:
+  const PdfType type;
   virtual ~PdfObj() {}
-  virtual void write(std::ostream &os) const = 0;
-  virtual bool operator==(const PdfObj &other) const = 0;
-  virtual bool operator!=(const PdfObj &other) const {
-    return !(*this == other);
-  };
+  template <typename T> const T *as() const {
+    return type == T::TYPE ? static_cast<const T *>(this) : nullptr;
+  }
+  template <typename T> T *as() {
+    return type == T::TYPE ? static_cast<T *>(this) : nullptr;
+  }
+  // Writing and comparing switch on the tag rather than being virtual. Only
+  // the destructor is, so deleting through a PdfObj * frees the right thing.
+  void write(std::ostream &os) const { write_obj(os, *this); }
+  bool operator==(const PdfObj &other) const;
+  bool operator!=(const PdfObj &other) const { return !(*this == other); }
+
+  static void *operator new(size_t size);
+  static void *operator new(size_t size, Arena &arena);
+  static void operator delete(void *p);
+  static void operator delete(void *p, Arena &arena);
+
+protected:
+  PdfObj(PdfType t) : type(t) {}
 };
 
+// Tag for making a string that borrows its bytes from memory that outlives it,
+// like the input or an arena, instead of owning a copy.
+struct Borrowed {};
+inline constexpr Borrowed borrowed{};
+
 class PdfNull : public PdfObj {
 public:
-  virtual void write(std::ostream &os) const override { os << "null"; }
-  virtual bool operator==(const PdfObj &other) const override {
-    if (const PdfNull *null = dynamic_cast<const PdfNull *>(&other)) {
-      return true;
-    }
-    return false;
-  }
+  static constexpr PdfType TYPE = PdfType::Null;
+  PdfNull() : PdfObj(TYPE) {}
 };
 
+// Holds the decoded bytes of the string, so writing escapes the chars that
+// would otherwise end the string early. data either points at storage or at
+// borrowed bytes, and copies of a borrowed string keep borrowing.
 class PdfString : public PdfObj {
+  std::string storage;
+
 public:
-  std::string data;
-  PdfString(const std::string &s) : data(s) {}
-  virtual void write(std::ostream &os) const override {
-    os << "(" << data << ")";
-  }
-  virtual bool operator==(const PdfObj &obj) const override {
-    if (const PdfString *other = dynamic_cast<const PdfString *>(&obj)) {
-      return data == other->data;
-    }
-    return false;
+  static constexpr PdfType TYPE = PdfType::String;
+  std::string_view data;
+  PdfString(const std::string &s) : PdfObj(TYPE), storage(s), data(storage) {}
+  PdfString(std::string_view s, Borrowed) : PdfObj(TYPE), data(s) {}
+  PdfString(const PdfString &other)
+      : PdfObj(TYPE), storage(other.storage),
+        data(other.owns_data() ? std::string_view(storage) : other.data) {}
+  PdfString &operator=(const PdfString &other) {
+    storage = other.storage;
+    data = other.owns_data() ? std::string_view(storage) : other.data;
+    return *this;
   }
+  bool owns_data() const { return data.data() == storage.data(); }
 };
 
+// Names are interned. atom identifies the name and data is its text in the
+// global NameTable, including the /, so it is always valid and two names are
+// the same exactly when their atoms are.
 class PdfName : public PdfObj {
 public:
-  std::string data;
-  PdfName(const std::string &s) : data(s) {} // Validate?
-  virtual void write(std::ostream &os) const override { os << data; }
-  bool operator<(const PdfName &other) const { return data < other.data; }
-  bool operator<(const PdfName &other) { return data < other.data; }
-  virtual bool operator==(const PdfObj &obj) const override {
-    if (const PdfName *other = dynamic_cast<const PdfName *>(&obj)) {
-      return data == other->data;
-    }
-    return false;
+  static constexpr PdfType TYPE = PdfType::Name;
+  PdfAtom atom;
+  std::string_view data;
+  PdfName(std::string_view s) : PdfObj(TYPE) { // Validate?
+    atom = NameTable::global().intern(s, &data);
   }
+  explicit PdfName(PdfAtom a)
+      : PdfObj(TYPE), atom(a), data(NameTable::global().text(a)) {}
+  PdfName(const PdfName &other)
+      : PdfObj(TYPE), atom(other.atom), data(other.data) {}
+  PdfName &operator=(const PdfName &other) {
+    atom = other.atom;
+    data = other.data;
+    return *this;
+  }
+  bool operator<(const PdfName &other) const { return data < other.data; }
+};
+
+// Flat map from names to objects for dicts, keyed by atom. The atoms are kept
+// sorted in their own array so a lookup only has to look at a few integers,
+// with a linear scan for small dicts and a binary search for bigger ones.
+// Iterating gives the pairs in atom order, not name order.
+class PdfNameMap {
+public:
+  using value_type = std::pair<PdfName, PdfObj *>;
+  using iterator = std::pmr::vector<value_type>::iterator;
+  using const_iterator = std::pmr::vector<value_type>::const_iterator;
+
+  PdfNameMap(std::pmr::memory_resource *mr = std::pmr::get_default_resource())
+      : keys(mr), entries(mr) {}
+
+  // Value for the key, inserting a null pointer if it is missing
+  PdfObj *&operator[](const PdfName &key);
+  // Insert if the key is missing, like std::map::emplace
+  std::pair<iterator, bool> emplace(const PdfName &key, PdfObj *obj);
+  iterator find(PdfAtom key);
+  const_iterator find(PdfAtom key) const;
+  iterator find(const PdfName &key) { return find(key.atom); }
+  const_iterator find(const PdfName &key) const { return find(key.atom); }
+  // Value for the key or null if it is missing
+  PdfObj *get(PdfAtom key) const;
+  // Value for the key, throws std::out_of_range if it is missing
+  PdfObj *at(const PdfName &key) const;
+  iterator erase(iterator it);
+
+  size_t size() const { return keys.size(); }
+  bool empty() const { return keys.empty(); }
+  iterator begin() { return entries.begin(); }
+  iterator end() { return entries.end(); }
+  const_iterator begin() const { return entries.begin(); }
+  const_iterator end() const { return entries.end(); }
+
+private:
+  size_t lower_bound(PdfAtom key) const;
+
+  std::pmr::vector<PdfAtom> keys;
+  std::pmr::vector<value_type> entries;
 };
 
 class PdfInt : public PdfObj {
 public:
+  static constexpr PdfType TYPE = PdfType::Int;
   int64_t data;
-  PdfInt(int64_t i) : data(i) {}
-  virtual void write(std::ostream &os) const override { os << data; }
-  virtual bool operator==(const PdfObj &obj) const override {
-    if (const PdfInt *other = dynamic_cast<const PdfInt *>(&obj)) {
-      return data == other->data;
-    }
-    return false;
-  }
+  PdfInt(int64_t i) : PdfObj(TYPE), data(i) {}
 };
 
 class PdfReal : public PdfObj {
 public:
+  static constexpr PdfType TYPE = PdfType::Real;
   double data;
-  PdfReal(double d) : data(d) {}
-  virtual void write(std::ostream &os) const override {
-    os << std::setprecision(15) << data;
-  }
-  virtual bool operator==(const PdfObj &obj) const override {
-    if (const PdfReal *other = dynamic_cast<const PdfReal *>(&obj)) {
-      return data == other->data;
-    }
-    return false;
-  }
+  PdfReal(double d) : PdfObj(TYPE), data(d) {}
 };
 
 class PdfBool : public PdfObj {
 public:
+  static constexpr PdfType TYPE = PdfType::Bool;
   bool data;
-  PdfBool(bool b) : data(b) {}
-  virtual void write(std::ostream &os) const override {
-    os << (data ? "true" : "false");
-  }
-  virtual bool operator==(const PdfObj &obj) const override {
-    if (const PdfBool *other = dynamic_cast<const PdfBool *>(&obj)) {
-      return data == other->data;
-    }
-    return false;
-  }
+  PdfBool(bool b) : PdfObj(TYPE), data(b) {}
 };
 
+// Container storage comes from the given memory resource, which is the heap
+// unless the array was made in an arena.
 class PdfArray : public PdfObj {
 public:
-  std::vector<PdfObj *> objects;
+  static constexpr PdfType TYPE = PdfType::Array;
+  std::pmr::vector<PdfObj *> objects;
+  PdfArray(std::pmr::memory_resource *mr = std::pmr::get_default_resource())
+      : PdfObj(TYPE), objects(mr) {}
   virtual ~PdfArray() {
     for (auto obj : objects)
       delete obj;
   }
-  virtual void write(std::ostream &os) const override {
-    os << "[ ";
-    for (auto obj : objects) {
-      obj->write(os);
-      os << " ";
-    }
-    os << "]";
-  }
-  virtual bool operator==(const PdfObj &obj) const override {
-    if (const PdfArray *other = dynamic_cast<const PdfArray *>(&obj)) {
-      if (objects.size() != other->objects.size())
-        return false;
-      for (size_t i = 0; i < objects.size(); ++i) {
-        if (*objects.at(i) != *other->objects.at(i))
-          return false;
-      }
-    }
-    return true;
-  }
 };
 
 class PdfDict : public PdfObj {
 public:
-  std::map<PdfName, PdfObj *> pairs;
-  virtual void write(std::ostream &os) const override {
-    os << "<< ";
-    for (auto &p : pairs) {
-      p.first.write(os);
-      os << " ";
-      p.second->write(os);
-      os << " ";
-    }
-    os << ">>";
-  }
-  virtual bool operator==(const PdfObj &obj) const override {
-    if (const PdfDict *other = dynamic_cast<const PdfDict *>(&obj)) {
-      if (pairs.size() != other->pairs.size()) {
-        return false;
-      } else {
-        for (auto &p : pairs) {
-          auto it = other->pairs.find(p.first);
-          if (it == other->pairs.end() || *it->second != *p.second)
-            return false;
-        }
-      }
-    }
-    return true;
+  static constexpr PdfType TYPE = PdfType::Dict;
+  PdfNameMap pairs;
+  PdfDict(std::pmr::memory_resource *mr = std::pmr::get_default_resource())
+      : PdfObj(TYPE), pairs(mr) {}
+  virtual ~PdfDict() {
+    for (auto &p : pairs)
+      delete p.second;
   }
 };
 
+// The payload is either owned in stream, or when it was parsed straight out of
+// an InputSource it is a view into the source in payload and stream is left
+// empty. Use bytes() to read it without caring which.
 class PdfStream : public PdfObj {
 public:
+  static constexpr PdfType TYPE = PdfType::Stream;
   PdfDict *dict;
-  std::vector<char> stream;
-  PdfStream() : dict(new PdfDict) {}
-  PdfStream(PdfDict *d) : dict(d) {}
+  std::pmr::vector<char> stream;
+  std::string_view payload;
+  PdfStream() : PdfObj(TYPE), dict(new PdfDict) {}
+  PdfStream(PdfDict *d,
+            std::pmr::memory_resource *mr = std::pmr::get_default_resource())
+      : PdfObj(TYPE), dict(d), stream(mr) {}
   virtual ~PdfStream() { delete dict; }
-  virtual void write(std::ostream &os) const override {
-    dict->write(os);
-    os << "\nstream\n";
-    for (auto ch : stream) {
-      os << ch;
-    }
-    // Should this start with an endline? or would that mess up compression
-    os << "\nendstream\n";
-  }
-  virtual bool operator==(const PdfObj &obj) const override {
-    if (const PdfStream *other = dynamic_cast<const PdfStream *>(&obj)) {
-      return *dict == *other->dict && stream == other->stream;
-    }
-    return false;
+  std::string_view bytes() const {
+    if (payload.data() != nullptr)
+      return payload;
+    return std::string_view(stream.data(), stream.size());
   }
 };
 
 class PdfRef : public PdfObj {
 public:
+  static constexpr PdfType TYPE = PdfType::Ref;
   int64_t num;
   int64_t gen;
-  PdfRef(int64_t n, int64_t g) : num(n), gen(g) {}
-  virtual void write(std::ostream &os) const override {
-    os << num << " " << gen << " R";
-  }
-  virtual bool operator==(const PdfObj &obj) const override {
-    if (const PdfRef *other = dynamic_cast<const PdfRef *>(&obj)) {
-      return num == other->num && gen == other->gen;
-    }
-    return false;
-  }
+  PdfRef(int64_t n, int64_t g) : PdfObj(TYPE), num(n), gen(g) {}
 };
 
 // TODO This should be renamed indirect object instead
@@ -229,23 +281,13 @@ public:
 // so it will be necessary to provide this context at some point.
 class PdfTopLevel : public PdfObj {
 public:
+  static constexpr PdfType TYPE = PdfType::TopLevel;
   int64_t num;
   int64_t gen;
   PdfObj *obj;
-  PdfTopLevel(int64_t n, int64_t g, PdfObj *o) : num(n), gen(g), obj(o) {}
+  PdfTopLevel(int64_t n, int64_t g, PdfObj *o)
+      : PdfObj(TYPE), num(n), gen(g), obj(o) {}
   virtual ~PdfTopLevel() { delete obj; }
-  virtual void write(std::ostream &os) const override {
-    os << num << " " << gen << " obj\n";
-    obj->write(os);
-    os << "\nendobj\n";
-  }
-  virtual bool operator==(const PdfObj &obj) const override {
-    if (const PdfTopLevel *other = dynamic_cast<const PdfTopLevel *>(&obj)) {
-      return num == other->num && gen == other->gen &&
-             *this->obj == *other->obj;
-    }
-    return false;
-  }
 };
 
 // TODO consider how we will represent the cross-reference table and/or the
@@ -273,6 +315,18 @@ std::ostream &operator<<(std::ostream &os, const util::PdfObj *const obj);
 // parse any object and return a pointer to it
 // it will likely be necessary to have other finer grained functions to get
 // specific object types where necessary
+// When an arena is given every object is made in it and is owned by it. Strings
+// borrow from the input whenever the lexer is stable and they do not need
+// decoding, otherwise they are copied into the arena. Names are interned.
+PdfObj *parse_pdf_obj(PdfLexer &lex, Arena *arena = nullptr);
+PdfArray *parse_pdf_array(PdfLexer &lex, Arena *arena = nullptr);
+PdfDict *parse_pdf_dict(PdfLexer &lex, Arena *arena = nullptr);
+PdfName parse_pdf_name_obj(PdfLexer &lex);
+PdfObj *parse_pdf_int_or_real(PdfLexer &lex, Arena *arena = nullptr);
+PdfObj *parse_pdf_num_ref_or_top_level(PdfLexer &lex, Arena *arena = nullptr);
+
+// The istream versions adapt the stream to a PdfLexer and leave the stream
+// just after the parsed object
 PdfObj *parse_pdf_obj(std::istream &is);
 
 PdfArray *parse_pdf_array(std::istream &is);
@@ -284,7 +338,16 @@ PdfName parse_pdf_name_obj(std::istream &is);
 std::string get_name_token(std::istream &is);
 bool parse_int(std::istream &is, int64_t *i);
 bool parse_double(std::istream &is, double *d);
-std::vector<char> parse_pdf_content_stream(std::istream &is);
+// Read stream ... endstream, taking length bytes of data when the stream's
+// /Length is known and searching for endstream when it is not.
+std::vector<char> parse_pdf_content_stream(std::istream &is,
+                                           int64_t length = -1);
+
+// Parse stream ... endstream from memory without copying the payload. The
+// returned view points into the span being read and the read position is moved
+// past endstream.
+std::string_view parse_pdf_stream_payload(SpanStreamBuf &buf,
+                                          int64_t length = -1);
 
 // Parser helpers
 void skip_whitespace(std::istream &is);
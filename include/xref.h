@@ -0,0 +1,99 @@
+#ifndef PDF_XREF_H
+#define PDF_XREF_H
+
+#include "utility.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/* The cross reference index of a document. Without it the only way to find an
+ * object is to scan the whole file. The xref says where every object starts,
+ * so an object can be parsed by seeking straight to it.
+ *
+ * Loading starts from the startxref offset at the end of the file. It handles
+ * classic xref tables, /XRef streams, and hybrid files whose trailer points at
+ * an extra stream with /XRefStm. It follows the /Prev chain back through
+ * incremental updates, with newer sections taking priority over older ones.
+ */
+
+enum class XrefType : uint8_t {
+  Missing,    // not in any section
+  Free,       // deleted or never used
+  InUse,      // offset is the byte offset of the object
+  Compressed, // offset is the number of the object stream holding it
+};
+
+struct XrefEntry {
+  XrefType type = XrefType::Missing;
+  uint16_t gen = 0;
+  uint32_t index = 0;  // position inside the object stream when compressed
+  uint64_t offset = 0; // byte offset or object stream number
+};
+
+class XrefTable {
+public:
+  // Load the whole index. Throws std::runtime_error if there is no startxref
+  // or a section cannot be parsed. When the bytes are not all there yet, like
+  // with a RangedSource, before_section is called with the offset of each
+  // section before it is read so it can be fetched.
+  static XrefTable
+  load(std::string_view data,
+       const std::function<void(size_t offset)> &before_section = nullptr);
+
+  // Load only the section at the given offset, without following /Prev
+  static XrefTable load_section(std::string_view data, size_t offset);
+
+  // Rebuild a table that was saved somewhere else, like a sidecar index,
+  // without reading the document. The table takes ownership of the trailer,
+  // which must be heap allocated. A null trailer leaves it empty.
+  static XrefTable from_entries(std::vector<XrefEntry> entries,
+                                util::PdfDict *trailer,
+                                std::vector<size_t> sections);
+
+  XrefTable();
+  XrefTable(XrefTable &&) = default;
+  XrefTable &operator=(XrefTable &&) = default;
+
+  // The entry for an object number, or null if it is not in the index
+  const XrefEntry *find(int64_t num) const;
+
+  // Number of object number slots, one more than the highest object number
+  size_t size() const { return entries.size(); }
+  // Number of objects marked in use or compressed
+  size_t object_count() const;
+
+  // The merged trailer, newest keys first. For xref streams this is the stream
+  // dict. It always exists but might be empty.
+  const util::PdfDict &trailer() const { return *trailer_dict; }
+
+  // Offsets of every section that was read, newest first
+  const std::vector<size_t> &sections() const { return section_offsets; }
+
+  // Every entry indexed by object number, some of them Missing
+  const std::vector<XrefEntry> &all() const { return entries; }
+
+private:
+  // Parse one section into the table, only filling slots that are still
+  // missing. Returns the /Prev offset or -1.
+  int64_t read_section(std::string_view data, size_t offset);
+  int64_t read_table(std::string_view data, size_t offset);
+  int64_t read_stream(std::string_view data, size_t offset);
+  void set(int64_t num, const XrefEntry &entry);
+  void merge_trailer(util::PdfDict *dict);
+
+  std::vector<XrefEntry> entries;
+  std::unique_ptr<util::PdfDict> trailer_dict;
+  std::vector<size_t> section_offsets;
+};
+
+namespace util {
+
+// The offset after the last startxref keyword in the data.
+// Throws std::runtime_error if there is none.
+size_t find_startxref(std::string_view data);
+
+} // namespace util
+
+#endif
@@ -0,0 +1,31 @@
+#include "arena.h"
+#include <cstring>
+
+Arena::Arena(size_t initial_block_size, std::pmr::memory_resource *upstream)
+    : pool(initial_block_size, upstream) {}
+
+std::string_view Arena::copy(std::string_view bytes) {
+  if (bytes.empty())
+    return std::string_view();
+  char *dest = static_cast<char *>(allocate(bytes.size(), 1));
+  std::memcpy(dest, bytes.data(), bytes.size());
+  return std::string_view(dest, bytes.size());
+}
+
+void Arena::release() {
+  pool.release();
+  used = 0;
+}
+
+void *Arena::do_allocate(size_t bytes, size_t alignment) {
+  used += bytes;
+  return pool.allocate(bytes, alignment);
+}
+
+// Memory in a monotonic arena is only given back by release
+void Arena::do_deallocate(void *, size_t, size_t) {}
+
+bool Arena::do_is_equal(const std::pmr::memory_resource &other) const
+    noexcept {
+  return this == &other;
+}
@@ -0,0 +1,141 @@
+#include "batch.h"
+#include "input_source.h"
+#include "pdf_parser.h"
+#include "range_reader.h"
+#include "stats.h"
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <glob.h>
+#include <memory>
+#include <optional>
+#include <sstream>
+
+namespace {
+
+struct DocumentResult {
+  bool ok = true;
+  std::string output; // only when it is not written to a file
+  std::string error;
+};
+
+std::string base_name(const std::string &path) {
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+DocumentResult run_document(const std::string &path, const DocumentTask &task,
+                            const BatchOptions &options) {
+  DocumentResult result;
+  try {
+    std::optional<InputSource> source;
+    std::unique_ptr<RangedSource> ranged;
+    std::unique_ptr<PdfParser> parser_ptr;
+    if (options.ranged) {
+      ranged = std::make_unique<RangedSource>(open_range_reader(path));
+      parser_ptr = std::make_unique<PdfParser>(*ranged);
+    } else {
+      source.emplace(InputSource::open(path));
+      parser_ptr = std::make_unique<PdfParser>(*source);
+    }
+    PdfParser &parser = *parser_ptr;
+    if (options.output_dir.empty()) {
+      std::ostringstream os;
+      task(parser, path, os);
+      result.output = os.str();
+    } else {
+      std::string out_path =
+          options.output_dir + "/" + base_name(path) + options.extension;
+      std::ofstream os(out_path, std::ios::binary | std::ios::trunc);
+      if (!os)
+        throw std::ios_base::failure("Could not write " + out_path);
+      task(parser, path, os);
+      os.close();
+      if (!os)
+        throw std::ios_base::failure("Could not write " + out_path);
+    }
+  } catch (const std::exception &e) {
+    result.ok = false;
+    result.output.clear();
+    result.error = e.what();
+  }
+  return result;
+}
+
+} // namespace
+
+BatchResult run_batch(const std::vector<std::string> &paths,
+                      const DocumentTask &task, ThreadPool &pool,
+                      std::ostream &out, std::ostream &err,
+                      const BatchOptions &options) {
+  const size_t window = pool.size() * options.files_per_thread;
+  std::deque<std::pair<const std::string *, std::future<DocumentResult>>>
+      pending;
+  BatchResult totals;
+
+  auto finish_front = [&] {
+    const std::string &path = *pending.front().first;
+    DocumentResult result = pending.front().second.get();
+    pending.pop_front();
+    if (!result.ok) {
+      ++totals.failed;
+      err << "pdfcli: " << path << ": " << result.error << "\n";
+      return;
+    }
+    ++totals.done;
+    if (options.output_dir.empty()) {
+      PDF_STATS_SCOPE(OutputWrite);
+      out << "==> " << path << " <==\n" << result.output;
+    }
+  };
+
+  for (const std::string &path : paths) {
+    pending.emplace_back(&path, pool.submit([&path, &task, &options] {
+      return run_document(path, task, options);
+    }));
+    // Write whatever is done in order, and wait once the window is full
+    while (!pending.empty() &&
+           (pending.size() >= window ||
+            pending.front().second.wait_for(std::chrono::seconds(0)) ==
+                std::future_status::ready))
+      finish_front();
+  }
+  while (!pending.empty())
+    finish_front();
+  out.flush();
+  return totals;
+}
+
+std::vector<std::string>
+expand_paths(const std::vector<std::string> &patterns) {
+  std::vector<std::string> paths;
+  for (const std::string &pattern : patterns) {
+    if (pattern.find_first_of("*?[") == std::string::npos) {
+      paths.push_back(pattern);
+      continue;
+    }
+    glob_t found;
+    if (glob(pattern.c_str(), 0, nullptr, &found) == 0) {
+      for (size_t i = 0; i < found.gl_pathc; ++i)
+        paths.emplace_back(found.gl_pathv[i]);
+    } else {
+      paths.push_back(pattern);
+    }
+    globfree(&found);
+  }
+  return paths;
+}
+
+std::vector<std::string> read_path_list(std::istream &is) {
+  std::vector<std::string> paths;
+  std::string line;
+  while (std::getline(is, line)) {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (!line.empty())
+      paths.push_back(line);
+  }
+  return paths;
+}
@@ -0,0 +1,363 @@
+#include "char_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PDFCLI_HAVE_SSE2 1
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define PDFCLI_HAVE_AVX2 1
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PDFCLI_HAVE_NEON 1
+#endif
+
+namespace {
+
+using util::char_class;
+using util::DELIMITER;
+using util::REGULAR;
+using util::WHITESPACE;
+
+inline bool needs_escape(char ch) {
+  return char_class(ch) != REGULAR || ch == '#' || ch <= ' ' || ch > '~';
+}
+
+// Byte at a time //////////////////////////////////////////////////////////////
+
+const char *scalar_skip_whitespace(const char *p, const char *end) {
+  while (p < end && char_class(*p) == WHITESPACE)
+    ++p;
+  return p;
+}
+
+const char *scalar_find_delimiter(const char *p, const char *end) {
+  while (p < end && char_class(*p) == REGULAR)
+    ++p;
+  return p;
+}
+
+const char *scalar_find_name_escape(const char *p, const char *end) {
+  while (p < end && !needs_escape(*p))
+    ++p;
+  return p;
+}
+
+const util::CharScanner SCALAR = {"scalar", scalar_skip_whitespace,
+                                  scalar_find_delimiter,
+                                  scalar_find_name_escape};
+
+/* The vector versions look up each byte's class with two 16 entry tables,
+ * one indexed by the high nibble and one by the low nibble, which is one
+ * shuffle each. Every high nibble that has whitespace or delimiters in it
+ * gets a bit for each of those classes. The high table holds a nibble's bits
+ * and the low table holds, for each low nibble, the bits of the high nibbles
+ * that make a non regular byte with it, so the two anded together are non
+ * zero exactly for whitespace and delimiters, and the whitespace bits alone
+ * pick out whitespace.
+ */
+struct NibbleTables {
+  uint8_t high[16] = {};
+  uint8_t low[16] = {};
+  uint8_t whitespace_bits = 0;
+  int bits_used = 0;
+
+  constexpr NibbleTables() {
+    for (int hi = 0; hi < 16; ++hi) {
+      uint8_t class_bit[3] = {};
+      for (int lo = 0; lo < 16; ++lo) {
+        uint8_t cls = util::CHAR_TABLE.classes[hi << 4 | lo];
+        if (cls == REGULAR)
+          continue;
+        if (class_bit[cls] == 0) {
+          class_bit[cls] = static_cast<uint8_t>(1u << bits_used++);
+          high[hi] |= class_bit[cls];
+          if (cls == WHITESPACE)
+            whitespace_bits |= class_bit[cls];
+        }
+        low[lo] |= class_bit[cls];
+      }
+    }
+  }
+};
+
+constexpr NibbleTables NIBBLES;
+static_assert(NIBBLES.bits_used <= 8, "The classes need more than 8 bits");
+
+inline const char *first_set(const char *p, uint32_t mask) {
+  return p + __builtin_ctz(mask);
+}
+
+// SSE2 ////////////////////////////////////////////////////////////////////////
+
+// SSE2 has no byte shuffle, so a byte is compared against every character of
+// the class instead. There are only 16 of them.
+#ifdef PDFCLI_HAVE_SSE2
+
+inline __m128i sse2_whitespace(__m128i v) {
+  __m128i m = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+  for (char ch : {'\t', '\n', '\f', '\r', ' '})
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(ch)));
+  return m;
+}
+
+inline __m128i sse2_delimiter(__m128i v) {
+  __m128i m = _mm_setzero_si128();
+  for (char ch : {'(', ')', '<', '>', '[', ']', '{', '}', '/', '%'})
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(ch)));
+  return m;
+}
+
+// Bytes at or below space and at or above DEL, with unsigned compares
+inline __m128i sse2_unprintable(__m128i v) {
+  __m128i low = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(' ')), v);
+  __m128i del = _mm_set1_epi8(static_cast<char>(0x7f));
+  __m128i high = _mm_cmpeq_epi8(_mm_max_epu8(v, del), v);
+  return _mm_or_si128(low, high);
+}
+
+template <typename Match, typename Tail>
+const char *sse2_scan(const char *p, const char *end, Match match, Tail tail) {
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    uint32_t mask = _mm_movemask_epi8(match(v));
+    if (mask != 0)
+      return first_set(p, mask);
+  }
+  return tail(p, end);
+}
+
+const char *sse2_skip_whitespace(const char *p, const char *end) {
+  return sse2_scan(
+      p, end,
+      [](__m128i v) {
+        return _mm_xor_si128(sse2_whitespace(v), _mm_set1_epi8(-1));
+      },
+      scalar_skip_whitespace);
+}
+
+const char *sse2_find_delimiter(const char *p, const char *end) {
+  return sse2_scan(
+      p, end,
+      [](__m128i v) {
+        return _mm_or_si128(sse2_whitespace(v), sse2_delimiter(v));
+      },
+      scalar_find_delimiter);
+}
+
+const char *sse2_find_name_escape(const char *p, const char *end) {
+  return sse2_scan(
+      p, end,
+      [](__m128i v) {
+        // Whitespace is all at or below space already
+        __m128i m = _mm_or_si128(sse2_unprintable(v), sse2_delimiter(v));
+        return _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('#')));
+      },
+      scalar_find_name_escape);
+}
+
+const util::CharScanner SSE2 = {"sse2", sse2_skip_whitespace,
+                                sse2_find_delimiter, sse2_find_name_escape};
+
+#endif
+
+// AVX2 ////////////////////////////////////////////////////////////////////////
+
+#ifdef PDFCLI_HAVE_AVX2
+
+#define PDFCLI_AVX2 __attribute__((target("avx2")))
+
+// The class bits of every byte, see NibbleTables
+PDFCLI_AVX2 inline __m256i avx2_class_bits(__m256i v) {
+  const __m256i high = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(NIBBLES.high)));
+  const __m256i low = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(NIBBLES.low)));
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+  __m256i lo = _mm256_and_si256(v, nibble);
+  return _mm256_and_si256(_mm256_shuffle_epi8(high, hi),
+                          _mm256_shuffle_epi8(low, lo));
+}
+
+// Bytes whose bits are all zero, as a movemask
+PDFCLI_AVX2 inline uint32_t avx2_zero_mask(__m256i bits) {
+  return _mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(bits, _mm256_setzero_si256()));
+}
+
+template <typename Mask, typename Tail>
+PDFCLI_AVX2 const char *avx2_scan(const char *p, const char *end, Mask mask_of,
+                                  Tail tail) {
+  for (; end - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    uint32_t mask = mask_of(v);
+    if (mask != 0)
+      return first_set(p, mask);
+  }
+  return tail(p, end);
+}
+
+PDFCLI_AVX2 const char *avx2_skip_whitespace(const char *p, const char *end) {
+  return avx2_scan(
+      p, end,
+      [](__m256i v) PDFCLI_AVX2 {
+        __m256i bits = _mm256_set1_epi8(NIBBLES.whitespace_bits);
+        __m256i ws = _mm256_and_si256(avx2_class_bits(v), bits);
+        return avx2_zero_mask(ws);
+      },
+      scalar_skip_whitespace);
+}
+
+PDFCLI_AVX2 const char *avx2_find_delimiter(const char *p, const char *end) {
+  return avx2_scan(
+      p, end,
+      [](__m256i v) PDFCLI_AVX2 { return ~avx2_zero_mask(avx2_class_bits(v)); },
+      scalar_find_delimiter);
+}
+
+PDFCLI_AVX2 const char *avx2_find_name_escape(const char *p,
+                                              const char *end) {
+  return avx2_scan(
+      p, end,
+      [](__m256i v) PDFCLI_AVX2 {
+        uint32_t special = ~avx2_zero_mask(avx2_class_bits(v));
+        __m256i low =
+            _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(' ')), v);
+        __m256i high = _mm256_cmpeq_epi8(
+            _mm256_max_epu8(v, _mm256_set1_epi8(static_cast<char>(0x7f))), v);
+        __m256i hash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('#'));
+        __m256i any = _mm256_or_si256(_mm256_or_si256(low, high), hash);
+        return special |
+               static_cast<uint32_t>(_mm256_movemask_epi8(any));
+      },
+      scalar_find_name_escape);
+}
+
+const util::CharScanner AVX2 = {"avx2", avx2_skip_whitespace,
+                                avx2_find_delimiter, avx2_find_name_escape};
+
+#endif
+
+// NEON ////////////////////////////////////////////////////////////////////////
+
+#ifdef PDFCLI_HAVE_NEON
+
+inline uint8x16_t neon_class_bits(uint8x16_t v) {
+  const uint8x16_t high = vld1q_u8(NIBBLES.high);
+  const uint8x16_t low = vld1q_u8(NIBBLES.low);
+  return vandq_u8(vqtbl1q_u8(high, vshrq_n_u8(v, 4)),
+                  vqtbl1q_u8(low, vandq_u8(v, vdupq_n_u8(0x0f))));
+}
+
+// NEON has no movemask. Narrowing each 16 bit lane by 4 leaves a nibble per
+// byte, so the first set byte is the lowest set bit over 4.
+inline uint64_t neon_nibble_mask(uint8x16_t matches) {
+  uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+template <typename Match, typename Tail>
+const char *neon_scan(const char *p, const char *end, Match match, Tail tail) {
+  for (; end - p >= 16; p += 16) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+    uint64_t mask = neon_nibble_mask(match(v));
+    if (mask != 0)
+      return p + (__builtin_ctzll(mask) >> 2);
+  }
+  return tail(p, end);
+}
+
+const char *neon_skip_whitespace(const char *p, const char *end) {
+  return neon_scan(
+      p, end,
+      [](uint8x16_t v) {
+        uint8x16_t ws =
+            vandq_u8(neon_class_bits(v), vdupq_n_u8(NIBBLES.whitespace_bits));
+        return vceqq_u8(ws, vdupq_n_u8(0));
+      },
+      scalar_skip_whitespace);
+}
+
+const char *neon_find_delimiter(const char *p, const char *end) {
+  return neon_scan(
+      p, end,
+      [](uint8x16_t v) {
+        uint8x16_t bits = neon_class_bits(v);
+        return vtstq_u8(bits, bits);
+      },
+      scalar_find_delimiter);
+}
+
+const char *neon_find_name_escape(const char *p, const char *end) {
+  return neon_scan(
+      p, end,
+      [](uint8x16_t v) {
+        uint8x16_t bits = neon_class_bits(v);
+        uint8x16_t m = vtstq_u8(bits, bits);
+        m = vorrq_u8(m, vcleq_u8(v, vdupq_n_u8(' ')));
+        m = vorrq_u8(m, vcgeq_u8(v, vdupq_n_u8(0x7f)));
+        return vorrq_u8(m, vceqq_u8(v, vdupq_n_u8('#')));
+      },
+      scalar_find_name_escape);
+}
+
+const util::CharScanner NEON = {"neon", neon_skip_whitespace,
+                                neon_find_delimiter, neon_find_name_escape};
+
+#endif
+
+const util::CharScanner *best_scanner() {
+#ifdef PDFCLI_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2"))
+    return &AVX2;
+#endif
+#ifdef PDFCLI_HAVE_SSE2
+  return &SSE2;
+#elif defined(PDFCLI_HAVE_NEON)
+  return &NEON;
+#else
+  return &SCALAR;
+#endif
+}
+
+// Picks the scanner before main. Anything lexed during static initialization
+// before this runs uses the byte at a time one, which gives the same answers.
+struct PickScanner {
+  PickScanner() { util::detail::active_scanner = best_scanner(); }
+} pick_scanner;
+
+} // namespace
+
+const util::CharScanner *util::detail::active_scanner = &SCALAR;
+
+std::vector<const util::CharScanner *> util::char_scanners() {
+  std::vector<const CharScanner *> scanners{&SCALAR};
+#ifdef PDFCLI_HAVE_SSE2
+  scanners.push_back(&SSE2);
+#endif
+#ifdef PDFCLI_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2"))
+    scanners.push_back(&AVX2);
+#endif
+#ifdef PDFCLI_HAVE_NEON
+  scanners.push_back(&NEON);
+#endif
+  return scanners;
+}
+
+const util::CharScanner &util::char_scanner() {
+  return *detail::active_scanner;
+}
+
+bool util::use_char_scanner(std::string_view name) {
+  for (const CharScanner *scanner : char_scanners()) {
+    if (name == scanner->name) {
+      detail::active_scanner = scanner;
+      return true;
+    }
+  }
+  return false;
+}
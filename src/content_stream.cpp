@@ -0,0 +1,192 @@
+#include "content_stream.h"
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// The data of an inline image, when its length can not be worked out
+const size_t UNKNOWN_LENGTH = static_cast<size_t>(-1);
+
+namespace {
+
+bool is_operand_keyword(const PdfToken &token) {
+  return token.text == "true" || token.text == "false" || token.text == "null";
+}
+
+// Index just past the value that starts at i, stepping over nested arrays and
+// dicts as one value
+size_t skip_value(const std::vector<PdfToken> &tokens, size_t i) {
+  int depth = 0;
+  do {
+    const PdfToken &token = tokens[i++];
+    if (token.is_delimiter("[") || token.is_delimiter("<<"))
+      ++depth;
+    else if (token.is_delimiter("]") || token.is_delimiter(">>"))
+      --depth;
+  } while (depth > 0 && i < tokens.size());
+  return i;
+}
+
+// Components per pixel of the color spaces an inline image can name directly
+int color_components(std::string_view name) {
+  if (name == "/G" || name == "/DeviceGray" || name == "/I" ||
+      name == "/Indexed")
+    return 1;
+  if (name == "/RGB" || name == "/DeviceRGB")
+    return 3;
+  if (name == "/CMYK" || name == "/DeviceCMYK")
+    return 4;
+  return 0;
+}
+
+// EI has to be a whole keyword
+bool is_ei_at(std::string_view data, size_t pos) {
+  return data.compare(pos, 2, "EI") == 0 &&
+         (pos + 2 == data.size() || !util::is_pdf_regular(data[pos + 2]));
+}
+
+} // namespace
+
+double ContentOp::number(size_t i) const {
+  if (i < count) {
+    if (operands[i].type == PdfTokenType::Int)
+      return static_cast<double>(operands[i].integer);
+    if (operands[i].type == PdfTokenType::Real)
+      return operands[i].real;
+  }
+  throw std::runtime_error("Parse Error: Operand " + std::to_string(i) +
+                           " of " + std::string(op) + " is not a number");
+}
+
+ContentLexer::ContentLexer(std::string_view data) : lex(data) {}
+
+bool ContentLexer::next(ContentOp &op) {
+  stack.clear();
+  while (true) {
+    PdfToken token = lex.next();
+    if (token.type == PdfTokenType::End)
+      return false; // operands with no operator after them are dropped
+
+    if (token.type != PdfTokenType::Keyword || is_operand_keyword(token)) {
+      stack.push_back(token);
+      continue;
+    }
+
+    op.op = token.text;
+    op.offset = token.offset;
+    op.image = std::string_view();
+    if (token.text == "BI")
+      read_inline_image(op);
+    op.operands = stack.data();
+    op.count = stack.size();
+    return true;
+  }
+}
+
+void ContentLexer::read_inline_image(ContentOp &op) {
+  // Anything before BI does not belong to it
+  stack.clear();
+  while (true) {
+    PdfToken token = lex.next();
+    if (token.type == PdfTokenType::End)
+      throw std::runtime_error("Parse Error: Inline image has no ID");
+    if (token.is_keyword("ID"))
+      break;
+    stack.push_back(token);
+  }
+
+  // One whitespace char separates ID from the data
+  std::string_view data = lex.buffer();
+  size_t start = lex.position();
+  if (start < data.size() && util::is_pdf_whitespace(data[start]))
+    ++start;
+
+  size_t length = inline_image_length();
+  if (length != UNKNOWN_LENGTH && length <= data.size() - start) {
+    size_t after = start + length;
+    while (after < data.size() && util::is_pdf_whitespace(data[after]))
+      ++after;
+    if (is_ei_at(data, after)) {
+      op.image = data.substr(start, length);
+      lex.seek(after + 2);
+      return;
+    }
+  }
+
+  // Without a usable length the data ends at the first EI that has
+  // whitespace before it
+  for (size_t pos = start; pos + 2 <= data.size(); ++pos) {
+    pos = data.find("EI", pos);
+    if (pos == std::string_view::npos)
+      break;
+    if (pos > start && util::is_pdf_whitespace(data[pos - 1]) &&
+        is_ei_at(data, pos)) {
+      op.image = data.substr(start, pos - 1 - start);
+      lex.seek(pos + 2);
+      return;
+    }
+  }
+  throw std::runtime_error("Parse Error: Inline image has no EI");
+}
+
+// The dict can say the length outright with /L or /Length. Otherwise it can
+// only be worked out for unfiltered data from the size and the color space.
+size_t ContentLexer::inline_image_length() const {
+  int64_t width = -1, height = -1, bpc = -1, length = -1;
+  int colors = 0;
+  bool filtered = false, mask = false;
+
+  for (size_t i = 0; i + 1 < stack.size();) {
+    const PdfToken &key = stack[i];
+    size_t v = i + 1;
+    size_t next = skip_value(stack, v);
+    const PdfToken &value = stack[v];
+    i = next;
+    if (key.type != PdfTokenType::Name)
+      continue;
+
+    bool is_int = value.type == PdfTokenType::Int;
+    if (key.text == "/L" || key.text == "/Length") {
+      if (is_int)
+        length = value.integer;
+    } else if (key.text == "/W" || key.text == "/Width") {
+      if (is_int)
+        width = value.integer;
+    } else if (key.text == "/H" || key.text == "/Height") {
+      if (is_int)
+        height = value.integer;
+    } else if (key.text == "/BPC" || key.text == "/BitsPerComponent") {
+      if (is_int)
+        bpc = value.integer;
+    } else if (key.text == "/CS" || key.text == "/ColorSpace") {
+      // An indexed space is an array that starts with /I
+      const PdfToken &space =
+          value.is_delimiter("[") && v + 1 < next ? stack[v + 1] : value;
+      colors = color_components(space.text);
+    } else if (key.text == "/F" || key.text == "/Filter") {
+      // An empty filter array means no filter
+      filtered = !(value.is_delimiter("[") && next == v + 2);
+    } else if (key.text == "/IM" || key.text == "/ImageMask") {
+      mask = value.is_keyword("true");
+    }
+  }
+
+  if (length >= 0)
+    return static_cast<size_t>(length);
+  if (filtered)
+    return UNKNOWN_LENGTH;
+  if (mask) {
+    bpc = 1;
+    colors = 1;
+  }
+  if (width <= 0 || height <= 0 || bpc <= 0 || colors == 0)
+    return UNKNOWN_LENGTH;
+  // Rows are padded to a whole byte. The sizes come straight from the
+  // stream, so one too big to be real is left to the EI search.
+  int64_t bits = 0, bytes = 0;
+  if (__builtin_mul_overflow(width, colors, &bits) ||
+      __builtin_mul_overflow(bits, bpc, &bits) ||
+      bits > INT64_MAX - 7 ||
+      __builtin_mul_overflow((bits + 7) / 8, height, &bytes))
+    return UNKNOWN_LENGTH;
+  return static_cast<size_t>(bytes);
+}
@@ -0,0 +1,163 @@
+#include "document_info.h"
+#include "page_tree.h"
+#include "pdf_parser.h"
+#include <exception>
+#include <memory>
+
+// The header has to be near the start, some files have junk before it
+const size_t HEADER_SEARCH_LIMIT = 1024;
+
+namespace {
+
+void append_utf8(std::string &out, uint32_t code) {
+  if (code < 0x80) {
+    out += static_cast<char>(code);
+  } else if (code < 0x800) {
+    out += static_cast<char>(0xc0 | (code >> 6));
+    out += static_cast<char>(0x80 | (code & 0x3f));
+  } else if (code < 0x10000) {
+    out += static_cast<char>(0xe0 | (code >> 12));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (code & 0x3f));
+  } else {
+    out += static_cast<char>(0xf0 | (code >> 18));
+    out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (code & 0x3f));
+  }
+}
+
+// Newlines in a value would break the one fact per line output
+std::string one_line(std::string text) {
+  for (char &c : text) {
+    if (c == '\n' || c == '\r')
+      c = ' ';
+  }
+  return text;
+}
+
+const util::PdfDict *as_dict(const util::PdfObj *obj) {
+  if (obj == nullptr)
+    return nullptr;
+  if (const util::PdfStream *stream = obj->as<util::PdfStream>())
+    return stream->dict;
+  return obj->as<util::PdfDict>();
+}
+
+} // namespace
+
+std::string_view header_version(std::string_view data) {
+  size_t pos = data.substr(0, HEADER_SEARCH_LIMIT).find("%PDF-");
+  if (pos == std::string_view::npos)
+    return std::string_view();
+  size_t start = pos + 5, end = start;
+  while (end < data.size() &&
+         ((data[end] >= '0' && data[end] <= '9') || data[end] == '.'))
+    ++end;
+  return data.substr(start, end - start);
+}
+
+std::string text_string_utf8(std::string_view bytes) {
+  std::string out;
+  if (bytes.size() >= 2 && static_cast<unsigned char>(bytes[0]) == 0xfe &&
+      static_cast<unsigned char>(bytes[1]) == 0xff) {
+    for (size_t i = 2; i + 1 < bytes.size(); i += 2) {
+      uint32_t unit = static_cast<unsigned char>(bytes[i]) << 8 |
+                      static_cast<unsigned char>(bytes[i + 1]);
+      // A high surrogate followed by a low one is a character past the BMP
+      if (unit >= 0xd800 && unit < 0xdc00 && i + 3 < bytes.size()) {
+        uint32_t low = static_cast<unsigned char>(bytes[i + 2]) << 8 |
+                       static_cast<unsigned char>(bytes[i + 3]);
+        if (low >= 0xdc00 && low < 0xe000) {
+          append_utf8(out, 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00));
+          i += 2;
+          continue;
+        }
+      }
+      append_utf8(out, unit);
+    }
+    return out;
+  }
+  for (unsigned char c : bytes)
+    append_utf8(out, c);
+  return out;
+}
+
+void write_info(PdfParser &parser, std::ostream &os) {
+  const XrefTable &xref = parser.xref();
+  // The few bytes past the limit are for a version that straddles it
+  std::string_view version =
+      header_version(parser.fetch_bytes(0, HEADER_SEARCH_LIMIT + 16));
+  os << "version: " << (version.empty() ? "unknown" : version) << "\n";
+  os << "size: " << parser.bytes().size() << "\n";
+  os << "objects: " << xref.object_count() << "\n";
+  os << "xref sections: " << xref.sections().size() << "\n";
+
+  std::string pages = "unknown";
+  try {
+    pages = std::to_string(PageTree(parser).count());
+  } catch (const std::exception &) {
+  }
+  os << "pages: " << pages << "\n";
+  os << "encrypted: "
+     << (xref.trailer().pairs.get(atom::Encrypt) != nullptr ? "yes" : "no")
+     << "\n";
+
+  std::shared_ptr<const util::PdfObj> info;
+  try {
+    info = parser.resolve(xref.trailer().pairs.get(atom::Info));
+  } catch (const std::exception &) {
+  }
+  const util::PdfDict *dict = as_dict(info.get());
+  if (dict == nullptr)
+    return;
+  const std::pair<PdfAtom, const char *> keys[] = {
+      {atom::Title, "title"},     {atom::Author, "author"},
+      {atom::Creator, "creator"}, {atom::Producer, "producer"},
+      {atom::CreationDate, "created"}, {atom::ModDate, "modified"},
+  };
+  for (const auto &[key, label] : keys) {
+    std::shared_ptr<const util::PdfObj> value;
+    try {
+      value = parser.resolve(dict->pairs.get(key));
+    } catch (const std::exception &) {
+      continue;
+    }
+    const util::PdfString *text =
+        value != nullptr ? value->as<util::PdfString>() : nullptr;
+    if (text != nullptr)
+      os << label << ": " << one_line(text_string_utf8(text->data)) << "\n";
+  }
+}
+
+void list_objects(PdfParser &parser, std::ostream &os) {
+  const std::vector<XrefEntry> &entries = parser.xref().all();
+  for (size_t num = 0; num < entries.size(); ++num) {
+    const XrefEntry &entry = entries[num];
+    if (entry.type != XrefType::InUse && entry.type != XrefType::Compressed)
+      continue;
+    int64_t gen = entry.type == XrefType::InUse ? entry.gen : 0;
+    os << num << " " << gen << " ";
+    if (entry.type == XrefType::InUse)
+      os << "offset=" << entry.offset;
+    else
+      os << "objstm=" << entry.offset << ":" << entry.index;
+
+    ObjectCache::ObjPtr obj;
+    try {
+      obj = parser.get_object(num, gen);
+    } catch (const std::exception &) {
+    }
+    if (obj == nullptr || obj->obj == nullptr) {
+      os << " damaged\n";
+      continue;
+    }
+    os << " " << util::type_name(obj->obj->type);
+    const util::PdfDict *dict = as_dict(obj->obj);
+    const util::PdfObj *type =
+        dict != nullptr ? dict->pairs.get(atom::Type) : nullptr;
+    if (type != nullptr && type->as<util::PdfName>() != nullptr)
+      os << " " << type->as<util::PdfName>()->data;
+    os << "\n";
+  }
+}
@@ -0,0 +1,624 @@
+#include "filters.h"
+#include "lexer.h"
+#include "stats.h"
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+// Size of the output buffer of each stage, and of the chunks fed into a chain
+const size_t FILTER_CHUNK_SIZE = 16384;
+
+// Decoded sizes are guessed from the encoded size when there is no /DL, and
+// never reserve more than the limit up front
+const size_t COMPRESSION_RATIO_GUESS = 4;
+const size_t MAX_SIZE_HINT = 64 * 1024 * 1024;
+
+namespace {
+
+[[noreturn]] void decode_error(const std::string &msg) {
+  throw std::runtime_error("Decode Error: " + msg);
+}
+
+int64_t int_param(const util::PdfDict *params, PdfAtom key, int64_t fallback) {
+  if (params == nullptr)
+    return fallback;
+  const util::PdfInt *value = nullptr;
+  if (util::PdfObj *obj = params->pairs.get(key))
+    value = obj->as<util::PdfInt>();
+  return value != nullptr ? value->data : fallback;
+}
+
+// Flate ///////////////////////////////////////////////////////////////////////
+
+class FlateStage : public util::FilterStage {
+public:
+  // The inflate state comes from the pool so building a chain for every
+  // stream does not set up zlib every time
+  FlateStage() : context(InflatePool::global().acquire()) {}
+
+  void reset() override {
+    FilterStage::reset();
+    context->state.reset();
+    done = false;
+  }
+
+  void write(const char *data, size_t size) override {
+    std::string_view in(data, size);
+    while (!done) {
+      size_t space = out.size() - used;
+      size_t before = in.size();
+      size_t produced = 0;
+      InflateState::Status status =
+          context->state.inflate(in, out.data() + used, space, produced);
+      used += produced;
+      if (used == out.size())
+        flush();
+
+      if (status == InflateState::Error)
+        throw std::runtime_error("Inflate Error: Corrupt deflate data");
+      if (status == InflateState::StreamEnd)
+        done = true; // anything after the end is ignored
+      // Stop once the input is used up and zlib had room to spare, or if
+      // nothing moved at all
+      if ((in.empty() && produced < space) ||
+          (produced == 0 && in.size() == before))
+        break;
+    }
+  }
+
+private:
+  InflatePool::Lease context;
+  bool done = false;
+};
+
+// LZW /////////////////////////////////////////////////////////////////////////
+
+const int LZW_CLEAR = 256;
+const int LZW_EOD = 257;
+const int LZW_FIRST_CODE = 258;
+const int LZW_MAX_CODES = 4096;
+
+class LzwStage : public util::FilterStage {
+public:
+  LzwStage(bool early_change)
+      : early(early_change ? 1 : 0), prefix(LZW_MAX_CODES),
+        suffix(LZW_MAX_CODES), first(LZW_MAX_CODES), length(LZW_MAX_CODES),
+        text(LZW_MAX_CODES) {
+    for (int i = 0; i < 256; ++i) {
+      suffix[i] = first[i] = static_cast<char>(i);
+      length[i] = 1;
+    }
+    reset();
+  }
+
+  void reset() override {
+    FilterStage::reset();
+    clear_table();
+    bits = 0;
+    bit_count = 0;
+    done = false;
+  }
+
+  void write(const char *data, size_t size) override {
+    for (size_t i = 0; i < size && !done; ++i) {
+      bits = bits << 8 | static_cast<unsigned char>(data[i]);
+      bit_count += 8;
+      while (bit_count >= width && !done) {
+        bit_count -= width;
+        code((bits >> bit_count) & ((1u << width) - 1));
+      }
+    }
+  }
+
+private:
+  void clear_table() {
+    next_code = LZW_FIRST_CODE;
+    width = 9;
+    prev = -1;
+  }
+
+  void code(int c) {
+    if (c == LZW_CLEAR) {
+      clear_table();
+      return;
+    }
+    if (c == LZW_EOD) {
+      done = true;
+      return;
+    }
+
+    if (prev == -1) {
+      if (c > 255)
+        decode_error("LZW data starts with an undefined code");
+      put(static_cast<char>(c));
+      prev = c;
+      return;
+    }
+
+    if (c < next_code) {
+      emit(c);
+      add(prev, first[c]);
+    } else if (c == next_code) {
+      // The KwKwK case, the code being defined right now
+      add(prev, first[prev]);
+      emit(c);
+    } else {
+      decode_error("LZW code is not in the table yet");
+    }
+    prev = c;
+  }
+
+  void add(int code, char ch) {
+    if (next_code >= LZW_MAX_CODES)
+      return;
+    prefix[next_code] = static_cast<uint16_t>(code);
+    suffix[next_code] = ch;
+    first[next_code] = first[code];
+    length[next_code] = length[code] + 1;
+    ++next_code;
+    if (next_code + early >= (1 << width) && width < 12)
+      ++width;
+  }
+
+  // The string for a code is stored backwards as a chain of prefixes
+  void emit(int c) {
+    size_t n = length[c];
+    for (size_t i = n; i > 0; --i) {
+      text[i - 1] = suffix[c];
+      c = prefix[c];
+    }
+    put(text.data(), n);
+  }
+
+  int early;
+  std::vector<uint16_t> prefix;
+  std::vector<char> suffix;
+  std::vector<char> first;
+  std::vector<uint16_t> length;
+  std::vector<char> text;
+  int next_code = LZW_FIRST_CODE;
+  int width = 9;
+  int prev = -1;
+  uint32_t bits = 0;
+  int bit_count = 0;
+  bool done = false;
+};
+
+// ASCIIHex ////////////////////////////////////////////////////////////////////
+
+int hex_digit(char ch) {
+  if (ch >= '0' && ch <= '9')
+    return ch - '0';
+  if (ch >= 'a' && ch <= 'f')
+    return ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'F')
+    return ch - 'A' + 10;
+  return -1;
+}
+
+class AsciiHexStage : public util::FilterStage {
+public:
+  void reset() override {
+    FilterStage::reset();
+    high = -1;
+    done = false;
+  }
+
+  void write(const char *data, size_t size) override {
+    for (size_t i = 0; i < size && !done; ++i) {
+      char ch = data[i];
+      if (ch == '>') {
+        done = true;
+        break;
+      }
+      if (util::is_pdf_whitespace(ch))
+        continue;
+      int digit = hex_digit(ch);
+      if (digit < 0)
+        decode_error("Invalid char in ASCIIHex data");
+      if (high < 0) {
+        high = digit;
+      } else {
+        put(static_cast<char>(high << 4 | digit));
+        high = -1;
+      }
+    }
+  }
+
+  void finish() override {
+    // A missing last digit is taken as 0
+    if (high >= 0)
+      put(static_cast<char>(high << 4));
+    high = -1;
+    FilterStage::finish();
+  }
+
+private:
+  int high = -1;
+  bool done = false;
+};
+
+// ASCII85 /////////////////////////////////////////////////////////////////////
+
+class Ascii85Stage : public util::FilterStage {
+public:
+  void reset() override {
+    FilterStage::reset();
+    count = 0;
+    value = 0;
+    done = false;
+  }
+
+  void write(const char *data, size_t size) override {
+    for (size_t i = 0; i < size && !done; ++i) {
+      char ch = data[i];
+      if (util::is_pdf_whitespace(ch))
+        continue;
+      if (ch == '~') {
+        end_group();
+        done = true;
+      } else if (ch == 'z' && count == 0) {
+        put("\0\0\0\0", 4);
+      } else if (ch >= '!' && ch <= 'u') {
+        value = value * 85 + (ch - '!');
+        if (++count == 5) {
+          put_bytes(4);
+          count = 0;
+          value = 0;
+        }
+      } else {
+        decode_error("Invalid char in ASCII85 data");
+      }
+    }
+  }
+
+  void finish() override {
+    if (!done)
+      end_group();
+    FilterStage::finish();
+  }
+
+private:
+  // A final group of n chars is padded with u and gives n - 1 bytes
+  void end_group() {
+    if (count > 1) {
+      int n = count;
+      for (; count < 5; ++count)
+        value = value * 85 + ('u' - '!');
+      put_bytes(n - 1);
+    }
+    count = 0;
+    value = 0;
+  }
+
+  void put_bytes(int n) {
+    for (int i = 0; i < n; ++i)
+      put(static_cast<char>(value >> (24 - 8 * i)));
+  }
+
+  int count = 0;
+  uint64_t value = 0;
+  bool done = false;
+};
+
+// RunLength ///////////////////////////////////////////////////////////////////
+
+class RunLengthStage : public util::FilterStage {
+public:
+  void reset() override {
+    FilterStage::reset();
+    literal = 0;
+    repeat = 0;
+    done = false;
+  }
+
+  void write(const char *data, size_t size) override {
+    for (size_t i = 0; i < size && !done; ++i) {
+      unsigned char ch = static_cast<unsigned char>(data[i]);
+      if (literal > 0) {
+        size_t n = std::min(static_cast<size_t>(literal), size - i);
+        put(data + i, n);
+        literal -= n;
+        i += n - 1;
+      } else if (repeat > 0) {
+        for (int j = 0; j < repeat; ++j)
+          put(static_cast<char>(ch));
+        repeat = 0;
+      } else if (ch < 128) {
+        literal = ch + 1;
+      } else if (ch > 128) {
+        repeat = 257 - ch;
+      } else {
+        done = true;
+      }
+    }
+  }
+
+private:
+  int literal = 0;
+  int repeat = 0;
+  bool done = false;
+};
+
+// Predictors //////////////////////////////////////////////////////////////////
+
+class PredictorStage : public util::FilterStage {
+public:
+  PredictorStage(const util::PdfDict *params) {
+    predictor = int_param(params, atom::Predictor, 1);
+    int64_t colors = int_param(params, atom::Colors, 1);
+    int64_t bits = int_param(params, atom::BitsPerComponent, 8);
+    int64_t columns = int_param(params, atom::Columns, 1);
+    if (colors < 1 || bits < 1 || columns < 1 ||
+        colors * bits * columns > 1 << 30)
+      decode_error("Invalid predictor parameters");
+    // TIFF predictor, only the common 8 bit case
+    if (predictor == 2 && bits != 8)
+      decode_error("TIFF predictor needs 8 bits");
+
+    pixel_bytes = (colors * bits + 7) / 8;
+    row_bytes = (colors * bits * columns + 7) / 8;
+    // PNG rows start with their own filter type byte
+    png = predictor >= 10;
+    row.resize(row_bytes + (png ? 1 : 0));
+    prev.resize(row_bytes);
+  }
+
+  void reset() override {
+    FilterStage::reset();
+    filled = 0;
+    std::fill(prev.begin(), prev.end(), 0);
+  }
+
+  void write(const char *data, size_t size) override {
+    while (size > 0) {
+      size_t n = std::min(size, row.size() - filled);
+      std::copy(data, data + n, row.begin() + filled);
+      filled += n;
+      data += n;
+      size -= n;
+      if (filled == row.size()) {
+        decode_row(row_bytes);
+        filled = 0;
+      }
+    }
+  }
+
+  void finish() override {
+    // A short last row is decoded as far as it goes for PNG and passed through
+    // for TIFF, like other readers do
+    if (png && filled > 1) {
+      std::fill(row.begin() + filled, row.end(), 0);
+      decode_row(filled - 1);
+    } else if (!png && filled > 0) {
+      put(row.data(), filled);
+    }
+    filled = 0;
+    FilterStage::finish();
+  }
+
+private:
+  void decode_row(size_t len) {
+    if (!png) {
+      for (size_t i = pixel_bytes; i < row_bytes; ++i)
+        row[i] = static_cast<char>(row[i] + row[i - pixel_bytes]);
+      put(row.data(), len);
+      return;
+    }
+
+    unsigned char type = row[0];
+    unsigned char *cur = reinterpret_cast<unsigned char *>(row.data() + 1);
+    for (size_t i = 0; i < row_bytes; ++i) {
+      unsigned left = i >= pixel_bytes ? cur[i - pixel_bytes] : 0;
+      unsigned up = prev[i];
+      unsigned up_left = i >= pixel_bytes ? prev[i - pixel_bytes] : 0;
+      switch (type) {
+      case 0:
+        break;
+      case 1:
+        cur[i] += left;
+        break;
+      case 2:
+        cur[i] += up;
+        break;
+      case 3:
+        cur[i] += (left + up) / 2;
+        break;
+      case 4: {
+        int p = static_cast<int>(left + up) - static_cast<int>(up_left);
+        int pa = std::abs(p - static_cast<int>(left));
+        int pb = std::abs(p - static_cast<int>(up));
+        int pc = std::abs(p - static_cast<int>(up_left));
+        cur[i] += (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : up_left);
+        break;
+      }
+      default:
+        decode_error("Unknown PNG predictor row type");
+      }
+    }
+    std::copy(cur, cur + row_bytes, prev.begin());
+    put(row.data() + 1, len);
+  }
+
+  int64_t predictor = 1;
+  size_t pixel_bytes = 1;
+  size_t row_bytes = 1;
+  bool png = false;
+  std::vector<char> row;
+  std::vector<unsigned char> prev;
+  size_t filled = 0;
+};
+
+// Decode params can be an array with one entry for each filter
+const util::PdfDict *params_at(const util::PdfObj *params, size_t i) {
+  if (params == nullptr)
+    return nullptr;
+  if (const util::PdfArray *all = params->as<util::PdfArray>()) {
+    if (i >= all->objects.size() || all->objects[i] == nullptr)
+      return nullptr;
+    return all->objects[i]->as<util::PdfDict>();
+  }
+  return i == 0 ? params->as<util::PdfDict>() : nullptr;
+}
+
+} // namespace
+
+size_t util::decoded_size_hint(const PdfDict &dict, size_t encoded_size) {
+  // /DL is optional but exact when it is there. Nothing stops it from being
+  // huge though, so it is not trusted past a limit.
+  int64_t dl = int_param(&dict, atom::DL, -1);
+  if (dl >= 0 && static_cast<uint64_t>(dl) <= MAX_SIZE_HINT)
+    return dl;
+
+  if (dict.pairs.get(atom::Filter) == nullptr)
+    return encoded_size;
+  size_t guess = encoded_size * COMPRESSION_RATIO_GUESS;
+  return guess < MAX_SIZE_HINT ? guess : MAX_SIZE_HINT;
+}
+
+// Stages //////////////////////////////////////////////////////////////////////
+
+util::FilterStage::FilterStage() : out(FILTER_CHUNK_SIZE) {}
+
+void util::FilterStage::put(const char *data, size_t size) {
+  while (size > 0) {
+    size_t n = std::min(size, out.size() - used);
+    std::copy(data, data + n, out.begin() + used);
+    used += n;
+    data += n;
+    size -= n;
+    if (used == out.size())
+      flush();
+  }
+}
+
+void util::FilterStage::flush() {
+  if (used > 0 && next != nullptr)
+    next->write(out.data(), used);
+  used = 0;
+}
+
+void util::FilterStage::finish() {
+  flush();
+  if (next != nullptr)
+    next->finish();
+}
+
+std::unique_ptr<util::FilterStage>
+util::make_filter(const PdfName &filter, const PdfDict *params) {
+  // Inline images use abbreviated names for the same filters
+  std::string_view name = filter.data;
+  if (filter.atom == atom::FlateDecode || name == "/Fl")
+    return std::make_unique<FlateStage>();
+  if (filter.atom == atom::LZWDecode || name == "/LZW")
+    return std::make_unique<LzwStage>(int_param(params, atom::EarlyChange, 1));
+  if (filter.atom == atom::ASCIIHexDecode || name == "/AHx")
+    return std::make_unique<AsciiHexStage>();
+  if (filter.atom == atom::ASCII85Decode || name == "/A85")
+    return std::make_unique<Ascii85Stage>();
+  if (filter.atom == atom::RunLengthDecode || name == "/RL")
+    return std::make_unique<RunLengthStage>();
+  decode_error("Unsupported filter " + std::string(name));
+}
+
+std::unique_ptr<util::FilterStage>
+util::make_predictor(const PdfDict *params) {
+  if (int_param(params, atom::Predictor, 1) < 2)
+    return nullptr;
+  return std::make_unique<PredictorStage>(params);
+}
+
+// Chains //////////////////////////////////////////////////////////////////////
+
+util::FilterChain util::FilterChain::for_dict(const PdfDict &dict) {
+  FilterChain chain;
+  PdfObj *filter = dict.pairs.get(atom::Filter);
+  if (filter == nullptr)
+    return chain;
+  PdfObj *params = dict.pairs.get(atom::DecodeParms);
+
+  std::vector<const PdfName *> names;
+  if (const PdfArray *filters = filter->as<PdfArray>()) {
+    for (PdfObj *obj : filters->objects) {
+      const PdfName *name = obj != nullptr ? obj->as<PdfName>() : nullptr;
+      if (name == nullptr)
+        decode_error("Filter arrays can only hold names");
+      names.push_back(name);
+    }
+  } else if (const PdfName *name = filter->as<PdfName>()) {
+    names.push_back(name);
+  } else {
+    decode_error("/Filter must be a name or an array of names");
+  }
+
+  for (size_t i = 0; i < names.size(); ++i) {
+    const PdfDict *p = params_at(params, i);
+    chain.add(make_filter(*names[i], p));
+    // Only Flate and LZW can be followed by a predictor
+    bool predicted = names[i]->atom == atom::FlateDecode ||
+                     names[i]->atom == atom::LZWDecode ||
+                     names[i]->data == "/Fl" || names[i]->data == "/LZW";
+    if (predicted) {
+      if (auto predictor = make_predictor(p))
+        chain.add(std::move(predictor));
+    }
+  }
+  return chain;
+}
+
+void util::FilterChain::add(std::unique_ptr<FilterStage> stage) {
+  stages.push_back(std::move(stage));
+}
+
+void util::FilterChain::decode(std::string_view data, ByteSink &sink) {
+  PDF_STATS_SCOPE(FilterDecode);
+  if (stages.empty()) {
+    sink.write(data.data(), data.size());
+    sink.finish();
+    return;
+  }
+
+  for (size_t i = 0; i < stages.size(); ++i) {
+    stages[i]->reset();
+    stages[i]->set_next(i + 1 < stages.size() ? stages[i + 1].get() : &sink);
+  }
+  FilterStage &head = *stages.front();
+  while (!data.empty()) {
+    size_t n = std::min(data.size(), FILTER_CHUNK_SIZE);
+    head.write(data.data(), n);
+    data.remove_prefix(n);
+  }
+  head.finish();
+}
+
+// Whole buffer helpers ////////////////////////////////////////////////////////
+
+std::vector<char> util::decode_stream(const PdfStream &stream) {
+  std::vector<char> out;
+  out.reserve(decoded_size_hint(*stream.dict, stream.bytes().size()));
+  VectorSink sink(out);
+  FilterChain::for_dict(*stream.dict).decode(stream.bytes(), sink);
+  return out;
+}
+
+std::vector<char> util::inflate_bytes(std::string_view data) {
+  std::vector<char> out;
+  VectorSink sink(out);
+  FilterChain chain;
+  chain.add(std::make_unique<FlateStage>());
+  chain.decode(data, sink);
+  return out;
+}
+
+std::vector<char> util::unpredict(const std::vector<char> &data,
+                                  const PdfDict *params) {
+  auto predictor = make_predictor(params);
+  if (predictor == nullptr)
+    return data;
+  std::vector<char> out;
+  VectorSink sink(out);
+  FilterChain chain;
+  chain.add(std::move(predictor));
+  chain.decode(std::string_view(data.data(), data.size()), sink);
+  return out;
+}
@@ -0,0 +1,270 @@
+#include "incremental.h"
+#include "lexer.h"
+#include "pdf_parser.h"
+#include "serializer.h"
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// One past the %%EOF that ends the revision whose xref is at offset, and the
+// end of line after it
+size_t revision_end(std::string_view data, size_t offset) {
+  size_t found = util::find_bytes(data.substr(offset), "%%EOF");
+  if (found == std::string_view::npos)
+    return data.size();
+  size_t end = offset + found + 5;
+  if (end < data.size() && data[end] == '\r')
+    ++end;
+  if (end < data.size() && data[end] == '\n')
+    ++end;
+  return end;
+}
+
+// Read one section into a revision and return its /Prev, or -1
+int64_t read_revision(std::string_view data, size_t offset,
+                      Revision &revision) {
+  XrefTable section = XrefTable::load_section(data, offset);
+  revision.xref_offset = offset;
+  revision.end = revision_end(data, offset);
+  const std::vector<XrefEntry> &entries = section.all();
+  for (size_t num = 1; num < entries.size(); ++num) {
+    if (entries[num].type == XrefType::InUse ||
+        entries[num].type == XrefType::Compressed)
+      revision.changed.push_back(num);
+    else if (entries[num].type == XrefType::Free)
+      revision.freed.push_back(num);
+  }
+  const util::PdfObj *prev = section.trailer().pairs.get(atom::Prev);
+  const util::PdfInt *value =
+      prev != nullptr ? prev->as<util::PdfInt>() : nullptr;
+  return value != nullptr ? value->data : -1;
+}
+
+} // namespace
+
+std::vector<Revision> find_revisions(std::string_view data) {
+  std::vector<Revision> revisions;
+  int64_t offset = util::find_startxref(data);
+  std::set<int64_t> seen;
+  while (offset >= 0 && seen.insert(offset).second) {
+    if (static_cast<size_t>(offset) >= data.size())
+      throw std::runtime_error(
+          "Xref Error: Section offset is past the end of the file");
+    revisions.emplace_back();
+    offset = read_revision(data, offset, revisions.back());
+  }
+
+  // Each revision starts where the one before it ended
+  for (size_t i = 0; i + 1 < revisions.size(); ++i)
+    revisions[i].start = revisions[i + 1].end;
+  return revisions;
+}
+
+Revision latest_revision(std::string_view data) {
+  Revision revision;
+  int64_t prev = read_revision(data, util::find_startxref(data), revision);
+  if (prev >= 0 && static_cast<size_t>(prev) < data.size())
+    revision.start = revision_end(data, prev);
+  return revision;
+}
+
+namespace {
+
+// Objects that are not the current version are not put in the parser's
+// cache, they get an arena of their own that the pointer keeps alive
+ObjectCache::ObjPtr own_object(std::unique_ptr<Arena> arena,
+                               const util::PdfTopLevel *obj) {
+  return ObjectCache::ObjPtr(std::shared_ptr<Arena>(std::move(arena)), obj);
+}
+
+// Parse the object a revision's section says is at offset, out of the bytes
+// up to the end of that revision
+const util::PdfTopLevel *parse_revision_object(PdfParser &parser,
+                                               const Revision &revision,
+                                               uint64_t offset, int64_t num,
+                                               Arena &arena) {
+  if (offset >= revision.end)
+    throw std::runtime_error("Parse Error: Object " + std::to_string(num) +
+                             " is past the end of its revision");
+  parser.fetch_bytes(offset, revision.end - offset);
+  PdfLexer lex(parser.bytes().substr(0, revision.end));
+  lex.seek(offset);
+  const util::PdfTopLevel *top =
+      util::parse_pdf_obj(lex, &arena)->as<util::PdfTopLevel>();
+  if (top == nullptr || top->num != num)
+    throw std::runtime_error("Parse Error: Xref offset for object " +
+                             std::to_string(num) +
+                             " does not point at that object");
+  return top;
+}
+
+} // namespace
+
+std::vector<ObjectCache::ObjPtr> revision_objects(PdfParser &parser,
+                                                  const Revision &revision) {
+  const XrefTable &current = parser.xref();
+  XrefTable section = XrefTable::load_section(parser.bytes(),
+                                              revision.xref_offset);
+  std::vector<ObjectCache::ObjPtr> objects;
+  for (int64_t num : revision.changed) {
+    const XrefEntry *entry = section.find(num);
+    const XrefEntry *latest = current.find(num);
+    if (entry == nullptr)
+      continue;
+
+    // Still the current version, so it goes through the cache like any other
+    if (latest != nullptr && latest->type == entry->type &&
+        latest->offset == entry->offset && latest->gen == entry->gen &&
+        latest->index == entry->index) {
+      if (ObjectCache::ObjPtr obj = parser.get_object(
+              num, entry->type == XrefType::InUse ? entry->gen : 0))
+        objects.push_back(obj);
+      continue;
+    }
+
+    auto arena = std::make_unique<Arena>();
+    if (entry->type == XrefType::InUse) {
+      const util::PdfTopLevel *top =
+          parse_revision_object(parser, revision, entry->offset, num, *arena);
+      objects.push_back(own_object(std::move(arena), top));
+      continue;
+    }
+
+    // An older version of a compressed object, read from the object stream
+    // this revision wrote, or from the current one if it wrote none
+    std::shared_ptr<const ObjectStream> stream;
+    const XrefEntry *stream_entry = section.find(entry->offset);
+    if (stream_entry != nullptr && stream_entry->type == XrefType::InUse) {
+      Arena stream_arena;
+      const util::PdfTopLevel *top = parse_revision_object(
+          parser, revision, stream_entry->offset, entry->offset, stream_arena);
+      const util::PdfStream *payload = top->obj->as<util::PdfStream>();
+      if (payload == nullptr)
+        throw std::runtime_error("Parse Error: Object " +
+                                 std::to_string(entry->offset) +
+                                 " is not an object stream");
+      stream = std::make_shared<const ObjectStream>(*payload);
+    } else {
+      stream = parser.object_stream(entry->offset);
+    }
+    int64_t index = stream->find(num);
+    if (index < 0)
+      throw std::runtime_error("Parse Error: Object " + std::to_string(num) +
+                               " is not in object stream " +
+                               std::to_string(entry->offset));
+    const util::PdfTopLevel *top = stream->parse(index, *arena);
+    objects.push_back(own_object(std::move(arena), top));
+  }
+  return objects;
+}
+
+// Writer //////////////////////////////////////////////////////////////////////
+
+IncrementalWriter::IncrementalWriter(PdfParser &p)
+    : parser(p), data(p.bytes()),
+      next_num(std::max<size_t>(p.xref().size(), 1)) {
+  // The original bytes are written out as they are
+  parser.fetch_all();
+}
+
+void IncrementalWriter::set(int64_t num, std::unique_ptr<util::PdfObj> obj,
+                            int64_t gen) {
+  if (num <= 0)
+    throw std::out_of_range("Object numbers start at 1");
+  if (obj == nullptr)
+    throw std::invalid_argument("Use remove to delete an object");
+  changes[num] = Change{gen, std::move(obj)};
+  if (num >= next_num)
+    next_num = num + 1;
+}
+
+int64_t IncrementalWriter::add(std::unique_ptr<util::PdfObj> obj) {
+  int64_t num = next_num;
+  set(num, std::move(obj));
+  return num;
+}
+
+// A deleted object's generation goes up by one so that old references to it
+// no longer match anything
+void IncrementalWriter::remove(int64_t num) {
+  // Only objects the document or this update has can go, or the new xref
+  // would hold rows past its /Size
+  if (num <= 0)
+    throw std::out_of_range("Object numbers start at 1");
+  if (num >= next_num)
+    throw std::out_of_range("No object " + std::to_string(num) + " to remove");
+  const XrefEntry *entry = parser.xref().find(num);
+  int64_t gen = entry != nullptr && entry->type == XrefType::InUse
+                    ? entry->gen + 1
+                    : 0;
+  changes[num] = Change{gen, nullptr};
+}
+
+void IncrementalWriter::write(std::ostream &os) const {
+  // No changes is no revision, not an empty one
+  if (changes.empty())
+    return;
+  const XrefTable &xref = parser.xref();
+  PdfSerializer out(os);
+
+  // The update has to start on a new line after the old %%EOF
+  if (!data.empty() && data.back() != '\n' && data.back() != '\r')
+    out.put('\n');
+
+  std::map<int64_t, size_t> offsets;
+  for (const auto &[num, change] : changes) {
+    if (change.obj == nullptr)
+      continue;
+    offsets[num] = data.size() + out.offset();
+    out.integer(num);
+    out.put(' ');
+    out.integer(change.gen);
+    out.raw(" obj\n");
+    out.write(*change.obj);
+    out.raw("\nendobj\n");
+  }
+
+  // One subsection for each run of consecutive object numbers
+  size_t xref_offset = data.size() + out.offset();
+  out.raw("xref\n");
+  for (auto it = changes.begin(); it != changes.end();) {
+    auto run_end = it;
+    int64_t count = 0;
+    while (run_end != changes.end() && run_end->first == it->first + count) {
+      ++run_end;
+      ++count;
+    }
+    out.integer(it->first);
+    out.put(' ');
+    out.integer(count);
+    out.put('\n');
+    for (; it != run_end; ++it) {
+      bool in_use = it->second.obj != nullptr;
+      out.padded(in_use ? offsets[it->first] : 0, 10);
+      out.put(' ');
+      out.padded(it->second.gen, 5);
+      out.raw(in_use ? " n\r\n" : " f\r\n");
+    }
+  }
+
+  int64_t size = std::max<int64_t>(xref.size(), next_num);
+  out.raw("trailer\n<< /Size ");
+  out.integer(size);
+  out.raw(" /Prev ");
+  out.integer(util::find_startxref(data));
+  for (PdfAtom key : {atom::Root, atom::Info, atom::ID, atom::Encrypt}) {
+    const util::PdfObj *value = xref.trailer().pairs.get(key);
+    if (value == nullptr)
+      continue;
+    out.put(' ');
+    out.raw(NameTable::global().text(key));
+    out.put(' ');
+    out.write(*value);
+  }
+  out.raw(" >>\nstartxref\n");
+  out.integer(xref_offset);
+  out.raw("\n%%EOF\n");
+}
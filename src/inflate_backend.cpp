@@ -0,0 +1,155 @@
+#include "inflate_backend.h"
+#include "stats.h"
+#include <cstdint>
+#include <stdexcept>
+
+#ifdef PDFCLI_ZLIB_NG
+#include <zlib-ng.h>
+using backend_stream = zng_stream;
+#define BACKEND_CALL(name) zng_##name
+#define BACKEND_NAME "zlib-ng"
+#else
+#include <zlib.h>
+using backend_stream = z_stream;
+#define BACKEND_CALL(name) ::name
+#define BACKEND_NAME "zlib"
+#endif
+
+struct InflateState::Impl {
+  backend_stream strm{};
+};
+
+InflateState::InflateState() : impl(new Impl) {
+  if (BACKEND_CALL(inflateInit)(&impl->strm) != Z_OK)
+    throw std::runtime_error("Inflate Error: Failed to initialize "
+                             BACKEND_NAME);
+}
+
+InflateState::~InflateState() { BACKEND_CALL(inflateEnd)(&impl->strm); }
+
+void InflateState::reset() { BACKEND_CALL(inflateReset)(&impl->strm); }
+
+InflateState::Status InflateState::inflate(std::string_view &in, char *out,
+                                           size_t out_size, size_t &produced) {
+  backend_stream &strm = impl->strm;
+  // zlib counts in 32 bits, so very big inputs go in more than one call
+  size_t in_size = in.size() < UINT32_MAX ? in.size() : UINT32_MAX;
+  size_t out_limit = out_size < UINT32_MAX ? out_size : UINT32_MAX;
+  strm.next_in = reinterpret_cast<decltype(strm.next_in)>(
+      const_cast<char *>(in.data()));
+  strm.avail_in = in_size;
+  strm.next_out = reinterpret_cast<decltype(strm.next_out)>(out);
+  strm.avail_out = out_limit;
+
+  int ret = BACKEND_CALL(inflate)(&strm, Z_NO_FLUSH);
+  produced = out_limit - strm.avail_out;
+  PDF_STATS_ADD(BytesInflated, produced);
+  in.remove_prefix(in_size - strm.avail_in);
+
+  if (ret == Z_STREAM_END)
+    return StreamEnd;
+  // Z_BUF_ERROR only means there was nothing to do, which is fine here
+  if (ret == Z_OK || ret == Z_BUF_ERROR)
+    return Ok;
+  return Error;
+}
+
+const char *InflateState::backend_name() { return BACKEND_NAME; }
+
+// Deflating is only done for whole buffers, so it does not need a state that
+// is kept around like inflating does
+std::vector<char> deflate_buffer(std::string_view data, int level) {
+  auto bound = BACKEND_CALL(compressBound)(data.size());
+  std::vector<char> out(bound);
+  decltype(bound) size = bound;
+  int ret = BACKEND_CALL(compress2)(
+      reinterpret_cast<uint8_t *>(out.data()), &size,
+      reinterpret_cast<const uint8_t *>(data.data()), data.size(), level);
+  if (ret != Z_OK)
+    throw std::runtime_error("Deflate Error: " BACKEND_NAME
+                             " failed to compress");
+  out.resize(size);
+  return out;
+}
+
+// Pool ////////////////////////////////////////////////////////////////////////
+
+InflatePool::Lease::~Lease() {
+  if (context)
+    pool->release(std::move(context));
+}
+
+InflatePool &InflatePool::global() {
+  static InflatePool pool;
+  return pool;
+}
+
+InflatePool::InflatePool(size_t buffer_size, size_t max_idle)
+    : buffer_bytes(buffer_size > 0 ? buffer_size : 1), max_idle(max_idle) {}
+
+InflatePool::Lease InflatePool::acquire() {
+  std::unique_ptr<Context> context;
+  size_t size;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    size = buffer_bytes;
+    if (!contexts.empty()) {
+      context = std::move(contexts.back());
+      contexts.pop_back();
+    } else {
+      ++created_count;
+    }
+  }
+
+  // Setting up a new one is the slow part, so it is done outside the lock
+  if (context)
+    context->state.reset();
+  else
+    context = std::make_unique<Context>();
+  context->in.resize(size);
+  context->out.resize(size);
+  return Lease(this, std::move(context));
+}
+
+void InflatePool::reserve(size_t count) {
+  size_t missing, size;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    count = count < max_idle ? count : max_idle;
+    missing = count > contexts.size() ? count - contexts.size() : 0;
+    size = buffer_bytes;
+    created_count += missing;
+  }
+  for (size_t i = 0; i < missing; ++i) {
+    auto context = std::make_unique<Context>();
+    context->in.resize(size);
+    context->out.resize(size);
+    release(std::move(context));
+  }
+}
+
+void InflatePool::release(std::unique_ptr<Context> context) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (contexts.size() < max_idle)
+    contexts.push_back(std::move(context));
+}
+
+void InflatePool::set_buffer_size(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  buffer_bytes = bytes > 0 ? bytes : 1;
+}
+
+size_t InflatePool::buffer_size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return buffer_bytes;
+}
+
+size_t InflatePool::idle() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return contexts.size();
+}
+
+size_t InflatePool::created() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return created_count;
+}
@@ -0,0 +1,166 @@
+#include "input_source.h"
+#include "stats.h"
+#include <fstream>
+#include <ios>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PDFCLI_HAVE_MMAP 1
+#endif
+
+const size_t READ_CHUNK_SIZE = 65536;
+
+InputSource InputSource::open(const std::string &filename) {
+#ifdef PDFCLI_HAVE_MMAP
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::ios_base::failure("Failed to open file: " + filename);
+
+  InputSource source;
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    void *addr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      source.mapping = addr;
+      source.start = static_cast<const char *>(addr);
+      source.length = info.st_size;
+      ::close(fd);
+      PDF_STATS_ADD(BytesRead, source.length);
+      return source;
+    }
+  }
+
+  // Not something we can map, so read it in chunks until there is no more.
+  // This is the path for pipes and special files that do not know their size.
+  while (true) {
+    size_t used = source.buffer.size();
+    source.buffer.resize(used + READ_CHUNK_SIZE);
+    ssize_t got = ::read(fd, source.buffer.data() + used, READ_CHUNK_SIZE);
+    if (got < 0) {
+      ::close(fd);
+      throw std::ios_base::failure("Error reading file: " + filename);
+    }
+    source.buffer.resize(used + got);
+    if (got == 0)
+      break;
+  }
+  ::close(fd);
+  source.start = source.buffer.data();
+  source.length = source.buffer.size();
+  PDF_STATS_ADD(BytesRead, source.length);
+  return source;
+#else
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open())
+    throw std::ios_base::failure("Failed to open file: " + filename);
+  return InputSource::read(file);
+#endif
+}
+
+InputSource InputSource::read(std::istream &is) {
+  InputSource source;
+  while (is) {
+    size_t used = source.buffer.size();
+    source.buffer.resize(used + READ_CHUNK_SIZE);
+    is.read(source.buffer.data() + used, READ_CHUNK_SIZE);
+    source.buffer.resize(used + is.gcount());
+  }
+  if (is.bad())
+    throw std::ios_base::failure("Error reading input stream");
+
+  source.start = source.buffer.data();
+  source.length = source.buffer.size();
+  PDF_STATS_ADD(BytesRead, source.length);
+  return source;
+}
+
+InputSource InputSource::view(std::string_view bytes) {
+  InputSource source;
+  source.start = bytes.data();
+  source.length = bytes.size();
+  return source;
+}
+
+InputSource::InputSource(InputSource &&other) noexcept {
+  *this = std::move(other);
+}
+
+InputSource &InputSource::operator=(InputSource &&other) noexcept {
+  if (this == &other)
+    return *this;
+  unmap();
+
+  // Moving a vector keeps its heap block, so start stays valid when it
+  // points into the buffer.
+  buffer = std::move(other.buffer);
+  mapping = other.mapping;
+  start = other.start;
+  length = other.length;
+
+  other.mapping = nullptr;
+  other.start = nullptr;
+  other.length = 0;
+  return *this;
+}
+
+InputSource::~InputSource() { unmap(); }
+
+void InputSource::unmap() {
+#ifdef PDFCLI_HAVE_MMAP
+  if (mapping != nullptr)
+    munmap(mapping, length);
+#endif
+  mapping = nullptr;
+}
+
+// SpanStreamBuf //////////////////////////////////////////////////////////////
+
+SpanStreamBuf::SpanStreamBuf(std::string_view bytes) {
+  // The get area is never written to, the cast is only to satisfy setg
+  char *begin = const_cast<char *>(bytes.data());
+  setg(begin, begin, begin + bytes.size());
+}
+
+std::string_view SpanStreamBuf::remaining() const {
+  return std::string_view(gptr(), egptr() - gptr());
+}
+
+void SpanStreamBuf::advance(size_t n) {
+  size_t left = egptr() - gptr();
+  setg(eback(), gptr() + (n < left ? n : left), egptr());
+}
+
+size_t SpanStreamBuf::position() const { return gptr() - eback(); }
+
+SpanStreamBuf::pos_type SpanStreamBuf::seekoff(off_type off,
+                                               std::ios_base::seekdir dir,
+                                               std::ios_base::openmode which) {
+  if (!(which & std::ios_base::in))
+    return pos_type(off_type(-1));
+
+  off_type base = 0;
+  if (dir == std::ios_base::cur)
+    base = gptr() - eback();
+  else if (dir == std::ios_base::end)
+    base = egptr() - eback();
+
+  off_type target = base + off;
+  if (target < 0 || target > egptr() - eback())
+    return pos_type(off_type(-1));
+
+  setg(eback(), eback() + target, egptr());
+  return pos_type(target);
+}
+
+SpanStreamBuf::pos_type SpanStreamBuf::seekpos(pos_type pos,
+                                               std::ios_base::openmode which) {
+  return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+SpanStream::SpanStream(std::string_view bytes)
+    : std::istream(nullptr), buf(bytes) {
+  rdbuf(&buf);
+}
@@ -0,0 +1,439 @@
+#include "lexer.h"
+#include "char_scan.h"
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+using util::char_class;
+using util::DELIMITER;
+using util::REGULAR;
+using util::WHITESPACE;
+
+inline bool is_digit(char ch) { return ch >= '0' && ch <= '9'; }
+
+int hex_value(char ch) {
+  if (ch >= '0' && ch <= '9')
+    return ch - '0';
+  if (ch >= 'a' && ch <= 'f')
+    return ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'F')
+    return ch - 'A' + 10;
+  return -1;
+}
+
+[[noreturn]] void lex_error(const std::string &msg, std::string_view text) {
+  throw std::runtime_error("Parse Error: " + msg + std::string(text));
+}
+
+// Exact powers of ten. A double can hold every one of these and every integer
+// below 2^53 exactly, so one division of the two is correctly rounded.
+constexpr double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                            1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                            1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+constexpr uint64_t MAX_EXACT_MANTISSA = uint64_t(1) << 53;
+
+// The slow path for the numbers the kernel does not take, from_chars is
+// still correct for those but does not take a leading +
+bool slow_number(std::string_view text, util::PdfNumber &number) {
+  std::string_view digits = text.substr(text[0] == '+' ? 1 : 0);
+  double d = 0;
+  auto result =
+      std::from_chars(digits.data(), digits.data() + digits.size(), d);
+  if (result.ec != std::errc() || result.ptr != digits.data() + digits.size())
+    return false;
+  number.is_int = false;
+  number.real = d;
+  return true;
+}
+
+} // namespace
+
+bool util::scan_pdf_number(std::string_view text, PdfNumber &number) {
+  if (text.empty())
+    return false;
+  size_t i = 0;
+  bool negative = false;
+  if (text[i] == '+' || text[i] == '-') {
+    negative = text[i] == '-';
+    ++i;
+  }
+
+  // Digits on both sides of the point go into one mantissa, and the number
+  // of them after the point is the power of ten to divide by at the end
+  uint64_t mantissa = 0;
+  size_t digits = 0;
+  size_t fraction_digits = 0;
+  bool point = false;
+  bool exact = true;
+  for (; i < text.size(); ++i) {
+    char ch = text[i];
+    if (is_digit(ch)) {
+      if (mantissa > (UINT64_MAX - 9) / 10)
+        exact = false;
+      else
+        mantissa = mantissa * 10 + (ch - '0');
+      ++digits;
+      fraction_digits += point;
+    } else if (ch == '.' && !point) {
+      point = true;
+    } else {
+      break;
+    }
+  }
+
+  // Anything left over, like an exponent, is not pdf syntax but the old
+  // parser took it, so let from_chars decide
+  if (i != text.size())
+    return slow_number(text, number);
+  if (digits == 0)
+    return false;
+
+  if (!point && exact && mantissa <= static_cast<uint64_t>(INT64_MAX)) {
+    number.is_int = true;
+    number.integer = negative ? -static_cast<int64_t>(mantissa)
+                              : static_cast<int64_t>(mantissa);
+    return true;
+  }
+  if (exact && mantissa <= MAX_EXACT_MANTISSA &&
+      fraction_digits < std::size(POW10)) {
+    double d = static_cast<double>(mantissa) / POW10[fraction_digits];
+    number.is_int = false;
+    number.real = negative ? -d : d;
+    return true;
+  }
+  return slow_number(text, number);
+}
+
+namespace {
+
+// Convert a run of regular characters that starts like a number. Returns false
+// if it is not actually a valid number.
+bool convert_number(std::string_view text, PdfToken &token) {
+  util::PdfNumber number;
+  if (!util::scan_pdf_number(text, number))
+    return false;
+  if (number.is_int) {
+    token.type = PdfTokenType::Int;
+    token.integer = number.integer;
+  } else {
+    token.type = PdfTokenType::Real;
+    token.real = number.real;
+  }
+  return true;
+}
+
+} // namespace
+
+bool util::is_pdf_whitespace(char ch) { return char_class(ch) == WHITESPACE; }
+bool util::is_pdf_delimiter(char ch) { return char_class(ch) == DELIMITER; }
+bool util::is_pdf_regular(char ch) { return char_class(ch) == REGULAR; }
+
+// Lexer //////////////////////////////////////////////////////////////////////
+
+PdfLexer::PdfLexer(const char *data, size_t size, bool stable)
+    : begin(data), cur(data), end(data + size), bytes_are_stable(stable) {}
+
+PdfLexer::PdfLexer(std::string_view data, bool stable)
+    : PdfLexer(data.data(), data.size(), stable) {}
+
+void PdfLexer::skip_whitespace() {
+  while (true) {
+    cur = util::skip_pdf_whitespace(cur, end);
+    if (cur == end || *cur != '%')
+      return;
+    while (cur < end && *cur != '\n' && *cur != '\r')
+      ++cur;
+  }
+}
+
+std::string_view PdfLexer::context(const char *from) const {
+  return std::string_view(from, end - from < 16 ? end - from : 16);
+}
+
+PdfToken PdfLexer::peek() {
+  const char *saved = cur;
+  PdfToken token = next();
+  cur = saved;
+  return token;
+}
+
+PdfToken PdfLexer::next() {
+  skip_whitespace();
+
+  PdfToken token;
+  token.offset = position();
+  if (cur >= end)
+    return token;
+
+  const char *start = cur;
+  char ch = *cur;
+
+  if (ch == '/') {
+    cur = util::find_pdf_delimiter(cur + 1, end);
+    token.type = PdfTokenType::Name;
+    token.text = std::string_view(start, cur - start);
+    return token;
+  }
+
+  if (ch == '(') {
+    // Parens can nest without escapes as long as they are balanced
+    size_t depth = 1;
+    ++cur;
+    while (cur < end) {
+      if (*cur == '\\') {
+        cur = end - cur > 2 ? cur + 2 : end;
+        continue;
+      }
+      if (*cur == '(') {
+        ++depth;
+      } else if (*cur == ')' && --depth == 0) {
+        break;
+      }
+      ++cur;
+    }
+    if (cur >= end)
+      lex_error("Unterminated PDF string: ", context(start));
+    token.type = PdfTokenType::String;
+    token.text = std::string_view(start + 1, cur - start - 1);
+    ++cur;
+    return token;
+  }
+
+  if (ch == '<') {
+    if (cur + 1 < end && cur[1] == '<') {
+      cur += 2;
+      token.type = PdfTokenType::Delimiter;
+      token.text = std::string_view(start, 2);
+      return token;
+    }
+    ++cur;
+    while (cur < end && *cur != '>') {
+      if (hex_value(*cur) < 0 && char_class(*cur) != WHITESPACE)
+        lex_error("Invalid char in PDF hex string: ", std::string_view(cur, 1));
+      ++cur;
+    }
+    if (cur >= end)
+      lex_error("Unterminated PDF hex string: ", context(start));
+    token.type = PdfTokenType::HexString;
+    token.text = std::string_view(start + 1, cur - start - 1);
+    ++cur;
+    return token;
+  }
+
+  if (ch == '>') {
+    if (cur + 1 < end && cur[1] == '>') {
+      cur += 2;
+      token.type = PdfTokenType::Delimiter;
+      token.text = std::string_view(start, 2);
+      return token;
+    }
+    lex_error("Dicts must end with >>, Got ", std::string_view(cur, 1));
+  }
+
+  if (ch == '[' || ch == ']' || ch == '{' || ch == '}') {
+    ++cur;
+    token.type = PdfTokenType::Delimiter;
+    token.text = std::string_view(start, 1);
+    return token;
+  }
+
+  if (ch == ')')
+    lex_error("Unbalanced ) in PDF: ", std::string_view(cur, 1));
+
+  // Everything else is a run of regular characters
+  cur = util::find_pdf_delimiter(cur, end);
+  token.text = std::string_view(start, cur - start);
+
+  if (is_digit(ch) || ch == '+' || ch == '-' || ch == '.') {
+    if (!convert_number(token.text, token))
+      lex_error("Failed to parse a number: Got ", token.text);
+    return token;
+  }
+
+  token.type = PdfTokenType::Keyword;
+  return token;
+}
+
+std::string_view PdfLexer::stream_payload(int64_t length) {
+  PdfToken keyword = next();
+  if (!keyword.is_keyword("stream"))
+    lex_error("Content stream must start with stream, Got ", keyword.text);
+
+  // The keyword is followed by CRLF or LF before the data starts
+  if (end - cur >= 2 && cur[0] == '\r' && cur[1] == '\n')
+    cur += 2;
+  else if (cur < end && *cur == '\n')
+    cur += 1;
+
+  // Trust the length if endstream is right where it says the data ends
+  if (length >= 0 && length <= end - cur) {
+    const char *after = cur + length;
+    while (after < end && util::is_pdf_whitespace(*after))
+      ++after;
+    if (end - after >= 9 && std::memcmp(after, "endstream", 9) == 0) {
+      std::string_view payload(cur, length);
+      cur = after + 9;
+      return payload;
+    }
+  }
+
+  std::string_view rest = remaining();
+  size_t found = util::find_bytes(rest, "endstream");
+  if (found == std::string_view::npos)
+    lex_error("Content stream is missing endstream", "");
+
+  // The end of line before endstream is not part of the data
+  size_t data_end = found;
+  if (data_end > 0 && rest[data_end - 1] == '\n')
+    --data_end;
+  if (data_end > 0 && rest[data_end - 1] == '\r')
+    --data_end;
+
+  cur += found + 9;
+  return rest.substr(0, data_end);
+}
+
+size_t util::find_bytes(std::string_view haystack, std::string_view needle) {
+#if defined(__GLIBC__) || defined(__APPLE__) || defined(__FreeBSD__)
+  if (needle.empty())
+    return 0;
+  const void *found = memmem(haystack.data(), haystack.size(), needle.data(),
+                             needle.size());
+  if (found == nullptr)
+    return std::string_view::npos;
+  return static_cast<const char *>(found) - haystack.data();
+#else
+  return haystack.find(needle);
+#endif
+}
+
+// String decoding ////////////////////////////////////////////////////////////
+
+std::string util::decode_literal_string(std::string_view raw) {
+  std::string out;
+  out.reserve(raw.size());
+  for (size_t i = 0; i < raw.size(); ++i) {
+    char ch = raw[i];
+    if (ch != '\\' || i + 1 >= raw.size()) {
+      // A bare CR or CRLF inside a string is read as LF
+      if (ch == '\r') {
+        if (i + 1 < raw.size() && raw[i + 1] == '\n')
+          ++i;
+        ch = '\n';
+      }
+      out += ch;
+      continue;
+    }
+
+    ch = raw[++i];
+    switch (ch) {
+    case 'n':
+      out += '\n';
+      break;
+    case 'r':
+      out += '\r';
+      break;
+    case 't':
+      out += '\t';
+      break;
+    case 'b':
+      out += '\b';
+      break;
+    case 'f':
+      out += '\f';
+      break;
+    case '\r': // line continuation
+      if (i + 1 < raw.size() && raw[i + 1] == '\n')
+        ++i;
+      break;
+    case '\n':
+      break;
+    default:
+      if (ch >= '0' && ch <= '7') {
+        int value = 0;
+        for (size_t n = 0; n < 3 && i < raw.size() && raw[i] >= '0' &&
+                           raw[i] <= '7';
+             ++n, ++i)
+          value = value * 8 + (raw[i] - '0');
+        --i;
+        out += static_cast<char>(value & 0xFF);
+      } else {
+        // \( \) \\ and unknown escapes are just the char
+        out += ch;
+      }
+    }
+  }
+  return out;
+}
+
+std::string util::decode_hex_string(std::string_view raw) {
+  std::string out;
+  out.reserve(raw.size() / 2 + 1);
+  int high = -1;
+  for (char ch : raw) {
+    int value = hex_value(ch);
+    if (value < 0)
+      continue;
+    if (high < 0) {
+      high = value;
+    } else {
+      out += static_cast<char>(high << 4 | value);
+      high = -1;
+    }
+  }
+  if (high >= 0)
+    out += static_cast<char>(high << 4);
+  return out;
+}
+
+std::string util::decode_name(std::string_view raw) {
+  std::string out;
+  out.reserve(raw.size());
+  size_t from = 0;
+  for (size_t hash = raw.find('#'); hash != std::string_view::npos;
+       hash = raw.find('#', hash + 1)) {
+    if (hash + 2 >= raw.size())
+      break;
+    int high = hex_value(raw[hash + 1]);
+    int low = hex_value(raw[hash + 2]);
+    if (high < 0 || low < 0)
+      continue;
+    out.append(raw.substr(from, hash - from));
+    out += static_cast<char>(high << 4 | low);
+    from = hash + 3;
+    hash += 2;
+  }
+  out.append(raw.substr(from));
+  return out;
+}
+
+bool util::name_needs_escapes(std::string_view name) {
+  if (name.empty())
+    return false;
+  const char *end = name.data() + name.size();
+  return find_name_escape(name.data() + 1, end) != end;
+}
+
+std::string util::encode_name(std::string_view name) {
+  if (name.empty())
+    return std::string();
+  static const char HEX[] = "0123456789ABCDEF";
+  std::string out(1, name[0]);
+  const char *cur = name.data() + 1;
+  const char *end = name.data() + name.size();
+  while (cur < end) {
+    const char *escape = find_name_escape(cur, end);
+    out.append(cur, escape);
+    if (escape == end)
+      break;
+    unsigned char ch = static_cast<unsigned char>(*escape);
+    out += '#';
+    out += HEX[ch >> 4];
+    out += HEX[ch & 0xF];
+    cur = escape + 1;
+  }
+  return out;
+}
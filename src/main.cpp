@@ -1,32 +1,285 @@
+#include "batch.h"
+#include "document_info.h"
 #include "pdf_parser.h"
+#include "range_reader.h"
+#include "rewriter.h"
+#include "sidecar.h"
+#include "stats.h"
+#include "text_extract.h"
+#include "thread_pool.h"
+#include <cstdlib>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 
-// This is an informal test to be able to read a test pdf document and check
-// what it looks like with the streams decompressed. The file is not included
-// in the project and it is not a test to confirm the correctness of a function.
+// The command line tool. The first argument picks what to do with the files
+// given last, and the options in between depend on the command. One file is
+// worked on with every thread, more than one is a batch where the threads
+// each take a file.
 
-int main() {
-  // Read from a test pdf file
-  std::ifstream file(
-      "/home/strinsberg/Documents/references-steven-deutekom.pdf",
-      std::ios::binary);
+namespace {
 
-  if (!file.is_open()) {
-    throw std::runtime_error("Failed to open file");
+const char *USAGE = R"(usage: pdfcli <command> [options] <file>...
+       pdfcli <command> [options] -b <list>
+
+commands:
+  inflate        write the document with every deflate stream decompressed
+  extract-text   write the text of each page, followed by a form feed
+  rewrite        write a clean copy of the document with a new xref table
+  objects        list every object with where it is and what it is
+  info           write the version, page count, and /Info of the document
+
+options:
+  -p <pages>     pages to extract like 1-3,7,10-, every page by default
+  -j <threads>   threads to use, every core by default
+  -z <level>     rewrite: deflate streams again at a level from 0 to 9
+  -s             rewrite: pack objects into object streams with an xref stream
+  -i             keep a sidecar index next to the file so it opens faster
+  -r             read the file in ranges as they are needed instead of mapping
+                 it, with io_uring where it can, for files on network storage
+  -o <path>      write to a file instead of stdout, or for a batch to one file
+                 per document in the directory path
+  -b <list>      batch: read the files from a list, one per line, - for stdin
+  --stats[=json] print where the time went to stderr, as a table or JSON
+
+A file of - reads the document from stdin. Files with * ? or [ in them are
+expanded here, so a quoted pattern can name more files than the shell allows.
+)";
+
+struct Command {
+  const char *name;
+  const char *extension; // for batch output files
+};
+
+const Command COMMANDS[] = {
+    {"inflate", ".pdf"}, {"extract-text", ".txt"}, {"rewrite", ".pdf"},
+    {"objects", ".txt"}, {"info", ".txt"},
+};
+
+struct Options {
+  const Command *command = nullptr;
+  std::vector<std::string> files;
+  std::string list; // batch list file, - for stdin
+  std::string output;
+  PageRange pages;
+  size_t threads = 0;
+  bool sidecar = false;
+  bool ranged = false;
+  std::string stats; // empty, table, or json
+  RewriteOptions rewrite;
+};
+
+[[noreturn]] void usage_error(const std::string &msg) {
+  std::cerr << "pdfcli: " << msg << "\n\n" << USAGE;
+  std::exit(2);
+}
+
+bool takes_value(std::string_view arg) {
+  return arg == "-p" || arg == "-j" || arg == "-z" || arg == "-o" ||
+         arg == "-b";
+}
+
+Options parse_args(int argc, char **argv) {
+  std::vector<std::string_view> args(argv + 1, argv + argc);
+  if (args.empty())
+    usage_error("no command given");
+  if (args[0] == "-h" || args[0] == "--help") {
+    std::cout << USAGE;
+    std::exit(0);
   }
 
-  file.seekg(0, std::ios::end);
-  std::string contents(static_cast<std::string::size_type>(file.tellg()), ' ');
-  file.seekg(0, std::ios::beg);
-  file.read(&contents[0], contents.size());
+  Options options;
+  for (const Command &command : COMMANDS) {
+    if (args[0] == command.name)
+      options.command = &command;
+  }
+  if (options.command == nullptr)
+    usage_error("unknown command " + std::string(args[0]));
+  for (size_t i = 1; i < args.size(); ++i) {
+    std::string_view arg = args[i];
+    if (takes_value(arg) && i + 1 >= args.size())
+      usage_error(std::string(arg) + " needs a value");
+    if (arg == "-p") {
+      try {
+        options.pages = PageRange::parse(args[++i]);
+      } catch (const std::exception &e) {
+        usage_error(e.what());
+      }
+    } else if (arg == "-j") {
+      std::string value(args[++i]);
+      char *end = nullptr;
+      unsigned long threads = std::strtoul(value.c_str(), &end, 10);
+      if (value.empty() || *end != '\0')
+        usage_error("bad thread count " + value);
+      options.threads = threads;
+    } else if (arg == "-z") {
+      std::string_view value = args[++i];
+      if (value.size() != 1 || value[0] < '0' || value[0] > '9')
+        usage_error("bad compression level " + std::string(value));
+      options.rewrite.compress_level = value[0] - '0';
+    } else if (arg == "-s") {
+      options.rewrite.object_streams = true;
+    } else if (arg == "-i") {
+      options.sidecar = true;
+    } else if (arg == "-r") {
+      options.ranged = true;
+    } else if (arg == "-o") {
+      options.output = args[++i];
+    } else if (arg == "-b") {
+      options.list = args[++i];
+    } else if (arg == "--stats" || arg == "--stats=table") {
+      options.stats = "table";
+    } else if (arg == "--stats=json") {
+      options.stats = "json";
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      usage_error("unknown option " + std::string(arg));
+    } else {
+      options.files.emplace_back(arg);
+    }
+  }
+  if (options.files.empty() && options.list.empty())
+    usage_error("no file given");
+  return options;
+}
 
-  file.close();
+// Run the command on one document. With a pool the work is spread over it,
+// without one it is all done on the calling thread. Pages that had to be
+// skipped are reported on stderr and do not fail the document.
+void run_command(const Options &options, PdfParser &parser,
+                 const std::string &file, std::ostream &os, ThreadPool *pool) {
+  std::string_view name = options.command->name;
+  if (name == "inflate") {
+    if (pool != nullptr)
+      parser.parallel_inflate_to(os, *pool);
+    else
+      parser.inflate_to(os);
+  } else if (name == "extract-text") {
+    std::vector<PageError> errors =
+        pool != nullptr ? extract_text(parser, os, *pool, options.pages)
+                        : extract_text(parser, os, options.pages);
+    for (const PageError &error : errors)
+      std::cerr << "pdfcli: " << file << ": page " << error.page << ": "
+                << error.message << "\n";
+  } else if (name == "rewrite") {
+    if (pool != nullptr)
+      rewrite_document(parser, os, *pool, options.rewrite);
+    else
+      rewrite_document(parser, os, options.rewrite);
+  } else if (name == "objects") {
+    list_objects(parser, os);
+  } else {
+    write_info(parser, os);
+  }
+  os.flush();
+}
 
-  // Create a parser and printout the decompressed pdf
-  PdfParser parser(contents);
-  std::cout << parser.naive_inflate() << std::endl;
+// One document with the whole pool. - reads it from stdin.
+int run_single(const Options &options, const std::string &file,
+               ThreadPool &pool) {
+  try {
+    // Only one of these is used, whichever the parser reads from
+    std::optional<InputSource> source;
+    std::unique_ptr<RangedSource> ranged;
+    std::unique_ptr<PdfParser> parser_ptr;
+    if (file == "-") {
+      source.emplace(InputSource::read(std::cin));
+      parser_ptr = std::make_unique<PdfParser>(*source);
+    } else if (options.ranged) {
+      ranged = std::make_unique<RangedSource>(open_range_reader(file));
+      parser_ptr = std::make_unique<PdfParser>(*ranged);
+    } else {
+      source.emplace(InputSource::open(file));
+      parser_ptr = std::make_unique<PdfParser>(*source);
+    }
+    PdfParser &parser = *parser_ptr;
+    if (options.sidecar && file != "-")
+      open_with_sidecar(parser, file);
 
+    std::ofstream out_file;
+    if (!options.output.empty() && options.output != "-") {
+      out_file.open(options.output, std::ios::binary | std::ios::trunc);
+      if (!out_file)
+        throw std::ios_base::failure("Could not write " + options.output);
+    }
+    std::ostream &os = out_file.is_open() ? out_file : std::cout;
+    run_command(options, parser, file, os, &pool);
+    if (!os)
+      throw std::ios_base::failure("Error writing output");
+  } catch (const std::exception &e) {
+    std::cerr << "pdfcli: " << file << ": " << e.what() << "\n";
+    return 1;
+  }
   return 0;
 }
+
+int run_many(const Options &options, const std::vector<std::string> &files,
+             ThreadPool &pool) {
+  BatchOptions batch;
+  batch.ranged = options.ranged;
+  if (!options.output.empty() && options.output != "-") {
+    batch.output_dir = options.output;
+    batch.extension = options.command->extension;
+  }
+  DocumentTask task = [&options](PdfParser &parser, const std::string &path,
+                                 std::ostream &os) {
+    if (options.sidecar)
+      open_with_sidecar(parser, path);
+    run_command(options, parser, path, os, nullptr);
+  };
+  BatchResult result =
+      run_batch(files, task, pool, std::cout, std::cerr, batch);
+  return result.failed == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options = parse_args(argc, argv);
+#ifndef PDFCLI_STATS
+  if (!options.stats.empty()) {
+    std::cerr << "pdfcli: built without stats, --stats is ignored\n";
+    options.stats.clear();
+  }
+#endif
+  stats::enable(!options.stats.empty());
+
+  std::vector<std::string> files = expand_paths(options.files);
+  if (!options.list.empty()) {
+    std::vector<std::string> listed;
+    if (options.list == "-") {
+      listed = read_path_list(std::cin);
+    } else {
+      std::ifstream is(options.list);
+      if (!is) {
+        std::cerr << "pdfcli: " << options.list << ": could not be read\n";
+        return 1;
+      }
+      listed = read_path_list(is);
+    }
+    files.insert(files.end(), listed.begin(), listed.end());
+  }
+
+  ThreadPool pool(options.threads);
+  bool batch = files.size() > 1 || !options.list.empty();
+  int status = 0;
+  if (batch) {
+    for (const std::string &file : files) {
+      if (file == "-")
+        usage_error("stdin can only be read for a single document");
+    }
+    status = run_many(options, files, pool);
+  } else if (!files.empty()) {
+    status = run_single(options, files.front(), pool);
+  }
+
+  if (options.stats == "json")
+    stats::write_json(std::cerr, stats::snapshot());
+  else if (options.stats == "table")
+    stats::write_table(std::cerr, stats::snapshot());
+  return status;
+}
@@ -0,0 +1,70 @@
+#include "names.h"
+#include <mutex>
+#include <stdexcept>
+
+static_assert(well_known_atom("/Length") == atom::Length,
+              "Well known atoms should resolve at compile time");
+
+NameTable &NameTable::global() {
+  static NameTable table;
+  return table;
+}
+
+NameTable::NameTable() {
+  // The well known names are string literals so they do not need storage
+  for (std::string_view name : WELL_KNOWN_NAMES) {
+    atoms.emplace(name, static_cast<PdfAtom>(texts.size()));
+    texts.push_back(name);
+  }
+}
+
+PdfAtom NameTable::intern(std::string_view name, std::string_view *text) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = atoms.find(name);
+    if (it != atoms.end()) {
+      if (text != nullptr)
+        *text = it->first;
+      return it->second;
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  // Someone else might have added it while we waited for the lock
+  auto it = atoms.find(name);
+  if (it != atoms.end()) {
+    if (text != nullptr)
+      *text = it->first;
+    return it->second;
+  }
+
+  storage.emplace_back(name);
+  std::string_view stored = storage.back();
+  PdfAtom id = static_cast<PdfAtom>(texts.size());
+  texts.push_back(stored);
+  atoms.emplace(stored, id);
+  if (text != nullptr)
+    *text = stored;
+  return id;
+}
+
+PdfAtom NameTable::find(std::string_view name) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  auto it = atoms.find(name);
+  return it == atoms.end() ? NO_ATOM : it->second;
+}
+
+std::string_view NameTable::text(PdfAtom id) const {
+  // The well known names never change so they do not need the lock
+  if (id < atom::WELL_KNOWN_COUNT)
+    return WELL_KNOWN_NAMES[id];
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  if (id >= texts.size())
+    throw std::out_of_range("Name table has no atom " + std::to_string(id));
+  return texts[id];
+}
+
+size_t NameTable::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return texts.size();
+}
@@ -0,0 +1,72 @@
+#include "object_cache.h"
+#include "stats.h"
+
+ObjectCache::ObjectCache(size_t budget) : max_bytes(budget) {}
+
+// The aliasing constructor shares ownership of the entry, and so its arena,
+// while pointing at the object inside it
+ObjectCache::ObjPtr ObjectCache::share(const EntryPtr &entry) {
+  return ObjPtr(entry, entry->obj);
+}
+
+ObjectCache::ObjPtr ObjectCache::get(int64_t num) {
+  auto it = index.find(num);
+  if (it == index.end()) {
+    ++miss_count;
+    PDF_STATS_ADD(CacheMisses, 1);
+    return nullptr;
+  }
+  ++hit_count;
+  PDF_STATS_ADD(CacheHits, 1);
+  lru.splice(lru.begin(), lru, it->second);
+  return share(*it->second);
+}
+
+ObjectCache::ObjPtr ObjectCache::put(int64_t num, std::unique_ptr<Arena> arena,
+                                     const util::PdfTopLevel *obj) {
+  erase(num);
+  auto entry = std::make_shared<Entry>();
+  entry->num = num;
+  entry->bytes = sizeof(Entry) + (arena ? arena->bytes_used() : 0);
+  entry->arena = std::move(arena);
+  entry->obj = obj;
+
+  if (entry->bytes > max_bytes)
+    return share(entry);
+
+  evict(max_bytes - entry->bytes);
+  lru.push_front(entry);
+  index[num] = lru.begin();
+  used_bytes += entry->bytes;
+  return share(entry);
+}
+
+void ObjectCache::erase(int64_t num) {
+  auto it = index.find(num);
+  if (it == index.end())
+    return;
+  used_bytes -= (*it->second)->bytes;
+  lru.erase(it->second);
+  index.erase(it);
+}
+
+void ObjectCache::clear() {
+  lru.clear();
+  index.clear();
+  used_bytes = 0;
+}
+
+void ObjectCache::set_budget(size_t bytes) {
+  max_bytes = bytes;
+  evict(max_bytes);
+}
+
+void ObjectCache::evict(size_t target) {
+  while (used_bytes > target && !lru.empty()) {
+    EntryPtr &last = lru.back();
+    used_bytes -= last->bytes;
+    index.erase(last->num);
+    lru.pop_back();
+    ++eviction_count;
+  }
+}
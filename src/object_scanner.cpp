@@ -0,0 +1,89 @@
+#include "object_scanner.h"
+#include "lexer.h"
+#include <stdexcept>
+
+// Objects are small, most fit in the first block of the arena
+const size_t SCANNER_ARENA_SIZE = 16 * 1024;
+
+namespace {
+
+bool is_digit(char ch) { return ch >= '0' && ch <= '9'; }
+
+} // namespace
+
+ObjectScanner::ObjectScanner(std::string_view d)
+    : data(d), arena(SCANNER_ARENA_SIZE) {}
+
+const util::PdfTopLevel *ObjectScanner::next() {
+  arena.release();
+  size_t start;
+  while (pos < data.size() && find_object(pos, start)) {
+    PdfLexer lex(data);
+    lex.seek(start);
+    try {
+      util::PdfObj *obj = util::parse_pdf_obj(lex, &arena);
+      if (auto top = obj->as<util::PdfTopLevel>()) {
+        pos = lex.position();
+        last_offset = start;
+        return top;
+      }
+    } catch (const std::runtime_error &) {
+      ++error_count;
+    }
+    // Look again after the obj keyword that led us here, the next object
+    // may well start inside the damaged one
+    size_t keyword = data.find("obj", start);
+    pos = keyword == std::string_view::npos ? data.size() : keyword + 3;
+    arena.release();
+  }
+  pos = data.size();
+  return nullptr;
+}
+
+bool ObjectScanner::find_object(size_t from, size_t &start) const {
+  while (from < data.size()) {
+    size_t found = util::find_bytes(data.substr(from), "obj");
+    if (found == std::string_view::npos)
+      return false;
+    size_t keyword = from + found;
+    from = keyword + 3;
+
+    // obj has to be a whole keyword with whitespace before it, which also
+    // rules out the end of endobj
+    if (keyword + 3 < data.size() && util::is_pdf_regular(data[keyword + 3]))
+      continue;
+    if (keyword == 0 || !util::is_pdf_whitespace(data[keyword - 1]))
+      continue;
+
+    // Walk back over the generation and object numbers
+    size_t i = keyword;
+    while (i > 0 && util::is_pdf_whitespace(data[i - 1]))
+      --i;
+    size_t gen_end = i;
+    while (i > 0 && is_digit(data[i - 1]))
+      --i;
+    if (i == gen_end || i == 0 || !util::is_pdf_whitespace(data[i - 1]))
+      continue;
+    while (i > 0 && util::is_pdf_whitespace(data[i - 1]))
+      --i;
+    size_t num_end = i;
+    while (i > 0 && is_digit(data[i - 1]))
+      --i;
+    if (i == num_end || (i > 0 && util::is_pdf_regular(data[i - 1])))
+      continue;
+
+    // Skip anything that is commented out. This does not know about strings
+    // so a % in a string on the same line hides the object, but then it is
+    // just found by the resync after the object before it instead.
+    size_t line = i;
+    while (line > 0 && data[line - 1] != '\n' && data[line - 1] != '\r' &&
+           data[line - 1] != '%')
+      --line;
+    if (line > 0 && data[line - 1] == '%')
+      continue;
+
+    start = i;
+    return true;
+  }
+  return false;
+}
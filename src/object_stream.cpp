@@ -0,0 +1,73 @@
+#include "object_stream.h"
+#include "filters.h"
+#include "lexer.h"
+#include <stdexcept>
+
+namespace {
+
+[[noreturn]] void objstm_error(const std::string &msg) {
+  throw std::runtime_error("Parse Error: Object stream " + msg);
+}
+
+int64_t int_value(const util::PdfDict &dict, PdfAtom key) {
+  const util::PdfObj *obj = dict.pairs.get(key);
+  const util::PdfInt *i = obj != nullptr ? obj->as<util::PdfInt>() : nullptr;
+  if (i == nullptr)
+    objstm_error("is missing " + std::string(NameTable::global().text(key)));
+  return i->data;
+}
+
+} // namespace
+
+ObjectStream::ObjectStream(const util::PdfStream &stream) {
+  const util::PdfObj *type = stream.dict->pairs.get(atom::Type);
+  const util::PdfName *name = type ? type->as<util::PdfName>() : nullptr;
+  if (name == nullptr || name->atom != atom::ObjStm)
+    objstm_error("does not have /Type /ObjStm");
+
+  int64_t count = int_value(*stream.dict, atom::N);
+  int64_t first = int_value(*stream.dict, atom::First);
+  decoded = util::decode_stream(stream);
+  if (count < 0 || first < 0 || static_cast<size_t>(first) > decoded.size())
+    objstm_error("has an invalid /N or /First");
+  // Every pair in the header takes at least a digit, a space, a digit and
+  // another space, so a bigger /N is a lie and must not size anything
+  if (static_cast<uint64_t>(count) > (static_cast<uint64_t>(first) + 1) / 4)
+    objstm_error("has a /N of " + std::to_string(count) +
+                 " that does not fit before /First");
+
+  PdfLexer lex(decoded.data(), first, false);
+  numbers.reserve(count);
+  offsets.reserve(count);
+  for (int64_t i = 0; i < count; ++i) {
+    PdfToken num = lex.next();
+    PdfToken off = lex.next();
+    if (num.type != PdfTokenType::Int || off.type != PdfTokenType::Int ||
+        off.integer < 0 ||
+        static_cast<uint64_t>(off.integer) >= decoded.size() - first)
+      objstm_error("has a bad header entry at " + std::to_string(i));
+    numbers.push_back(num.integer);
+    offsets.push_back(first + off.integer);
+  }
+}
+
+int64_t ObjectStream::find(int64_t num) const {
+  for (size_t i = 0; i < numbers.size(); ++i) {
+    if (numbers[i] == num)
+      return i;
+  }
+  return -1;
+}
+
+util::PdfTopLevel *ObjectStream::parse(size_t index, Arena &arena) const {
+  PdfLexer lex(decoded.data(), decoded.size(), false);
+  lex.seek(offsets.at(index));
+  util::PdfObj *obj = util::parse_pdf_obj(lex, &arena);
+  return new (arena) util::PdfTopLevel(numbers[index], 0, obj);
+}
+
+PdfValue ObjectStream::parse(size_t index, PdfGraph &graph) const {
+  PdfLexer lex(decoded.data(), decoded.size(), false);
+  lex.seek(offsets.at(index));
+  return graph.parse(lex);
+}
@@ -0,0 +1,22 @@
+#include "object_table.h"
+#include <algorithm>
+
+void ObjectTable::keep(std::unique_ptr<PdfGraph> graph) {
+  graphs.push_back(std::move(graph));
+}
+
+void ObjectTable::add(const Object &obj) {
+  if (obj.num < 0 || obj.graph == nullptr)
+    return;
+  size_t num = static_cast<size_t>(obj.num);
+  if (num >= objects.size())
+    objects.resize(num + 1);
+  if (objects[num].graph == nullptr)
+    ++count;
+  objects[num] = obj;
+}
+
+void ObjectTable::sort_damaged() {
+  std::sort(failed.begin(), failed.end());
+  failed.erase(std::unique(failed.begin(), failed.end()), failed.end());
+}
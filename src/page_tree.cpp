@@ -0,0 +1,271 @@
+#include "page_tree.h"
+#include "pdf_parser.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+// Real trees are only a few levels deep, anything this deep is a loop
+const int MAX_PAGE_TREE_DEPTH = 64;
+
+namespace {
+
+const util::PdfDict *as_dict(const util::PdfObj *obj) {
+  return obj != nullptr ? obj->as<util::PdfDict>() : nullptr;
+}
+
+const util::PdfDict *node_dict(const ObjectCache::ObjPtr &node) {
+  return node != nullptr ? as_dict(node->obj) : nullptr;
+}
+
+// A leaf is a /Page, or anything without kids so a broken node still counts
+// as a page rather than losing the pages after it
+bool is_leaf(const util::PdfDict &dict) {
+  const util::PdfObj *type = dict.pairs.get(atom::Type);
+  if (type != nullptr && *type == util::PdfName(atom::Page))
+    return true;
+  return dict.pairs.get(atom::Kids) == nullptr;
+}
+
+[[noreturn]] void loop_error(int64_t num) {
+  throw std::runtime_error("Parse Error: Page tree has a loop at object " +
+                           std::to_string(num));
+}
+
+// Every node has one parent, so a node that is reached again is either a
+// loop or a subtree shared between parents. Walking shared subtrees again
+// each time they come up doubles the work per level, so both are errors.
+void visit(std::unordered_set<int64_t> &seen, int64_t num) {
+  if (!seen.insert(num).second)
+    throw std::runtime_error("Parse Error: Page tree reaches object " +
+                             std::to_string(num) + " more than once");
+}
+
+} // namespace
+
+const util::PdfDict &PageTree::Page::dict() const {
+  return *obj->obj->as<util::PdfDict>();
+}
+
+struct PageTree::Inherited {
+  ObjHandle resources;
+  ObjHandle media_box;
+  ObjHandle crop_box;
+  ObjHandle rotate;
+
+  // Take any of the attributes the node sets, they win over the ones from
+  // further up. A direct value lives in the node's arena, so the handle
+  // shares ownership of the node to keep it alive.
+  void take(PdfParser &parser, const ObjectCache::ObjPtr &node) {
+    const util::PdfDict *dict = node_dict(node);
+    auto update = [&](ObjHandle &slot, PdfAtom key) {
+      const util::PdfObj *value = dict->pairs.get(key);
+      if (value == nullptr)
+        return;
+      if (value->as<util::PdfRef>() != nullptr)
+        slot = parser.resolve(value);
+      else
+        slot = ObjHandle(node, value);
+    };
+    update(resources, atom::Resources);
+    update(media_box, atom::MediaBox);
+    update(crop_box, atom::CropBox);
+    update(rotate, atom::Rotate);
+  }
+};
+
+PageTree::PageTree(PdfParser &p) : parser(p) {
+  if (!parser.page_index().empty()) {
+    total = parser.page_index().size();
+    return;
+  }
+  auto catalog_obj =
+      parser.resolve(parser.xref().trailer().pairs.get(atom::Root));
+  const util::PdfDict *catalog = as_dict(catalog_obj.get());
+  if (catalog == nullptr)
+    throw std::runtime_error("Parse Error: Document has no catalog");
+  const util::PdfObj *pages = catalog->pairs.get(atom::Pages);
+  const util::PdfRef *ref =
+      pages != nullptr ? pages->as<util::PdfRef>() : nullptr;
+  if (ref != nullptr)
+    root = parser.get_object(ref->num, ref->gen);
+  if (node_dict(root) == nullptr)
+    throw std::runtime_error("Parse Error: Catalog has no page tree");
+  std::unordered_set<int64_t> seen;
+  total = node_count(root, 0, seen);
+}
+
+size_t PageTree::node_count(const ObjectCache::ObjPtr &node, int depth,
+                            std::unordered_set<int64_t> &seen) const {
+  const util::PdfDict *dict = node_dict(node);
+  if (dict == nullptr)
+    return 0;
+  if (is_leaf(*dict))
+    return 1;
+  if (depth > MAX_PAGE_TREE_DEPTH)
+    loop_error(node->num);
+  visit(seen, node->num);
+
+  auto count = parser.resolve(dict->pairs.get(atom::Count));
+  const util::PdfInt *value =
+      count != nullptr ? count->as<util::PdfInt>() : nullptr;
+  if (value != nullptr && value->data >= 0)
+    return static_cast<size_t>(value->data);
+
+  // No usable count, so add up the kids
+  auto kids_obj = parser.resolve(dict->pairs.get(atom::Kids));
+  const util::PdfArray *kids =
+      kids_obj != nullptr ? kids_obj->as<util::PdfArray>() : nullptr;
+  size_t total = 0;
+  if (kids != nullptr) {
+    for (const util::PdfObj *kid : kids->objects) {
+      if (const util::PdfRef *ref = kid->as<util::PdfRef>())
+        total += node_count(parser.get_object(ref->num, ref->gen), depth + 1,
+                            seen);
+    }
+  }
+  return total;
+}
+
+const PageTree::Kids &PageTree::kids_of(const ObjectCache::ObjPtr &node,
+                                        int depth) const {
+  auto cached = kids_cache.find(node->num);
+  if (cached != kids_cache.end())
+    return cached->second;
+
+  Kids result;
+  auto kids_obj = parser.resolve(node_dict(node)->pairs.get(atom::Kids));
+  const util::PdfArray *kids =
+      kids_obj != nullptr ? kids_obj->as<util::PdfArray>() : nullptr;
+  if (kids != nullptr) {
+    for (const util::PdfObj *kid : kids->objects) {
+      if (const util::PdfRef *ref = kid->as<util::PdfRef>())
+        result.refs.emplace_back(ref->num, ref->gen);
+    }
+    // Only the kids themselves are loaded, a subtree that is skipped by its
+    // count is never read below its top node. A ranged parser fetches them
+    // all together first.
+    std::vector<int64_t> kid_nums;
+    for (const auto &ref : result.refs)
+      kid_nums.push_back(ref.first);
+    parser.prefetch(kid_nums);
+    // The node itself counts as seen so a kid that points back up is caught
+    std::unordered_set<int64_t> seen{node->num};
+    size_t end = 0;
+    for (const auto &[num, gen] : result.refs) {
+      end += node_count(parser.get_object(num, gen), depth + 1, seen);
+      result.ends.push_back(end);
+    }
+  }
+  return kids_cache.emplace(node->num, std::move(result)).first->second;
+}
+
+PageTree::Page PageTree::page(size_t index) const {
+  if (index >= total)
+    throw std::out_of_range("Page " + std::to_string(index + 1) +
+                            " is past the last page");
+  if (!parser.page_index().empty())
+    return indexed_page(index);
+  auto counts_error = [index] {
+    return std::runtime_error("Parse Error: Page tree counts are wrong, page " +
+                              std::to_string(index + 1) + " is not there");
+  };
+
+  Inherited inherited;
+  ObjectCache::ObjPtr node = root;
+  size_t remaining = index;
+  for (int depth = 0; depth <= MAX_PAGE_TREE_DEPTH; ++depth) {
+    inherited.take(parser, node);
+    const util::PdfDict *dict = node_dict(node);
+    if (is_leaf(*dict)) {
+      if (remaining != 0)
+        throw counts_error();
+      return Page{node, inherited.resources, inherited.media_box,
+                  inherited.crop_box, inherited.rotate};
+    }
+
+    const Kids &kids = kids_of(node, depth);
+    auto found =
+        std::upper_bound(kids.ends.begin(), kids.ends.end(), remaining);
+    if (found == kids.ends.end())
+      throw counts_error();
+    size_t kid = found - kids.ends.begin();
+    if (kid > 0)
+      remaining -= kids.ends[kid - 1];
+    ObjectCache::ObjPtr next =
+        parser.get_object(kids.refs[kid].first, kids.refs[kid].second);
+    if (next == nullptr)
+      throw counts_error();
+    node = next;
+  }
+  loop_error(node->num);
+}
+
+PageTree::Page PageTree::indexed_page(size_t index) const {
+  int64_t num = parser.page_index()[index];
+  const XrefEntry *entry = parser.xref().find(num);
+  int64_t gen = entry != nullptr && entry->type == XrefType::InUse ? entry->gen
+                                                                   : 0;
+  ObjectCache::ObjPtr page = parser.get_object(num, gen);
+  if (node_dict(page) == nullptr)
+    throw std::runtime_error("Parse Error: Page index is wrong, page " +
+                             std::to_string(index + 1) + " is not a dict");
+
+  // The nodes from the page up to the root. Inherited values have to be taken
+  // from the top down so the nearest node wins, same as the descent.
+  std::vector<ObjectCache::ObjPtr> chain{page};
+  for (int depth = 0;; ++depth) {
+    if (depth > MAX_PAGE_TREE_DEPTH)
+      loop_error(num);
+    const util::PdfRef *parent = nullptr;
+    if (const util::PdfObj *obj = node_dict(chain.back())->pairs.get(
+            atom::Parent))
+      parent = obj->as<util::PdfRef>();
+    if (parent == nullptr)
+      break;
+    ObjectCache::ObjPtr node = parser.get_object(parent->num, parent->gen);
+    if (node_dict(node) == nullptr)
+      break;
+    chain.push_back(node);
+  }
+
+  Inherited inherited;
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+    inherited.take(parser, *it);
+  return Page{page, inherited.resources, inherited.media_box,
+              inherited.crop_box, inherited.rotate};
+}
+
+std::vector<int64_t> PageTree::page_numbers() const {
+  if (!parser.page_index().empty())
+    return parser.page_index();
+  std::vector<int64_t> nums;
+  nums.reserve(total);
+  std::unordered_set<int64_t> seen;
+  collect(root, 0, seen, nums);
+  return nums;
+}
+
+void PageTree::collect(const ObjectCache::ObjPtr &node, int depth,
+                       std::unordered_set<int64_t> &seen,
+                       std::vector<int64_t> &nums) const {
+  const util::PdfDict *dict = node_dict(node);
+  if (dict == nullptr)
+    return;
+  if (is_leaf(*dict)) {
+    nums.push_back(node->num);
+    return;
+  }
+  if (depth > MAX_PAGE_TREE_DEPTH)
+    loop_error(node->num);
+  visit(seen, node->num);
+  auto kids_obj = parser.resolve(dict->pairs.get(atom::Kids));
+  const util::PdfArray *kids =
+      kids_obj != nullptr ? kids_obj->as<util::PdfArray>() : nullptr;
+  if (kids == nullptr)
+    return;
+  for (const util::PdfObj *kid : kids->objects) {
+    if (const util::PdfRef *ref = kid->as<util::PdfRef>())
+      collect(parser.get_object(ref->num, ref->gen), depth + 1, seen, nums);
+  }
+}
@@ -0,0 +1,178 @@
+#include "pdf_events.h"
+#include "lexer.h"
+#include "names.h"
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+[[noreturn]] void parse_error(const std::string &msg, std::string_view got) {
+  throw std::runtime_error("Parse Error: " + msg + std::string(got));
+}
+
+std::string_view describe(const PdfToken &token) {
+  return token.type == PdfTokenType::End ? "EOF" : token.text;
+}
+
+// The text of a name token with its #xx escapes decoded. Most names have
+// none and are handed on as they are, the decoded ones are interned so the
+// view stays valid as long as the raw one would have.
+std::string_view name_text(std::string_view raw) {
+  if (raw.find('#') == std::string_view::npos)
+    return raw;
+  std::string_view text;
+  NameTable::global().intern(util::decode_name(raw), &text);
+  return text;
+}
+
+} // namespace
+
+// Counts one level of nesting for as long as it is open, including when a
+// parse error unwinds through it
+struct PdfEventParser::Nested {
+  size_t &depth;
+
+  explicit Nested(size_t &d) : depth(d) {
+    if (depth >= MAX_NESTING_DEPTH)
+      parse_error("Objects are nested too deep, more than ",
+                  std::to_string(MAX_NESTING_DEPTH));
+    ++depth;
+  }
+  ~Nested() { --depth; }
+};
+
+PdfEventParser::PdfEventParser(PdfLexer &l) : lex(l) {}
+
+void PdfEventParser::parse_object(PdfEventHandler &handler) {
+  parse_token(lex.next(), handler);
+}
+
+void PdfEventParser::parse_token(const PdfToken &token,
+                                 PdfEventHandler &handler) {
+  switch (token.type) {
+  case PdfTokenType::Int:
+    parse_int(token, handler);
+    return;
+  case PdfTokenType::Real:
+    handler.real_value(token.real);
+    return;
+  case PdfTokenType::Name:
+    handler.name_value(name_text(token.text));
+    return;
+  case PdfTokenType::String:
+  case PdfTokenType::HexString:
+    handler.string_value(token.text, token.type == PdfTokenType::HexString);
+    return;
+  case PdfTokenType::Keyword:
+    if (token.text == "null")
+      return handler.null_value();
+    if (token.text == "true")
+      return handler.bool_value(true);
+    if (token.text == "false")
+      return handler.bool_value(false);
+    parse_error("Unexpected keyword to start a PDF object: ", token.text);
+  case PdfTokenType::Delimiter:
+    if (token.text == "[")
+      return parse_array_body(handler);
+    if (token.text == "<<")
+      return parse_dict_body(handler);
+    parse_error("Unexpected delimiter to start a PDF object: ", token.text);
+  case PdfTokenType::End:
+    break;
+  }
+  parse_error("Unexpected end of input, expected a PDF object", "");
+}
+
+void PdfEventParser::parse_array_body(PdfEventHandler &handler) {
+  Nested nested(depth);
+  handler.begin_array();
+  while (true) {
+    PdfToken token = lex.next();
+    if (token.is_delimiter("]"))
+      break;
+    if (token.type == PdfTokenType::End)
+      parse_error("Arrays must end with ], Got ", "EOF");
+    parse_token(token, handler);
+  }
+  handler.end_array();
+}
+
+void PdfEventParser::parse_dict_body(PdfEventHandler &handler,
+                                     bool allow_stream) {
+  Nested nested(depth);
+  handler.begin_dict();
+  int64_t length = -1;
+  while (true) {
+    PdfToken token = lex.next();
+    if (token.is_delimiter(">>"))
+      break;
+    if (token.type != PdfTokenType::Name)
+      parse_error("Dict keys must be names, Got ", describe(token));
+
+    std::string_view key = name_text(token.text);
+    handler.key(key);
+    PdfToken value = lex.next();
+    parse_token(value, handler);
+
+    // Remember the length in case this dict belongs to a stream
+    if (key == "/Length" && value.type == PdfTokenType::Int) {
+      if (!last_was_ref)
+        length = last_int;
+      else
+        length = lex.resolve_length(last_int, last_ref_gen);
+    }
+  }
+
+  if (allow_stream && lex.peek().is_keyword("stream"))
+    parse_stream(length, handler);
+  else
+    handler.end_dict();
+}
+
+void PdfEventParser::parse_stream(int64_t length, PdfEventHandler &handler) {
+  std::string_view payload = lex.stream_payload(length);
+  handler.begin_stream();
+  // The payload is already a view into the buffer, chunking it just keeps
+  // each event small for handlers that copy what they are given
+  while (!payload.empty()) {
+    size_t n = payload.size() < STREAM_CHUNK_SIZE ? payload.size()
+                                                   : STREAM_CHUNK_SIZE;
+    handler.stream_data(payload.substr(0, n));
+    payload.remove_prefix(n);
+  }
+  handler.end_stream();
+}
+
+// An int can be the start of a ref N G R or a top level object N G obj. If the
+// next two tokens do not complete one, the lexer is put back after the int.
+void PdfEventParser::parse_int(const PdfToken &num, PdfEventHandler &handler) {
+  size_t after_num = lex.position();
+  PdfToken gen = lex.next();
+  if (num.integer >= 0 && gen.type == PdfTokenType::Int && gen.integer >= 0) {
+    PdfToken keyword = lex.next();
+    if (keyword.is_keyword("R")) {
+      last_int = num.integer;
+      last_was_ref = true;
+      last_ref_gen = gen.integer;
+      handler.ref_value(num.integer, gen.integer);
+      return;
+    }
+
+    if (keyword.is_keyword("obj")) {
+      Nested nested(depth);
+      handler.begin_object(num.integer, gen.integer);
+      parse_object(handler);
+      PdfToken end = lex.next();
+      if (!end.is_keyword("endobj"))
+        parse_error("Top level PDF objects must be closed by endobj, Got ",
+                    describe(end));
+      handler.end_object();
+      return;
+    }
+  }
+
+  lex.seek(after_num);
+  last_int = num.integer;
+  last_was_ref = false;
+  handler.int_value(num.integer);
+}
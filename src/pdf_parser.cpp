@@ -1,66 +1,810 @@
 #include "pdf_parser.h"
+#include "inflate_backend.h"
+#include "lexer.h"
+#include "object_scanner.h"
+#include "pdf_events.h"
+#include "stats.h"
+#include <algorithm>
+#include <deque>
+#include <future>
 #include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
 #include <string>
-#include <zlib.h>
+#include <utility>
 
-PdfParser::PdfParser(const std::string &d) : data(d) {}
+// The parser's own arena, for objects parsed with parse_at
+const size_t PARSER_ARENA_SIZE = 64 * 1024;
+
+PdfParser::PdfParser(std::string_view d)
+    : PdfParser(d, std::pmr::new_delete_resource()) {}
+
+PdfParser::PdfParser(const InputSource &source) : PdfParser(source.bytes()) {}
+
+PdfParser::PdfParser(std::string_view d, std::pmr::memory_resource *m,
+                     size_t cache_budget)
+    : data(d), memory(m), arena(PARSER_ARENA_SIZE, m), objects(cache_budget) {}
+
+PdfParser::PdfParser(RangedSource &source, std::pmr::memory_resource *m,
+                     size_t cache_budget)
+    : PdfParser(source.bytes(), m, cache_budget) {
+  ranged = &source;
+}
 
 // This appears to work on my test pdf that was built using lualatex
-// I have written a utility function to do the decoding that I will make more
-// robust and use to rewrite this function. I might even move this to the
-// utility section as it is not really a parsing function. When parsing the
-// more generic inflate function can be used to decompress a stream as needed
-// from an input stream without needing to read the whole file into memory.
+// It used to decompress into one 64KB buffer with a single call to inflate,
+// which cut off any stream that was bigger than that. Now it is just the
+// streaming version writing into a string.
 std::string PdfParser::naive_inflate() {
-  size_t start = 0;
-  size_t end = 0;
-  std::string new_data = "";
-
-  // Initialize a big buffer for holding output, really I should use a small
-  // buffer and loop while decompressing and push the decompressed bytes into
-  // the string in chunks.
-  uint out_buf_size = 65536;
-  auto out_buffer = (Bytef *)malloc(sizeof(Bytef *) * out_buf_size);
-
-  while (start != std::string::npos && end != std::string::npos) {
-    // find stream and copy the data between streams into the new string
-    start = data.find("stream", end + 10);
-    if (start == std::string::npos)
-      break;
-
-    new_data += data.substr(end, (start + 7) - end);
-
-    // Find the end of the stream and cut out the data
-    end = data.find("endstream", start);
-    if (end == std::string::npos)
-      break;
-    std::string stream = data.substr(start + 7, end - (start + 7));
-
-    // Initialize the decompression stream
-    z_stream strm;
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
-    strm.avail_in = stream.size();
-    strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(stream.data()));
-    strm.avail_out = (uInt)out_buf_size;
-    strm.next_out = out_buffer;
-
-    // Decompress
-    inflateInit(&strm);
-    inflate(&strm, Z_NO_FLUSH);
-    inflateEnd(&strm);
-
-    // Move the decompressed data into the new data
-    // This is not the most efficient way to do this
-    size_t out_size = out_buf_size - strm.avail_out;
-    for (size_t i = 0; i < out_size; ++i) {
-      new_data += out_buffer[i];
+  std::ostringstream os;
+  inflate_to(os);
+  return os.str();
+}
+
+// How many streams each thread can have decoded and waiting to be written
+const size_t PARALLEL_STREAMS_PER_THREAD = 4;
+
+namespace {
+
+// Remembers where the payload of the stream in an object is. The lexer's
+// buffer is stable, so the chunks are views next to each other in it.
+class StreamFinder : public PdfEventHandler {
+public:
+  void stream_data(std::string_view chunk) override {
+    if (payload.data() == nullptr)
+      payload = chunk;
+    else
+      payload = std::string_view(payload.data(), payload.size() + chunk.size());
+  }
+
+  std::string_view payload;
+};
+
+// Inflates whole streams with a context leased from the inflate pool, whose
+// out buffer sets the size of the chunks written
+class Inflater {
+public:
+  Inflater() : context(InflatePool::global().acquire()) {}
+
+  // Inflate one stream, handing each chunk of output to sink(data, size).
+  // Returns false without any output if the data is not deflate data at all.
+  template <typename Sink> bool inflate_to(std::string_view in, Sink &&sink) {
+    PDF_STATS_SCOPE(FilterDecode);
+    InflateState &state = context->state;
+    std::vector<char> &out = context->out;
+    state.reset();
+    bool wrote = false;
+
+    while (true) {
+      size_t before = in.size();
+      size_t produced = 0;
+      InflateState::Status status =
+          state.inflate(in, out.data(), out.size(), produced);
+      if (produced > 0) {
+        sink(out.data(), produced);
+        wrote = true;
+      }
+      if (status == InflateState::StreamEnd)
+        return true;
+      // Truncated or corrupt part way through, keep what came out of it
+      if (status == InflateState::Error ||
+          (produced == 0 && in.size() == before))
+        return wrote;
+    }
+  }
+
+private:
+  InflatePool::Lease context;
+};
+
+// The output for one stream in the parallel version
+struct InflatedStream {
+  bool inflated = false;
+  std::string bytes;
+};
+
+// Write a stream's payload the same way for both versions
+void write_stream(std::ostream &os, std::string_view payload,
+                  const InflatedStream &result) {
+  PDF_STATS_SCOPE(OutputWrite);
+  if (result.inflated) {
+    os.write(result.bytes.data(), result.bytes.size());
+    os.put('\n'); // so endstream still starts on its own line
+  } else {
+    os.write(payload.data(), payload.size());
+  }
+}
+
+} // namespace
+
+std::vector<PdfParser::StreamSpan> PdfParser::stream_spans() {
+  std::vector<StreamSpan> spans;
+  // The payload runs up to the end of line before endstream, which is
+  // written from the document as it is after an inflated payload too
+  auto add = [&](std::string_view payload) {
+    if (payload.empty())
+      return;
+    size_t start = payload.data() - data.data();
+    size_t end = start + payload.size();
+    while (end < data.size() && (data[end] == '\r' || data[end] == '\n'))
+      ++end;
+    spans.push_back({start, end});
+  };
+
+  std::vector<uint64_t> offsets;
+  try {
+    // Every section, so the streams of older revisions are found as well
+    const XrefTable &table = xref();
+    auto add_offsets = [&](const XrefTable &section) {
+      for (const XrefEntry &entry : section.all()) {
+        if (entry.type == XrefType::InUse && entry.offset < data.size())
+          offsets.push_back(entry.offset);
+      }
+    };
+    add_offsets(table);
+    if (table.sections().size() > 1) {
+      for (size_t section : table.sections())
+        add_offsets(XrefTable::load_section(data, section));
+    }
+    // An xref stream is not always listed in its own section
+    for (size_t section : table.sections())
+      offsets.push_back(section);
+  } catch (const std::runtime_error &) {
+    // Without a usable xref the objects are found by scanning for them
+    ObjectScanner scanner(data);
+    for (const util::PdfTopLevel &top : scanner) {
+      if (const util::PdfStream *stream = top.obj->as<util::PdfStream>())
+        add(stream->bytes());
+    }
+    return spans;
+  }
+  std::sort(offsets.begin(), offsets.end());
+  offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+  PdfLexer lex(data);
+  lex.set_length_resolver([this](int64_t num, int64_t gen) {
+    return indirect_length(num, gen);
+  });
+  for (uint64_t offset : offsets) {
+    lex.seek(offset);
+    StreamFinder finder;
+    try {
+      PdfEventParser(lex).parse_object(finder);
+    } catch (const std::runtime_error &) {
+      // A damaged object is written as it is
+      continue;
     }
+    // Objects the xref claims overlap are only inflated once
+    size_t before = spans.size();
+    add(finder.payload);
+    if (spans.size() > before && before > 0 &&
+        spans.back().start < spans[before - 1].end)
+      spans.pop_back();
+  }
+  return spans;
+}
+
+void PdfParser::inflate_to(std::ostream &os) {
+  fetch_all();
+  Inflater inflater;
+  size_t written = 0;
+
+  // Writes happen in the middle of inflating here, so the output is timed a
+  // chunk at a time
+  auto write = [&os](const char *bytes, size_t n) {
+    PDF_STATS_SCOPE(OutputWrite);
+    os.write(bytes, n);
+  };
+  for (const StreamSpan &span : stream_spans()) {
+    write(data.data() + written, span.start - written);
+    std::string_view payload = data.substr(span.start, span.end - span.start);
+    if (inflater.inflate_to(payload, write))
+      write("\n", 1); // so endstream still starts on its own line
+    else
+      write(payload.data(), payload.size());
+    written = span.end;
   }
 
-  new_data += data.substr(end, data.length() - end);
+  write(data.data() + written, data.size() - written);
+}
+
+void PdfParser::parallel_inflate_to(std::ostream &os, size_t threads) {
+  ThreadPool pool(threads);
+  parallel_inflate_to(os, pool);
+}
+
+void PdfParser::parallel_inflate_to(std::ostream &os, ThreadPool &pool) {
+  // Only a few streams per thread are in flight at once so the decoded bytes
+  // waiting to be written stay bounded
+  fetch_all();
+  const size_t window = pool.size() * PARALLEL_STREAMS_PER_THREAD;
+  std::deque<std::pair<StreamSpan, std::future<InflatedStream>>> in_flight;
+  size_t written = 0;
+
+  auto write_oldest = [&]() {
+    auto &[span, future] = in_flight.front();
+    InflatedStream result = future.get();
+    {
+      PDF_STATS_SCOPE(OutputWrite);
+      os.write(data.data() + written, span.start - written);
+    }
+    write_stream(os, data.substr(span.start, span.end - span.start), result);
+    written = span.end;
+    in_flight.pop_front();
+  };
+
+  for (const StreamSpan &span : stream_spans()) {
+    std::string_view payload = data.substr(span.start, span.end - span.start);
+    in_flight.emplace_back(span, pool.submit([payload]() {
+      Inflater inflater;
+      InflatedStream result;
+      // Deflate usually shrinks text to about a quarter
+      result.bytes.reserve(payload.size() * 4);
+      result.inflated = inflater.inflate_to(
+          payload, [&result](const char *bytes, size_t n) {
+            result.bytes.append(bytes, n);
+          });
+      return result;
+    }));
+    if (in_flight.size() >= window)
+      write_oldest();
+  }
+  while (!in_flight.empty())
+    write_oldest();
+
+  PDF_STATS_SCOPE(OutputWrite);
+  os.write(data.data() + written, data.size() - written);
+}
+
+util::PdfObj *PdfParser::parse_at(size_t offset) {
+  if (offset >= data.size())
+    throw std::out_of_range("Parse Error: Offset is past the end of the data");
+  // There may be no xref to say where the object ends
+  fetch_all();
+  PdfLexer lex(data);
+  lex.seek(offset);
+  return util::parse_pdf_obj(lex, &arena);
+}
+
+// The end of the file that is fetched to find startxref, the same amount
+// find_startxref looks through, and how much is fetched at each xref section.
+// A section that does not fit in the window fails to parse and the whole file
+// is read instead.
+const size_t RANGED_TAIL_SIZE = 4096;
+const size_t RANGED_XREF_WINDOW = 1024 * 1024;
+
+// A closure that reaches this many objects is most of the document, and the
+// rest of it is left to be fetched as it is needed
+const size_t MAX_CLOSURE_OBJECTS = 4096;
+
+namespace {
+
+XrefTable load_ranged_xref(RangedSource &source) {
+  std::string_view data = source.bytes();
+  source.fetch(data.size() > RANGED_TAIL_SIZE ? data.size() - RANGED_TAIL_SIZE
+                                              : 0,
+               RANGED_TAIL_SIZE);
+  try {
+    return XrefTable::load(data, [&source](size_t offset) {
+      source.fetch(offset, RANGED_XREF_WINDOW);
+    });
+  } catch (const std::runtime_error &) {
+    // Unfetched bytes are zeros, which lex as whitespace, so a section that
+    // ran out of its window or a hybrid file's stream somewhere else fails
+    // here rather than being read wrong
+    if (source.complete())
+      throw;
+    source.fetch_all();
+    return XrefTable::load(data);
+  }
+}
+
+bool is_page_node(const util::PdfObj *obj) {
+  const util::PdfDict *dict =
+      obj != nullptr ? obj->as<util::PdfDict>() : nullptr;
+  if (dict == nullptr)
+    return false;
+  const util::PdfObj *type = dict->pairs.get(atom::Type);
+  return type != nullptr && (*type == util::PdfName(atom::Page) ||
+                             *type == util::PdfName(atom::Pages));
+}
+
+// Every object number referred to anywhere inside obj, except by /Parent
+void collect_refs(const util::PdfObj *obj, std::vector<int64_t> &nums) {
+  if (obj == nullptr)
+    return;
+  switch (obj->type) {
+  case util::PdfType::Ref:
+    nums.push_back(obj->as<util::PdfRef>()->num);
+    break;
+  case util::PdfType::Array:
+    for (const util::PdfObj *item : obj->as<util::PdfArray>()->objects)
+      collect_refs(item, nums);
+    break;
+  case util::PdfType::Dict:
+    for (const auto &[key, value] : obj->as<util::PdfDict>()->pairs) {
+      if (key.atom != atom::Parent)
+        collect_refs(value, nums);
+    }
+    break;
+  case util::PdfType::Stream:
+    collect_refs(obj->as<util::PdfStream>()->dict, nums);
+    break;
+  case util::PdfType::TopLevel:
+    collect_refs(obj->as<util::PdfTopLevel>()->obj, nums);
+    break;
+  default:
+    break;
+  }
+}
+
+} // namespace
+
+uint64_t PdfParser::object_end(uint64_t offset) {
+  if (boundaries.empty()) {
+    for (const XrefEntry &entry : xref().all()) {
+      if (entry.type == XrefType::InUse)
+        boundaries.push_back(entry.offset);
+    }
+    for (size_t section : xref().sections())
+      boundaries.push_back(section);
+    boundaries.push_back(data.size());
+    std::sort(boundaries.begin(), boundaries.end());
+    boundaries.erase(std::unique(boundaries.begin(), boundaries.end()),
+                     boundaries.end());
+  }
+  auto next = std::upper_bound(boundaries.begin(), boundaries.end(), offset);
+  return next != boundaries.end() ? *next : data.size();
+}
+
+void PdfParser::fetch_object(uint64_t offset) {
+  if (ranged != nullptr)
+    ranged->fetch(offset, object_end(offset) - offset);
+}
+
+void PdfParser::fetch_all() {
+  if (ranged != nullptr)
+    ranged->fetch_all();
+}
+
+std::string_view PdfParser::fetch_bytes(uint64_t offset, uint64_t length) {
+  if (ranged != nullptr)
+    ranged->fetch(offset, length);
+  if (offset >= data.size())
+    return std::string_view();
+  return data.substr(offset, length);
+}
+
+void PdfParser::prefetch(const std::vector<int64_t> &nums) {
+  if (ranged == nullptr || ranged->complete())
+    return;
+  std::vector<ByteRange> ranges;
+  for (int64_t num : nums) {
+    const XrefEntry *entry = xref().find(num);
+    if (entry != nullptr && entry->type == XrefType::Compressed) {
+      if (streams.count(entry->offset))
+        continue;
+      entry = xref().find(entry->offset);
+    }
+    if (entry == nullptr || entry->type != XrefType::InUse ||
+        entry->offset >= data.size())
+      continue;
+    ranges.push_back(
+        {entry->offset, object_end(entry->offset) - entry->offset});
+  }
+  ranged->fetch(ranges);
+}
+
+void PdfParser::prefetch_closure(const std::vector<int64_t> &roots) {
+  if (ranged == nullptr || ranged->complete())
+    return;
+  std::unordered_set<int64_t> seen(roots.begin(), roots.end());
+  std::vector<int64_t> level = roots;
+  while (!level.empty() && seen.size() < MAX_CLOSURE_OBJECTS) {
+    prefetch(level);
+    std::vector<int64_t> next;
+    for (int64_t num : level) {
+      const XrefEntry *entry = xref().find(num);
+      if (entry == nullptr)
+        continue;
+      ObjectCache::ObjPtr obj;
+      try {
+        obj = get_object(num, entry->type == XrefType::InUse ? entry->gen : 0);
+      } catch (const std::exception &) {
+        // Whoever needs it will get the error
+        continue;
+      }
+      if (obj == nullptr)
+        continue;
+      bool root = std::find(roots.begin(), roots.end(), num) != roots.end();
+      if (!root && is_page_node(obj->obj))
+        continue;
+      std::vector<int64_t> refs;
+      collect_refs(obj->obj, refs);
+      for (int64_t ref : refs) {
+        if (seen.insert(ref).second)
+          next.push_back(ref);
+      }
+    }
+    level = std::move(next);
+  }
+}
+
+const XrefTable &PdfParser::xref() {
+  if (!xref_table) {
+    PDF_STATS_SCOPE(XrefLoad);
+    xref_table = std::make_unique<XrefTable>(
+        ranged != nullptr ? load_ranged_xref(*ranged) : XrefTable::load(data));
+  }
+  return *xref_table;
+}
+
+void PdfParser::use_index(XrefTable table, std::vector<int64_t> page_nums) {
+  xref_table = std::make_unique<XrefTable>(std::move(table));
+  pages = std::move(page_nums);
+  boundaries.clear();
+  objects.clear();
+  streams.clear();
+  stream_lru.clear();
+  stream_bytes = 0;
+}
+
+// Cached objects are parsed into their own small arena so they can be evicted
+// one at a time
+const size_t OBJECT_ARENA_SIZE = 1024;
+
+// References to references are allowed but should never be this deep
+const int MAX_REF_CHAIN = 32;
+
+ObjectCache::ObjPtr PdfParser::get_object(int64_t num, int64_t gen) {
+  if (auto cached = objects.get(num))
+    return cached->gen == gen ? cached : nullptr;
+
+  const XrefEntry *entry = xref().find(num);
+  if (entry == nullptr || entry->type == XrefType::Free ||
+      entry->type == XrefType::Missing)
+    return nullptr;
+  if (entry->type == XrefType::Compressed)
+    return gen == 0 ? load_compressed(num, *entry) : nullptr;
+  if (entry->gen != gen)
+    return nullptr;
+  if (entry->offset >= data.size())
+    throw std::out_of_range("Parse Error: Offset is past the end of the data");
+
+  // A stream whose /Length leads back to itself would recurse forever
+  if (!loading.insert(num).second)
+    throw std::runtime_error("Parse Error: Object " + std::to_string(num) +
+                             " refers to itself while loading");
+  struct Unmark {
+    std::unordered_set<int64_t> &loading;
+    int64_t num;
+    ~Unmark() { loading.erase(num); }
+  } unmark{loading, num};
+
+  PDF_STATS_SCOPE(ObjectParse);
+  fetch_object(entry->offset);
+  auto obj_arena = std::make_unique<Arena>(OBJECT_ARENA_SIZE, memory);
+  auto parse = [&]() {
+    PdfLexer lex(data);
+    lex.seek(entry->offset);
+    lex.set_length_resolver([this](int64_t len_num, int64_t len_gen) {
+      return indirect_length(len_num, len_gen);
+    });
+    util::PdfObj *parsed = util::parse_pdf_obj(lex, obj_arena.get());
+    const util::PdfTopLevel *top = parsed->as<util::PdfTopLevel>();
+    if (top == nullptr || top->num != num)
+      throw std::runtime_error("Parse Error: Xref offset for object " +
+                               std::to_string(num) +
+                               " does not point at that object");
+    // Bytes that were not fetched are zeros, which lex as whitespace, so an
+    // object that ran into them could have parsed as something it is not
+    if (ranged != nullptr &&
+        !ranged->has(entry->offset, lex.position() - entry->offset))
+      throw std::runtime_error("Parse Error: Object " + std::to_string(num) +
+                               " runs past the bytes fetched for it");
+    return top;
+  };
+
+  const util::PdfTopLevel *obj = nullptr;
+  try {
+    obj = parse();
+  } catch (const std::runtime_error &) {
+    // The object may run past the next offset in the xref, so with a ranged
+    // source read everything before calling it broken
+    if (ranged == nullptr || ranged->complete())
+      throw;
+    ranged->fetch_all();
+    obj_arena->release();
+    obj = parse();
+  }
+
+  auto shared = objects.put(num, std::move(obj_arena), obj);
+  return obj->gen == gen ? shared : nullptr;
+}
+
+// A bad indirect length is not fatal, the payload is found by searching for
+// endstream instead
+int64_t PdfParser::indirect_length(int64_t num, int64_t gen) {
+  if (loading.count(num))
+    return -1;
+  try {
+    ObjectCache::ObjPtr obj = get_object(num, gen);
+    const util::PdfInt *length =
+        obj != nullptr ? obj->obj->as<util::PdfInt>() : nullptr;
+    return length != nullptr ? length->data : -1;
+  } catch (const std::exception &) {
+    return -1;
+  }
+}
+
+// Objects in object streams always have generation 0
+ObjectCache::ObjPtr PdfParser::load_compressed(int64_t num,
+                                               const XrefEntry &entry) {
+  auto stream = object_stream(entry.offset);
+
+  // The index in the xref should be right, but check before trusting it
+  int64_t index = entry.index;
+  if (index >= static_cast<int64_t>(stream->size()) ||
+      stream->number(index) != num)
+    index = stream->find(num);
+  if (index < 0)
+    throw std::runtime_error("Parse Error: Object " + std::to_string(num) +
+                             " is not in object stream " +
+                             std::to_string(entry.offset));
+
+  PDF_STATS_SCOPE(ObjectParse);
+  auto obj_arena = std::make_unique<Arena>(OBJECT_ARENA_SIZE, memory);
+  const util::PdfTopLevel *obj = stream->parse(index, *obj_arena);
+  return objects.put(num, std::move(obj_arena), obj);
+}
+
+std::shared_ptr<const ObjectStream> PdfParser::object_stream(int64_t num) {
+  auto it = streams.find(num);
+  if (it != streams.end()) {
+    stream_lru.splice(stream_lru.begin(), stream_lru, it->second);
+    return it->second->second;
+  }
+
+  // Object streams can not be inside other object streams
+  const XrefEntry *entry = xref().find(num);
+  if (entry == nullptr || entry->type != XrefType::InUse)
+    throw std::runtime_error("Parse Error: Object stream " +
+                             std::to_string(num) + " is not in the xref");
+
+  ObjectCache::ObjPtr top = get_object(num, entry->gen);
+  const util::PdfStream *stream =
+      top != nullptr ? top->obj->as<util::PdfStream>() : nullptr;
+  if (stream == nullptr)
+    throw std::runtime_error("Parse Error: Object " + std::to_string(num) +
+                             " is not an object stream");
+
+  auto decoded = std::make_shared<const ObjectStream>(*stream);
+  // The decoded copy is all that is needed from now on
+  objects.erase(num);
+  stream_lru.emplace_front(num, decoded);
+  streams.emplace(num, stream_lru.begin());
+  stream_bytes += decoded->bytes();
+  // The newest one stays even on its own over the budget, like one object
+  // that is too big for the cache is still handed back
+  while (stream_lru.size() > 1 &&
+         stream_bytes + objects.bytes() > objects.budget()) {
+    stream_bytes -= stream_lru.back().second->bytes();
+    streams.erase(stream_lru.back().first);
+    stream_lru.pop_back();
+  }
+  return decoded;
+}
+
+std::shared_ptr<const util::PdfObj>
+PdfParser::resolve(const util::PdfObj *obj) {
+  // An empty owner, so the caller keeps owning objects that are not refs
+  std::shared_ptr<const util::PdfObj> result(std::shared_ptr<void>(), obj);
+  for (int depth = 0; depth < MAX_REF_CHAIN; ++depth) {
+    const util::PdfRef *ref = result ? result->as<util::PdfRef>() : nullptr;
+    if (ref == nullptr)
+      return result;
+    ObjectCache::ObjPtr top = get_object(ref->num, ref->gen);
+    if (top == nullptr)
+      return nullptr;
+    result = std::shared_ptr<const util::PdfObj>(top, top->obj);
+  }
+  throw std::runtime_error("Parse Error: Reference chain is too long");
+}
+
+// The document is cut into a few chunks per thread so a slow chunk near the
+// end does not leave the other threads idle, but chunks are never so small
+// that the tasks cost more than the parsing
+const size_t PARSE_CHUNKS_PER_THREAD = 4;
+const size_t MIN_PARSE_CHUNK = 64 * 1024;
+
+namespace {
+
+struct ChunkEntry {
+  int64_t num;
+  uint64_t offset;
+};
+
+// What one task parsed. The objects are values in the graph, which takes its
+// node storage and arena blocks from the parser's memory resource.
+struct ParsedChunk {
+  explicit ParsedChunk(std::pmr::memory_resource *memory)
+      : graph(std::make_unique<PdfGraph>(PARSER_ARENA_SIZE, memory)) {}
+
+  std::unique_ptr<PdfGraph> graph;
+  std::vector<ObjectTable::Object> objects;
+  std::vector<int64_t> damaged;
+};
+
+// Workers can not use the parser's cache, so an indirect /Length is read
+// straight from its offset. One that is not a plain int in the same file is
+// left to the endstream search.
+int64_t direct_length(std::string_view data, const XrefTable &xref,
+                      int64_t num, int64_t gen, PdfGraph &scratch) {
+  const XrefEntry *entry = xref.find(num);
+  if (entry == nullptr || entry->type != XrefType::InUse ||
+      entry->gen != gen || entry->offset >= data.size())
+    return -1;
+  PdfLexer lex(data);
+  lex.seek(entry->offset);
+  int64_t length = -1;
+  try {
+    const PdfValue &value = scratch.object(scratch.parse(lex)).value;
+    if (value.type == util::PdfType::Int)
+      length = value.integer;
+  } catch (const std::runtime_error &) {
+  }
+  scratch.clear();
+  return length;
+}
+
+ParsedChunk parse_chunk(std::string_view data, const XrefTable &xref,
+                        const ChunkEntry *begin, const ChunkEntry *end,
+                        std::pmr::memory_resource *memory) {
+  PDF_STATS_SCOPE(ObjectParse);
+  ParsedChunk chunk(memory);
+  PdfGraph scratch(OBJECT_ARENA_SIZE, memory);
+  PdfLexer lex(data);
+  lex.set_length_resolver([&](int64_t num, int64_t gen) {
+    return direct_length(data, xref, num, gen, scratch);
+  });
+
+  for (const ChunkEntry *it = begin; it != end; ++it) {
+    lex.seek(it->offset);
+    try {
+      PdfObjectValue top = chunk.graph->object(chunk.graph->parse(lex));
+      if (top.num == it->num)
+        chunk.objects.push_back({top.num, top.gen, chunk.graph.get(),
+                                 top.value});
+      else
+        chunk.damaged.push_back(it->num);
+    } catch (const std::runtime_error &) {
+      chunk.damaged.push_back(it->num);
+    }
+  }
+  return chunk;
+}
+
+// ObjectStream decodes a PdfStream, so the stream's dict is converted and its
+// payload borrowed from the graph the stream was parsed into
+ParsedChunk parse_object_stream(const ObjectTable::Object *top,
+                                const std::vector<int64_t> &nums,
+                                std::pmr::memory_resource *memory) {
+  PDF_STATS_SCOPE(ObjectParse);
+  ParsedChunk chunk(memory);
+  if (top == nullptr || top->value.type != util::PdfType::Stream) {
+    chunk.damaged = nums;
+    return chunk;
+  }
+  try {
+    PdfStreamValue value = top->graph->stream(top->value);
+    util::PdfStream stream(
+        top->graph->to_obj(value.dict)->as<util::PdfDict>());
+    stream.payload = value.payload;
+    ObjectStream objstm(stream);
+    for (int64_t num : nums) {
+      int64_t index = objstm.find(num);
+      if (index < 0) {
+        chunk.damaged.push_back(num);
+        continue;
+      }
+      try {
+        chunk.objects.push_back(
+            {num, 0, chunk.graph.get(), objstm.parse(index, *chunk.graph)});
+      } catch (const std::runtime_error &) {
+        chunk.damaged.push_back(num);
+      }
+    }
+  } catch (const std::runtime_error &) {
+    chunk.damaged = nums;
+  }
+  return chunk;
+}
+
+void merge_chunk(ObjectTable &table, ParsedChunk chunk) {
+  for (const ObjectTable::Object &obj : chunk.objects)
+    table.add(obj);
+  for (int64_t num : chunk.damaged)
+    table.add_damaged(num);
+  table.keep(std::move(chunk.graph));
+}
+
+} // namespace
+
+ObjectTable PdfParser::parse_all(size_t threads) {
+  ThreadPool pool(threads);
+  return parse_all(pool);
+}
+
+ObjectTable PdfParser::parse_all(ThreadPool &pool) {
+  const XrefTable &table = xref();
+  fetch_all();
+  std::string_view bytes = data;
+  std::pmr::memory_resource *resource = memory;
+
+  // Objects in the file are parsed by offset so each task reads one
+  // contiguous range of the input. Compressed objects wait for their streams.
+  std::vector<ChunkEntry> direct;
+  std::map<int64_t, std::vector<int64_t>> compressed;
+  const std::vector<XrefEntry> &entries = table.all();
+  for (size_t num = 0; num < entries.size(); ++num) {
+    const XrefEntry &entry = entries[num];
+    if (entry.type == XrefType::InUse && entry.offset < data.size())
+      direct.push_back({static_cast<int64_t>(num), entry.offset});
+    else if (entry.type == XrefType::Compressed)
+      compressed[entry.offset].push_back(num);
+  }
+  std::sort(direct.begin(), direct.end(),
+            [](const ChunkEntry &a, const ChunkEntry &b) {
+              return a.offset < b.offset;
+            });
+
+  size_t chunks = std::max<size_t>(1, pool.size() * PARSE_CHUNKS_PER_THREAD);
+  size_t chunk_bytes = std::max(MIN_PARSE_CHUNK, data.size() / chunks);
+
+  std::vector<std::future<ParsedChunk>> parsing;
+  size_t first = 0;
+  for (size_t i = 1; i <= direct.size(); ++i) {
+    if (i < direct.size() &&
+        direct[i].offset - direct[first].offset < chunk_bytes)
+      continue;
+    const ChunkEntry *begin = direct.data() + first;
+    const ChunkEntry *end = direct.data() + i;
+    parsing.push_back(pool.submit([bytes, &table, begin, end, resource] {
+      return parse_chunk(bytes, table, begin, end, resource);
+    }));
+    first = i;
+  }
+
+  // The tasks point into direct, so none can be left running if one of
+  // them throws something other than a parse error
+  auto merge_all = [](ObjectTable &table,
+                      std::vector<std::future<ParsedChunk>> &futures) {
+    try {
+      for (auto &future : futures)
+        merge_chunk(table, future.get());
+    } catch (...) {
+      for (auto &future : futures) {
+        if (future.valid())
+          future.wait();
+      }
+      throw;
+    }
+  };
+
+  ObjectTable result;
+  merge_all(result, parsing);
+
+  // Every object stream is decoded and parsed by its own task
+  std::vector<std::future<ParsedChunk>> unpacking;
+  for (const auto &[stream_num, nums] : compressed) {
+    const ObjectTable::Object *top = result.get(stream_num);
+    unpacking.push_back(pool.submit([top, &nums, resource] {
+      return parse_object_stream(top, nums, resource);
+    }));
+  }
+  merge_all(result, unpacking);
 
-  free(out_buffer);
-  return new_data;
+  result.sort_damaged();
+  return result;
 }
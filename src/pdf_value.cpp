@@ -0,0 +1,372 @@
+#include "pdf_value.h"
+#include "lexer.h"
+#include "pdf_events.h"
+#include "serializer.h"
+#include <limits>
+#include <stdexcept>
+
+using util::PdfType;
+
+namespace {
+
+uint32_t checked_size(size_t size) {
+  if (size > std::numeric_limits<uint32_t>::max())
+    throw std::runtime_error("Parse Error: Object is too large for a value");
+  return static_cast<uint32_t>(size);
+}
+
+uint16_t checked_gen(int64_t gen) {
+  if (gen > std::numeric_limits<uint16_t>::max())
+    throw std::runtime_error("Parse Error: Generation " + std::to_string(gen) +
+                             " is more than 65535");
+  return static_cast<uint16_t>(gen);
+}
+
+// Returned for the parts of a value that is not the kind asked for
+const PdfValue NULL_VALUE;
+
+} // namespace
+
+// Builds values from parse events. Every finished value is pushed onto the
+// graph's scratch, and each open container remembers where its children start
+// there so closing it can move them to the node table in one run.
+class PdfGraph::Builder : public PdfEventHandler {
+public:
+  Builder(PdfGraph &g, bool s) : graph(g), stable(s) {}
+
+  PdfValue result;
+
+  void null_value() override { add(PdfValue()); }
+  void bool_value(bool b) override {
+    PdfValue v;
+    v.type = PdfType::Bool;
+    v.boolean = b;
+    add(v);
+  }
+  void int_value(int64_t i) override { add(make_int(i)); }
+  void real_value(double d) override {
+    PdfValue v;
+    v.type = PdfType::Real;
+    v.real = d;
+    add(v);
+  }
+  void name_value(std::string_view name) override { add(make_name(name)); }
+  void string_value(std::string_view raw, bool hex) override {
+    // Most strings have no escapes and can be used as they are
+    if (!hex && raw.find_first_of("\\\r") == std::string_view::npos) {
+      add(make_text(PdfType::String, raw));
+      return;
+    }
+    std::string decoded =
+        hex ? util::decode_hex_string(raw) : util::decode_literal_string(raw);
+    add(text_value(PdfType::String, graph.strings.copy(decoded)));
+  }
+  void ref_value(int64_t num, int64_t gen) override {
+    PdfValue v;
+    v.type = PdfType::Ref;
+    v.integer = num;
+    v.gen = checked_gen(gen);
+    add(v);
+  }
+
+  void begin_array() override { open(PdfType::Array); }
+  void end_array() override {
+    Frame frame = close();
+    add(graph.close_children(PdfType::Array, frame.mark,
+                             checked_size(graph.scratch.size() - frame.mark)));
+  }
+
+  void begin_dict() override { open(PdfType::Dict); }
+  void key(std::string_view name) override {
+    graph.scratch.push_back(make_name(name));
+  }
+  void end_dict() override { add(close_dict()); }
+
+  // The dict is already open, it is closed here and becomes the first of the
+  // stream's two children
+  void begin_stream() override {
+    PdfValue dict = close_dict();
+    open(PdfType::Stream);
+    graph.scratch.push_back(dict);
+    payload = std::string_view();
+  }
+  // The chunks are pieces of one view of the buffer, so they are joined back
+  // up rather than copied
+  void stream_data(std::string_view chunk) override {
+    if (payload.data() == nullptr)
+      payload = chunk;
+    else
+      payload = std::string_view(payload.data(), payload.size() + chunk.size());
+  }
+  void end_stream() override {
+    Frame frame = close();
+    graph.scratch.push_back(make_text(PdfType::String, payload));
+    add(graph.close_children(PdfType::Stream, frame.mark, 2));
+  }
+
+  void begin_object(int64_t num, int64_t gen) override {
+    open(PdfType::TopLevel);
+    frames.back().gen = checked_gen(gen);
+    graph.scratch.push_back(make_int(num));
+  }
+  void end_object() override {
+    Frame frame = close();
+    PdfValue top = graph.close_children(PdfType::TopLevel, frame.mark, 2);
+    top.gen = frame.gen;
+    add(top);
+  }
+
+private:
+  struct Frame {
+    PdfType type;
+    size_t mark; // scratch size when the container opened
+    uint16_t gen;
+  };
+
+  PdfValue make_int(int64_t i) {
+    PdfValue v;
+    v.type = PdfType::Int;
+    v.integer = i;
+    return v;
+  }
+  PdfValue make_name(std::string_view name) {
+    NameTable::global().intern(name, &name);
+    return text_value(PdfType::Name, name);
+  }
+  // Text from the buffer is only kept as it is when the buffer outlives the
+  // graph
+  PdfValue make_text(PdfType type, std::string_view text) {
+    if (!stable)
+      text = graph.strings.copy(text);
+    return text_value(type, text);
+  }
+  PdfValue text_value(PdfType type, std::string_view text) {
+    PdfValue v;
+    v.type = type;
+    v.text = text.data();
+    v.size = checked_size(text.size());
+    return v;
+  }
+
+  void open(PdfType type) {
+    frames.push_back(Frame{type, graph.scratch.size(), 0});
+  }
+  Frame close() {
+    Frame frame = frames.back();
+    frames.pop_back();
+    return frame;
+  }
+  PdfValue close_dict() {
+    Frame frame = close();
+    return graph.close_children(
+        PdfType::Dict, frame.mark,
+        checked_size((graph.scratch.size() - frame.mark) / 2));
+  }
+  void add(const PdfValue &v) {
+    if (frames.empty())
+      result = v;
+    else
+      graph.scratch.push_back(v);
+  }
+
+  PdfGraph &graph;
+  bool stable;
+  std::vector<Frame> frames;
+  std::string_view payload;
+};
+
+PdfGraph::PdfGraph(size_t arena_size, std::pmr::memory_resource *memory)
+    : nodes(memory), scratch(memory), strings(arena_size, memory) {}
+
+void PdfGraph::clear() {
+  nodes.clear();
+  scratch.clear();
+  strings.release();
+}
+
+// A parse that throws leaves whatever containers it had closed in the node
+// table, unreferenced, until the graph is cleared
+PdfValue PdfGraph::parse(PdfLexer &lex) {
+  size_t mark = scratch.size();
+  Builder builder(*this, lex.stable());
+  try {
+    PdfEventParser(lex).parse_object(builder);
+  } catch (...) {
+    scratch.resize(mark);
+    throw;
+  }
+  return builder.result;
+}
+
+// Move the children collected since mark into one contiguous run at the end of
+// the node table and return the container that refers to them
+PdfValue PdfGraph::close_children(PdfType type, size_t mark, uint32_t size) {
+  PdfValue v;
+  v.type = type;
+  v.first = nodes.size();
+  v.size = size;
+  nodes.insert(nodes.end(), scratch.begin() + mark, scratch.end());
+  scratch.resize(mark);
+  return v;
+}
+
+PdfArrayValue PdfGraph::array(const PdfValue &v) const {
+  if (v.type != PdfType::Array)
+    return PdfArrayValue{nullptr, 0};
+  return PdfArrayValue{nodes.data() + v.first, v.size};
+}
+
+PdfDictValue PdfGraph::dict(const PdfValue &v) const {
+  if (v.type == PdfType::Stream)
+    return dict(nodes[v.first]);
+  if (v.type != PdfType::Dict)
+    return PdfDictValue{nullptr, 0};
+  return PdfDictValue{nodes.data() + v.first, v.size};
+}
+
+PdfStreamValue PdfGraph::stream(const PdfValue &v) const {
+  if (v.type != PdfType::Stream)
+    return PdfStreamValue{NULL_VALUE, std::string_view()};
+  return PdfStreamValue{nodes[v.first], nodes[v.first + 1].str()};
+}
+
+PdfObjectValue PdfGraph::object(const PdfValue &v) const {
+  if (v.type != PdfType::TopLevel)
+    return PdfObjectValue{-1, 0, NULL_VALUE};
+  return PdfObjectValue{nodes[v.first].integer, v.gen, nodes[v.first + 1]};
+}
+
+const PdfValue *PdfGraph::find(const PdfValue &d, std::string_view key) const {
+  PdfAtom id = NameTable::global().find(key);
+  if (id == NameTable::NO_ATOM)
+    return nullptr;
+  return find(d, id);
+}
+
+// Keys are interned, so comparing the text pointers compares the names. The
+// search goes backwards so a repeated key finds its last value.
+const PdfValue *PdfGraph::find(const PdfValue &d, PdfAtom key) const {
+  const char *text = NameTable::global().text(key).data();
+  PdfDictValue pairs = dict(d);
+  for (size_t i = pairs.size; i > 0; --i) {
+    if (pairs.key(i - 1).text == text)
+      return &pairs.value(i - 1);
+  }
+  return nullptr;
+}
+
+// Like PdfObj::write this is usually one value at a time
+const size_t WRITE_VALUE_BUFFER_SIZE = 4096;
+
+void PdfGraph::write(std::ostream &os, const PdfValue &v) const {
+  PdfSerializer out(os, WRITE_VALUE_BUFFER_SIZE);
+  out.write(*this, v);
+}
+
+util::PdfObj *PdfGraph::to_obj(const PdfValue &v) const {
+  switch (v.type) {
+  case PdfType::Bool:
+    return new util::PdfBool(v.boolean);
+  case PdfType::Int:
+    return new util::PdfInt(v.integer);
+  case PdfType::Real:
+    return new util::PdfReal(v.real);
+  case PdfType::Name:
+    return new util::PdfName(v.str());
+  case PdfType::String:
+    return new util::PdfString(std::string(v.str()));
+  case PdfType::Ref:
+    return new util::PdfRef(v.integer, v.gen);
+  case PdfType::Array: {
+    auto arr = new util::PdfArray();
+    for (const PdfValue &item : array(v))
+      arr->objects.push_back(to_obj(item));
+    return arr;
+  }
+  case PdfType::Dict: {
+    auto d = new util::PdfDict();
+    PdfDictValue pairs = dict(v);
+    for (size_t i = 0; i < pairs.size; ++i) {
+      util::PdfObj *&slot = d->pairs[util::PdfName(pairs.key(i).str())];
+      delete slot;
+      slot = to_obj(pairs.value(i));
+    }
+    return d;
+  }
+  case PdfType::Stream: {
+    PdfStreamValue s = stream(v);
+    auto obj = new util::PdfStream(to_obj(s.dict)->as<util::PdfDict>());
+    obj->stream.assign(s.payload.begin(), s.payload.end());
+    return obj;
+  }
+  case PdfType::TopLevel: {
+    PdfObjectValue top = object(v);
+    return new util::PdfTopLevel(top.num, top.gen, to_obj(top.value));
+  }
+  default:
+    return new util::PdfNull();
+  }
+}
+
+bool values_equal(const PdfGraph &ga, const PdfValue &a, const PdfGraph &gb,
+                  const PdfValue &b) {
+  if (a.type != b.type)
+    return false;
+
+  switch (a.type) {
+  case PdfType::Null:
+    return true;
+  case PdfType::Bool:
+    return a.boolean == b.boolean;
+  case PdfType::Int:
+    return a.integer == b.integer;
+  case PdfType::Real:
+    return a.real == b.real;
+  case PdfType::Name:
+    // Interned, so the same name is the same pointer
+    return a.text == b.text;
+  case PdfType::String:
+    return a.str() == b.str();
+  case PdfType::Ref:
+    return a.integer == b.integer && a.gen == b.gen;
+  case PdfType::Array: {
+    PdfArrayValue xs = ga.array(a);
+    PdfArrayValue ys = gb.array(b);
+    if (xs.size != ys.size)
+      return false;
+    for (size_t i = 0; i < xs.size; ++i) {
+      if (!values_equal(ga, xs.items[i], gb, ys.items[i]))
+        return false;
+    }
+    return true;
+  }
+  case PdfType::Dict: {
+    PdfDictValue xs = ga.dict(a);
+    PdfDictValue ys = gb.dict(b);
+    if (xs.size != ys.size)
+      return false;
+    for (size_t i = 0; i < xs.size; ++i) {
+      const PdfValue *other = nullptr;
+      for (size_t j = 0; j < ys.size && other == nullptr; ++j) {
+        if (ys.key(j).text == xs.key(i).text)
+          other = &ys.value(j);
+      }
+      if (other == nullptr || !values_equal(ga, xs.value(i), gb, *other))
+        return false;
+    }
+    return true;
+  }
+  case PdfType::Stream: {
+    PdfStreamValue x = ga.stream(a);
+    PdfStreamValue y = gb.stream(b);
+    return x.payload == y.payload && values_equal(ga, x.dict, gb, y.dict);
+  }
+  case PdfType::TopLevel: {
+    PdfObjectValue x = ga.object(a);
+    PdfObjectValue y = gb.object(b);
+    return x.num == y.num && x.gen == y.gen &&
+           values_equal(ga, x.value, gb, y.value);
+  }
+  }
+  return false;
+}
@@ -0,0 +1,386 @@
+#include "range_reader.h"
+#include "stats.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <ios>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PDFCLI_HAVE_MMAP 1
+#endif
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+// Runs of blocks are read with requests of at most this many bytes, so a big
+// fetch still turns into several reads that can be in flight at once
+const size_t MAX_RANGE_READ = 1024 * 1024;
+
+namespace {
+
+[[noreturn]] void read_error(const std::string &msg) {
+  throw std::ios_base::failure("Error reading range: " + msg);
+}
+
+int open_file(const std::string &path, uint64_t &length) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::ios_base::failure("Failed to open file: " + path);
+  struct stat info;
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    ::close(fd);
+    throw std::ios_base::failure("Not a regular file: " + path);
+  }
+  length = info.st_size;
+  return fd;
+}
+
+} // namespace
+
+// FileRangeReader ////////////////////////////////////////////////////////////
+
+FileRangeReader::FileRangeReader(const std::string &path) {
+  fd = open_file(path, length);
+}
+
+FileRangeReader::~FileRangeReader() { ::close(fd); }
+
+void FileRangeReader::read(const std::vector<ReadRequest> &requests) {
+  for (const ReadRequest &request : requests) {
+    size_t done = 0;
+    while (done < request.length) {
+      ssize_t got = ::pread(fd, request.dest + done, request.length - done,
+                            request.offset + done);
+      if (got < 0 && errno == EINTR)
+        continue;
+      if (got <= 0)
+        read_error(got < 0 ? std::strerror(errno) : "unexpected end of file");
+      done += got;
+    }
+  }
+}
+
+// UringRangeReader ///////////////////////////////////////////////////////////
+
+#ifdef __linux__
+
+// The shared rings. The kernel reads the submission tail and writes the
+// completion tail, so those are read and written with acquire and release.
+struct UringRangeReader::Ring {
+  int fd = -1;
+  unsigned entries = 0;
+  void *sq_ring = MAP_FAILED;
+  size_t sq_ring_size = 0;
+  void *cq_ring = MAP_FAILED;
+  size_t cq_ring_size = 0;
+  io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+  size_t sqes_size = 0;
+
+  unsigned *sq_head = nullptr;
+  unsigned *sq_tail = nullptr;
+  unsigned *sq_mask = nullptr;
+  unsigned *sq_array = nullptr;
+  unsigned *cq_head = nullptr;
+  unsigned *cq_tail = nullptr;
+  unsigned *cq_mask = nullptr;
+  io_uring_cqe *cqes = nullptr;
+
+  ~Ring() {
+    if (sqes != MAP_FAILED)
+      munmap(sqes, sqes_size);
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+      munmap(cq_ring, cq_ring_size);
+    if (sq_ring != MAP_FAILED)
+      munmap(sq_ring, sq_ring_size);
+    if (fd >= 0)
+      ::close(fd);
+  }
+
+  // Null if the ring can not be set up
+  static std::unique_ptr<Ring> create(unsigned depth) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    auto ring = std::make_unique<Ring>();
+    ring->fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+    if (ring->fd < 0)
+      return nullptr;
+    ring->entries = params.sq_entries;
+
+    ring->sq_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single)
+      ring->sq_ring_size = ring->cq_ring_size =
+          std::max(ring->sq_ring_size, ring->cq_ring_size);
+
+    ring->sq_ring =
+        mmap(nullptr, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED)
+      return nullptr;
+    ring->cq_ring = single ? ring->sq_ring
+                           : mmap(nullptr, ring->cq_ring_size,
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, ring->fd,
+                                  IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED)
+      return nullptr;
+    ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = static_cast<io_uring_sqe *>(
+        mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES));
+    if (ring->sqes == MAP_FAILED)
+      return nullptr;
+
+    char *sq = static_cast<char *>(ring->sq_ring);
+    ring->sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    ring->sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    ring->sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    ring->sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    char *cq = static_cast<char *>(ring->cq_ring);
+    ring->cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    ring->cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    ring->cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return ring;
+  }
+
+  // Queue a readv of one iovec, tagged with the slot it belongs to
+  void push_read(int file, uint64_t offset, const iovec *iov, uint64_t slot) {
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    io_uring_sqe *sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = file;
+    sqe->off = offset;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = 1;
+    sqe->user_data = slot;
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+  }
+
+  // Submit whatever is queued and wait for at least one completion. Returns
+  // the errno on failure.
+  int submit_and_wait() {
+    while (true) {
+      unsigned queued =
+          *sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+      long ret = syscall(__NR_io_uring_enter, fd, queued, 1,
+                         IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (ret >= 0)
+        return 0;
+      if (errno != EINTR)
+        return errno;
+    }
+  }
+};
+
+UringRangeReader::UringRangeReader(int f, uint64_t len,
+                                   std::unique_ptr<Ring> r)
+    : fd(f), length(len), ring(std::move(r)) {}
+
+UringRangeReader::~UringRangeReader() {
+  ring.reset();
+  ::close(fd);
+}
+
+std::unique_ptr<UringRangeReader>
+UringRangeReader::open(const std::string &path, unsigned depth) {
+  uint64_t length = 0;
+  int fd = open_file(path, length);
+  std::unique_ptr<Ring> ring = Ring::create(depth);
+  if (ring == nullptr) {
+    ::close(fd);
+    return nullptr;
+  }
+  return std::unique_ptr<UringRangeReader>(
+      new UringRangeReader(fd, length, std::move(ring)));
+}
+
+void UringRangeReader::read(const std::vector<ReadRequest> &requests) {
+  if (ring == nullptr)
+    read_error("io_uring failed earlier and was closed");
+  std::deque<ReadRequest> waiting(requests.begin(), requests.end());
+  // Each slot is one read in flight. The iovecs have to stay put until the
+  // read completes, since the kernel may look at them after the submit.
+  std::vector<ReadRequest> slots(ring->entries);
+  std::vector<iovec> iovs(ring->entries);
+  std::vector<uint64_t> free_slots;
+  for (unsigned i = 0; i < ring->entries; ++i)
+    free_slots.push_back(i);
+  size_t in_flight = 0;
+  std::string error;
+
+  while (in_flight > 0 || (!waiting.empty() && error.empty())) {
+    while (!waiting.empty() && !free_slots.empty() && error.empty()) {
+      uint64_t slot = free_slots.back();
+      free_slots.pop_back();
+      slots[slot] = waiting.front();
+      waiting.pop_front();
+      iovs[slot].iov_base = slots[slot].dest;
+      iovs[slot].iov_len = slots[slot].length;
+      ring->push_read(fd, slots[slot].offset, &iovs[slot], slot);
+      ++in_flight;
+    }
+
+    if (int err = ring->submit_and_wait()) {
+      // Nothing more can be learned about what is in flight, so give up on
+      // the ring rather than leave reads writing into memory after we return
+      ring.reset();
+      read_error(std::strerror(err));
+    }
+
+    unsigned head = *ring->cq_head;
+    while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+      const io_uring_cqe &cqe = ring->cqes[head & *ring->cq_mask];
+      ++head;
+      ReadRequest &request = slots[cqe.user_data];
+      int res = cqe.res;
+      --in_flight;
+      free_slots.push_back(cqe.user_data);
+
+      if (res == -EINTR || res == -EAGAIN) {
+        waiting.push_back(request);
+      } else if (res < 0) {
+        error = std::strerror(-res);
+      } else if (res == 0) {
+        error = "unexpected end of file";
+      } else if (static_cast<size_t>(res) < request.length) {
+        // A short read, ask again for the rest
+        waiting.push_back({request.offset + res, request.length - res,
+                           request.dest + res});
+      }
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  }
+  if (!error.empty())
+    read_error(error);
+}
+
+#endif
+
+std::unique_ptr<RangeReader> open_range_reader(const std::string &path) {
+#ifdef __linux__
+  if (auto uring = UringRangeReader::open(path))
+    return uring;
+#endif
+  return std::make_unique<FileRangeReader>(path);
+}
+
+// RangedSource ///////////////////////////////////////////////////////////////
+
+RangedSource::RangedSource(std::unique_ptr<RangeReader> r, size_t block)
+    : reader(std::move(r)), block_size(std::max<size_t>(block, 1)) {
+  length = reader->size();
+  if (length > 0) {
+#ifdef PDFCLI_HAVE_MMAP
+    // Anonymous pages cost nothing until they are written, so the span of a
+    // big document that is only looked at in places stays small
+    void *addr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr != MAP_FAILED) {
+      start = static_cast<char *>(addr);
+      mapped = true;
+    }
+#endif
+    if (start == nullptr)
+      start = new char[length]();
+  }
+  block_count = (length + block_size - 1) / block_size;
+  loaded.reset(new std::atomic<bool>[block_count]);
+  for (size_t i = 0; i < block_count; ++i)
+    loaded[i].store(false, std::memory_order_relaxed);
+  missing = block_count;
+}
+
+RangedSource::~RangedSource() {
+#ifdef PDFCLI_HAVE_MMAP
+  if (mapped) {
+    munmap(start, length);
+    return;
+  }
+#endif
+  delete[] start;
+}
+
+bool RangedSource::has(uint64_t offset, uint64_t len) const {
+  if (offset >= length || len == 0)
+    return true;
+  uint64_t end = std::min<uint64_t>(offset + len, length);
+  for (uint64_t b = offset / block_size; b <= (end - 1) / block_size; ++b) {
+    if (!loaded[b].load(std::memory_order_acquire))
+      return false;
+  }
+  return true;
+}
+
+void RangedSource::fetch(const std::vector<ByteRange> &ranges) {
+  if (complete())
+    return;
+  std::vector<size_t> wanted;
+  for (const ByteRange &range : ranges) {
+    if (range.offset >= length || range.length == 0)
+      continue;
+    uint64_t end = std::min<uint64_t>(range.offset + range.length, length);
+    for (uint64_t b = range.offset / block_size; b <= (end - 1) / block_size;
+         ++b) {
+      if (!loaded[b].load(std::memory_order_acquire))
+        wanted.push_back(b);
+    }
+  }
+  if (wanted.empty())
+    return;
+
+  PDF_STATS_SCOPE(RangeFetch);
+  std::lock_guard<std::mutex> lock(reading);
+  std::sort(wanted.begin(), wanted.end());
+  wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+  // Another thread may have read some of them while this one waited
+  wanted.erase(std::remove_if(wanted.begin(), wanted.end(),
+                              [this](size_t b) {
+                                return loaded[b].load(
+                                    std::memory_order_relaxed);
+                              }),
+               wanted.end());
+  if (wanted.empty())
+    return;
+
+  // Neighbouring blocks are read together, up to the biggest single read
+  const size_t run_limit = std::max<size_t>(1, MAX_RANGE_READ / block_size);
+  std::vector<ReadRequest> requests;
+  uint64_t total = 0;
+  for (size_t i = 0; i < wanted.size();) {
+    size_t first = wanted[i];
+    size_t last = first;
+    while (++i < wanted.size() && wanted[i] == last + 1 &&
+           last + 1 - first < run_limit)
+      last = wanted[i];
+    uint64_t offset = static_cast<uint64_t>(first) * block_size;
+    uint64_t end = static_cast<uint64_t>(last + 1) * block_size;
+    end = std::min<uint64_t>(end, length);
+    requests.push_back({offset, static_cast<size_t>(end - offset),
+                        start + offset});
+    total += end - offset;
+  }
+
+  reader->read(requests);
+  for (size_t b : wanted)
+    loaded[b].store(true, std::memory_order_release);
+  missing -= wanted.size();
+  fetched += total;
+  ++batch_count;
+  PDF_STATS_ADD(BytesRead, total);
+  PDF_STATS_ADD(RangeReads, requests.size());
+}
@@ -0,0 +1,415 @@
+#include "rewriter.h"
+#include "filters.h"
+#include "inflate_backend.h"
+#include "pdf_parser.h"
+#include "serializer.h"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// How many objects each thread can have waiting to be written
+const size_t REWRITE_OBJECTS_PER_THREAD = 8;
+
+// The keys of the trailer that describe the document, the rest were about the
+// old file's layout
+const PdfAtom TRAILER_KEYS[] = {atom::Root, atom::Info, atom::ID,
+                                atom::Encrypt};
+
+namespace {
+
+// Objects that only exist to index or pack other objects, which the new file
+// does not have
+bool is_structural(const util::PdfObj &obj) {
+  const util::PdfStream *stream = obj.as<util::PdfStream>();
+  if (stream == nullptr)
+    return false;
+  const util::PdfObj *type = stream->dict->pairs.get(atom::Type);
+  return type != nullptr && (*type == util::PdfName(atom::ObjStm) ||
+                             *type == util::PdfName(atom::XRef));
+}
+
+// A stream that was compressed again, or that is kept as it was
+struct Encoded {
+  bool changed = false;
+  bool add_filter = false; // it had no filter and now needs /FlateDecode
+  std::vector<char> payload;
+};
+
+// Only a lone /FlateDecode can be undone and done again here
+bool only_deflated(const util::PdfObj *filter) {
+  if (filter == nullptr)
+    return false;
+  if (const util::PdfArray *filters = filter->as<util::PdfArray>())
+    return filters->objects.size() == 1 &&
+           only_deflated(filters->objects.front());
+  return *filter == util::PdfName(atom::FlateDecode);
+}
+
+Encoded recompress(const util::PdfStream &stream, int level) {
+  Encoded result;
+  std::string_view bytes = stream.bytes();
+  const util::PdfObj *filter = stream.dict->pairs.get(atom::Filter);
+  std::vector<char> deflated;
+  try {
+    if (filter == nullptr) {
+      deflated = deflate_buffer(bytes, level);
+      result.add_filter = true;
+    } else if (only_deflated(filter)) {
+      // Predictors are left in place, they still apply to the same bytes
+      std::vector<char> raw = util::inflate_bytes(bytes);
+      deflated = deflate_buffer(std::string_view(raw.data(), raw.size()),
+                                level);
+    } else {
+      return result;
+    }
+  } catch (const std::runtime_error &) {
+    return Encoded();
+  }
+  if (deflated.size() < bytes.size()) {
+    result.changed = true;
+    result.payload = std::move(deflated);
+  } else {
+    result.add_filter = false;
+  }
+  return result;
+}
+
+struct Written {
+  XrefType type = XrefType::Free;
+  uint16_t gen = 0;
+  uint32_t index = 0;  // inside the object stream
+  uint64_t offset = 0; // or the number of the object stream
+};
+
+class Rewriter {
+public:
+  Rewriter(PdfParser &parser, std::ostream &os, ThreadPool *pool,
+           const RewriteOptions &options);
+  void run();
+
+private:
+  // An object on its way out. Streams being compressed and packed object
+  // streams have their data coming from the pool.
+  struct Pending {
+    int64_t num;
+    uint16_t gen;
+    ObjectCache::ObjPtr obj;
+    std::future<Encoded> encoded;
+    int64_t packed_count = 0; // set for object streams made here
+    size_t first = 0;
+  };
+
+  void add(int64_t num, uint16_t gen, ObjectCache::ObjPtr obj);
+  void pack(int64_t num, const util::PdfTopLevel &obj);
+  void close_object_stream();
+  void push(Pending pending);
+  void write_front();
+  void write_xref_table();
+  void write_xref_stream();
+
+  PdfParser &parser;
+  const XrefTable &xref;
+  ThreadPool *pool;
+  RewriteOptions options;
+  PdfSerializer out;
+  std::vector<Written> objects;
+  std::deque<Pending> pending;
+  size_t window;
+
+  // The object stream being filled
+  std::ostringstream packed_header, packed_body;
+  std::vector<int64_t> packed_nums;
+  int64_t next_num;
+};
+
+Rewriter::Rewriter(PdfParser &p, std::ostream &os, ThreadPool *tp,
+                   const RewriteOptions &o)
+    : parser(p), xref(p.xref()), pool(tp), options(o), out(os),
+      objects(std::max<size_t>(xref.size(), 1)),
+      window(tp != nullptr ? tp->size() * REWRITE_OBJECTS_PER_THREAD : 1),
+      next_num(objects.size()) {
+  if (xref.trailer().pairs.get(atom::Encrypt) != nullptr) {
+    options.compress_level = -1;
+    options.object_streams = false;
+  }
+  options.objects_per_stream =
+      std::clamp<size_t>(options.objects_per_stream, 1, UINT16_MAX);
+}
+
+void Rewriter::run() {
+  // The binary comment tells transfer tools the file is not plain text
+  out.raw("%PDF-1.7\n%\xE2\xE3\xCF\xD3\n");
+
+  for (size_t num = 1; num < xref.size(); ++num) {
+    const XrefEntry &entry = xref.all()[num];
+    if (entry.type != XrefType::InUse && entry.type != XrefType::Compressed) {
+      objects[num].gen = entry.type == XrefType::Free ? entry.gen : 0;
+      continue;
+    }
+
+    // Compressed objects always have generation 0
+    uint16_t gen = entry.type == XrefType::Compressed ? 0 : entry.gen;
+    ObjectCache::ObjPtr obj;
+    try {
+      obj = parser.get_object(num, gen);
+    } catch (const std::runtime_error &) {
+    }
+    if (obj == nullptr || is_structural(*obj->obj))
+      continue;
+    add(num, gen, std::move(obj));
+  }
+  close_object_stream();
+  while (!pending.empty())
+    write_front();
+
+  if (options.object_streams)
+    write_xref_stream();
+  else
+    write_xref_table();
+  out.flush();
+}
+
+void Rewriter::add(int64_t num, uint16_t gen, ObjectCache::ObjPtr obj) {
+  const util::PdfStream *stream = obj->obj->as<util::PdfStream>();
+  if (options.object_streams && stream == nullptr && gen == 0) {
+    pack(num, *obj);
+    return;
+  }
+
+  Pending next{num, gen, obj, {}};
+  if (stream != nullptr && options.compress_level >= 0) {
+    int level = options.compress_level;
+    // The handle keeps the stream alive while the pool works on it
+    auto task = [obj, stream, level] { return recompress(*stream, level); };
+    if (pool != nullptr)
+      next.encoded = pool->submit(task);
+    else {
+      std::promise<Encoded> done;
+      done.set_value(task());
+      next.encoded = done.get_future();
+    }
+  }
+  push(std::move(next));
+}
+
+void Rewriter::pack(int64_t num, const util::PdfTopLevel &obj) {
+  // Offsets in the header count from the start of the objects
+  packed_header << num << " " << packed_body.tellp() << " ";
+  {
+    PdfSerializer body(packed_body);
+    body.write(*obj.obj);
+    body.put('\n');
+  }
+  packed_nums.push_back(num);
+  if (packed_nums.size() >= options.objects_per_stream)
+    close_object_stream();
+}
+
+// Turn the objects collected so far into an object stream of its own, with a
+// new object number after all of the old ones
+void Rewriter::close_object_stream() {
+  if (packed_nums.empty())
+    return;
+  int64_t num = next_num++;
+  objects.resize(next_num);
+  for (size_t i = 0; i < packed_nums.size(); ++i)
+    objects[packed_nums[i]] = {XrefType::Compressed, 0,
+                               static_cast<uint32_t>(i),
+                               static_cast<uint64_t>(num)};
+
+  std::string header = packed_header.str();
+  std::string data = header + packed_body.str();
+  Pending next{num, 0, nullptr, {}};
+  next.packed_count = packed_nums.size();
+  next.first = header.size();
+  int level = options.compress_level >= 0 ? options.compress_level : 6;
+  auto task = [data = std::move(data), level] {
+    Encoded encoded;
+    encoded.changed = true;
+    encoded.payload = deflate_buffer(data, level);
+    return encoded;
+  };
+  if (pool != nullptr)
+    next.encoded = pool->submit(std::move(task));
+  else {
+    std::promise<Encoded> done;
+    done.set_value(task());
+    next.encoded = done.get_future();
+  }
+  push(std::move(next));
+
+  packed_header.str("");
+  packed_body.str("");
+  packed_nums.clear();
+}
+
+void Rewriter::push(Pending next) {
+  pending.push_back(std::move(next));
+  while (pending.size() > window)
+    write_front();
+}
+
+void Rewriter::write_front() {
+  Pending next = std::move(pending.front());
+  pending.pop_front();
+  objects[next.num].type = XrefType::InUse;
+  objects[next.num].gen = next.gen;
+  objects[next.num].offset = out.offset();
+
+  out.integer(next.num);
+  out.put(' ');
+  out.integer(next.gen);
+  out.raw(" obj\n");
+
+  if (next.packed_count > 0) {
+    Encoded encoded = next.encoded.get();
+    out.raw("<< /Type /ObjStm /N ");
+    out.integer(next.packed_count);
+    out.raw(" /First ");
+    out.integer(next.first);
+    out.raw(" /Filter /FlateDecode /Length ");
+    out.integer(encoded.payload.size());
+    out.raw(" >>\nstream\n");
+    out.raw(std::string_view(encoded.payload.data(), encoded.payload.size()));
+    out.raw("\nendstream\n");
+  } else if (next.encoded.valid()) {
+    Encoded encoded = next.encoded.get();
+    const util::PdfStream &stream = *next.obj->obj->as<util::PdfStream>();
+    util::PdfName flate(atom::FlateDecode);
+    if (encoded.changed)
+      out.write_stream(*stream.dict,
+                       std::string_view(encoded.payload.data(),
+                                        encoded.payload.size()),
+                       encoded.add_filter ? &flate : nullptr);
+    else
+      out.write_stream(*stream.dict, stream.bytes());
+  } else if (const util::PdfStream *stream =
+                 next.obj->obj->as<util::PdfStream>();
+             stream != nullptr && options.object_streams) {
+    // The /Length could be an object that is now packed, which the spec does
+    // not allow, so it is always written directly
+    out.write_stream(*stream->dict, stream->bytes());
+  } else {
+    out.write(*next.obj->obj);
+  }
+  out.raw("\nendobj\n");
+}
+
+void Rewriter::write_xref_table() {
+  // The free entries form a list through their offsets, starting at object 0
+  // and ending back at it
+  std::vector<size_t> next_free(objects.size(), 0);
+  size_t last_free = 0;
+  for (size_t num = 1; num < objects.size(); ++num) {
+    if (objects[num].type == XrefType::Free) {
+      next_free[last_free] = num;
+      last_free = num;
+    }
+  }
+
+  size_t xref_offset = out.offset();
+  out.raw("xref\n0 ");
+  out.integer(objects.size());
+  out.put('\n');
+  for (size_t num = 0; num < objects.size(); ++num) {
+    const Written &obj = objects[num];
+    bool in_use = num != 0 && obj.type == XrefType::InUse;
+    out.padded(in_use ? obj.offset : next_free[num], 10);
+    out.put(' ');
+    out.padded(num == 0 ? 65535 : obj.gen, 5);
+    out.raw(in_use ? " n\r\n" : " f\r\n");
+  }
+
+  out.raw("trailer\n<< /Size ");
+  out.integer(objects.size());
+  for (PdfAtom key : TRAILER_KEYS) {
+    const util::PdfObj *value = xref.trailer().pairs.get(key);
+    if (value == nullptr)
+      continue;
+    out.put(' ');
+    out.raw(NameTable::global().text(key));
+    out.put(' ');
+    out.write(*value);
+  }
+  out.raw(" >>\nstartxref\n");
+  out.integer(xref_offset);
+  out.raw("\n%%EOF\n");
+}
+
+void Rewriter::write_xref_stream() {
+  int64_t num = next_num++;
+  objects.resize(next_num);
+  size_t xref_offset = out.offset();
+  objects[num] = {XrefType::InUse, 0, 0, xref_offset};
+
+  // Offsets need 4 bytes until the file passes 4GB
+  int offset_width = xref_offset > UINT32_MAX ? 8 : 4;
+  std::string rows;
+  rows.reserve(objects.size() * (3 + offset_width));
+  auto field = [&rows](uint64_t value, int width) {
+    for (int shift = (width - 1) * 8; shift >= 0; shift -= 8)
+      rows += static_cast<char>((value >> shift) & 0xff);
+  };
+  for (size_t i = 0; i < objects.size(); ++i) {
+    const Written &obj = objects[i];
+    switch (i == 0 ? XrefType::Free : obj.type) {
+    case XrefType::InUse:
+      field(1, 1);
+      field(obj.offset, offset_width);
+      field(obj.gen, 2);
+      break;
+    case XrefType::Compressed:
+      field(2, 1);
+      field(obj.offset, offset_width);
+      field(obj.index, 2);
+      break;
+    default:
+      field(0, 1);
+      field(0, offset_width);
+      field(i == 0 ? 65535 : obj.gen, 2);
+      break;
+    }
+  }
+  int level = options.compress_level >= 0 ? options.compress_level : 6;
+  std::vector<char> payload = deflate_buffer(rows, level);
+
+  out.integer(num);
+  out.raw(" 0 obj\n<< /Type /XRef /Size ");
+  out.integer(objects.size());
+  out.raw(" /W [ 1 ");
+  out.integer(offset_width);
+  out.raw(" 2 ]");
+  for (PdfAtom key : TRAILER_KEYS) {
+    const util::PdfObj *value = xref.trailer().pairs.get(key);
+    if (value == nullptr)
+      continue;
+    out.put(' ');
+    out.raw(NameTable::global().text(key));
+    out.put(' ');
+    out.write(*value);
+  }
+  out.raw(" /Filter /FlateDecode /Length ");
+  out.integer(payload.size());
+  out.raw(" >>\nstream\n");
+  out.raw(std::string_view(payload.data(), payload.size()));
+  out.raw("\nendstream\nendobj\nstartxref\n");
+  out.integer(xref_offset);
+  out.raw("\n%%EOF\n");
+}
+
+} // namespace
+
+void rewrite_document(PdfParser &parser, std::ostream &os,
+                      const RewriteOptions &options) {
+  Rewriter(parser, os, nullptr, options).run();
+}
+
+void rewrite_document(PdfParser &parser, std::ostream &os, ThreadPool &pool,
+                      const RewriteOptions &options) {
+  Rewriter(parser, os, &pool, options).run();
+}
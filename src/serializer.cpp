@@ -0,0 +1,275 @@
+#include "serializer.h"
+#include "lexer.h"
+#include "pdf_value.h"
+#include "stats.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <system_error>
+
+// Longer than any integer, and than any double written in fixed notation
+const size_t NUMBER_SPACE = 400;
+
+PdfSerializer::PdfSerializer(std::ostream &o, size_t buffer_size)
+    : os(o), capacity(std::max<size_t>(buffer_size, NUMBER_SPACE)) {
+  buffer.reserve(capacity);
+}
+
+PdfSerializer::~PdfSerializer() { flush(); }
+
+void PdfSerializer::flush() {
+  if (buffer.empty())
+    return;
+  PDF_STATS_SCOPE(OutputWrite);
+  os.write(buffer.data(), buffer.size());
+  flushed += buffer.size();
+  buffer.clear();
+}
+
+void PdfSerializer::raw(std::string_view bytes) {
+  if (bytes.size() > capacity - buffer.size()) {
+    // Big pieces like stream payloads skip the buffer entirely
+    flush();
+    if (bytes.size() >= capacity) {
+      os.write(bytes.data(), bytes.size());
+      flushed += bytes.size();
+      return;
+    }
+  }
+  buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+}
+
+void PdfSerializer::integer(int64_t value) {
+  char digits[24];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  raw(std::string_view(digits, result.ptr - digits));
+}
+
+void PdfSerializer::padded(uint64_t value, int width) {
+  char digits[24];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  for (int i = result.ptr - digits; i < width; ++i)
+    put('0');
+  raw(std::string_view(digits, result.ptr - digits));
+}
+
+// The shortest fixed notation that reads back as the same double. PDF has no
+// exponent syntax and no way to write infinity or nan, so those become 0.
+void PdfSerializer::real(double value) {
+  if (!std::isfinite(value))
+    value = 0;
+  char digits[NUMBER_SPACE];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value,
+                              std::chars_format::fixed);
+  raw(std::string_view(digits, result.ptr - digits));
+}
+
+void PdfSerializer::write_string(std::string_view data) {
+  put('(');
+  for (char ch : data) {
+    if (ch == '(' || ch == ')' || ch == '\\') {
+      put('\\');
+      put(ch);
+    } else if (ch == '\r') {
+      // A bare CR in a string is read back as a LF
+      raw("\\r");
+    } else {
+      put(ch);
+    }
+  }
+  put(')');
+}
+
+void PdfSerializer::write_name(std::string_view name) {
+  if (util::name_needs_escapes(name))
+    raw(util::encode_name(name));
+  else
+    raw(name);
+}
+
+// Pairs are written in name order so the output does not depend on the order
+// names happened to be interned in
+void PdfSerializer::write_pairs(size_t base) {
+  std::sort(pairs.begin() + base, pairs.end(), [](auto a, auto b) {
+    return a->first.data < b->first.data;
+  });
+  // Indexes because nested dicts push onto the same vector
+  size_t end = pairs.size();
+  for (size_t i = base; i < end; ++i) {
+    write_name(pairs[i]->first.data);
+    put(' ');
+    write(*pairs[i]->second);
+    put(' ');
+  }
+  pairs.resize(base);
+}
+
+void PdfSerializer::write_dict(const util::PdfDict &dict) {
+  size_t base = pairs.size();
+  for (auto &p : dict.pairs)
+    pairs.push_back(&p);
+  raw("<< ");
+  write_pairs(base);
+  raw(">>");
+}
+
+void PdfSerializer::write_stream(const util::PdfDict &dict,
+                                 std::string_view payload,
+                                 const util::PdfObj *filter) {
+  size_t base = pairs.size();
+  for (auto &p : dict.pairs) {
+    if (p.first.atom == atom::Length ||
+        (filter != nullptr && p.first.atom == atom::Filter))
+      continue;
+    pairs.push_back(&p);
+  }
+  raw("<< ");
+  write_pairs(base);
+  if (filter != nullptr) {
+    raw("/Filter ");
+    write(*filter);
+    put(' ');
+  }
+  raw("/Length ");
+  integer(payload.size());
+  raw(" >>\nstream\n");
+  raw(payload);
+  raw("\nendstream\n");
+}
+
+void PdfSerializer::write(const util::PdfObj &obj) {
+  switch (obj.type) {
+  case util::PdfType::Null:
+    raw("null");
+    break;
+  case util::PdfType::Bool:
+    raw(obj.as<util::PdfBool>()->data ? "true" : "false");
+    break;
+  case util::PdfType::Int:
+    integer(obj.as<util::PdfInt>()->data);
+    break;
+  case util::PdfType::Real:
+    real(obj.as<util::PdfReal>()->data);
+    break;
+  case util::PdfType::Name:
+    write_name(obj.as<util::PdfName>()->data);
+    break;
+  case util::PdfType::String:
+    write_string(obj.as<util::PdfString>()->data);
+    break;
+  case util::PdfType::Ref: {
+    const util::PdfRef *ref = obj.as<util::PdfRef>();
+    integer(ref->num);
+    put(' ');
+    integer(ref->gen);
+    raw(" R");
+    break;
+  }
+  case util::PdfType::Array:
+    raw("[ ");
+    for (const util::PdfObj *item : obj.as<util::PdfArray>()->objects) {
+      write(*item);
+      put(' ');
+    }
+    put(']');
+    break;
+  case util::PdfType::Dict:
+    write_dict(*obj.as<util::PdfDict>());
+    break;
+  case util::PdfType::Stream: {
+    const util::PdfStream *stream = obj.as<util::PdfStream>();
+    write_dict(*stream->dict);
+    raw("\nstream\n");
+    raw(stream->bytes());
+    raw("\nendstream\n");
+    break;
+  }
+  case util::PdfType::TopLevel: {
+    const util::PdfTopLevel *top = obj.as<util::PdfTopLevel>();
+    integer(top->num);
+    put(' ');
+    integer(top->gen);
+    raw(" obj\n");
+    write(*top->obj);
+    raw("\nendobj\n");
+    break;
+  }
+  }
+}
+
+// The same syntax for a graph value, except dict keys stay in parse order
+void PdfSerializer::write(const PdfGraph &graph, const PdfValue &value) {
+  switch (value.type) {
+  case util::PdfType::Null:
+    raw("null");
+    break;
+  case util::PdfType::Bool:
+    raw(value.boolean ? "true" : "false");
+    break;
+  case util::PdfType::Int:
+    integer(value.integer);
+    break;
+  case util::PdfType::Real:
+    real(value.real);
+    break;
+  case util::PdfType::Name:
+    write_name(value.str());
+    break;
+  case util::PdfType::String:
+    write_string(value.str());
+    break;
+  case util::PdfType::Ref:
+    integer(value.integer);
+    put(' ');
+    integer(value.gen);
+    raw(" R");
+    break;
+  case util::PdfType::Array:
+    raw("[ ");
+    for (const PdfValue &item : graph.array(value)) {
+      write(graph, item);
+      put(' ');
+    }
+    put(']');
+    break;
+  case util::PdfType::Dict: {
+    PdfDictValue pairs = graph.dict(value);
+    raw("<< ");
+    for (size_t i = 0; i < pairs.size; ++i) {
+      write_name(pairs.key(i).str());
+      put(' ');
+      write(graph, pairs.value(i));
+      put(' ');
+    }
+    raw(">>");
+    break;
+  }
+  case util::PdfType::Stream: {
+    PdfStreamValue stream = graph.stream(value);
+    write(graph, stream.dict);
+    raw("\nstream\n");
+    raw(stream.payload);
+    raw("\nendstream\n");
+    break;
+  }
+  case util::PdfType::TopLevel: {
+    PdfObjectValue top = graph.object(value);
+    integer(top.num);
+    put(' ');
+    integer(top.gen);
+    raw(" obj\n");
+    write(graph, top.value);
+    raw("\nendobj\n");
+    break;
+  }
+  }
+}
+
+// PdfObj::write is usually one object at a time, so it does not need the big
+// buffer a whole document does
+const size_t WRITE_OBJ_BUFFER_SIZE = 4096;
+
+void util::write_obj(std::ostream &os, const PdfObj &obj) {
+  PdfSerializer serializer(os, WRITE_OBJ_BUFFER_SIZE);
+  serializer.write(obj);
+}
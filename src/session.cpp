@@ -0,0 +1,128 @@
+#include "session.h"
+#include "document_info.h"
+#include "inflate_backend.h"
+#include "sidecar.h"
+#include <stdexcept>
+
+// Blocks up to this size are pooled, bigger ones go straight to the heap.
+// Object arenas start at 1KB and double, so this covers all but the biggest.
+const size_t SESSION_POOLED_BLOCK = 1024 * 1024;
+
+struct Document::State {
+  InputSource source; // before the parser, which refers to its bytes
+  PdfParser parser;
+  std::unique_ptr<PageTree> tree;
+
+  State(InputSource src, std::pmr::memory_resource *memory, size_t budget)
+      : source(std::move(src)), parser(source.bytes(), memory, budget) {}
+};
+
+// Session ////////////////////////////////////////////////////////////////////
+
+Session::Session() : Session(Options()) {}
+
+Session::Session(const Options &options)
+    : settings(options),
+      blocks(std::pmr::pool_options{0, SESSION_POOLED_BLOCK}),
+      workers(options.threads) {
+  InflatePool::global().reserve(workers.size());
+}
+
+Session::~Session() = default;
+
+Document Session::open(const std::string &path) {
+  return adopt(InputSource::open(path), path);
+}
+
+Document Session::open(std::istream &is) {
+  return adopt(InputSource::read(is), std::string());
+}
+
+Document Session::view(std::string_view bytes) {
+  return adopt(InputSource::view(bytes), std::string());
+}
+
+Document Session::adopt(InputSource source, const std::string &path) {
+  auto state = std::make_unique<Document::State>(std::move(source), &blocks,
+                                                 settings.cache_budget);
+  if (settings.sidecars && !path.empty())
+    open_with_sidecar(state->parser, path);
+  return Document(this, std::move(state));
+}
+
+// Document ///////////////////////////////////////////////////////////////////
+
+Document::Document(Session *s, std::unique_ptr<State> st)
+    : session(s), state(std::move(st)) {
+  ++session->open_count;
+}
+
+Document::Document(Document &&other) noexcept
+    : session(other.session), state(std::move(other.state)) {}
+
+Document &Document::operator=(Document &&other) noexcept {
+  if (this != &other) {
+    close();
+    session = other.session;
+    state = std::move(other.state);
+  }
+  return *this;
+}
+
+Document::~Document() { close(); }
+
+void Document::close() {
+  if (state == nullptr)
+    return;
+  state.reset();
+  --session->open_count;
+}
+
+Document::State &Document::open_state() const {
+  if (state == nullptr)
+    throw std::logic_error("Document is closed");
+  return *state;
+}
+
+ThreadPool *Document::pool_for_work() {
+  ThreadPool &pool = session->pool();
+  return pool.in_worker() ? nullptr : &pool;
+}
+
+PdfParser &Document::parser() { return open_state().parser; }
+
+std::string_view Document::bytes() const {
+  return open_state().source.bytes();
+}
+
+const PageTree &Document::pages() {
+  State &st = open_state();
+  if (st.tree == nullptr)
+    st.tree = std::make_unique<PageTree>(st.parser);
+  return *st.tree;
+}
+
+std::vector<PageError> Document::extract_text(std::ostream &os,
+                                              const PageRange &range) {
+  if (ThreadPool *pool = pool_for_work())
+    return ::extract_text(parser(), os, *pool, range);
+  return ::extract_text(parser(), os, range);
+}
+
+void Document::inflate(std::ostream &os) {
+  if (ThreadPool *pool = pool_for_work())
+    parser().parallel_inflate_to(os, *pool);
+  else
+    parser().inflate_to(os);
+}
+
+void Document::rewrite(std::ostream &os, const RewriteOptions &options) {
+  if (ThreadPool *pool = pool_for_work())
+    rewrite_document(parser(), os, *pool, options);
+  else
+    rewrite_document(parser(), os, options);
+}
+
+void Document::info(std::ostream &os) { write_info(parser(), os); }
+
+void Document::objects(std::ostream &os) { list_objects(parser(), os); }
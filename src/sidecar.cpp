@@ -0,0 +1,287 @@
+#include "sidecar.h"
+#include "input_source.h"
+#include "lexer.h"
+#include "page_tree.h"
+#include "pdf_parser.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+// Files up to this size are hashed whole
+const size_t HASH_WHOLE_LIMIT = 1024 * 1024;
+// Bytes hashed from each end of a bigger file
+const size_t HASH_EDGE_SIZE = 256 * 1024;
+// Blocks sampled between the ends and the size of each
+const size_t HASH_SAMPLES = 64;
+const size_t HASH_SAMPLE_SIZE = 4096;
+
+const char SIDECAR_SUFFIX[] = ".pdfcli-index";
+const char SIDECAR_MAGIC[8] = {'P', 'D', 'F', 'C', 'L', 'I', 'X', '\n'};
+// Written as a number and read back, a machine with the other byte order
+// sees it reversed
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+namespace {
+
+struct SidecarHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t size;
+  int64_t mtime;
+  uint64_t hash;
+  uint64_t entry_count;
+  uint64_t section_count;
+  uint64_t page_count;
+  uint64_t trailer_size;
+};
+
+// An XrefEntry with a layout that does not depend on the compiler
+struct SidecarEntry {
+  uint8_t type;
+  uint8_t unused;
+  uint16_t gen;
+  uint32_t index;
+  uint64_t offset;
+};
+
+static_assert(sizeof(SidecarHeader) == 72, "The sidecar header is 72 bytes");
+static_assert(sizeof(SidecarEntry) == 16, "Sidecar entries are 16 bytes");
+
+// FNV-1a, simple and plenty for telling versions of one file apart
+const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+uint64_t fnv_add(uint64_t hash, std::string_view bytes) {
+  for (unsigned char c : bytes) {
+    hash ^= c;
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+// Copy one array out of the mapping, moving pos past it. Returns false if the
+// file is too short to hold it.
+template <typename T>
+bool read_array(std::string_view bytes, size_t &pos, uint64_t count,
+                std::vector<T> &out) {
+  if (count > (bytes.size() - pos) / sizeof(T))
+    return false;
+  out.resize(count);
+  if (count != 0)
+    std::memcpy(out.data(), bytes.data() + pos, count * sizeof(T));
+  pos += count * sizeof(T);
+  return true;
+}
+
+util::PdfDict *parse_trailer(std::string_view text) {
+  // Not stable, so strings like the /ID are copied out of the text
+  PdfLexer lex(text, false);
+  std::unique_ptr<util::PdfObj> obj(util::parse_pdf_obj(lex));
+  if (obj->as<util::PdfDict>() == nullptr)
+    throw std::runtime_error("Parse Error: Sidecar trailer is not a dict");
+  return static_cast<util::PdfDict *>(obj.release());
+}
+
+} // namespace
+
+// Stamp //////////////////////////////////////////////////////////////////////
+
+std::vector<ByteRange> sample_ranges(uint64_t size) {
+  if (size <= HASH_WHOLE_LIMIT)
+    return {{0, size}};
+  std::vector<ByteRange> ranges{{0, HASH_EDGE_SIZE}};
+  uint64_t middle = size - 2 * HASH_EDGE_SIZE;
+  for (size_t i = 0; i < HASH_SAMPLES; ++i)
+    ranges.push_back({HASH_EDGE_SIZE + middle / HASH_SAMPLES * i,
+                      HASH_SAMPLE_SIZE});
+  ranges.push_back({size - HASH_EDGE_SIZE, HASH_EDGE_SIZE});
+  return ranges;
+}
+
+uint64_t sample_hash(std::string_view data) {
+  uint64_t size = data.size();
+  std::string_view size_bytes(reinterpret_cast<const char *>(&size),
+                              sizeof(size));
+  uint64_t hash = fnv_add(FNV_OFFSET, size_bytes);
+  for (const ByteRange &range : sample_ranges(size))
+    hash = fnv_add(hash, data.substr(range.offset, range.length));
+  return hash;
+}
+
+FileStamp FileStamp::of(const std::string &path, std::string_view data) {
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0)
+    throw std::ios_base::failure("Could not stat " + path);
+  FileStamp stamp;
+  stamp.size = data.size();
+  stamp.mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 +
+                info.st_mtim.tv_nsec;
+  stamp.hash = sample_hash(data);
+  return stamp;
+}
+
+// Sidecar ////////////////////////////////////////////////////////////////////
+
+std::string SidecarIndex::path_for(const std::string &document) {
+  return document + SIDECAR_SUFFIX;
+}
+
+SidecarIndex SidecarIndex::build(PdfParser &parser, const FileStamp &stamp) {
+  SidecarIndex index;
+  index.file_stamp = stamp;
+  const XrefTable &xref = parser.xref();
+  index.xref_entries = xref.all();
+  index.sections = xref.sections();
+  std::ostringstream trailer;
+  xref.trailer().write(trailer);
+  index.trailer = trailer.str();
+
+  // The pages are only a shortcut, the xref alone is still worth saving
+  try {
+    index.page_nums = PageTree(parser).page_numbers();
+  } catch (const std::exception &) {
+    index.page_nums.clear();
+  }
+  return index;
+}
+
+std::optional<SidecarIndex> SidecarIndex::load(const std::string &path,
+                                               const FileStamp &stamp) {
+  std::optional<InputSource> source;
+  try {
+    source.emplace(InputSource::open(path));
+  } catch (const std::ios_base::failure &) {
+    return std::nullopt;
+  }
+  std::string_view bytes = source->bytes();
+
+  SidecarHeader header;
+  if (bytes.size() < sizeof(header))
+    return std::nullopt;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (std::memcmp(header.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC)) != 0 ||
+      header.version != FORMAT_VERSION ||
+      header.byte_order != BYTE_ORDER_MARK)
+    return std::nullopt;
+  if (header.size != stamp.size || header.mtime != stamp.mtime ||
+      header.hash != stamp.hash)
+    return std::nullopt;
+
+  SidecarIndex index;
+  index.file_stamp = stamp;
+  size_t pos = sizeof(header);
+  std::vector<SidecarEntry> records;
+  std::vector<uint64_t> sections;
+  if (!read_array(bytes, pos, header.entry_count, records) ||
+      !read_array(bytes, pos, header.section_count, sections) ||
+      !read_array(bytes, pos, header.page_count, index.page_nums) ||
+      header.trailer_size != bytes.size() - pos)
+    return std::nullopt;
+
+  index.xref_entries.reserve(records.size());
+  for (const SidecarEntry &record : records) {
+    if (record.type > static_cast<uint8_t>(XrefType::Compressed))
+      return std::nullopt;
+    XrefEntry entry;
+    entry.type = static_cast<XrefType>(record.type);
+    entry.gen = record.gen;
+    entry.index = record.index;
+    entry.offset = record.offset;
+    index.xref_entries.push_back(entry);
+  }
+  index.sections.assign(sections.begin(), sections.end());
+  index.trailer.assign(bytes.substr(pos));
+
+  // Make sure the trailer parses now so apply cannot fail on it later
+  try {
+    delete parse_trailer(index.trailer);
+  } catch (const std::exception &) {
+    return std::nullopt;
+  }
+  return index;
+}
+
+void SidecarIndex::save(const std::string &path) const {
+  SidecarHeader header;
+  std::memcpy(header.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC));
+  header.version = FORMAT_VERSION;
+  header.byte_order = BYTE_ORDER_MARK;
+  header.size = file_stamp.size;
+  header.mtime = file_stamp.mtime;
+  header.hash = file_stamp.hash;
+  header.entry_count = xref_entries.size();
+  header.section_count = sections.size();
+  header.page_count = page_nums.size();
+  header.trailer_size = trailer.size();
+
+  std::vector<SidecarEntry> records;
+  records.reserve(xref_entries.size());
+  for (const XrefEntry &entry : xref_entries) {
+    SidecarEntry record{};
+    record.type = static_cast<uint8_t>(entry.type);
+    record.gen = entry.gen;
+    record.index = entry.index;
+    record.offset = entry.offset;
+    records.push_back(record);
+  }
+  std::vector<uint64_t> section_offsets(sections.begin(), sections.end());
+
+  std::string temp = path + ".tmp";
+  {
+    std::ofstream os(temp, std::ios::binary | std::ios::trunc);
+    if (!os)
+      throw std::ios_base::failure("Could not write " + temp);
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char *>(records.data()),
+             records.size() * sizeof(SidecarEntry));
+    os.write(reinterpret_cast<const char *>(section_offsets.data()),
+             section_offsets.size() * sizeof(uint64_t));
+    os.write(reinterpret_cast<const char *>(page_nums.data()),
+             page_nums.size() * sizeof(int64_t));
+    os.write(trailer.data(), trailer.size());
+    os.close();
+    if (!os) {
+      std::remove(temp.c_str());
+      throw std::ios_base::failure("Could not write " + temp);
+    }
+  }
+  if (std::rename(temp.c_str(), path.c_str()) != 0) {
+    std::remove(temp.c_str());
+    throw std::ios_base::failure("Could not write " + path);
+  }
+}
+
+void SidecarIndex::apply(PdfParser &parser) const {
+  parser.use_index(
+      XrefTable::from_entries(xref_entries, parse_trailer(trailer), sections),
+      page_nums);
+}
+
+bool open_with_sidecar(PdfParser &parser, const std::string &path,
+                       const std::string &sidecar) {
+  std::string sidecar_path =
+      sidecar.empty() ? SidecarIndex::path_for(path) : sidecar;
+  // The stamp hashes samples from all over the file, a ranged source only
+  // reads those in one batch
+  if (RangedSource *source = parser.ranged_source())
+    source->fetch(sample_ranges(source->size()));
+  FileStamp stamp = FileStamp::of(path, parser.bytes());
+  if (auto index = SidecarIndex::load(sidecar_path, stamp)) {
+    index->apply(parser);
+    return true;
+  }
+
+  SidecarIndex index = SidecarIndex::build(parser, stamp);
+  try {
+    index.save(sidecar_path);
+  } catch (const std::ios_base::failure &) {
+    // A read only directory just means no sidecar
+  }
+  index.apply(parser);
+  return false;
+}
@@ -0,0 +1,167 @@
+#include "stats.h"
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+const size_t PHASES = static_cast<size_t>(stats::Phase::COUNT);
+const size_t COUNTERS = static_cast<size_t>(stats::Counter::COUNT);
+
+// Relaxed everywhere, the totals only have to be right once the work is done
+struct Totals {
+  std::atomic<bool> on{false};
+  std::atomic<uint64_t> calls[PHASES] = {};
+  std::atomic<uint64_t> nanoseconds[PHASES] = {};
+  std::atomic<uint64_t> counters[COUNTERS] = {};
+  std::atomic<uint64_t> objects[stats::OBJECT_TYPES] = {};
+};
+
+Totals &totals() {
+  static Totals t;
+  return t;
+}
+
+std::string seconds(uint64_t nanoseconds) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.6f", nanoseconds / 1e9);
+  return text;
+}
+
+} // namespace
+
+void stats::enable(bool on) {
+  totals().on.store(on, std::memory_order_relaxed);
+}
+
+bool stats::enabled() { return totals().on.load(std::memory_order_relaxed); }
+
+void stats::reset() {
+  Totals &t = totals();
+  for (auto &c : t.calls)
+    c.store(0, std::memory_order_relaxed);
+  for (auto &n : t.nanoseconds)
+    n.store(0, std::memory_order_relaxed);
+  for (auto &c : t.counters)
+    c.store(0, std::memory_order_relaxed);
+  for (auto &o : t.objects)
+    o.store(0, std::memory_order_relaxed);
+}
+
+void stats::add(Counter counter, uint64_t n) {
+  totals().counters[static_cast<size_t>(counter)].fetch_add(
+      n, std::memory_order_relaxed);
+}
+
+void stats::add_object(util::PdfType type) {
+  totals().objects[static_cast<size_t>(type)].fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+void stats::add_time(Phase phase, uint64_t nanoseconds) {
+  size_t i = static_cast<size_t>(phase);
+  totals().calls[i].fetch_add(1, std::memory_order_relaxed);
+  totals().nanoseconds[i].fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+stats::Snapshot stats::snapshot() {
+  Totals &t = totals();
+  Snapshot snap;
+  for (size_t i = 0; i < PHASES; ++i) {
+    snap.calls[i] = t.calls[i].load(std::memory_order_relaxed);
+    snap.nanoseconds[i] = t.nanoseconds[i].load(std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < COUNTERS; ++i)
+    snap.counters[i] = t.counters[i].load(std::memory_order_relaxed);
+  for (size_t i = 0; i < OBJECT_TYPES; ++i)
+    snap.objects[i] = t.objects[i].load(std::memory_order_relaxed);
+  return snap;
+}
+
+const char *stats::phase_name(Phase phase) {
+  switch (phase) {
+  case Phase::XrefLoad:
+    return "xref_load";
+  case Phase::ObjectParse:
+    return "object_parse";
+  case Phase::FilterDecode:
+    return "filter_decode";
+  case Phase::OutputWrite:
+    return "output_write";
+  case Phase::RangeFetch:
+    return "range_fetch";
+  default:
+    return "unknown";
+  }
+}
+
+const char *stats::counter_name(Counter counter) {
+  switch (counter) {
+  case Counter::BytesRead:
+    return "bytes_read";
+  case Counter::BytesInflated:
+    return "bytes_inflated";
+  case Counter::CacheHits:
+    return "cache_hits";
+  case Counter::CacheMisses:
+    return "cache_misses";
+  case Counter::RangeReads:
+    return "range_reads";
+  default:
+    return "unknown";
+  }
+}
+
+void stats::write_table(std::ostream &os, const Snapshot &snap) {
+  char line[80];
+  std::snprintf(line, sizeof(line), "%-16s %12s %14s\n", "phase", "calls",
+                "seconds");
+  os << line;
+  for (size_t i = 0; i < PHASES; ++i) {
+    std::snprintf(line, sizeof(line), "%-16s %12llu %14s\n",
+                  phase_name(static_cast<Phase>(i)),
+                  static_cast<unsigned long long>(snap.calls[i]),
+                  seconds(snap.nanoseconds[i]).c_str());
+    os << line;
+  }
+
+  std::snprintf(line, sizeof(line), "\n%-16s %27s\n", "counter", "value");
+  os << line;
+  for (size_t i = 0; i < COUNTERS; ++i) {
+    std::snprintf(line, sizeof(line), "%-16s %27llu\n",
+                  counter_name(static_cast<Counter>(i)),
+                  static_cast<unsigned long long>(snap.counters[i]));
+    os << line;
+  }
+
+  std::snprintf(line, sizeof(line), "\n%-16s %27s\n", "objects", "count");
+  os << line;
+  for (size_t i = 0; i < OBJECT_TYPES; ++i) {
+    std::snprintf(line, sizeof(line), "%-16s %27llu\n",
+                  util::type_name(static_cast<util::PdfType>(i)),
+                  static_cast<unsigned long long>(snap.objects[i]));
+    os << line;
+  }
+}
+
+void stats::write_json(std::ostream &os, const Snapshot &snap) {
+  os << "{\n  \"phases\": {";
+  for (size_t i = 0; i < PHASES; ++i) {
+    os << (i == 0 ? "\n" : ",\n") << "    \""
+       << phase_name(static_cast<Phase>(i)) << "\": {\"calls\": "
+       << snap.calls[i] << ", \"seconds\": " << seconds(snap.nanoseconds[i])
+       << "}";
+  }
+  os << "\n  },\n  \"counters\": {";
+  for (size_t i = 0; i < COUNTERS; ++i) {
+    os << (i == 0 ? "\n" : ",\n") << "    \""
+       << counter_name(static_cast<Counter>(i)) << "\": " << snap.counters[i];
+  }
+  os << "\n  },\n  \"objects\": {";
+  for (size_t i = 0; i < OBJECT_TYPES; ++i) {
+    os << (i == 0 ? "\n" : ",\n") << "    \""
+       << util::type_name(static_cast<util::PdfType>(i)) << "\": "
+       << snap.objects[i];
+  }
+  os << "\n  }\n}\n";
+}
@@ -0,0 +1,286 @@
+#include "text_extract.h"
+#include "content_stream.h"
+#include "filters.h"
+#include "lexer.h"
+#include "page_tree.h"
+#include "pdf_parser.h"
+#include "stats.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <stdexcept>
+
+// How many pages each thread can have extracted and waiting to be written
+const size_t EXTRACT_PAGES_PER_THREAD = 4;
+
+// A gap in a TJ array wider than this, in thousandths of the font size, is
+// taken as a space between words
+const double TJ_SPACE_GAP = 200;
+
+// Page ranges ////////////////////////////////////////////////////////////////
+
+PageRange::PageRange() : spans{{0, SIZE_MAX}} {}
+
+namespace {
+
+[[noreturn]] void range_error(std::string_view spec) {
+  throw std::runtime_error("Parse Error: Bad page range: " +
+                           std::string(spec));
+}
+
+// A one based page number, made zero based
+size_t page_number(std::string_view text, std::string_view spec) {
+  util::PdfNumber number;
+  if (!util::scan_pdf_number(text, number) || !number.is_int ||
+      number.integer < 1 || text[0] == '+' || text[0] == '-')
+    range_error(spec);
+  return static_cast<size_t>(number.integer - 1);
+}
+
+} // namespace
+
+PageRange PageRange::parse(std::string_view spec) {
+  PageRange range;
+  range.spans.clear();
+  size_t start = 0;
+  while (start <= spec.size()) {
+    size_t comma = spec.find(',', start);
+    if (comma == std::string_view::npos)
+      comma = spec.size();
+    std::string_view part = spec.substr(start, comma - start);
+    if (part.empty())
+      range_error(spec);
+
+    size_t dash = part.find('-');
+    if (dash == std::string_view::npos) {
+      size_t page = page_number(part, spec);
+      range.spans.emplace_back(page, page);
+    } else {
+      size_t first = page_number(part.substr(0, dash), spec);
+      std::string_view rest = part.substr(dash + 1);
+      size_t last = rest.empty() ? SIZE_MAX : page_number(rest, spec);
+      if (last < first)
+        range_error(spec);
+      range.spans.emplace_back(first, last);
+    }
+    start = comma + 1;
+  }
+  return range;
+}
+
+// Content text ///////////////////////////////////////////////////////////////
+
+namespace {
+
+class TextWriter {
+public:
+  void show(const PdfToken &token) {
+    if (token.type == PdfTokenType::String)
+      text += util::decode_literal_string(token.text);
+    else if (token.type == PdfTokenType::HexString)
+      text += util::decode_hex_string(token.text);
+    else
+      return;
+    line_has_text = true;
+  }
+  void space() {
+    if (line_has_text && text.back() != ' ')
+      text += ' ';
+  }
+  void new_line() {
+    if (line_has_text)
+      text += '\n';
+    line_has_text = false;
+  }
+  std::string finish() {
+    new_line();
+    return std::move(text);
+  }
+
+private:
+  std::string text;
+  bool line_has_text = false;
+};
+
+} // namespace
+
+std::string content_text(std::string_view content) {
+  TextWriter out;
+  double line_y = 0;
+  ContentLexer lex(content);
+  lex.for_each([&](const ContentOp &op) {
+    std::string_view name = op.op;
+    if (name == "Tj" && op.count >= 1) {
+      out.show(op[op.count - 1]);
+    } else if (name == "'" || name == "\"") {
+      out.new_line();
+      if (op.count >= 1)
+        out.show(op[op.count - 1]);
+    } else if (name == "TJ") {
+      for (const PdfToken &item : op) {
+        if (item.type == PdfTokenType::Int || item.type == PdfTokenType::Real) {
+          double gap = item.type == PdfTokenType::Int
+                           ? static_cast<double>(item.integer)
+                           : item.real;
+          if (-gap > TJ_SPACE_GAP)
+            out.space();
+        } else {
+          out.show(item);
+        }
+      }
+    } else if ((name == "Td" || name == "TD") && op.count == 2) {
+      if (op.number(1) != 0)
+        out.new_line();
+      else if (op.number(0) > 0)
+        out.space();
+    } else if (name == "Tm" && op.count == 6) {
+      if (op.number(5) != line_y)
+        out.new_line();
+      line_y = op.number(5);
+    } else if (name == "T*" || name == "ET") {
+      out.new_line();
+    }
+  });
+  return out.finish();
+}
+
+// Extraction /////////////////////////////////////////////////////////////////
+
+namespace {
+
+using ObjHandle = std::shared_ptr<const util::PdfObj>;
+
+// The content streams of a page, loaded on the calling thread because the
+// parser is not thread safe. A page can have one stream or an array of them.
+std::vector<ObjHandle> page_contents(PdfParser &parser,
+                                     const PageTree::Page &page) {
+  std::vector<ObjHandle> streams;
+  ObjHandle contents =
+      parser.resolve(page.dict().pairs.get(atom::Contents));
+  if (contents == nullptr)
+    return streams;
+  if (const util::PdfArray *parts = contents->as<util::PdfArray>()) {
+    for (const util::PdfObj *part : parts->objects) {
+      ObjHandle stream = parser.resolve(part);
+      if (stream != nullptr && stream->as<util::PdfStream>() != nullptr)
+        streams.push_back(stream);
+    }
+  } else if (contents->as<util::PdfStream>() != nullptr) {
+    streams.push_back(contents);
+  }
+  return streams;
+}
+
+// A page with everything it refers to fetched in a few batches when the
+// parser reads through a ranged source
+PageTree::Page fetched_page(PdfParser &parser, const PageTree &pages,
+                            size_t index) {
+  PageTree::Page page = pages.page(index);
+  parser.prefetch_closure({page.obj->num});
+  return page;
+}
+
+// The text of a page, or why there is none
+struct PageText {
+  std::string text;
+  std::string error;
+};
+
+// The objects only need reading here, which is safe from any thread as long as
+// the handles keep them alive
+PageText page_text(const std::vector<ObjHandle> &streams) {
+  try {
+    std::string content;
+    for (const ObjHandle &obj : streams) {
+      std::vector<char> decoded =
+          util::decode_stream(*obj->as<util::PdfStream>());
+      content.append(decoded.begin(), decoded.end());
+      // The streams of a page are one content stream split up, and a token
+      // can not run across the join
+      content += '\n';
+    }
+    return PageText{content_text(content), ""};
+  } catch (const std::runtime_error &e) {
+    return PageText{"", e.what()};
+  }
+}
+
+// Load a page's content streams, or say why they could not be loaded. The
+// page itself comes from the tree, and the tree being broken is not caught.
+std::vector<ObjHandle> load_contents(PdfParser &parser,
+                                     const PageTree &pages, size_t index,
+                                     std::string &error) {
+  PageTree::Page page = fetched_page(parser, pages, index);
+  try {
+    return page_contents(parser, page);
+  } catch (const std::runtime_error &e) {
+    error = e.what();
+    return {};
+  }
+}
+
+} // namespace
+
+std::vector<PageError> extract_text(PdfParser &parser, std::ostream &os,
+                                    ThreadPool &pool, const PageRange &range) {
+  PageTree pages(parser);
+  const size_t window = pool.size() * EXTRACT_PAGES_PER_THREAD;
+  std::deque<std::pair<size_t, std::future<PageText>>> pending;
+  std::vector<PageError> errors;
+
+  auto write_front = [&] {
+    PageText page = pending.front().second.get();
+    if (!page.error.empty())
+      errors.push_back({pending.front().first + 1, page.error});
+    pending.pop_front();
+    PDF_STATS_SCOPE(OutputWrite);
+    os << page.text << '\f';
+  };
+
+  for (const auto &[first, last] : range.ranges()) {
+    for (size_t index = first; index <= last && index < pages.count();
+         ++index) {
+      std::string error;
+      std::vector<ObjHandle> streams =
+          load_contents(parser, pages, index, error);
+      pending.emplace_back(
+          index, pool.submit([streams = std::move(streams), error] {
+            return error.empty() ? page_text(streams) : PageText{"", error};
+          }));
+      // Write whatever is already done so the output starts with the first
+      // page, and wait once too many pages are in flight
+      while (!pending.empty() &&
+             (pending.size() >= window ||
+              pending.front().second.wait_for(std::chrono::seconds(0)) ==
+                  std::future_status::ready))
+        write_front();
+    }
+  }
+  while (!pending.empty())
+    write_front();
+  os.flush();
+  return errors;
+}
+
+std::vector<PageError> extract_text(PdfParser &parser, std::ostream &os,
+                                    const PageRange &range) {
+  PageTree pages(parser);
+  std::vector<PageError> errors;
+  for (const auto &[first, last] : range.ranges()) {
+    for (size_t index = first; index <= last && index < pages.count();
+         ++index) {
+      std::string error;
+      std::vector<ObjHandle> streams =
+          load_contents(parser, pages, index, error);
+      PageText page = error.empty() ? page_text(streams) : PageText{"", error};
+      if (!page.error.empty())
+        errors.push_back({index + 1, page.error});
+      PDF_STATS_SCOPE(OutputWrite);
+      os << page.text << '\f';
+    }
+  }
+  os.flush();
+  return errors;
+}
@@ -0,0 +1,93 @@
+#include "thread_pool.h"
+
+namespace {
+
+// Which pool and queue the current thread works for, so tasks that submit more
+// work can keep it on their own queue
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local size_t current_queue = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t threads) {
+  if (threads == 0)
+    threads = default_threads();
+  for (size_t i = 0; i < threads; ++i)
+    queues.push_back(std::make_unique<Queue>());
+  for (size_t i = 0; i < threads; ++i)
+    workers.emplace_back([this, i]() { run(i); });
+}
+
+bool ThreadPool::in_worker() const { return current_pool == this; }
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+size_t ThreadPool::default_threads() {
+  size_t cores = std::thread::hardware_concurrency();
+  return cores > 0 ? cores : 1;
+}
+
+void ThreadPool::push(Task task) {
+  size_t index = current_pool == this
+                     ? current_queue
+                     : next_queue.fetch_add(1) % queues.size();
+  {
+    // Counted under the wake lock so a worker can not miss it between checking
+    // and going to sleep, and before the task is queued so a worker that takes
+    // it straight away can not bring the count below zero
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    ++pending;
+  }
+  {
+    std::lock_guard<std::mutex> lock(queues[index]->mutex);
+    queues[index]->tasks.push_back(std::move(task));
+  }
+  wake.notify_one();
+}
+
+bool ThreadPool::pop(size_t index, Task &task) {
+  {
+    Queue &own = *queues[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues.size(); ++i) {
+    Queue &other = *queues[(index + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(other.mutex);
+    if (!other.tasks.empty()) {
+      task = std::move(other.tasks.front());
+      other.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::run(size_t index) {
+  current_pool = this;
+  current_queue = index;
+  while (true) {
+    Task task;
+    if (pop(index, task)) {
+      --pending;
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    wake.wait(lock, [this]() { return stopping || pending > 0; });
+    if (stopping && pending == 0)
+      return;
+  }
+}
@@ -1,12 +1,22 @@
 #include "utility.h"
+#include "arena.h"
+#include "inflate_backend.h"
+#include "input_source.h"
+#include "lexer.h"
+#include "pdf_events.h"
+#include "stats.h"
 #include <cctype>
 #include <fstream>
 #include <ios>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <stdexcept>
-#include <zlib.h>
 
-const size_t BUFF_SIZE = 1024;
+// Decompressed sizes are guessed from the compressed size when there is no
+// hint, up to a limit
+const size_t INFLATE_RATIO_GUESS = 4;
+const size_t INFLATE_MAX_HINT = 64 * 1024 * 1024;
 
 size_t util::bytes_till_end(std::istream &is) {
   // Save current position
@@ -47,66 +57,217 @@ std::vector<char> util::slurp_bytes(const std::string &filename) {
 // TODO try to make this as robust as possible. It passes a test on a file
 // bigger than the buffer size, but I could add tests for bad data etc. and
 // ensure that all of my bounds etc. cannot fail.
-std::vector<char> util::inflate_stream(std::istream &is, std::streamoff size) {
+// The buffers and the zlib state come from the inflate pool now, so there is
+// no inflateInit for each stream and the buffers are much bigger than the 1KB
+// ones on the stack were.
+std::vector<char> util::inflate_stream(std::istream &is, std::streamoff size,
+                                       size_t size_hint) {
   std::vector<char> contents;
+  if (size <= 0)
+    return contents;
+  if (size_hint == 0)
+    size_hint = std::min<size_t>(size * INFLATE_RATIO_GUESS, INFLATE_MAX_HINT);
+  contents.reserve(size_hint);
 
   // save the position in the stream
   std::streampos initial = is.tellg();
-  std::streampos end = initial + size;
-  std::streampos current = initial;
-
-  // Create buffers and how much it holds
-  char in_buffer[BUFF_SIZE];
-  char out_buffer[BUFF_SIZE];
-
-  // Initialize the decompression stream
-  z_stream strm;
-  strm.zalloc = Z_NULL;
-  strm.zfree = Z_NULL;
-  strm.opaque = Z_NULL;
-  strm.avail_in = 0;
-  strm.next_in = Z_NULL;
-  // TODO check return for errors
-  inflateInit(&strm);
+  std::streamoff left = size;
+
+  InflatePool::Lease context = InflatePool::global().acquire();
+  std::vector<char> &in_buffer = context->in;
+  std::vector<char> &out_buffer = context->out;
+  bool done = false;
 
   // Process the file stream in chunks until we reach the desired offset
-  while (current < end) {
-    // Find the new position in the stream and read chars into the input buffer
-    current = is.tellg();
-    size_t chars_to_read =
-        end - current < BUFF_SIZE ? end - current : BUFF_SIZE;
-    is.read(in_buffer, chars_to_read);
-    size_t chars_read = is.tellg() - current;
-    if (chars_read == 0) {
+  while (left > 0 && !done) {
+    size_t chars_to_read = std::min<std::streamoff>(
+        left, static_cast<std::streamoff>(in_buffer.size()));
+    is.read(in_buffer.data(), chars_to_read);
+    size_t chars_read = is.gcount();
+    if (chars_read == 0)
       break;
-    }
-
-    strm.next_in = reinterpret_cast<Bytef *>(in_buffer);
-    strm.avail_in = chars_read;
+    left -= chars_read;
 
     // Loop to decode the contents, we need to loop again because the
     // decompressed contents will be larger than the input.
-    do {
-      strm.next_out = reinterpret_cast<Bytef *>(out_buffer);
-      strm.avail_out = BUFF_SIZE;
-
-      // TODO Check return for errors
-      int ret = inflate(&strm, Z_NO_FLUSH);
-
-      size_t chars_decoded = BUFF_SIZE - strm.avail_out;
-      contents.insert(contents.end(), out_buffer, out_buffer + chars_decoded);
-    } while (strm.avail_out == 0);
+    std::string_view in(in_buffer.data(), chars_read);
+    while (true) {
+      size_t produced = 0;
+      InflateState::Status status = context->state.inflate(
+          in, out_buffer.data(), out_buffer.size(), produced);
+      contents.insert(contents.end(), out_buffer.data(),
+                      out_buffer.data() + produced);
+      if (status != InflateState::Ok) {
+        done = true;
+        break;
+      }
+      if (in.empty() && produced < out_buffer.size())
+        break;
+    }
   }
 
-  // Clean up
-  inflateEnd(&strm);
+  is.clear();
   is.seekg(initial);
-
   return contents;
 }
 
 // Prototypes /////////////////////////////////////////////////////////////////
 
+// Small dicts are scanned, bigger ones are binary searched
+const size_t NAME_MAP_SCAN_SIZE = 8;
+
+size_t util::PdfNameMap::lower_bound(PdfAtom key) const {
+  if (keys.size() <= NAME_MAP_SCAN_SIZE) {
+    size_t i = 0;
+    while (i < keys.size() && keys[i] < key)
+      ++i;
+    return i;
+  }
+  return std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+}
+
+util::PdfObj *&util::PdfNameMap::operator[](const PdfName &key) {
+  return emplace(key, nullptr).first->second;
+}
+
+std::pair<util::PdfNameMap::iterator, bool>
+util::PdfNameMap::emplace(const PdfName &key, PdfObj *obj) {
+  size_t i = lower_bound(key.atom);
+  if (i < keys.size() && keys[i] == key.atom)
+    return {entries.begin() + i, false};
+  keys.insert(keys.begin() + i, key.atom);
+  auto it = entries.insert(entries.begin() + i, value_type(key, obj));
+  return {it, true};
+}
+
+util::PdfNameMap::iterator util::PdfNameMap::find(PdfAtom key) {
+  size_t i = lower_bound(key);
+  if (i < keys.size() && keys[i] == key)
+    return entries.begin() + i;
+  return entries.end();
+}
+
+util::PdfNameMap::const_iterator util::PdfNameMap::find(PdfAtom key) const {
+  size_t i = lower_bound(key);
+  if (i < keys.size() && keys[i] == key)
+    return entries.begin() + i;
+  return entries.end();
+}
+
+util::PdfObj *util::PdfNameMap::get(PdfAtom key) const {
+  auto it = find(key);
+  return it == end() ? nullptr : it->second;
+}
+
+util::PdfObj *util::PdfNameMap::at(const PdfName &key) const {
+  auto it = find(key);
+  if (it == end())
+    throw std::out_of_range("Dict has no key " + std::string(key.data));
+  return it->second;
+}
+
+util::PdfNameMap::iterator util::PdfNameMap::erase(iterator it) {
+  keys.erase(keys.begin() + (it - entries.begin()));
+  return entries.erase(it);
+}
+
+// Every PdfObj allocation is preceded by a header that says which arena it came
+// from, or null for the heap, so delete knows whether it has anything to free.
+namespace {
+struct alignas(std::max_align_t) AllocHeader {
+  Arena *arena;
+};
+} // namespace
+
+void *util::PdfObj::operator new(size_t size) {
+  void *block = ::operator new(sizeof(AllocHeader) + size);
+  static_cast<AllocHeader *>(block)->arena = nullptr;
+  return static_cast<AllocHeader *>(block) + 1;
+}
+
+void *util::PdfObj::operator new(size_t size, Arena &arena) {
+  void *block = arena.allocate(sizeof(AllocHeader) + size,
+                               alignof(AllocHeader));
+  static_cast<AllocHeader *>(block)->arena = &arena;
+  return static_cast<AllocHeader *>(block) + 1;
+}
+
+void util::PdfObj::operator delete(void *p) {
+  if (p == nullptr)
+    return;
+  AllocHeader *header = static_cast<AllocHeader *>(p) - 1;
+  if (header->arena == nullptr)
+    ::operator delete(header);
+}
+
+// Only called when a constructor throws during new (arena), the arena keeps
+// the memory either way.
+void util::PdfObj::operator delete(void *, Arena &) {}
+
+// Deep comparison, switching on the tag. Dict keys can be in any order.
+bool util::PdfObj::operator==(const PdfObj &other) const {
+  if (type != other.type)
+    return false;
+  switch (type) {
+  case PdfType::Null:
+    return true;
+  case PdfType::Bool:
+    return static_cast<const PdfBool *>(this)->data ==
+           static_cast<const PdfBool &>(other).data;
+  case PdfType::Int:
+    return static_cast<const PdfInt *>(this)->data ==
+           static_cast<const PdfInt &>(other).data;
+  case PdfType::Real:
+    return static_cast<const PdfReal *>(this)->data ==
+           static_cast<const PdfReal &>(other).data;
+  case PdfType::Name:
+    return static_cast<const PdfName *>(this)->atom ==
+           static_cast<const PdfName &>(other).atom;
+  case PdfType::String:
+    return static_cast<const PdfString *>(this)->data ==
+           static_cast<const PdfString &>(other).data;
+  case PdfType::Ref: {
+    auto a = static_cast<const PdfRef *>(this);
+    auto &b = static_cast<const PdfRef &>(other);
+    return a->num == b.num && a->gen == b.gen;
+  }
+  case PdfType::Array: {
+    auto &a = static_cast<const PdfArray *>(this)->objects;
+    auto &b = static_cast<const PdfArray &>(other).objects;
+    if (a.size() != b.size())
+      return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+      if (*a[i] != *b[i])
+        return false;
+    }
+    return true;
+  }
+  case PdfType::Dict: {
+    auto &a = static_cast<const PdfDict *>(this)->pairs;
+    auto &b = static_cast<const PdfDict &>(other).pairs;
+    if (a.size() != b.size())
+      return false;
+    for (const auto &[key, value] : a) {
+      const PdfObj *match = b.get(key.atom);
+      if (match == nullptr || *match != *value)
+        return false;
+    }
+    return true;
+  }
+  case PdfType::Stream: {
+    auto a = static_cast<const PdfStream *>(this);
+    auto &b = static_cast<const PdfStream &>(other);
+    return *a->dict == *b.dict && a->bytes() == b.bytes();
+  }
+  case PdfType::TopLevel: {
+    auto a = static_cast<const PdfTopLevel *>(this);
+    auto &b = static_cast<const PdfTopLevel &>(other);
+    return a->num == b.num && a->gen == b.gen && *a->obj == *b.obj;
+  }
+  }
+  return false;
+}
+
 std::ostream &util::operator<<(std::ostream &os, const util::PdfObj &obj) {
   obj.write(os);
   return os;
@@ -132,164 +293,331 @@ std::ostream &util::operator<<(std::ostream &os,
 // 3 objects could make up a coposite object probably move the stream back
 // before returning if the first object is all we need.
 
-// NOTE while parsing we do not need a function to skip whitespace, unless we
-// want special behaviour. is >> in will skip whitespace and is.get(in) will
-// grab whitespace. So anywhere where whitespace ends a token or can be
-// included in a token, like strings and names, you have to use get to ensure
-// you can accurately test for whitespace.
 
-util::PdfObj *util::parse_pdf_obj(std::istream &is) {
-  // TODO replace the switch with if statments so that local variables can
-  // be initialized in the blocks rather than shared, and to help prevent
-  // errors like the one I had parsing names where code jumped up the switch.
-  // TODO make sure to deal with EOF in all the parsing functions
-  // TODO instead of collecting characters and then calling is.unget() I think
-  // it might be better to use is.peek(). It is possible that either is fine,
-  // but there is always a danger of calling unget too many times, and by
-  // using peek we can write logic that checks the next char and allows a
-  // separate function to fully parse the token expecting that the first char
-  // is the first char, making them usable in different contexts.
-  // TODO extract as much parsing logic as is possible into separate functions
-  // to tame the length and unruliness of this function. It is also nice to be
-  // able to call all individual parsing functions in other contexts, were we
-  // to want to parse each object type specifically.
-  char in;
-  std::string token;
-  size_t len;
+// NOTE the parsing functions are built on PdfLexer, which works on a buffer
+// rather than a stream. The istream versions are kept as thin adapters so
+// existing callers still work. They lex straight out of the memory when the
+// stream is a SpanStream, otherwise they read what is left of the stream into
+// a buffer, parse from that, and seek the stream back to just after the object
+// that was parsed. For large inputs prefer a SpanStream or a PdfLexer.
+
+namespace {
+
+// Run a lexer based parse on an istream and leave the stream positioned just
+// after whatever was consumed.
+template <typename Parse>
+auto parse_from_stream(std::istream &is, Parse parse) -> decltype(parse(
+    std::declval<PdfLexer &>())) {
+  if (auto span = dynamic_cast<SpanStreamBuf *>(is.rdbuf())) {
+    PdfLexer lex(span->remaining());
+    auto result = parse(lex);
+    span->advance(lex.position());
+    return result;
+  }
 
-  is >> in;
-  token.push_back(in);
+  std::streampos begin = is.tellg();
+  std::string rest((std::istreambuf_iterator<char>(is)),
+                   std::istreambuf_iterator<char>());
+  is.clear();
 
-  switch (in) {
-  case 'n': // should start a null object
-    for (size_t i = 0; i < 3; ++i) {
-      is >> in;
-      token += in;
-    }
-    if (token == "null") {
-      return new PdfNull();
-    } else {
-      throw std::runtime_error(std::string("Parse Error: Invalid PDF null: ") +
-                               token);
-    }
-  case 't': // should start bool
-  case 'f':
-    len = in == 't' ? 3 : 4;
-    for (size_t i = 0; i < len; ++i) {
-      is >> in;
-      token += in;
+  // The buffer goes away when we return so nothing can keep views into it
+  PdfLexer lex(rest, false);
+  auto result = parse(lex);
+  if (begin != std::streampos(-1))
+    is.seekg(begin + std::streamoff(lex.position()), std::ios_base::beg);
+  return result;
+}
+
+[[noreturn]] void parse_error(const std::string &msg, std::string_view got) {
+  throw std::runtime_error("Parse Error: " + msg + std::string(got));
+}
+
+// Make an object on the heap or in the arena
+template <typename T, typename... Args> T *make(Arena *arena, Args &&...args) {
+  PDF_STATS_OBJECT(T::TYPE);
+  if (arena != nullptr)
+    return new (*arena) T(std::forward<Args>(args)...);
+  return new T(std::forward<Args>(args)...);
+}
+
+std::pmr::memory_resource *resource_for(Arena *arena) {
+  return arena != nullptr ? arena : std::pmr::get_default_resource();
+}
+
+// Make a string from the raw bytes of a token. The bytes are borrowed when
+// they can be, copied into the arena when there is one, and owned otherwise.
+// Names do not need this, they always refer to the name table.
+util::PdfString *make_text(bool stable, Arena *arena, std::string_view text) {
+  if (stable)
+    return make<util::PdfString>(arena, text, util::borrowed);
+  if (arena != nullptr)
+    return make<util::PdfString>(arena, arena->copy(text), util::borrowed);
+  return make<util::PdfString>(arena, std::string(text));
+}
+
+util::PdfString *make_string(bool stable, Arena *arena, std::string_view raw,
+                             bool hex) {
+  // Most strings have no escapes and can be used as they are
+  if (!hex && raw.find_first_of("\\\r") == std::string_view::npos)
+    return make_text(stable, arena, raw);
+
+  std::string decoded =
+      hex ? util::decode_hex_string(raw) : util::decode_literal_string(raw);
+  if (arena != nullptr)
+    return make<util::PdfString>(arena, arena->copy(decoded), util::borrowed);
+  return new util::PdfString(decoded);
+}
+
+// Builds the PdfObj tree from parse events. Containers that are still open are
+// kept on a stack and each finished object is added to the one on top. If the
+// parse throws, whatever was built so far is deleted with the builder, unless
+// it is in an arena which still owns it.
+class ObjBuilder : public PdfEventHandler {
+public:
+  ObjBuilder(bool stable, Arena *arena) : stable(stable), arena(arena) {}
+  ~ObjBuilder() {
+    if (arena != nullptr)
+      return;
+    delete result;
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+      delete (it->obj != nullptr ? it->obj : it->child);
+  }
+  ObjBuilder(const ObjBuilder &) = delete;
+  ObjBuilder &operator=(const ObjBuilder &) = delete;
+
+  util::PdfObj *release() {
+    util::PdfObj *obj = result;
+    result = nullptr;
+    return obj;
+  }
+
+  void null_value() override { add(make<util::PdfNull>(arena)); }
+  void bool_value(bool b) override { add(make<util::PdfBool>(arena, b)); }
+  void int_value(int64_t i) override { add(make<util::PdfInt>(arena, i)); }
+  void real_value(double d) override { add(make<util::PdfReal>(arena, d)); }
+  void name_value(std::string_view name) override {
+    add(make<util::PdfName>(arena, name));
+  }
+  void string_value(std::string_view raw, bool hex) override {
+    add(make_string(stable, arena, raw, hex));
+  }
+  void ref_value(int64_t num, int64_t gen) override {
+    add(make<util::PdfRef>(arena, num, gen));
+  }
+
+  void begin_array() override {
+    push(make<util::PdfArray>(arena, resource_for(arena)));
+  }
+  void end_array() override { pop(); }
+
+  void begin_dict() override {
+    push(make<util::PdfDict>(arena, resource_for(arena)));
+  }
+  void key(std::string_view name) override { frames.back().key = name; }
+  void end_dict() override { pop(); }
+
+  // The dict on top of the stack turns out to be a stream dict
+  void begin_stream() override {
+    auto dict = static_cast<util::PdfDict *>(frames.back().obj);
+    frames.pop_back();
+    push(make<util::PdfStream>(arena, dict, resource_for(arena)));
+  }
+  void stream_data(std::string_view chunk) override {
+    auto stream = static_cast<util::PdfStream *>(frames.back().obj);
+    // The chunks are next to each other in a stable buffer, so the payload
+    // can just grow to cover them
+    if (!stable)
+      stream->stream.insert(stream->stream.end(), chunk.begin(), chunk.end());
+    else if (stream->payload.data() == nullptr)
+      stream->payload = chunk;
+    else
+      stream->payload = std::string_view(stream->payload.data(),
+                                         stream->payload.size() + chunk.size());
+  }
+  void end_stream() override { pop(); }
+
+  void begin_object(int64_t num, int64_t gen) override {
+    frames.push_back(Frame{nullptr, {}, num, gen, nullptr});
+  }
+  void end_object() override {
+    Frame frame = frames.back();
+    frames.pop_back();
+    add(make<util::PdfTopLevel>(arena, frame.num, frame.gen, frame.child));
+  }
+
+private:
+  // An open array, dict, or stream in obj, or an indirect object whose value
+  // ends up in child
+  struct Frame {
+    util::PdfObj *obj;
+    std::string_view key;
+    int64_t num;
+    int64_t gen;
+    util::PdfObj *child;
+  };
+
+  void push(util::PdfObj *obj) {
+    frames.push_back(Frame{obj, {}, 0, 0, nullptr});
+  }
+
+  void pop() {
+    util::PdfObj *obj = frames.back().obj;
+    frames.pop_back();
+    add(obj);
+  }
+
+  void add(util::PdfObj *obj) {
+    if (frames.empty()) {
+      result = obj;
+      return;
     }
-    if (token == "true") {
-      return new PdfBool(true);
-    } else if (token == "false") {
-      return new PdfBool(false);
+    Frame &top = frames.back();
+    if (top.obj == nullptr) {
+      top.child = obj;
+    } else if (auto arr = top.obj->as<util::PdfArray>()) {
+      arr->objects.push_back(obj);
     } else {
-      throw std::runtime_error(std::string("Parse Error: Invalid PDF bool: ") +
-                               token);
-    }
-  case '(': // should start a string
-    // TODO handle escape characters \n, \t, \r, \b, \f, \ddd (octal digits?)
-    // TODO paraenthesis in a string do not need to be escaped if they
-    //      are balanced, which we can do with a stack. But of course if one
-    //      is escaped it does not go on the stack.
-    // TODO a \ needs to be escaped also
-    token.pop_back(); // remove (
-    while (true) {
-      is.get(in);
-      if (in == ')' && !token.empty() && token.back() != '\\')
-        break;
-      token += in;
-    }
-    return new PdfString(token);
-  case '/': // should start a name
-    return new PdfName(get_name_token(is));
-  case '<': // should start a dict (we will add hex strings later)
-    // TODO extract this into a function
-    is.get(in);
-    if (in == '<') {
-      is.unget();
-      is.unget();
-      PdfDict *dict = parse_pdf_dict(is);
-      is >> in;
-      if (in == 's') {
-        is.unget();
-        std::vector<char> stream = parse_pdf_content_stream(is);
-        PdfStream *obj = new PdfStream(dict);
-        obj->stream = stream;
-        return obj;
+      // A repeated key replaces the earlier value
+      auto dict = static_cast<util::PdfDict *>(top.obj);
+      util::PdfName name(top.key);
+      auto it = dict->pairs.find(name);
+      if (it != dict->pairs.end()) {
+        delete it->second;
+        it->second = obj;
+      } else {
+        dict->pairs.emplace(name, obj);
       }
-      return dict;
-    } else if (isxdigit(in)) {
-      throw std::runtime_error(
-          std::string("Parse Error: No support for hex strings yet."));
-    } else {
-      throw std::runtime_error(
-          std::string("Parse Error: Expected < or hex digit after <, Got ") +
-          in);
     }
-  case '[': // should start an array
-    is.unget();
-    return parse_pdf_array(is);
-    break;
-  case '-': // should start a number -/+123 -/+123.456 .90 etc.
-  case '+':
-  case '.':
-    is.unget();
-    return parse_pdf_int_or_real(is);
-  case '0': // Digits start numbers, refs, or obj/endobj
-  case '1':
-  case '2':
-  case '3':
-  case '4':
-  case '5':
-  case '6':
-  case '7':
-  case '9':
-    is.unget();
-    return parse_pdf_num_ref_or_top_level(is);
-  default: // if we see anything else it is an error in the doc or the parser
-    throw std::runtime_error(
-        std::string("Parse Error: Unexpected char to start a PDF object: ") +
-        in);
   }
-  throw std::runtime_error(
-      std::string("Parse Error: Unexpected char to start a PDF object: ") + in);
+
+  bool stable;
+  Arena *arena;
+  util::PdfObj *result = nullptr;
+  std::vector<Frame> frames;
+};
+
+// Run one of the event parser's entry points into a builder
+template <typename Parse>
+util::PdfObj *build(PdfLexer &lex, Arena *arena, Parse parse) {
+  ObjBuilder builder(lex.stable(), arena);
+  PdfEventParser events(lex);
+  parse(events, builder);
+  return builder.release();
+}
+
+} // namespace
+
+// Lexer based parsing ////////////////////////////////////////////////////////
+
+util::PdfObj *util::parse_pdf_obj(PdfLexer &lex, Arena *arena) {
+  return build(lex, arena, [](PdfEventParser &events, ObjBuilder &builder) {
+    events.parse_object(builder);
+  });
+}
+
+util::PdfArray *util::parse_pdf_array(PdfLexer &lex, Arena *arena) {
+  PdfToken token = lex.next();
+  if (!token.is_delimiter("["))
+    parse_error("Arrays must start with a [, Got ", token.text);
+  return static_cast<PdfArray *>(
+      build(lex, arena, [](PdfEventParser &events, ObjBuilder &builder) {
+        events.parse_array_body(builder);
+      }));
+}
+
+util::PdfDict *util::parse_pdf_dict(PdfLexer &lex, Arena *arena) {
+  PdfToken token = lex.next();
+  if (!token.is_delimiter("<<"))
+    parse_error("Dicts must start with <<, Got ", token.text);
+  return static_cast<PdfDict *>(
+      build(lex, arena, [](PdfEventParser &events, ObjBuilder &builder) {
+        events.parse_dict_body(builder, false);
+      }));
+}
+
+util::PdfName util::parse_pdf_name_obj(PdfLexer &lex) {
+  PdfToken token = lex.next();
+  if (token.type != PdfTokenType::Name)
+    parse_error("Pdf names must start with /, Got ", token.text);
+  if (token.text.find('#') != std::string_view::npos)
+    return PdfName(decode_name(token.text));
+  return PdfName(token.text);
+}
+
+util::PdfObj *util::parse_pdf_int_or_real(PdfLexer &lex, Arena *arena) {
+  PdfToken token = lex.next();
+  if (token.type == PdfTokenType::Int)
+    return make<PdfInt>(arena, token.integer);
+  if (token.type == PdfTokenType::Real)
+    return make<PdfReal>(arena, token.real);
+  parse_error("Failed to parse an int or real from the stream: Got ",
+              token.text);
+}
+
+util::PdfObj *util::parse_pdf_num_ref_or_top_level(PdfLexer &lex,
+                                                   Arena *arena) {
+  PdfToken token = lex.next();
+  if (token.type == PdfTokenType::Int)
+    return build(lex, arena,
+                 [&token](PdfEventParser &events, ObjBuilder &builder) {
+                   events.parse_token(token, builder);
+                 });
+  if (token.type == PdfTokenType::Real)
+    return make<PdfReal>(arena, token.real);
+  parse_error("Failed to parse a number from the stream: Got ", token.text);
+}
+
+// Stream adapters ////////////////////////////////////////////////////////////
+
+util::PdfObj *util::parse_pdf_obj(std::istream &is) {
+  return parse_from_stream(
+      is, [](PdfLexer &lex) { return util::parse_pdf_obj(lex); });
 }
 
 util::PdfArray *util::parse_pdf_array(std::istream &is) {
-  PdfArray *arr = new PdfArray();
-  char in;
-  is >> in;
+  return parse_from_stream(
+      is, [](PdfLexer &lex) { return util::parse_pdf_array(lex); });
+}
 
-  // TODO handle EOF
-  if (in == '[') {
-    while (true) {
-      is >> in;
-      if (in == ']')
-        break;
-      is.unget();
-      PdfObj *obj = util::parse_pdf_obj(is);
-      arr->objects.push_back(obj);
-    }
-    return arr;
-  } else {
-    delete arr;
-    throw std::runtime_error(
-        std::string("Parse Error: Arrays must start with a [, Got ") + in);
-  }
+util::PdfDict *util::parse_pdf_dict(std::istream &is) {
+  return parse_from_stream(
+      is, [](PdfLexer &lex) { return util::parse_pdf_dict(lex); });
 }
 
 util::PdfName util::parse_pdf_name_obj(std::istream &is) {
-  std::string name("/");
-  char in;
-  is >> in;
-  if (in != '/')
-    throw std::runtime_error(
-        std::string("Parse Error: Pdf names must start with /, Got ") + in);
+  return parse_from_stream(
+      is, [](PdfLexer &lex) { return util::parse_pdf_name_obj(lex); });
+}
+
+util::PdfObj *util::parse_pdf_int_or_real(std::istream &is) {
+  return parse_from_stream(
+      is, [](PdfLexer &lex) { return util::parse_pdf_int_or_real(lex); });
+}
+
+util::PdfObj *util::parse_pdf_num_ref_or_top_level(std::istream &is) {
+  return parse_from_stream(is, [](PdfLexer &lex) {
+    return util::parse_pdf_num_ref_or_top_level(lex);
+  });
+}
+
+std::vector<char> util::parse_pdf_content_stream(std::istream &is,
+                                                 int64_t length) {
+  return parse_from_stream(is, [length](PdfLexer &lex) {
+    std::string_view payload = lex.stream_payload(length);
+    return std::vector<char>(payload.begin(), payload.end());
+  });
+}
 
-  return PdfName(get_name_token(is));
+std::string_view util::parse_pdf_stream_payload(SpanStreamBuf &buf,
+                                                int64_t length) {
+  PdfLexer lex(buf.remaining());
+  std::string_view payload = lex.stream_payload(length);
+  buf.advance(lex.position());
+  return payload;
 }
 
+// Char level helpers /////////////////////////////////////////////////////////
+
 std::string util::get_name_token(std::istream &is) {
   std::string token("/");
   char in;
@@ -306,198 +634,108 @@ std::string util::get_name_token(std::istream &is) {
     }
     token += in;
   }
+  if (token.find('#') != std::string::npos)
+    return decode_name(token);
   return token;
 }
 
-util::PdfDict *util::parse_pdf_dict(std::istream &is) {
-  char in, inB;
-  is >> in;
-  is.get(inB);
-  if (in == '<' && inB == '<') {
-    PdfDict *dict = new PdfDict();
-    while (true) {
-      is >> in;
-      if (in == '>') {
-        is >> in;
-        if (in == '>' || is.eof()) {
-          break;
-        } else {
-          throw std::runtime_error(
-              std::string("Parse Error: Dicts must end with >>, Got >") + in);
-        }
-      }
-      is.unget();
-      PdfName name = parse_pdf_name_obj(is);
-      PdfObj *obj = parse_pdf_obj(is);
-      dict->pairs[name] = obj;
-    }
-    return dict;
-  } else {
-    throw std::runtime_error(
-        std::string("Parse Error: Dicts must start with <<, Got ") + in + inB);
-  }
-}
-
-std::vector<char> util::parse_pdf_content_stream(std::istream &is) {
-  std::vector<char> contents;
-  std::string token;
-  char in;
-  for (size_t i = 0; i < 6; i++) {
-    is >> in;
-    token += in;
-  }
-
-  if (token != "stream") {
-    throw std::runtime_error(
-        std::string(
-            "Parse Error: Content stream must start with stream, Got ") +
-        token);
-  }
-
-  std::string line;
-  while (!is.eof()) {
-    // TODO consider if this is the right way to iterate till finding endstream
-    // The problem is that if I iterate bytes I have to manually check the next
-    // n chars at every point where I encounter something starting with any
-    // of the chars in endstream. string::find() handles this really well,
-    // except that it makes a copy of the data with getline and then copies it
-    // again into the result. If I kept track myself then I would just be
-    // peeking and copying data into the vector without copying the whole line.
-    // but it would add a bunch of if statements to the code below.
-    getline(is, line);
-    auto pos = line.find("endstream");
-    if (pos == std::string::npos) {
-      contents.insert(contents.end(), line.begin(), line.end());
+namespace {
+
+// Read the characters of a number off the stream, stopping at the first one
+// that can not be part of it so nothing has to be put back. Leading
+// whitespace is skipped like operator>> did.
+std::string read_number_chars(std::istream &is, bool allow_point) {
+  while (is.peek() != EOF &&
+         util::is_pdf_whitespace(static_cast<char>(is.peek())))
+    is.get();
+  std::string text;
+  if (is.peek() == '+' || is.peek() == '-')
+    text += static_cast<char>(is.get());
+  bool point = false;
+  while (true) {
+    int ch = is.peek();
+    if (ch >= '0' && ch <= '9') {
+      text += static_cast<char>(is.get());
+    } else if (ch == '.' && allow_point && !point) {
+      point = true;
+      text += static_cast<char>(is.get());
     } else {
-      contents.insert(contents.end(), contents.begin(), contents.begin() + pos);
       break;
     }
   }
-  return contents;
+  is.clear();
+  return text;
 }
 
+} // namespace
+
 bool util::parse_int(std::istream &is, int64_t *i) {
-  int64_t in;
-  // TODO be sure that it is better to use the stream operation to try and
-  // parse an int than to use stoi or some other method.
-  if (is >> in) {
-    *i = in;
-    return true;
-  } else {
-    is.clear();
+  PdfNumber number;
+  if (!scan_pdf_number(read_number_chars(is, false), number) ||
+      !number.is_int)
     return false;
-  }
+  *i = number.integer;
+  return true;
 }
 
 bool util::parse_double(std::istream &is, double *d) {
-  double in;
-  // TODO be sure that it is better to use the stream operation to try and
-  // parse an int than to use stoi or some other method.
-  if (is >> in) {
-    *d = in;
-    return true;
-  } else {
-    is.clear();
+  PdfNumber number;
+  if (!scan_pdf_number(read_number_chars(is, true), number))
     return false;
-  }
-}
-
-util::PdfObj *util::parse_pdf_int_or_real(std::istream &is) {
-  int64_t i;
-  double d;
-
-  // Try int first as it will happily put an int into a double
-  if (parse_int(is, &i) && (isspace(is.peek()) || is.eof())) {
-    return new PdfInt(i);
-  } else if (parse_double(is, &d) && (isspace(is.peek()) || is.eof())) {
-    return new PdfReal(d);
-  } else {
-    is.clear();
-    std::string token;
-    is >> token;
-    throw std::runtime_error(std::string("Parse Error: Failed to parse an int "
-                                         "or real from the stream: Got ") +
-                             token);
-  }
+  *d = number.is_int ? static_cast<double>(number.integer) : number.real;
+  return true;
 }
 
-util::PdfObj *util::parse_pdf_num_ref_or_top_level(std::istream &is) {
-  int64_t num;
-  double d;
-  std::streampos begin = is.tellg();
-
-  // TODO is whitespace the only valid thing to find after an int?
-  if (parse_int(is, &num) && (isspace(is.peek()) || is.eof())) {
-    int64_t gen;
-    std::streampos pos_after_num = is.tellg();
-    if (parse_int(is, &gen) && (isspace(is.peek()) || is.eof())) {
-      char ch;
-      is >> ch;
-      if (ch == 'R') {
-        return new PdfRef(num, gen);
-      } else if (ch == 'o') {
-        // check we actually have obj
-        std::string token("o");
-        for (size_t i = 0; i < 2; ++i) {
-          is >> ch;
-          token += ch;
-        }
-
-        if (token == "obj") {
-          PdfObj *obj = parse_pdf_obj(is);
-          token = "";
-          for (size_t i = 0; i < 6; i++) {
-            is >> ch;
-            token += ch;
-          }
-          if (token == "endobj") {
-            return new PdfTopLevel(num, gen, obj);
-          } else {
-            throw std::runtime_error(
-                std::string("Parse Error: Top level PDF objects must be closed "
-                            "by endobj, Got ") +
-                token);
-          }
-        }
-        // if we don't find obj fall through, other parsers will catch the
-        // error
-      }
-      // If we didn't find o or R after the two ints then just fall through
+void util::skip_whitespace(std::istream &is) {
+  while (true) {
+    int ch = is.peek();
+    if (ch == std::char_traits<char>::eof())
+      return;
+    if (ch == '%') {
+      while (ch != std::char_traits<char>::eof() && ch != '\n' && ch != '\r')
+        ch = (is.get(), is.peek());
+    } else if (is_pdf_whitespace(static_cast<char>(ch))) {
+      is.get();
+    } else {
+      return;
     }
-
-    // we did not find an ref or object, so return the first int
-    // and reset the stream to after the first int
-    is.clear();
-    is.seekg(pos_after_num, std::ios_base::beg);
-    return new PdfInt(num);
-  }
-
-  // Since we started with a digit we might still have a real
-  is.clear();
-  is.seekg(begin, std::ios_base::beg);
-
-  if (parse_double(is, &d) && (isspace(is.peek()) || is.eof())) {
-    return new PdfReal(d);
-  } else {
-    is.clear();
-    is.seekg(begin, std::ios_base::beg);
-    std::string token;
-    is >> token;
-    throw std::runtime_error(
-        std::string(
-            "Parse Error: Failed to parse a number from the stream: Got ") +
-        token);
   }
 }
 
 bool util::ends_name(char ch) {
-  // Is it only space???
-  return isspace(ch);
+  return is_pdf_whitespace(ch) || is_pdf_delimiter(ch);
 }
 
 bool util::valid_name_char(char ch) {
-  // I need to consult the specification to be sure of all chars not allowed
-  // in a pdf name object
-  return !isspace(ch) && !iscntrl(ch) && ch != '$' && ch != '*' && ch != '%' &&
-         ch != '^' && ch != '&' && ch != '"' && ch != '\'';
+  // Anything outside of the printable range has to be written as a #xx escape
+  return is_pdf_regular(ch) && ch > ' ' && ch <= '~';
+}
+
+const char *util::type_name(util::PdfType type) {
+  switch (type) {
+  case util::PdfType::Null:
+    return "null";
+  case util::PdfType::Bool:
+    return "bool";
+  case util::PdfType::Int:
+    return "int";
+  case util::PdfType::Real:
+    return "real";
+  case util::PdfType::Name:
+    return "name";
+  case util::PdfType::String:
+    return "string";
+  case util::PdfType::Ref:
+    return "ref";
+  case util::PdfType::Array:
+    return "array";
+  case util::PdfType::Dict:
+    return "dict";
+  case util::PdfType::Stream:
+    return "stream";
+  case util::PdfType::TopLevel:
+    return "top_level";
+  default:
+    return "unknown";
+  }
 }
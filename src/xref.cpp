@@ -0,0 +1,302 @@
+#include "xref.h"
+#include "filters.h"
+#include "lexer.h"
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+// How far back from the end to look for startxref before scanning everything
+const size_t STARTXREF_TAIL_SIZE = 4096;
+
+// The most indirect objects the spec lets a document have. The table is
+// indexed by object number, so a bigger one would only be a way for a tiny
+// file to ask for gigabytes.
+const int64_t MAX_OBJECT_NUMBER = 8388607;
+
+namespace {
+
+[[noreturn]] void xref_error(const std::string &msg) {
+  throw std::runtime_error("Xref Error: " + msg);
+}
+
+int64_t int_value(const util::PdfObj *obj, int64_t fallback) {
+  if (obj == nullptr)
+    return fallback;
+  const util::PdfInt *i = obj->as<util::PdfInt>();
+  return i != nullptr ? i->data : fallback;
+}
+
+// One past the highest object number a section may list. /Size is one more
+// than the highest number, but writers that are off by one are common enough
+// that the number equal to it is let through too.
+int64_t object_limit(const util::PdfDict &dict) {
+  int64_t size = int_value(dict.pairs.get(atom::Size), -1);
+  if (size < 0 || size > MAX_OBJECT_NUMBER)
+    return MAX_OBJECT_NUMBER + 1;
+  return size + 1;
+}
+
+void check_number(int64_t num, int64_t limit) {
+  if (num >= limit)
+    xref_error("Object number " + std::to_string(num) +
+               " is past the /Size of its section");
+}
+
+// Read a big endian field of a row in an xref stream
+uint64_t read_field(const char *p, int64_t width) {
+  uint64_t value = 0;
+  for (int64_t i = 0; i < width; ++i)
+    value = value << 8 | static_cast<unsigned char>(p[i]);
+  return value;
+}
+
+} // namespace
+
+size_t util::find_startxref(std::string_view data) {
+  size_t tail = data.size() > STARTXREF_TAIL_SIZE
+                    ? data.size() - STARTXREF_TAIL_SIZE
+                    : 0;
+  size_t pos = data.substr(tail).rfind("startxref");
+  if (pos != std::string_view::npos)
+    pos += tail;
+  else
+    pos = data.rfind("startxref");
+  if (pos == std::string_view::npos)
+    xref_error("Missing startxref");
+
+  PdfLexer lex(data);
+  lex.seek(pos + 9);
+  PdfToken token = lex.next();
+  if (token.type != PdfTokenType::Int || token.integer < 0 ||
+      static_cast<size_t>(token.integer) >= data.size())
+    xref_error("Invalid startxref offset");
+  return token.integer;
+}
+
+XrefTable::XrefTable() : trailer_dict(new util::PdfDict()) {}
+
+XrefTable XrefTable::from_entries(std::vector<XrefEntry> entries,
+                                  util::PdfDict *trailer,
+                                  std::vector<size_t> sections) {
+  XrefTable table;
+  table.entries = std::move(entries);
+  table.section_offsets = std::move(sections);
+  table.merge_trailer(trailer);
+  return table;
+}
+
+XrefTable
+XrefTable::load(std::string_view data,
+                const std::function<void(size_t offset)> &before_section) {
+  XrefTable table;
+  int64_t offset = util::find_startxref(data);
+
+  // Guard against /Prev chains that loop back on themselves
+  std::set<int64_t> seen;
+  while (offset >= 0 && seen.insert(offset).second) {
+    if (static_cast<size_t>(offset) >= data.size())
+      xref_error("Section offset is past the end of the file");
+    if (before_section)
+      before_section(offset);
+    offset = table.read_section(data, offset);
+  }
+  return table;
+}
+
+XrefTable XrefTable::load_section(std::string_view data, size_t offset) {
+  XrefTable table;
+  table.read_section(data, offset);
+  return table;
+}
+
+const XrefEntry *XrefTable::find(int64_t num) const {
+  if (num < 0 || static_cast<size_t>(num) >= entries.size() ||
+      entries[num].type == XrefType::Missing)
+    return nullptr;
+  return &entries[num];
+}
+
+size_t XrefTable::object_count() const {
+  size_t count = 0;
+  for (auto &entry : entries) {
+    if (entry.type == XrefType::InUse || entry.type == XrefType::Compressed)
+      ++count;
+  }
+  return count;
+}
+
+void XrefTable::set(int64_t num, const XrefEntry &entry) {
+  if (num < 0)
+    xref_error("Negative object number");
+  if (num > MAX_OBJECT_NUMBER)
+    xref_error("Object number " + std::to_string(num) + " is too big");
+  if (static_cast<size_t>(num) >= entries.size())
+    entries.resize(num + 1);
+  // Sections are read newest first, so anything already set wins
+  if (entries[num].type == XrefType::Missing)
+    entries[num] = entry;
+}
+
+void XrefTable::merge_trailer(util::PdfDict *dict) {
+  if (dict == nullptr)
+    return;
+  for (auto &p : dict->pairs) {
+    if (trailer_dict->pairs.emplace(p.first, p.second).second)
+      p.second = nullptr;
+  }
+  delete dict;
+}
+
+int64_t XrefTable::read_section(std::string_view data, size_t offset) {
+  section_offsets.push_back(offset);
+  PdfLexer lex(data);
+  lex.seek(offset);
+  if (lex.peek().is_keyword("xref"))
+    return read_table(data, offset);
+  return read_stream(data, offset);
+}
+
+int64_t XrefTable::read_table(std::string_view data, size_t offset) {
+  PdfLexer lex(data);
+  lex.seek(offset);
+  lex.next(); // xref
+
+  // Subsections of "start count" followed by count "offset gen n|f" lines.
+  // The /Size they are checked against is in the trailer after them.
+  std::vector<std::pair<int64_t, XrefEntry>> rows;
+  while (true) {
+    PdfToken token = lex.next();
+    if (token.is_keyword("trailer"))
+      break;
+    PdfToken count = lex.next();
+    if (token.type != PdfTokenType::Int || count.type != PdfTokenType::Int)
+      xref_error("Invalid subsection header in xref table");
+    if (token.integer < 0 || token.integer > MAX_OBJECT_NUMBER ||
+        count.integer < 0 || count.integer > MAX_OBJECT_NUMBER)
+      xref_error("Invalid subsection " + std::to_string(token.integer) + " " +
+                 std::to_string(count.integer) + " in xref table");
+
+    for (int64_t i = 0; i < count.integer; ++i) {
+      PdfToken off = lex.next();
+      PdfToken gen = lex.next();
+      PdfToken kind = lex.next();
+      if (off.type != PdfTokenType::Int || gen.type != PdfTokenType::Int ||
+          (!kind.is_keyword("n") && !kind.is_keyword("f")))
+        xref_error("Invalid entry in xref table");
+
+      XrefEntry entry;
+      entry.type = kind.is_keyword("n") ? XrefType::InUse : XrefType::Free;
+      entry.gen = static_cast<uint16_t>(gen.integer);
+      entry.offset = off.integer;
+      // Some writers use 0 0 n for missing objects, treat them as free
+      if (entry.type == XrefType::InUse && off.integer == 0)
+        entry.type = XrefType::Free;
+      rows.emplace_back(token.integer + i, entry);
+    }
+  }
+
+  std::unique_ptr<util::PdfDict> trailer(util::parse_pdf_dict(lex));
+  int64_t limit = object_limit(*trailer);
+  for (const auto &[num, entry] : rows) {
+    check_number(num, limit);
+    set(num, entry);
+  }
+  int64_t prev = int_value(trailer->pairs.get(atom::Prev), -1);
+
+  // Hybrid files keep compressed objects in an extra stream, whose entries
+  // belong to this same revision. set() keeps the table's entries, so read it
+  // after the table but let it fill in the ones the table lists as free.
+  int64_t stream_offset = int_value(trailer->pairs.get(atom::XRefStm), -1);
+  merge_trailer(trailer.release());
+  if (stream_offset >= 0 && static_cast<size_t>(stream_offset) < data.size()) {
+    XrefTable extra;
+    extra.read_stream(data, stream_offset);
+    for (size_t num = 0; num < extra.entries.size(); ++num) {
+      const XrefEntry &entry = extra.entries[num];
+      if (entry.type == XrefType::Missing)
+        continue;
+      if (num < entries.size() && entries[num].type == XrefType::Free)
+        entries[num] = entry;
+      else
+        set(num, entry);
+    }
+  }
+  return prev;
+}
+
+int64_t XrefTable::read_stream(std::string_view data, size_t offset) {
+  PdfLexer lex(data);
+  lex.seek(offset);
+  std::unique_ptr<util::PdfObj> obj(util::parse_pdf_obj(lex));
+  auto top = obj->as<util::PdfTopLevel>();
+  auto stream = top != nullptr ? top->obj->as<util::PdfStream>() : nullptr;
+  if (stream == nullptr)
+    xref_error("Expected an xref table or stream at offset " +
+               std::to_string(offset));
+
+  const util::PdfDict &dict = *stream->dict;
+  auto w = dict.pairs.get(atom::W);
+  auto widths = w != nullptr ? w->as<util::PdfArray>() : nullptr;
+  if (widths == nullptr || widths->objects.size() != 3)
+    xref_error("Xref stream needs a /W array of 3 widths");
+  int64_t w0 = int_value(widths->objects[0], -1);
+  int64_t w1 = int_value(widths->objects[1], -1);
+  int64_t w2 = int_value(widths->objects[2], -1);
+  if (w0 < 0 || w1 < 0 || w2 < 0 || w0 > 8 || w1 > 8 || w2 > 8)
+    xref_error("Invalid /W widths in xref stream");
+  size_t row_size = w0 + w1 + w2;
+  if (row_size == 0)
+    xref_error("Invalid /W widths in xref stream");
+
+  // /Index pairs of first object and count, by default the whole /Size
+  std::vector<std::pair<int64_t, int64_t>> ranges;
+  auto index = dict.pairs.get(atom::Index);
+  if (auto arr = index != nullptr ? index->as<util::PdfArray>() : nullptr) {
+    for (size_t i = 0; i + 1 < arr->objects.size(); i += 2)
+      ranges.emplace_back(int_value(arr->objects[i], 0),
+                          int_value(arr->objects[i + 1], 0));
+  } else {
+    ranges.emplace_back(0, int_value(dict.pairs.get(atom::Size), 0));
+  }
+
+  std::vector<char> rows = util::decode_stream(*stream);
+  int64_t limit = object_limit(dict);
+  size_t pos = 0;
+  for (auto &range : ranges) {
+    if (range.first < 0 || range.second < 0)
+      xref_error("Invalid /Index in xref stream");
+    for (int64_t i = 0; i < range.second; ++i, pos += row_size) {
+      if (pos + row_size > rows.size())
+        xref_error("Xref stream is shorter than its /Index says");
+
+      const char *row = rows.data() + pos;
+      // A missing type field means every entry is in use
+      uint64_t type = w0 == 0 ? 1 : read_field(row, w0);
+      uint64_t f2 = read_field(row + w0, w1);
+      uint64_t f3 = read_field(row + w0 + w1, w2);
+
+      XrefEntry entry;
+      if (type == 0) {
+        entry.type = XrefType::Free;
+        entry.gen = static_cast<uint16_t>(f3);
+      } else if (type == 1) {
+        entry.type = XrefType::InUse;
+        entry.offset = f2;
+        entry.gen = static_cast<uint16_t>(f3);
+      } else if (type == 2) {
+        entry.type = XrefType::Compressed;
+        entry.offset = f2;
+        entry.index = static_cast<uint32_t>(f3);
+      } else {
+        continue; // unknown types are to be ignored
+      }
+      check_number(range.first + i, limit);
+      set(range.first + i, entry);
+    }
+  }
+
+  int64_t prev = int_value(dict.pairs.get(atom::Prev), -1);
+  merge_trailer(stream->dict);
+  stream->dict = new util::PdfDict();
+  return prev;
+}
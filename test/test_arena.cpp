@@ -0,0 +1,67 @@
+#include "arena.h"
+#include "lexer.h"
+#include "pdf_parser.h"
+#include "utility.h"
+#include <gtest/gtest.h>
+
+using namespace util;
+
+TEST(Arena, CopiesBytesAndCountsWhatItHandsOut) {
+  Arena arena(128);
+  std::string_view copy = arena.copy("Hello");
+  EXPECT_EQ(copy, "Hello");
+  EXPECT_EQ(arena.bytes_used(), 5);
+
+  arena.release();
+  EXPECT_EQ(arena.bytes_used(), 0);
+}
+
+TEST(Arena, ParsedObjectsLiveInTheArenaAndBorrowFromTheInput) {
+  Arena arena;
+  std::string data("<< /Type /Page /Kids [ 1 0 R (text) ] >>");
+  PdfLexer lex(data);
+  PdfObj *parsed = parse_pdf_obj(lex, &arena);
+  EXPECT_GT(arena.bytes_used(), 0);
+
+  PdfDict expected;
+  expected.pairs[PdfName("/Type")] = new PdfName("/Page");
+  auto kids = new PdfArray();
+  kids->objects.push_back(new PdfRef(1, 0));
+  kids->objects.push_back(new PdfString("text"));
+  expected.pairs[PdfName("/Kids")] = kids;
+  EXPECT_EQ(*parsed, expected);
+
+  // Strings point straight into the input rather than holding a copy
+  auto dict = static_cast<PdfDict *>(parsed);
+  auto kids_arr = static_cast<PdfArray *>(dict->pairs.at(PdfName("/Kids")));
+  auto text = static_cast<PdfString *>(kids_arr->objects.at(1));
+  EXPECT_FALSE(text->owns_data());
+  EXPECT_EQ(text->data.data(), data.data() + 30);
+  // No delete, the arena releases everything
+}
+
+TEST(Arena, DecodedStringsAreCopiedIntoTheArena) {
+  Arena arena;
+  PdfLexer lex("(a\\(b)");
+  PdfObj *parsed = parse_pdf_obj(lex, &arena);
+  auto str = static_cast<PdfString *>(parsed);
+  EXPECT_EQ(str->data, "a(b");
+  EXPECT_FALSE(str->owns_data());
+}
+
+TEST(Arena, DeletingAnArenaObjectIsSafe) {
+  Arena arena;
+  PdfLexer lex("[ 1 2 3 ]");
+  delete parse_pdf_obj(lex, &arena);
+}
+
+TEST(PdfParser, ParsesObjectsAtAnOffsetIntoItsArena) {
+  std::string data("%PDF-1.7\n1 0 obj\n<< /Length 5 >>\nendobj\n");
+  PdfParser parser(data);
+  PdfObj *parsed = parser.parse_at(9);
+
+  PdfDict *dict = new PdfDict();
+  dict->pairs[PdfName("/Length")] = new PdfInt(5);
+  PdfTopLevel expected(1, 0, dict);
+  EXPECT_EQ(*parsed, expected);
+}
@@ -0,0 +1,114 @@
+#include "batch.h"
+#include "document_info.h"
+#include "pdf_parser.h"
+#include "test_helpers.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+
+namespace {
+
+std::string document(int pages) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  std::string kids;
+  for (int i = 0; i < pages; ++i)
+    kids += std::to_string(3 + i) + " 0 R ";
+  pdf.add(2, "<< /Type /Pages /Kids [" + kids + "] /Count " +
+                 std::to_string(pages) + " >>");
+  for (int i = 0; i < pages; ++i)
+    pdf.add(3 + i, "<< /Type /Page /Parent 2 0 R >>");
+  return pdf.finish_with_table("/Root 1 0 R");
+}
+
+struct TempFiles {
+  std::vector<std::string> paths;
+  std::string add(const std::string &name, const std::string &data) {
+    std::string path = ::testing::TempDir() + name;
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << data;
+    paths.push_back(path);
+    return path;
+  }
+  ~TempFiles() {
+    for (const std::string &path : paths)
+      std::remove(path.c_str());
+  }
+};
+
+// Write the page count of each document
+void count_pages(PdfParser &parser, const std::string &, std::ostream &os) {
+  os << parser.xref().object_count() - 2 << "\n";
+}
+
+} // namespace
+
+TEST(Batch, DoesItWriteEveryDocumentInOrder) {
+  TempFiles files;
+  std::vector<std::string> paths;
+  for (int i = 1; i <= 20; ++i)
+    paths.push_back(
+        files.add("batch_" + std::to_string(i) + ".pdf", document(i)));
+
+  ThreadPool pool(4);
+  std::ostringstream out, err;
+  BatchOptions options;
+  options.files_per_thread = 1;
+  BatchResult result = run_batch(paths, count_pages, pool, out, err, options);
+  EXPECT_EQ(result.done, 20u);
+  EXPECT_EQ(result.failed, 0u);
+  EXPECT_EQ(err.str(), "");
+
+  std::string expected;
+  for (int i = 1; i <= 20; ++i)
+    expected += "==> " + paths[i - 1] + " <==\n" + std::to_string(i) + "\n";
+  EXPECT_EQ(out.str(), expected);
+}
+
+TEST(Batch, DoesItCarryOnPastBadDocuments) {
+  TempFiles files;
+  std::vector<std::string> paths = {
+      files.add("batch_good.pdf", document(2)),
+      files.add("batch_bad.pdf", "not a pdf"),
+      ::testing::TempDir() + "batch_missing.pdf",
+  };
+
+  ThreadPool pool(2);
+  std::ostringstream out, err;
+  BatchResult result = run_batch(paths, count_pages, pool, out, err);
+  EXPECT_EQ(result.done, 1u);
+  EXPECT_EQ(result.failed, 2u);
+  EXPECT_EQ(out.str(), "==> " + paths[0] + " <==\n2\n");
+  EXPECT_NE(err.str().find("pdfcli: " + paths[1] + ": "), std::string::npos);
+  EXPECT_NE(err.str().find("pdfcli: " + paths[2] + ": "), std::string::npos);
+}
+
+TEST(Batch, DoesItWriteAFilePerDocument) {
+  TempFiles files;
+  std::string path = files.add("batch_dir.pdf", document(3));
+  files.paths.push_back(path + ".txt");
+
+  ThreadPool pool(1);
+  std::ostringstream out, err;
+  BatchOptions options;
+  options.output_dir = ::testing::TempDir();
+  options.extension = ".txt";
+  run_batch({path}, count_pages, pool, out, err, options);
+  EXPECT_EQ(out.str(), "");
+  std::ifstream is(path + ".txt");
+  std::string written((std::istreambuf_iterator<char>(is)), {});
+  EXPECT_EQ(written, "3\n");
+}
+
+TEST(Batch, DoesItExpandGlobsAndReadLists) {
+  TempFiles files;
+  std::string a = files.add("batch_glob_a.pdf", "");
+  std::string b = files.add("batch_glob_b.pdf", "");
+  std::vector<std::string> paths = expand_paths(
+      {::testing::TempDir() + "batch_glob_*.pdf", "plain.pdf", "nothing*"});
+  EXPECT_EQ(paths, (std::vector<std::string>{a, b, "plain.pdf", "nothing*"}));
+
+  std::istringstream list("one.pdf\n\ntwo.pdf\r\n");
+  EXPECT_EQ(read_path_list(list),
+            (std::vector<std::string>{"one.pdf", "two.pdf"}));
+}
@@ -0,0 +1,180 @@
+#include "char_scan.h"
+#include "lexer.h"
+#include "pdf_value.h"
+#include "serializer.h"
+#include "utility.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace {
+
+const util::CharScanner &scalar() { return *util::char_scanners().front(); }
+
+// Compare every scanner with the byte at a time one on every start and end
+// inside data, so the vector loops and their tails all get a turn
+void expect_scanners_agree(const std::string &data) {
+  const char *base = data.data();
+  for (const util::CharScanner *scanner : util::char_scanners()) {
+    SCOPED_TRACE(scanner->name);
+    for (size_t from = 0; from < data.size(); ++from) {
+      for (size_t to = from; to <= data.size(); to += 1 + (to - from) / 8) {
+        const char *p = base + from, *end = base + to;
+        ASSERT_EQ(scanner->skip_whitespace(p, end),
+                  scalar().skip_whitespace(p, end))
+            << from << " " << to;
+        ASSERT_EQ(scanner->find_delimiter(p, end),
+                  scalar().find_delimiter(p, end))
+            << from << " " << to;
+        ASSERT_EQ(scanner->find_name_escape(p, end),
+                  scalar().find_name_escape(p, end))
+            << from << " " << to;
+      }
+    }
+  }
+}
+
+} // namespace
+
+TEST(CharScan, DoesItStartWithTheByteAtATimeScanner) {
+  std::vector<const util::CharScanner *> scanners = util::char_scanners();
+  ASSERT_FALSE(scanners.empty());
+  EXPECT_STREQ(scanners.front()->name, "scalar");
+  EXPECT_FALSE(util::use_char_scanner("not a scanner"));
+}
+
+TEST(CharScan, DoesEveryScannerFindEveryByteAfterARun) {
+  // Each of the 256 bytes after a run of regular bytes and after a run of
+  // whitespace, at lengths on both sides of the vector widths
+  for (int ch = 0; ch < 256; ++ch) {
+    for (size_t run : {0, 1, 15, 16, 17, 31, 32, 33, 47}) {
+      std::string regular(run, 'a'), spaces(run, ' ');
+      regular += static_cast<char>(ch);
+      spaces += static_cast<char>(ch);
+      for (const util::CharScanner *scanner : util::char_scanners()) {
+        SCOPED_TRACE(scanner->name);
+        const char *end = regular.data() + regular.size();
+        EXPECT_EQ(scanner->find_delimiter(regular.data(), end),
+                  scalar().find_delimiter(regular.data(), end))
+            << ch << " " << run;
+        EXPECT_EQ(scanner->find_name_escape(regular.data(), end),
+                  scalar().find_name_escape(regular.data(), end))
+            << ch << " " << run;
+        end = spaces.data() + spaces.size();
+        EXPECT_EQ(scanner->skip_whitespace(spaces.data(), end),
+                  scalar().skip_whitespace(spaces.data(), end))
+            << ch << " " << run;
+      }
+    }
+  }
+}
+
+TEST(CharScan, DoesEveryScannerAgreeOnRandomBytes) {
+  std::mt19937 rng(30);
+  // Mostly runs of one class so the runs are long enough to matter, with
+  // anything at all mixed in
+  const std::string pieces[] = {"Type",
+                                "   ",
+                                "\r\n",
+                                "/",
+                                "<<",
+                                "12 0 R",
+                                "#20",
+                                "\t\f",
+                                std::string("\0\0", 2),
+                                "\x80\xff",
+                                "~!",
+                                "()",
+                                "abcdefghijklmnopqrstuvwxyz"};
+  std::string data;
+  while (data.size() < 300) {
+    if (rng() % 8 == 0)
+      data += static_cast<char>(rng() % 256);
+    else
+      data += pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))];
+  }
+  expect_scanners_agree(data);
+}
+
+TEST(CharScan, DoesTheLexerGiveTheSameTokensWithEveryScanner) {
+  std::string data = "<< /Type /Page /Kids [ 1 0 R 2 0 R ]      /Count 2\n"
+                     "   /LongerNameThanAVectorIsWide 12345678901234567890 "
+                     "/Font<</F1 3 0 R>> % a comment\n"
+                     "\t\t\t\t\t\t\t\t/End 1 >>";
+  std::string start = util::char_scanner().name;
+  std::vector<std::string> expected;
+  for (const util::CharScanner *scanner : util::char_scanners()) {
+    ASSERT_TRUE(util::use_char_scanner(scanner->name));
+    PdfLexer lex(data);
+    std::vector<std::string> tokens;
+    for (PdfToken token = lex.next(); token.type != PdfTokenType::End;
+         token = lex.next())
+      tokens.emplace_back(token.text);
+    if (expected.empty())
+      expected = tokens;
+    EXPECT_EQ(tokens, expected) << scanner->name;
+  }
+  util::use_char_scanner(start);
+  EXPECT_EQ(expected.size(), 26u);
+}
+
+TEST(NameEscapes, DoesItDecodeAndEncodeNames) {
+  EXPECT_EQ(util::decode_name("/A#20B"), "/A B");
+  EXPECT_EQ(util::decode_name("/Lime#20Green#2f#28x#29"), "/Lime Green/(x)");
+  // Escapes that are not two hex digits are kept as they are
+  EXPECT_EQ(util::decode_name("/A#2"), "/A#2");
+  EXPECT_EQ(util::decode_name("/A#zz#"), "/A#zz#");
+  EXPECT_EQ(util::decode_name("/Plain"), "/Plain");
+
+  EXPECT_FALSE(util::name_needs_escapes("/Plain"));
+  EXPECT_TRUE(util::name_needs_escapes("/A B"));
+  EXPECT_EQ(util::encode_name("/A B"), "/A#20B");
+  EXPECT_EQ(util::encode_name("/Lime Green/(x)"), "/Lime#20Green#2F#28x#29");
+  EXPECT_EQ(util::encode_name(std::string("/\0#\xe9", 4)), "/#00#23#E9");
+
+  std::string every("/");
+  for (int ch = 0; ch < 256; ++ch)
+    every += static_cast<char>(ch);
+  EXPECT_EQ(util::decode_name(util::encode_name(every)), every);
+}
+
+TEST(NameEscapes, DoesEveryParserDecodeNameEscapes) {
+  std::string data = "<< /A#20B /C#23 /Type /Page >>";
+
+  PdfLexer lex(data);
+  std::unique_ptr<util::PdfObj> obj(util::parse_pdf_obj(lex));
+  const util::PdfDict *dict = obj->as<util::PdfDict>();
+  ASSERT_NE(dict, nullptr);
+  util::PdfObj *value_obj = dict->pairs.at(util::PdfName("/A B"));
+  ASSERT_NE(value_obj, nullptr);
+  EXPECT_EQ(*value_obj, util::PdfName("/C#"));
+
+  PdfGraph graph;
+  PdfLexer value_lex(data);
+  PdfValue value = graph.parse(value_lex);
+  const PdfValue *found = graph.find(value, "/A B");
+  ASSERT_NE(found, nullptr);
+  EXPECT_EQ(found->str(), "/C#");
+
+  std::istringstream is("#20B");
+  EXPECT_EQ(util::get_name_token(is), "/ B");
+}
+
+TEST(NameEscapes, DoesItWriteNamesBackWithEscapes) {
+  PdfLexer lex("<< /A#20B /C#23 >>");
+  std::unique_ptr<util::PdfObj> obj(util::parse_pdf_obj(lex));
+  std::ostringstream os;
+  {
+    PdfSerializer out(os);
+    out.write(*obj);
+  }
+  EXPECT_EQ(os.str(), "<< /A#20B /C#23 >>");
+
+  PdfGraph graph;
+  PdfLexer value_lex("[/A#20B /Plain]");
+  std::ostringstream value_os;
+  graph.write(value_os, graph.parse(value_lex));
+  EXPECT_EQ(value_os.str(), "[ /A#20B /Plain ]");
+}
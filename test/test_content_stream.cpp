@@ -0,0 +1,88 @@
+#include "content_stream.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+TEST(ContentLexer, DoesItPairOperatorsWithTheirOperands) {
+  ContentLexer lex("BT /F1 12 Tf 72 712.5 Td (Hello) Tj ET");
+  ContentOp op;
+  ASSERT_TRUE(lex.next(op));
+  EXPECT_EQ(op.op, "BT");
+  EXPECT_EQ(op.count, 0u);
+
+  ASSERT_TRUE(lex.next(op));
+  EXPECT_EQ(op.op, "Tf");
+  ASSERT_EQ(op.count, 2u);
+  EXPECT_EQ(op[0].text, "/F1");
+  EXPECT_EQ(op.number(1), 12);
+
+  ASSERT_TRUE(lex.next(op));
+  EXPECT_EQ(op.op, "Td");
+  EXPECT_EQ(op.number(1), 712.5);
+  EXPECT_THROW(op.number(2), std::runtime_error);
+
+  ASSERT_TRUE(lex.next(op));
+  EXPECT_EQ(op.op, "Tj");
+  EXPECT_EQ(op[0].type, PdfTokenType::String);
+  EXPECT_EQ(op[0].text, "Hello");
+
+  ASSERT_TRUE(lex.next(op));
+  EXPECT_EQ(op.op, "ET");
+  EXPECT_FALSE(lex.next(op));
+}
+
+TEST(ContentLexer, DoesItKeepArrayOperandsAsTokens) {
+  std::vector<std::string> ops;
+  size_t tj_operands = 0;
+  ContentLexer lex("[(A) -120 (B)] TJ 1 0 0 1 0 0 cm true null d0 'x' '");
+  lex.for_each([&](const ContentOp &op) {
+    ops.emplace_back(op.op);
+    if (op.op == "TJ")
+      tj_operands = op.count;
+  });
+  EXPECT_EQ(ops, (std::vector<std::string>{"TJ", "cm", "d0", "'x'", "'"}));
+  EXPECT_EQ(tj_operands, 5u);
+}
+
+TEST(ContentLexer, DoesItSkipInlineImagesByLength) {
+  // The data has EI in it, which only the length can get past
+  std::string content = "q BI /W 4 /H 1 /BPC 8 /CS /G ID ";
+  content += std::string("a EI", 4);
+  content += " EI Q";
+  ContentLexer lex(content);
+  ContentOp op;
+  ASSERT_TRUE(lex.next(op));
+  EXPECT_EQ(op.op, "q");
+  ASSERT_TRUE(lex.next(op));
+  EXPECT_EQ(op.op, "BI");
+  EXPECT_EQ(op.count, 8u);
+  EXPECT_EQ(op.image, "a EI");
+  ASSERT_TRUE(lex.next(op));
+  EXPECT_EQ(op.op, "Q");
+  EXPECT_FALSE(lex.next(op));
+}
+
+TEST(ContentLexer, DoesItSearchForEIWhenTheImageSizeOverflows) {
+  // 2^61 + 1 bytes wide would wrap to a 4 byte image that ends in the data
+  ContentLexer lex("BI /W 2305843009213693953 /H 4 /BPC 8 /CS /G ID a EI EI S");
+  ContentOp op;
+  ASSERT_TRUE(lex.next(op));
+  EXPECT_EQ(op.op, "BI");
+  EXPECT_EQ(op.image, "a");
+}
+
+TEST(ContentLexer, DoesItFindTheEndOfFilteredInlineImagesByEI) {
+  ContentLexer lex("BI /W 10 /H 10 /F /AHx ID 0a1b2c> EI S");
+  ContentOp op;
+  ASSERT_TRUE(lex.next(op));
+  EXPECT_EQ(op.op, "BI");
+  EXPECT_EQ(op.image, "0a1b2c>");
+  ASSERT_TRUE(lex.next(op));
+  EXPECT_EQ(op.op, "S");
+}
+
+TEST(ContentLexer, DoesItThrowOnAnInlineImageWithNoEnd) {
+  ContentLexer lex("BI /W 1 /F /AHx ID 00>");
+  ContentOp op;
+  EXPECT_THROW(lex.next(op), std::runtime_error);
+}
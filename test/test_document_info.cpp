@@ -0,0 +1,68 @@
+#include "document_info.h"
+#include "pdf_parser.h"
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+TEST(DocumentInfo, DoesItWriteTheSummary) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+  pdf.add(3, "<< /Type /Page /Parent 2 0 R >>");
+  pdf.add(4, "<< /Title (A\\nTitle) /Author <FEFF00E9> >>");
+  std::string data = pdf.finish_with_table("/Root 1 0 R /Info 4 0 R");
+
+  PdfParser parser(data);
+  std::ostringstream os;
+  write_info(parser, os);
+  std::string info = os.str();
+  EXPECT_NE(info.find("version: 1.7\n"), std::string::npos);
+  EXPECT_NE(info.find("objects: 4\n"), std::string::npos);
+  EXPECT_NE(info.find("pages: 1\n"), std::string::npos);
+  EXPECT_NE(info.find("encrypted: no\n"), std::string::npos);
+  EXPECT_NE(info.find("title: A Title\n"), std::string::npos);
+  EXPECT_NE(info.find("author: \xc3\xa9\n"), std::string::npos);
+}
+
+TEST(DocumentInfo, DoesItReportABrokenPageTreeAsUnknown) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog >>");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  std::ostringstream os;
+  write_info(parser, os);
+  EXPECT_NE(os.str().find("pages: unknown\n"), std::string::npos);
+}
+
+TEST(DocumentInfo, DoesItListObjectsWithWhereTheyAre) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  auto placed = pdf.add_object_stream(3, {{2, "<< /Type /Pages /Count 0 >>"}});
+  pdf.add(5, "not an object ]");
+  std::string data = pdf.finish_with_stream(6, "/Root 1 0 R", placed);
+
+  PdfParser parser(data);
+  std::ostringstream os;
+  list_objects(parser, os);
+  std::string list = os.str();
+  EXPECT_NE(list.find("1 0 offset=" + std::to_string(pdf.offsets[1]) +
+                      " dict /Catalog\n"),
+            std::string::npos);
+  EXPECT_NE(list.find("2 0 objstm=3:0 dict /Pages\n"), std::string::npos);
+  EXPECT_NE(list.find("3 0 offset=" + std::to_string(pdf.offsets[3]) +
+                      " stream /ObjStm\n"),
+            std::string::npos);
+  EXPECT_NE(list.find("5 0 offset=" + std::to_string(pdf.offsets[5]) +
+                      " damaged\n"),
+            std::string::npos);
+}
+
+TEST(DocumentInfo, DoesItConvertTextStrings) {
+  EXPECT_EQ(text_string_utf8("abc"), "abc");
+  EXPECT_EQ(text_string_utf8("\xe9"), "\xc3\xa9");
+  std::string utf16("\xfe\xff\x00\x41\xd8\x3d\xde\x00", 8);
+  EXPECT_EQ(text_string_utf8(utf16), "A\xf0\x9f\x98\x80");
+  EXPECT_EQ(header_version("%PDF-1.4\n%junk"), "1.4");
+  EXPECT_EQ(header_version("no header"), "");
+}
@@ -0,0 +1,198 @@
+#include "filters.h"
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+#include <map>
+
+namespace {
+
+std::string decode(util::FilterChain &chain, const std::string &data) {
+  std::vector<char> out;
+  util::VectorSink sink(out);
+  chain.decode(data, sink);
+  return std::string(out.begin(), out.end());
+}
+
+std::string decode(const std::string &filter, const std::string &data,
+                   util::PdfDict *params = nullptr) {
+  util::FilterChain chain;
+  chain.add(util::make_filter(util::PdfName(filter), params));
+  return decode(chain, data);
+}
+
+// A plain LZW encoder with early change, enough to check the code width
+// switches in the decoder
+std::string lzw_encode(const std::string &data) {
+  std::map<std::string, int> table;
+  for (int i = 0; i < 256; ++i)
+    table[std::string(1, static_cast<char>(i))] = i;
+  int next = 258, width = 9;
+  uint32_t bits = 0;
+  int count = 0;
+  std::string out;
+  auto emit = [&](int code) {
+    bits = bits << width | code;
+    count += width;
+    while (count >= 8) {
+      count -= 8;
+      out += static_cast<char>(bits >> count);
+    }
+  };
+
+  emit(256);
+  std::string w;
+  for (char ch : data) {
+    if (table.count(w + ch)) {
+      w += ch;
+      continue;
+    }
+    emit(table[w]);
+    if (next == 4094) {
+      // Start over before the table fills up
+      emit(256);
+      for (auto it = table.begin(); it != table.end();)
+        it = it->first.size() > 1 ? table.erase(it) : std::next(it);
+      next = 258;
+      width = 9;
+    } else {
+      table[w + ch] = next++;
+      // The decoder's table is one entry behind, so it switches one code later
+      if (next >= (1 << width))
+        ++width;
+    }
+    w = std::string(1, ch);
+  }
+  if (!w.empty())
+    emit(table[w]);
+  emit(257);
+  if (count > 0)
+    out += static_cast<char>(bits << (8 - count));
+  return out;
+}
+
+} // namespace
+
+TEST(Filters, DoesItDecodeASCIIHex) {
+  EXPECT_EQ(decode("/ASCIIHexDecode", "48 65\n6c6C6f>ignored"), "Hello");
+  EXPECT_EQ(decode("/AHx", "414"), "A@");
+  EXPECT_THROW(decode("/AHx", "4G"), std::runtime_error);
+}
+
+TEST(Filters, DoesItDecodeASCII85) {
+  EXPECT_EQ(decode("/ASCII85Decode", "87cURD_*#4DfTZ)+Wu)BEc6\"[z+D#G$~>"),
+            std::string("Hello, World! zeros:\0\0\0\0 end", 28));
+  EXPECT_EQ(decode("/A85", "87cUR\nDZ~>"), "Hello");
+  EXPECT_THROW(decode("/A85", "87c{"), std::runtime_error);
+}
+
+TEST(Filters, DoesItDecodeRunLength) {
+  std::string data("\x02" "abc" "\xfd" "x" "\x00" "y" "\x80" "zz", 11);
+  EXPECT_EQ(decode("/RunLengthDecode", data), "abcxxxxy");
+}
+
+TEST(Filters, DoesItDecodeTheLZWExampleFromTheSpec) {
+  std::string data = "\x80\x0b\x60\x50\x22\x0c\x0c\x85\x01";
+  EXPECT_EQ(decode("/LZWDecode", data), "-----A---B");
+}
+
+TEST(Filters, DoesItDecodeLZWPastTheCodeWidthChanges) {
+  std::string text;
+  for (int i = 0; i < 5000; ++i)
+    text += std::to_string(i * 7919 % 1000) + " ";
+  EXPECT_EQ(decode("/LZW", lzw_encode(text)), text);
+}
+
+TEST(Filters, DoesItInflateInManyChunks) {
+  std::string text;
+  for (int i = 0; i < 100000; ++i)
+    text += static_cast<char>('a' + i * 31 % 26);
+  EXPECT_EQ(decode("/FlateDecode", deflate_string(text)), text);
+}
+
+TEST(Filters, DoesItRejectUnsupportedFilters) {
+  EXPECT_THROW(decode("/DCTDecode", "data"), std::runtime_error);
+}
+
+TEST(FilterChain, DoesItChainFiltersAndPredictorsFromTheDict) {
+  // Two rows of three bytes with the PNG Sub predictor, deflated, then hexed
+  std::string rows = std::string("\x01\x01\x01\x01\x01\x02\x02\x02", 8);
+  std::string hex;
+  for (char ch : deflate_string(rows)) {
+    char buf[3];
+    snprintf(buf, sizeof(buf), "%02x", static_cast<unsigned char>(ch));
+    hex += buf;
+  }
+
+  util::PdfDict dict;
+  auto filters = new util::PdfArray();
+  filters->objects.push_back(new util::PdfName(atom::ASCIIHexDecode));
+  filters->objects.push_back(new util::PdfName(atom::FlateDecode));
+  dict.pairs[util::PdfName(atom::Filter)] = filters;
+  auto params = new util::PdfArray();
+  params->objects.push_back(new util::PdfNull());
+  auto flate_params = new util::PdfDict();
+  flate_params->pairs[util::PdfName(atom::Predictor)] = new util::PdfInt(11);
+  flate_params->pairs[util::PdfName(atom::Columns)] = new util::PdfInt(3);
+  params->objects.push_back(flate_params);
+  dict.pairs[util::PdfName(atom::DecodeParms)] = params;
+
+  util::FilterChain chain = util::FilterChain::for_dict(dict);
+  EXPECT_EQ(chain.size(), 3u);
+  EXPECT_EQ(decode(chain, hex), "\x01\x02\x03\x02\x04\x06");
+  // The same chain can decode again
+  EXPECT_EQ(decode(chain, hex), "\x01\x02\x03\x02\x04\x06");
+}
+
+TEST(FilterChain, DoesAnEmptyChainPassBytesThrough) {
+  util::PdfDict dict;
+  util::FilterChain chain = util::FilterChain::for_dict(dict);
+  EXPECT_EQ(chain.size(), 0u);
+  EXPECT_EQ(decode(chain, "raw"), "raw");
+}
+
+TEST(InflatePool, DoesItReuseContexts) {
+  InflatePool pool(4096, 2);
+  {
+    auto a = pool.acquire();
+    auto b = pool.acquire();
+    auto c = pool.acquire();
+    EXPECT_EQ(a->out.size(), 4096u);
+  }
+  // Only two are kept
+  EXPECT_EQ(pool.created(), 3u);
+  EXPECT_EQ(pool.idle(), 2u);
+
+  pool.set_buffer_size(100);
+  for (int i = 0; i < 10; ++i) {
+    auto lease = pool.acquire();
+    EXPECT_EQ(lease->in.size(), 100u);
+  }
+  EXPECT_EQ(pool.created(), 3u);
+}
+
+TEST(InflatePool, DoesAReusedContextInflateCleanly) {
+  InflatePool pool;
+  std::string first = deflate_string("first stream");
+  std::string second = deflate_string("second stream");
+  for (const std::string &data : {first, second}) {
+    auto lease = pool.acquire();
+    std::string_view in(data);
+    size_t produced = 0;
+    // The first use is abandoned part way through
+    lease->state.inflate(in, lease->out.data(), data == first ? 3 : 100,
+                         produced);
+    if (data == second) {
+      EXPECT_EQ(std::string(lease->out.data(), produced), "second stream");
+    }
+  }
+  EXPECT_EQ(pool.created(), 1u);
+}
+
+TEST(Filters, DoesTheSizeHintUseDL) {
+  util::PdfDict dict;
+  EXPECT_EQ(util::decoded_size_hint(dict, 10), 10u);
+  dict.pairs[util::PdfName(atom::Filter)] =
+      new util::PdfName(atom::FlateDecode);
+  EXPECT_EQ(util::decoded_size_hint(dict, 10), 40u);
+  dict.pairs[util::PdfName(atom::DL)] = new util::PdfInt(1234);
+  EXPECT_EQ(util::decoded_size_hint(dict, 10), 1234u);
+}
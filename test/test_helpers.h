@@ -0,0 +1,134 @@
+#ifndef PDF_TEST_HELPERS_H
+#define PDF_TEST_HELPERS_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+
+// Compress bytes with zlib for building FlateDecode streams in tests
+inline std::string deflate_string(const std::string &data) {
+  uLongf size = compressBound(data.size());
+  std::string out(size, '\0');
+  compress(reinterpret_cast<Bytef *>(out.data()), &size,
+           reinterpret_cast<const Bytef *>(data.data()), data.size());
+  out.resize(size);
+  return out;
+}
+
+/* Builds small documents in memory with correct byte offsets, so tests can
+ * make a pdf with an xref table or xref stream without keeping binary files
+ * around. Objects are written in the order they are added.
+ */
+class TestPdf {
+public:
+  TestPdf() : data("%PDF-1.7\n") {}
+
+  // Add "num 0 obj body endobj"
+  void add(int64_t num, const std::string &body, int64_t gen = 0) {
+    offsets[num] = data.size();
+    gens[num] = gen;
+    data += std::to_string(num) + " " + std::to_string(gen) + " obj\n" +
+            body + "\nendobj\n";
+  }
+
+  // Add a stream object, dict_entries go inside the << >> before /Length
+  void add_stream(int64_t num, const std::string &dict_entries,
+                  const std::string &payload) {
+    add(num, "<< " + dict_entries + " /Length " +
+                 std::to_string(payload.size()) + " >>\nstream\n" + payload +
+                 "\nendstream");
+  }
+
+  // Add a compressed object stream holding the given objects. Returns where
+  // each one went, ready to pass to finish_with_stream.
+  std::map<int64_t, std::pair<int64_t, int64_t>>
+  add_object_stream(int64_t num,
+                    const std::vector<std::pair<int64_t, std::string>> &objs) {
+    std::string header, body;
+    std::map<int64_t, std::pair<int64_t, int64_t>> placed;
+    for (size_t i = 0; i < objs.size(); ++i) {
+      header += std::to_string(objs[i].first) + " " +
+                std::to_string(body.size()) + " ";
+      body += objs[i].second + "\n";
+      placed[objs[i].first] = {num, i};
+    }
+    add_stream(num,
+               "/Type /ObjStm /Filter /FlateDecode /N " +
+                   std::to_string(objs.size()) + " /First " +
+                   std::to_string(header.size()),
+               deflate_string(header + body));
+    return placed;
+  }
+
+  // Finish with a classic xref table covering every object added so far
+  std::string finish_with_table(const std::string &trailer_entries) {
+    size_t xref = data.size();
+    int64_t size = offsets.empty() ? 1 : offsets.rbegin()->first + 1;
+    data += "xref\n0 " + std::to_string(size) + "\n";
+    data += "0000000000 65535 f\r\n";
+    for (int64_t num = 1; num < size; ++num) {
+      char line[32];
+      if (offsets.count(num))
+        snprintf(line, sizeof(line), "%010zu %05lld n\r\n", offsets[num],
+                 static_cast<long long>(gens[num]));
+      else
+        snprintf(line, sizeof(line), "%010d %05d f\r\n", 0, 0);
+      data += line;
+    }
+    data += "trailer\n<< /Size " + std::to_string(size) + " " +
+            trailer_entries + " >>\nstartxref\n" + std::to_string(xref) +
+            "\n%%EOF\n";
+    return data;
+  }
+
+  // Finish with a compressed xref stream as object num. Offsets use 4 bytes,
+  // and compressed lists objects that live in an object stream as
+  // num -> (stream number, index).
+  std::string finish_with_stream(
+      int64_t num, const std::string &trailer_entries,
+      const std::map<int64_t, std::pair<int64_t, int64_t>> &compressed = {}) {
+    size_t xref = data.size();
+    offsets[num] = xref;
+    int64_t size = num + 1;
+    for (auto &p : offsets)
+      size = std::max(size, p.first + 1);
+    for (auto &p : compressed)
+      size = std::max(size, p.first + 1);
+
+    std::string rows;
+    for (int64_t i = 0; i < size; ++i) {
+      uint64_t type = 0, f2 = 0, f3 = i == 0 ? 65535 : 0;
+      if (compressed.count(i)) {
+        type = 2;
+        f2 = compressed.at(i).first;
+        f3 = compressed.at(i).second;
+      } else if (offsets.count(i)) {
+        type = 1;
+        f2 = offsets[i];
+        f3 = gens[i];
+      }
+      rows += static_cast<char>(type);
+      for (int shift = 24; shift >= 0; shift -= 8)
+        rows += static_cast<char>((f2 >> shift) & 0xff);
+      rows += static_cast<char>((f3 >> 8) & 0xff);
+      rows += static_cast<char>(f3 & 0xff);
+    }
+
+    std::string payload = deflate_string(rows);
+    data += std::to_string(num) + " 0 obj\n<< /Type /XRef /Size " +
+            std::to_string(size) + " /W [1 4 2] /Filter /FlateDecode " +
+            trailer_entries + " /Length " + std::to_string(payload.size()) +
+            " >>\nstream\n" + payload + "\nendstream\nendobj\nstartxref\n" +
+            std::to_string(xref) + "\n%%EOF\n";
+    return data;
+  }
+
+  std::string data;
+  std::map<int64_t, size_t> offsets;
+  std::map<int64_t, int64_t> gens;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "incremental.h"
+#include "pdf_parser.h"
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+namespace {
+
+std::string original_pdf() {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+  pdf.add(3, "<< /Type /Page /Parent 2 0 R >>");
+  pdf.add(4, "(old note)");
+  return pdf.finish_with_table("/Root 1 0 R");
+}
+
+// Append one revision that changes page 3, adds an annotation and deletes 4
+std::string updated_pdf(const std::string &data, int64_t *added) {
+  PdfParser parser(data);
+  IncrementalWriter writer(parser);
+
+  auto annot = std::make_unique<util::PdfDict>();
+  annot->pairs[util::PdfName("/Subtype")] = new util::PdfName("/Text");
+  *added = writer.add(std::move(annot));
+
+  auto page = std::make_unique<util::PdfDict>();
+  page->pairs[util::PdfName(atom::Type)] = new util::PdfName(atom::Page);
+  page->pairs[util::PdfName(atom::Parent)] = new util::PdfRef(2, 0);
+  auto annots = new util::PdfArray;
+  annots->objects.push_back(new util::PdfRef(*added, 0));
+  page->pairs[util::PdfName(atom::Annots)] = annots;
+  writer.set(3, std::move(page));
+  writer.remove(4);
+
+  std::ostringstream os;
+  writer.write(os);
+  return data + os.str();
+}
+
+} // namespace
+
+TEST(IncrementalWriter, DoesItAppendARevisionThatReadsBack) {
+  std::string data = original_pdf();
+  int64_t added = 0;
+  std::string updated = updated_pdf(data, &added);
+  EXPECT_EQ(added, 5);
+  EXPECT_EQ(updated.compare(0, data.size(), data), 0);
+
+  PdfParser parser(updated);
+  auto page = parser.get_object(3);
+  ASSERT_NE(page, nullptr);
+  EXPECT_NE(page->obj->as<util::PdfDict>()->pairs.get(atom::Annots), nullptr);
+  EXPECT_NE(parser.get_object(added), nullptr);
+  EXPECT_EQ(parser.get_object(4), nullptr);
+  EXPECT_EQ(parser.xref().find(4)->type, XrefType::Free);
+  EXPECT_NE(parser.get_object(1), nullptr);
+  EXPECT_EQ(*parser.xref().trailer().pairs.get(atom::Size), util::PdfInt(6));
+}
+
+TEST(FindRevisions, DoesItListEachRevisionsDelta) {
+  std::string data = original_pdf();
+  int64_t added = 0;
+  std::string updated = updated_pdf(data, &added);
+
+  std::vector<Revision> revisions = find_revisions(updated);
+  ASSERT_EQ(revisions.size(), 2u);
+  EXPECT_EQ(revisions[0].start, data.size());
+  EXPECT_EQ(revisions[0].end, updated.size());
+  EXPECT_EQ(revisions[0].changed, (std::vector<int64_t>{3, 5}));
+  EXPECT_EQ(revisions[0].freed, std::vector<int64_t>{4});
+  EXPECT_EQ(revisions[1].start, 0u);
+  EXPECT_EQ(revisions[1].end, data.size());
+  EXPECT_EQ(revisions[1].changed, (std::vector<int64_t>{1, 2, 3, 4}));
+
+  Revision latest = latest_revision(updated);
+  EXPECT_EQ(latest.start, data.size());
+  EXPECT_EQ(latest.changed, revisions[0].changed);
+}
+
+TEST(RevisionObjects, DoesItOnlyLoadTheObjectsOfTheRevision) {
+  std::string data = original_pdf();
+  int64_t added = 0;
+  std::string updated = updated_pdf(data, &added);
+
+  PdfParser parser(updated);
+  Revision latest = latest_revision(updated);
+  auto objects = revision_objects(parser, latest);
+  ASSERT_EQ(objects.size(), 2u);
+  EXPECT_EQ(objects[0]->num, 3);
+  EXPECT_EQ(objects[1]->num, added);
+  EXPECT_EQ(parser.cache().size(), 2u);
+}
+
+TEST(RevisionObjects, DoesItLoadOlderRevisionsAsTheyWereWritten) {
+  std::string data = original_pdf();
+  int64_t added = 0;
+  std::string updated = updated_pdf(data, &added);
+
+  PdfParser parser(updated);
+  std::vector<Revision> revisions = find_revisions(updated);
+  auto objects = revision_objects(parser, revisions[1]);
+  ASSERT_EQ(objects.size(), 4u);
+  // The page before the update had no annotations, and the note that was
+  // freed since is still there in the revision that wrote it
+  EXPECT_EQ(objects[2]->num, 3);
+  EXPECT_EQ(objects[2]->obj->as<util::PdfDict>()->pairs.get(atom::Annots),
+            nullptr);
+  EXPECT_EQ(*objects[3]->obj, util::PdfString("old note"));
+  // The current version is untouched
+  EXPECT_NE(parser.get_object(3)->obj->as<util::PdfDict>()->pairs.get(
+                atom::Annots),
+            nullptr);
+  EXPECT_EQ(parser.get_object(4), nullptr);
+}
+
+TEST(IncrementalWriter, DoesItWriteNothingWithoutChanges) {
+  std::string data = original_pdf();
+  PdfParser parser(data);
+  IncrementalWriter writer(parser);
+  std::ostringstream os;
+  writer.write(os);
+  EXPECT_TRUE(os.str().empty());
+}
+
+TEST(IncrementalWriter, DoesItOnlyRemoveObjectsThatExist) {
+  std::string data = original_pdf();
+  PdfParser parser(data);
+  IncrementalWriter writer(parser);
+  EXPECT_THROW(writer.remove(0), std::out_of_range);
+  EXPECT_THROW(writer.remove(-3), std::out_of_range);
+  EXPECT_THROW(writer.remove(5), std::out_of_range);
+  EXPECT_EQ(writer.size(), 0u);
+
+  // An object added by the update can be removed again
+  int64_t added = writer.add(std::make_unique<util::PdfInt>(7));
+  writer.remove(added);
+  writer.remove(4);
+  EXPECT_EQ(writer.size(), 2u);
+}
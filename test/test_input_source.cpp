@@ -0,0 +1,57 @@
+#include "input_source.h"
+#include "utility.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+TEST(InputSource, MapsAFileAndExposesItsBytes) {
+  InputSource source = InputSource::open("test/assets/hello_world.txt");
+  EXPECT_TRUE(source.is_mapped());
+  EXPECT_EQ(source.size(), 14);
+  EXPECT_EQ(source.bytes(), "Hello, World!\n");
+}
+
+TEST(InputSource, ThrowsWhenTheFileDoesNotExist) {
+  EXPECT_THROW(InputSource::open("test/assets/not_a_file.txt"),
+               std::ios_base::failure);
+}
+
+TEST(InputSource, ReadsAStreamThatCannotBeMapped) {
+  std::stringstream is("Hello, World!\n");
+  InputSource source = InputSource::read(is);
+  EXPECT_FALSE(source.is_mapped());
+  EXPECT_EQ(source.bytes(), "Hello, World!\n");
+}
+
+TEST(InputSource, KeepsItsBytesWhenMoved) {
+  std::stringstream is("Hello, World!\n");
+  InputSource source = InputSource::read(is);
+  const char *before = source.data();
+  InputSource moved = std::move(source);
+  EXPECT_EQ(moved.data(), before);
+  EXPECT_EQ(moved.bytes(), "Hello, World!\n");
+  EXPECT_EQ(source.size(), 0);
+}
+
+TEST(SpanStream, SeeksAndReadsLikeAStringStream) {
+  SpanStream is("1024 0 R");
+  int64_t i;
+  EXPECT_TRUE(util::parse_int(is, &i));
+  EXPECT_EQ(i, 1024);
+  EXPECT_EQ(is.tellg(), 4);
+  is.seekg(0, std::ios_base::beg);
+  EXPECT_TRUE(util::parse_int(is, &i));
+  EXPECT_EQ(i, 1024);
+}
+
+TEST(SpanStream, StreamPayloadsReferIntoTheSpanInsteadOfCopying) {
+  std::string data("<< /First null >>\nstream\nHello, World!\nendstream\n");
+  SpanStream is(data);
+  util::PdfObj *parsed = util::parse_pdf_obj(is);
+
+  auto stream = dynamic_cast<util::PdfStream *>(parsed);
+  ASSERT_NE(stream, nullptr);
+  EXPECT_TRUE(stream->stream.empty());
+  EXPECT_EQ(stream->bytes(), "Hello, World!");
+  EXPECT_EQ(stream->bytes().data(), data.data() + 25);
+  delete parsed;
+}
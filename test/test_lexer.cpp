@@ -0,0 +1,192 @@
+#include "lexer.h"
+#include "utility.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+TEST(PdfLexer, ReadsTypedTokensFromABuffer) {
+  PdfLexer lex("/Type/Page 12 -.5 (str) <4142> [ << >> ] obj");
+
+  PdfToken token = lex.next();
+  EXPECT_EQ(token.type, PdfTokenType::Name);
+  EXPECT_EQ(token.text, "/Type");
+
+  token = lex.next();
+  EXPECT_EQ(token.type, PdfTokenType::Name);
+  EXPECT_EQ(token.text, "/Page");
+
+  token = lex.next();
+  EXPECT_EQ(token.type, PdfTokenType::Int);
+  EXPECT_EQ(token.integer, 12);
+
+  token = lex.next();
+  EXPECT_EQ(token.type, PdfTokenType::Real);
+  EXPECT_EQ(token.real, -0.5);
+
+  token = lex.next();
+  EXPECT_EQ(token.type, PdfTokenType::String);
+  EXPECT_EQ(token.text, "str");
+
+  token = lex.next();
+  EXPECT_EQ(token.type, PdfTokenType::HexString);
+  EXPECT_EQ(token.text, "4142");
+
+  EXPECT_TRUE(lex.next().is_delimiter("["));
+  EXPECT_TRUE(lex.next().is_delimiter("<<"));
+  EXPECT_TRUE(lex.next().is_delimiter(">>"));
+  EXPECT_TRUE(lex.next().is_delimiter("]"));
+  EXPECT_TRUE(lex.next().is_keyword("obj"));
+  EXPECT_EQ(lex.next().type, PdfTokenType::End);
+}
+
+TEST(PdfLexer, SkipsCommentsLikeWhitespace) {
+  PdfLexer lex("%PDF-1.7\n% more\r\n  42 % trailing");
+  PdfToken token = lex.next();
+  EXPECT_EQ(token.type, PdfTokenType::Int);
+  EXPECT_EQ(token.integer, 42);
+  EXPECT_EQ(lex.next().type, PdfTokenType::End);
+}
+
+TEST(PdfLexer, ReadsNumbersInAllThePdfForms) {
+  PdfLexer lex("+17 -98 0 .5 4. -.002 34.5 8");
+  EXPECT_EQ(lex.next().integer, 17);
+  EXPECT_EQ(lex.next().integer, -98);
+  EXPECT_EQ(lex.next().integer, 0);
+  EXPECT_EQ(lex.next().real, 0.5);
+  EXPECT_EQ(lex.next().real, 4.0);
+  EXPECT_EQ(lex.next().real, -0.002);
+  EXPECT_EQ(lex.next().real, 34.5);
+  EXPECT_EQ(lex.next().integer, 8);
+}
+
+TEST(PdfLexer, ThrowsOnMalformedNumbers) {
+  PdfLexer lex("1.2.3");
+  EXPECT_THROW(lex.next(), std::runtime_error);
+}
+
+TEST(PdfLexer, KeepsBalancedParensInsideStrings) {
+  PdfLexer lex("(a (nested) \\) string) next");
+  PdfToken token = lex.next();
+  EXPECT_EQ(token.type, PdfTokenType::String);
+  EXPECT_EQ(token.text, "a (nested) \\) string");
+  EXPECT_TRUE(lex.next().is_keyword("next"));
+}
+
+TEST(PdfLexer, PeekDoesNotConsume) {
+  PdfLexer lex("1 0 R");
+  EXPECT_EQ(lex.peek().integer, 1);
+  EXPECT_EQ(lex.next().integer, 1);
+  EXPECT_EQ(lex.position(), 1);
+}
+
+TEST(DecodeLiteralString, HandlesEscapes) {
+  EXPECT_EQ(util::decode_literal_string("a\\nb\\(c\\)\\\\d\\101\\7"),
+            std::string("a\nb(c)\\dA\7"));
+  EXPECT_EQ(util::decode_literal_string("split \\\nline"), "split line");
+}
+
+TEST(DecodeHexString, IgnoresWhitespaceAndPadsAnOddDigit) {
+  EXPECT_EQ(util::decode_hex_string("48 65 6C6c6F"), "Hello");
+  EXPECT_EQ(util::decode_hex_string("414"), "A@");
+}
+
+TEST(ParsePdfObjFromLexer, ReadsRefsAndLeavesTrailingInts) {
+  PdfLexer lex("[ 1 0 R 2 3 4 ]");
+  util::PdfObj *parsed = util::parse_pdf_obj(lex);
+
+  util::PdfArray expected;
+  expected.objects.push_back(new util::PdfRef(1, 0));
+  expected.objects.push_back(new util::PdfInt(2));
+  expected.objects.push_back(new util::PdfInt(3));
+  expected.objects.push_back(new util::PdfInt(4));
+
+  EXPECT_EQ(*parsed, expected);
+  delete parsed;
+}
+
+TEST(ParsePdfObjFromLexer, ReadsANameDirectlyFollowedByAnotherToken) {
+  PdfLexer lex("<</Type/Page/Kids[1 0 R]/Title<4142>>>");
+  util::PdfObj *parsed = util::parse_pdf_obj(lex);
+
+  util::PdfDict expected;
+  expected.pairs[util::PdfName("/Type")] = new util::PdfName("/Page");
+  auto kids = new util::PdfArray();
+  kids->objects.push_back(new util::PdfRef(1, 0));
+  expected.pairs[util::PdfName("/Kids")] = kids;
+  expected.pairs[util::PdfName("/Title")] = new util::PdfString("AB");
+
+  EXPECT_EQ(*parsed, expected);
+  delete parsed;
+}
+
+TEST(ParsePdfObjFromStream, LeavesTheStreamAfterTheObject) {
+  std::stringstream is("<< /A 1 >> 42");
+  util::PdfObj *dict = util::parse_pdf_obj(is);
+  util::PdfObj *num = util::parse_pdf_obj(is);
+  EXPECT_EQ(*num, util::PdfInt(42));
+  delete dict;
+  delete num;
+}
+
+TEST(PdfLexer, DoesItSliceStreamsByLength) {
+  // The payload contains endstream, only the length can get it right
+  std::string data = "stream\nabc endstream xyz\nendstream";
+  PdfLexer lex(data);
+  EXPECT_EQ(lex.stream_payload(17), "abc endstream xyz");
+  EXPECT_TRUE(lex.at_end());
+}
+
+TEST(PdfLexer, DoesItFallBackToSearchingWhenTheLengthIsWrong) {
+  std::string data = "stream\r\nHello\r\nendstream 1";
+  for (int64_t length : {-1, 3, 200}) {
+    PdfLexer lex(data);
+    EXPECT_EQ(lex.stream_payload(length), "Hello");
+    EXPECT_EQ(lex.next().integer, 1);
+  }
+}
+
+TEST(FindBytes, DoesItFindTheFirstMatch) {
+  EXPECT_EQ(util::find_bytes("xxendstreamendstream", "endstream"), 2u);
+  EXPECT_EQ(util::find_bytes("endstrea", "endstream"), std::string_view::npos);
+  EXPECT_EQ(util::find_bytes("abc", ""), 0u);
+}
+
+TEST(ScanPdfNumber, DoesItClassifyIntsAndRealsInOnePass) {
+  util::PdfNumber number;
+  ASSERT_TRUE(util::scan_pdf_number("-.002", number));
+  EXPECT_FALSE(number.is_int);
+  EXPECT_EQ(number.real, -0.002);
+  ASSERT_TRUE(util::scan_pdf_number("+.5", number));
+  EXPECT_EQ(number.real, 0.5);
+  ASSERT_TRUE(util::scan_pdf_number("612", number));
+  EXPECT_TRUE(number.is_int);
+  EXPECT_EQ(number.integer, 612);
+  ASSERT_TRUE(util::scan_pdf_number("-9223372036854775808", number));
+  EXPECT_FALSE(number.is_int);
+  ASSERT_TRUE(util::scan_pdf_number("9223372036854775807", number));
+  EXPECT_EQ(number.integer, INT64_MAX);
+  EXPECT_FALSE(util::scan_pdf_number("-", number));
+  EXPECT_FALSE(util::scan_pdf_number(".", number));
+  EXPECT_FALSE(util::scan_pdf_number("1.2.3", number));
+  EXPECT_FALSE(util::scan_pdf_number("12a", number));
+}
+
+TEST(ScanPdfNumber, DoesItMatchFromCharsOnLongReals) {
+  util::PdfNumber number;
+  for (const char *text : {"0.1", "123.456", "3.14159265358979",
+                           "0.30000000000000004", "98765432109876543.21"}) {
+    ASSERT_TRUE(util::scan_pdf_number(text, number)) << text;
+    EXPECT_EQ(number.real, std::stod(text)) << text;
+  }
+}
+
+TEST(ParseIntFromStream, DoesItStopAtThePointWithoutRewinding) {
+  std::istringstream is("  12.5 x");
+  int64_t i = 0;
+  double d = 0;
+  EXPECT_TRUE(util::parse_int(is, &i));
+  EXPECT_EQ(i, 12);
+  EXPECT_EQ(is.tellg(), 4);
+  EXPECT_TRUE(util::parse_double(is, &d));
+  EXPECT_EQ(d, 0.5);
+  EXPECT_FALSE(util::parse_double(is, &d));
+}
@@ -0,0 +1,75 @@
+#include "lexer.h"
+#include "names.h"
+#include "pdf_value.h"
+#include "utility.h"
+#include <gtest/gtest.h>
+
+using namespace util;
+
+TEST(NameTable, WellKnownNamesHaveFixedAtoms) {
+  static_assert(well_known_atom("/Type") == atom::Type);
+  static_assert(well_known_atom("/NotWellKnown") == atom::WELL_KNOWN_COUNT);
+  EXPECT_EQ(NameTable::global().intern("/Length"), atom::Length);
+  EXPECT_EQ(NameTable::global().text(atom::Filter), "/Filter");
+}
+
+TEST(NameTable, InternsNewNamesOnce) {
+  NameTable table;
+  std::string_view first_text;
+  PdfAtom first = table.intern("/SomeNewName", &first_text);
+  PdfAtom again = table.intern(std::string("/SomeNewName"));
+  EXPECT_EQ(first, again);
+  EXPECT_GE(first, atom::WELL_KNOWN_COUNT);
+  EXPECT_EQ(table.text(first).data(), first_text.data());
+  EXPECT_EQ(table.find("/NeverSeen"), NameTable::NO_ATOM);
+}
+
+TEST(PdfName, IsEqualByAtom) {
+  PdfName a("/Strinsberg");
+  PdfName b(std::string("/Strinsberg"));
+  EXPECT_EQ(a.atom, b.atom);
+  EXPECT_EQ(a.data.data(), b.data.data());
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(PdfName(atom::Type), PdfName("/Type"));
+}
+
+TEST(PdfNameMap, LooksUpByAtom) {
+  PdfDict dict;
+  dict.pairs[PdfName("/Type")] = new PdfName("/Page");
+  dict.pairs[PdfName("/Length")] = new PdfInt(10);
+  dict.pairs[PdfName("/Custom")] = new PdfNull();
+
+  EXPECT_EQ(dict.pairs.size(), 3);
+  EXPECT_EQ(*dict.pairs.get(atom::Length), PdfInt(10));
+  EXPECT_EQ(dict.pairs.get(atom::Filter), nullptr);
+  EXPECT_NE(dict.pairs.find(PdfName("/Custom")), dict.pairs.end());
+
+  // Replacing keeps a single entry
+  delete dict.pairs[PdfName("/Length")];
+  dict.pairs[PdfName("/Length")] = new PdfInt(11);
+  EXPECT_EQ(dict.pairs.size(), 3);
+  EXPECT_EQ(*dict.pairs.at(PdfName("/Length")), PdfInt(11));
+}
+
+TEST(PdfNameMap, BinarySearchesBigDicts) {
+  PdfDict dict;
+  for (int i = 0; i < 40; ++i)
+    dict.pairs[PdfName("/Key" + std::to_string(i))] = new PdfInt(i);
+  for (int i = 0; i < 40; ++i)
+    EXPECT_EQ(*dict.pairs.at(PdfName("/Key" + std::to_string(i))), PdfInt(i));
+
+  auto it = dict.pairs.find(PdfName("/Key7"));
+  delete it->second;
+  dict.pairs.erase(it);
+  EXPECT_EQ(dict.pairs.size(), 39);
+  EXPECT_EQ(dict.pairs.find(PdfName("/Key7")), dict.pairs.end());
+}
+
+TEST(PdfGraph, FindsKeysByAtom) {
+  PdfGraph graph;
+  PdfLexer lex("<< /Type /XRef /Length 12 >>");
+  PdfValue dict = graph.parse(lex);
+  ASSERT_NE(graph.find(dict, atom::Length), nullptr);
+  EXPECT_EQ(graph.find(dict, atom::Length)->integer, 12);
+  EXPECT_EQ(graph.find(dict, atom::Filter), nullptr);
+}
@@ -0,0 +1,118 @@
+#include "object_cache.h"
+#include "pdf_parser.h"
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+// A cached object holding an int, with its own arena like the parser makes
+ObjectCache::ObjPtr put_int(ObjectCache &cache, int64_t num, int64_t value) {
+  auto arena = std::make_unique<Arena>(256);
+  auto obj = new (*arena)
+      util::PdfTopLevel(num, 0, new (*arena) util::PdfInt(value));
+  return cache.put(num, std::move(arena), obj);
+}
+
+size_t entry_size() {
+  ObjectCache cache;
+  put_int(cache, 1, 1);
+  return cache.bytes();
+}
+
+} // namespace
+
+TEST(ObjectCache, DoesItReturnCachedObjects) {
+  ObjectCache cache;
+  EXPECT_EQ(cache.get(1), nullptr);
+  put_int(cache, 1, 42);
+  auto obj = cache.get(1);
+  ASSERT_NE(obj, nullptr);
+  EXPECT_EQ(*obj->obj, util::PdfInt(42));
+  EXPECT_EQ(cache.hits(), 1u);
+  EXPECT_EQ(cache.misses(), 1u);
+}
+
+TEST(ObjectCache, DoesItEvictTheLeastRecentlyUsedObject) {
+  ObjectCache cache(entry_size() * 2);
+  put_int(cache, 1, 1);
+  put_int(cache, 2, 2);
+  cache.get(1); // 2 is now the oldest
+  put_int(cache, 3, 3);
+
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(cache.evictions(), 1u);
+  EXPECT_NE(cache.get(1), nullptr);
+  EXPECT_EQ(cache.get(2), nullptr);
+  EXPECT_NE(cache.get(3), nullptr);
+  EXPECT_LE(cache.bytes(), cache.budget());
+}
+
+TEST(ObjectCache, DoEvictedObjectsStayValidWhileHeld) {
+  ObjectCache cache(entry_size());
+  auto held = put_int(cache, 1, 7);
+  put_int(cache, 2, 8);
+  EXPECT_EQ(cache.get(1), nullptr);
+  EXPECT_EQ(*held->obj, util::PdfInt(7));
+}
+
+TEST(ObjectCache, DoesLoweringTheBudgetEvict) {
+  ObjectCache cache;
+  for (int i = 0; i < 10; ++i)
+    put_int(cache, i, i);
+  cache.set_budget(entry_size() * 3);
+  EXPECT_EQ(cache.size(), 3u);
+  EXPECT_NE(cache.get(9), nullptr);
+  cache.set_budget(0);
+  EXPECT_EQ(cache.size(), 0u);
+  EXPECT_EQ(cache.bytes(), 0u);
+}
+
+TEST(PdfParserResolve, DoesItFollowReferencesOnDemand) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Font 2 0 R /Missing 9 0 R /Direct 5 >>");
+  pdf.add(2, "3 0 R");
+  pdf.add(3, "<< /BaseFont /Helvetica >>");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  auto root = parser.get_object(1);
+  auto dict = root->obj->as<util::PdfDict>();
+  ASSERT_NE(dict, nullptr);
+
+  // A ref to a ref is followed all the way
+  auto font = parser.resolve(dict->pairs.get(atom::Font));
+  ASSERT_NE(font, nullptr);
+  ASSERT_NE(font->as<util::PdfDict>(), nullptr);
+  EXPECT_NE(font->as<util::PdfDict>()->pairs.get(atom::BaseFont), nullptr);
+
+  EXPECT_EQ(parser.resolve(dict->pairs.at(util::PdfName("/Missing"))), nullptr);
+  EXPECT_EQ(parser.resolve(dict->pairs.at(util::PdfName("/Direct"))).get(),
+            dict->pairs.at(util::PdfName("/Direct")));
+
+  // Only what was followed got loaded
+  EXPECT_EQ(parser.cache().size(), 3u);
+}
+
+TEST(PdfParserResolve, DoesItKeepWorkingWithATinyBudget) {
+  TestPdf pdf;
+  pdf.add(1, "[2 0 R 2 0 R]");
+  pdf.add(2, "(shared)");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  parser.cache().set_budget(0);
+  auto arr = parser.get_object(1);
+  auto first = parser.resolve(arr->obj->as<util::PdfArray>()->objects[0]);
+  auto second = parser.resolve(arr->obj->as<util::PdfArray>()->objects[1]);
+  EXPECT_EQ(*first, *second);
+  EXPECT_EQ(parser.cache().size(), 0u);
+}
+
+TEST(PdfParserResolve, DoesItRejectReferenceLoops) {
+  TestPdf pdf;
+  pdf.add(1, "1 0 R");
+  std::string data = pdf.finish_with_table("");
+  PdfParser parser(data);
+  util::PdfRef ref(1, 0);
+  EXPECT_THROW(parser.resolve(&ref), std::runtime_error);
+}
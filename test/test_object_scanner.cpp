@@ -0,0 +1,68 @@
+#include "object_scanner.h"
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(ObjectScanner, DoesItYieldEveryObjectInOrder) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [] /Count 0 >>");
+  pdf.add_stream(3, "", "some bytes");
+  pdf.finish_with_table("/Root 1 0 R");
+
+  std::vector<int64_t> nums;
+  ObjectScanner scanner(pdf.data);
+  for (const util::PdfTopLevel &obj : scanner)
+    nums.push_back(obj.num);
+  EXPECT_EQ(nums, (std::vector<int64_t>{1, 2, 3}));
+  EXPECT_EQ(scanner.errors(), 0u);
+}
+
+TEST(ObjectScanner, DoesItReportWhereEachObjectStarts) {
+  std::string data = "%PDF-1.7\n% comment 9 0 obj\n4 0 obj\n(four)\nendobj\n";
+  ObjectScanner scanner(data);
+  const util::PdfTopLevel *obj = scanner.next();
+  ASSERT_NE(obj, nullptr);
+  EXPECT_EQ(obj->num, 4);
+  EXPECT_EQ(scanner.offset(), data.find("4 0 obj"));
+  EXPECT_EQ(*obj->obj, util::PdfString("four"));
+  EXPECT_EQ(scanner.next(), nullptr);
+  EXPECT_EQ(scanner.errors(), 0u);
+}
+
+TEST(ObjectScanner, DoesItResyncAfterADamagedObject) {
+  std::string data = "%PDF-1.7\n"
+                     "1 0 obj\n<< /A [1 2 >>\nendobj\n"
+                     "2 0 obj\n(two)\nendobj\n"
+                     "3 0 obj\n<< /Broken";
+  ObjectScanner scanner(data);
+  std::vector<int64_t> nums;
+  for (const util::PdfTopLevel &obj : scanner)
+    nums.push_back(obj.num);
+  EXPECT_EQ(nums, std::vector<int64_t>{2});
+  EXPECT_EQ(scanner.errors(), 2u);
+}
+
+TEST(ObjectScanner, DoesItSkipAnObjectNestedTooDeep) {
+  // Deep enough to run off the stack if the parser had no limit
+  std::string data = "%PDF-1.7\n1 0 obj\n<< /X " + std::string(200000, '[') +
+                     std::string(200000, ']') + " >>\nendobj\n"
+                     "2 0 obj\n(two)\nendobj\n"
+                     "3 0 obj\n[3]\nendobj\n";
+  ObjectScanner scanner(data);
+  std::vector<int64_t> nums;
+  for (const util::PdfTopLevel &obj : scanner)
+    nums.push_back(obj.num);
+  EXPECT_EQ(nums, (std::vector<int64_t>{2, 3}));
+  EXPECT_EQ(scanner.errors(), 1u);
+}
+
+TEST(ObjectScanner, DoesItIgnoreObjKeywordsThatAreNotObjects) {
+  std::string data = "endobj 5 obj xobj 1 0 objx\n7 0 obj null endobj";
+  ObjectScanner scanner(data);
+  const util::PdfTopLevel *obj = scanner.next();
+  ASSERT_NE(obj, nullptr);
+  EXPECT_EQ(obj->num, 7);
+  EXPECT_EQ(scanner.next(), nullptr);
+  EXPECT_EQ(scanner.errors(), 0u);
+}
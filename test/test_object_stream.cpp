@@ -0,0 +1,106 @@
+#include "object_stream.h"
+#include "pdf_parser.h"
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+TEST(ObjectStream, DoesItIndexAndParseTheObjectsInside) {
+  std::string header = "10 0 11 6 ";
+  std::string body = "(ten) [1 2 (x)]";
+  std::string payload = deflate_string(header + body);
+
+  util::PdfStream stream;
+  stream.dict->pairs[util::PdfName(atom::Type)] =
+      new util::PdfName(atom::ObjStm);
+  stream.dict->pairs[util::PdfName(atom::N)] = new util::PdfInt(2);
+  stream.dict->pairs[util::PdfName(atom::First)] =
+      new util::PdfInt(header.size());
+  stream.dict->pairs[util::PdfName(atom::Filter)] =
+      new util::PdfName(atom::FlateDecode);
+  stream.stream.assign(payload.begin(), payload.end());
+
+  ObjectStream objstm(stream);
+  ASSERT_EQ(objstm.size(), 2u);
+  EXPECT_EQ(objstm.number(1), 11);
+  EXPECT_EQ(objstm.find(10), 0);
+  EXPECT_EQ(objstm.find(12), -1);
+
+  Arena arena;
+  util::PdfTopLevel *obj = objstm.parse(1, arena);
+  EXPECT_EQ(obj->num, 11);
+  ASSERT_NE(obj->obj->as<util::PdfArray>(), nullptr);
+  EXPECT_EQ(obj->obj->as<util::PdfArray>()->objects.size(), 3u);
+  EXPECT_EQ(*objstm.parse(0, arena)->obj, util::PdfString("ten"));
+}
+
+TEST(ObjectStream, DoesItRejectStreamsThatAreNotObjectStreams) {
+  util::PdfStream stream;
+  EXPECT_THROW(ObjectStream objstm(stream), std::runtime_error);
+}
+
+TEST(ObjectStream, DoesItRejectHeadersThatDoNotFit) {
+  auto make = [](int64_t count, const std::string &header) {
+    util::PdfStream stream;
+    stream.dict->pairs[util::PdfName(atom::Type)] =
+        new util::PdfName(atom::ObjStm);
+    stream.dict->pairs[util::PdfName(atom::N)] = new util::PdfInt(count);
+    stream.dict->pairs[util::PdfName(atom::First)] =
+        new util::PdfInt(header.size());
+    std::string payload = header + "(body)";
+    stream.stream.assign(payload.begin(), payload.end());
+    return ObjectStream(stream);
+  };
+  EXPECT_EQ(make(1, "10 0").size(), 1u);
+  // A /N that could never fit before /First must not be used to size
+  // anything, and an offset near the top of int64 must not wrap around
+  EXPECT_THROW(make(4000000000000000000, "10 0 "), std::runtime_error);
+  EXPECT_THROW(make(1, "10 9223372036854775807 "), std::runtime_error);
+}
+
+TEST(PdfParserObjectStreams, DoesItLoadCompressedObjectsThroughTheXref) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 3 0 R >>");
+  auto placed = pdf.add_object_stream(
+      2, {{3, "<< /Type /Pages /Kids [4 0 R] /Count 1 >>"},
+          {4, "<< /Type /Page /Parent 3 0 R >>"}});
+  std::string data = pdf.finish_with_stream(5, "/Root 1 0 R", placed);
+
+  PdfParser parser(data);
+  auto page = parser.get_object(4);
+  ASSERT_NE(page, nullptr);
+  EXPECT_EQ(page->num, 4);
+  auto dict = page->obj->as<util::PdfDict>();
+  ASSERT_NE(dict, nullptr);
+  EXPECT_EQ(*dict->pairs.get(atom::Parent), util::PdfRef(3, 0));
+
+  // Both objects come out of the same decoded stream
+  auto pages = parser.resolve(dict->pairs.get(atom::Parent));
+  ASSERT_NE(pages, nullptr);
+  EXPECT_NE(pages->as<util::PdfDict>(), nullptr);
+  EXPECT_EQ(parser.object_stream(2).get(), parser.object_stream(2).get());
+  EXPECT_EQ(parser.get_object(4, 1), nullptr);
+}
+
+TEST(PdfParserObjectStreams, DoesItKeepDecodedStreamsInTheCacheBudget) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog >>");
+  std::map<int64_t, std::pair<int64_t, int64_t>> placed;
+  for (int64_t i = 0; i < 10; ++i) {
+    auto one = pdf.add_object_stream(
+        10 + i, {{100 + i, "(" + std::string(2000, 'a' + i) + ")"}});
+    placed.insert(one.begin(), one.end());
+  }
+  std::string data = pdf.finish_with_stream(2, "/Root 1 0 R", placed);
+
+  const size_t budget = 5000;
+  PdfParser parser(data, std::pmr::new_delete_resource(), budget);
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int64_t i = 0; i < 10; ++i) {
+      auto obj = parser.get_object(100 + i);
+      ASSERT_NE(obj, nullptr);
+      EXPECT_EQ(*obj->obj, util::PdfString(std::string(2000, 'a' + i)));
+      EXPECT_LE(parser.object_stream_bytes() + parser.cache().bytes(),
+                budget + 2100);
+    }
+  }
+  EXPECT_LT(parser.object_stream_bytes(), budget);
+}
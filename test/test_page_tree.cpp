@@ -0,0 +1,155 @@
+#include "page_tree.h"
+#include "pdf_parser.h"
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+TEST(PageTree, DoesItListNestedPagesInOrder) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R 4 0 R 5 0 R] /Count 4 >>");
+  pdf.add(3, "<< /Type /Page /Parent 2 0 R >>");
+  pdf.add(4, "<< /Type /Pages /Parent 2 0 R /Kids [6 0 R 7 0 R] /Count 2 >>");
+  pdf.add(5, "<< /Type /Page /Parent 2 0 R >>");
+  pdf.add(6, "<< /Type /Page /Parent 4 0 R >>");
+  pdf.add(7, "<< /Type /Page /Parent 4 0 R >>");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  PageTree pages(parser);
+  ASSERT_EQ(pages.count(), 4u);
+  EXPECT_EQ(pages.page(0).obj->num, 3);
+  EXPECT_EQ(pages.page(1).obj->num, 6);
+  EXPECT_EQ(pages.page(2).obj->num, 7);
+  EXPECT_EQ(pages.page(3).obj->num, 5);
+  EXPECT_THROW(pages.page(4), std::out_of_range);
+}
+
+TEST(PageTree, DoesItThrowOnALoop) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [2 0 R] /Count 1 >>");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  PageTree pages(parser);
+  EXPECT_THROW(pages.page(0), std::runtime_error);
+}
+
+TEST(PageTree, DoesItSkipSubtreesByTheirCount) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R 4 0 R] /Count 501 >>");
+  // The first subtree claims 500 pages but its kids are never looked at, so
+  // they do not even have to exist
+  pdf.add(3, "<< /Type /Pages /Parent 2 0 R /Kids [90 0 R] /Count 500 >>");
+  pdf.add(4, "<< /Type /Pages /Parent 2 0 R /Kids [5 0 R] /Count 1 >>");
+  pdf.add(5, "<< /Type /Page /Parent 4 0 R >>");
+  pdf.add(90, "<< broken");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  PageTree pages(parser);
+  EXPECT_EQ(pages.count(), 501u);
+  EXPECT_EQ(pages.page(500).obj->num, 5);
+  EXPECT_THROW(pages.page(0), std::runtime_error);
+  EXPECT_THROW(pages.page(501), std::out_of_range);
+}
+
+TEST(PageTree, DoesItCountNodesThatHaveNoCount) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R 4 0 R] >>");
+  pdf.add(3, "<< /Type /Page /Parent 2 0 R >>");
+  pdf.add(4, "<< /Type /Page /Parent 2 0 R >>");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  PageTree pages(parser);
+  EXPECT_EQ(pages.count(), 2u);
+  EXPECT_EQ(pages.page(1).obj->num, 4);
+}
+
+TEST(PageTree, DoesItResolveInheritedAttributes) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R] /Count 2 /MediaBox [0 0 612 792] "
+             "/Resources 6 0 R /Rotate 90 >>");
+  pdf.add(3, "<< /Type /Pages /Parent 2 0 R /Kids [4 0 R 5 0 R] /Count 2 "
+             "/Rotate 180 >>");
+  pdf.add(4, "<< /Type /Page /Parent 3 0 R >>");
+  pdf.add(5, "<< /Type /Page /Parent 3 0 R /MediaBox [0 0 100 100] >>");
+  pdf.add(6, "<< /Font << /F1 7 0 R >> >>");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  PageTree pages(parser);
+  PageTree::Page first = pages.page(0);
+  ASSERT_NE(first.media_box, nullptr);
+  EXPECT_EQ(first.media_box->as<util::PdfArray>()->objects.size(), 4u);
+  EXPECT_EQ(*first.rotate, util::PdfInt(180));
+  ASSERT_NE(first.resources, nullptr);
+  EXPECT_NE(first.resources->as<util::PdfDict>(), nullptr);
+  EXPECT_EQ(first.crop_box, nullptr);
+
+  PageTree::Page second = pages.page(1);
+  EXPECT_EQ(*second.media_box->as<util::PdfArray>()->objects[2],
+            util::PdfInt(100));
+
+  // Inherited values stay valid even once the cache has let go of the nodes
+  parser.cache().clear();
+  EXPECT_EQ(*first.rotate, util::PdfInt(180));
+}
+
+TEST(PageTree, DoesItGoThroughAFlatKidsArrayOnceForEveryPage) {
+  const int count = 2000;
+  TestPdf pdf;
+  std::string kids;
+  for (int i = 0; i < count; ++i)
+    kids += std::to_string(10 + i) + " 0 R ";
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [" + kids + "] /Count " +
+                 std::to_string(count) + " >>");
+  for (int i = 0; i < count; ++i)
+    pdf.add(10 + i, "<< /Type /Page /Parent 2 0 R >>");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  PageTree pages(parser);
+  for (int i = 0; i < count; ++i)
+    ASSERT_EQ(pages.page(i).obj->num, 10 + i);
+  EXPECT_EQ(pages.page(count / 2).obj->num, 10 + count / 2);
+  // Each kid is counted once, then each page is one lookup of the root and
+  // one of the page. Going through the kids per page would be millions.
+  EXPECT_LT(parser.cache().hits() + parser.cache().misses(), size_t(8 * count));
+}
+
+TEST(PageTree, DoesItThrowOnSharedSubtreesWithNoCount) {
+  // Every level's two kids are the same node, so walking the counts would go
+  // through 2^40 paths
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  for (int64_t num = 2; num < 42; ++num) {
+    std::string next = std::to_string(num + 1) + " 0 R ";
+    pdf.add(num, "<< /Type /Pages /Kids [" + next + next + "] >>");
+  }
+  pdf.add(42, "<< /Type /Page >>");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  EXPECT_THROW(PageTree pages(parser), std::runtime_error);
+}
+
+TEST(PageTree, DoesItThrowOnSharedSubtreesWithACount) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R 3 0 R] /Count 2 >>");
+  pdf.add(3, "<< /Type /Pages /Kids [4 0 R] /Count 1 >>");
+  pdf.add(4, "<< /Type /Page >>");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  PageTree pages(parser);
+  EXPECT_EQ(pages.count(), 2u);
+  EXPECT_THROW(pages.page(0), std::runtime_error);
+  EXPECT_THROW(pages.page_numbers(), std::runtime_error);
+}
@@ -0,0 +1,154 @@
+#include "lexer.h"
+#include "pdf_events.h"
+#include "utility.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Writes every event as a short word so a whole parse can be compared at once
+class Recorder : public PdfEventHandler {
+public:
+  std::string log;
+
+  void null_value() override { add("null"); }
+  void bool_value(bool b) override { add(b ? "true" : "false"); }
+  void int_value(int64_t i) override { add("int:" + std::to_string(i)); }
+  void real_value(double) override { add("real"); }
+  void name_value(std::string_view n) override {
+    add("name:" + std::string(n));
+  }
+  void string_value(std::string_view s, bool hex) override {
+    add((hex ? "hex:" : "str:") + std::string(s));
+  }
+  void ref_value(int64_t num, int64_t gen) override {
+    add("ref:" + std::to_string(num) + "," + std::to_string(gen));
+  }
+  void begin_array() override { add("["); }
+  void end_array() override { add("]"); }
+  void begin_dict() override { add("<<"); }
+  void key(std::string_view k) override { add("key:" + std::string(k)); }
+  void end_dict() override { add(">>"); }
+  void begin_stream() override { add("stream"); }
+  void stream_data(std::string_view d) override {
+    add("data:" + std::to_string(d.size()));
+  }
+  void end_stream() override { add("endstream"); }
+  void begin_object(int64_t num, int64_t) override {
+    add("obj:" + std::to_string(num));
+  }
+  void end_object() override { add("endobj"); }
+
+private:
+  void add(const std::string &event) {
+    if (!log.empty())
+      log += " ";
+    log += event;
+  }
+};
+
+// Counts /Type /Page dicts without building anything
+class PageCounter : public PdfEventHandler {
+public:
+  int pages = 0;
+  void key(std::string_view k) override { after_type = k == "/Type"; }
+  void name_value(std::string_view n) override {
+    if (after_type && n == "/Page")
+      ++pages;
+    after_type = false;
+  }
+
+private:
+  bool after_type = false;
+};
+
+} // namespace
+
+TEST(PdfEventParser, DoesItReportEveryPartOfAnObject) {
+  PdfLexer lex("7 0 obj << /A [1 2.5 (s) <6869> null true] /B 3 0 R >> endobj");
+  PdfEventParser events(lex);
+  Recorder recorder;
+  events.parse_object(recorder);
+  EXPECT_EQ(recorder.log, "obj:7 << key:/A [ int:1 real str:s hex:6869 null "
+                          "true ] key:/B ref:3,0 >> endobj");
+}
+
+TEST(PdfEventParser, DoesItReportStreamsInChunks) {
+  std::string payload(PdfEventParser::STREAM_CHUNK_SIZE + 10, 'x');
+  std::string data = "<< /Length " + std::to_string(payload.size()) +
+                     " >>\nstream\n" + payload + "\nendstream";
+  PdfLexer lex(data);
+  PdfEventParser events(lex);
+  Recorder recorder;
+  events.parse_object(recorder);
+  EXPECT_EQ(recorder.log, "<< key:/Length int:" +
+                              std::to_string(payload.size()) +
+                              " stream data:65536 data:10 endstream");
+}
+
+TEST(PdfEventParser, CanAHandlerFindPagesWithoutBuildingObjects) {
+  PdfLexer lex("[<< /Type /Pages /Kids [<< /Type /Page >> << /Type /Page >>] >>"
+               " << /Type /Font >> << /Subtype /Page >>]");
+  PdfEventParser events(lex);
+  PageCounter counter;
+  events.parse_object(counter);
+  EXPECT_EQ(counter.pages, 2);
+}
+
+TEST(PdfEventParser, DoesItThrowAfterTheEventsBeforeTheError) {
+  PdfLexer lex("[1 /Two");
+  PdfEventParser events(lex);
+  Recorder recorder;
+  EXPECT_THROW(events.parse_object(recorder), std::runtime_error);
+  EXPECT_EQ(recorder.log, "[ int:1 name:/Two");
+}
+
+TEST(PdfEventParser, DoesTheDomParserCleanUpWhenItFails) {
+  // Nothing leaks when a half built tree is thrown away, ASan checks this
+  PdfLexer lex("<< /A [1 2 << /B (x) /C");
+  EXPECT_THROW(util::parse_pdf_obj(lex), std::runtime_error);
+  PdfLexer obj("4 0 obj << /S 1 0 R >>\nstream\nabc\nendstream endobj");
+  std::unique_ptr<util::PdfObj> parsed(util::parse_pdf_obj(obj));
+  auto top = parsed->as<util::PdfTopLevel>();
+  ASSERT_NE(top, nullptr);
+  ASSERT_NE(top->obj->as<util::PdfStream>(), nullptr);
+  EXPECT_EQ(top->obj->as<util::PdfStream>()->bytes(), "abc");
+}
+
+TEST(PdfEventParser, DoesItThrowOnObjectsNestedTooDeep) {
+  const size_t limit = PdfEventParser::MAX_NESTING_DEPTH;
+  // The limit itself is fine, counting the object and the dict around it
+  std::string fits = "1 0 obj << /X " + std::string(limit - 2, '[') +
+                     std::string(limit - 2, ']') + " >> endobj";
+  PdfLexer fits_lex(fits);
+  std::unique_ptr<util::PdfObj> parsed(util::parse_pdf_obj(fits_lex));
+  EXPECT_NE(parsed, nullptr);
+
+  std::string deep = "1 0 obj << /X " + std::string(limit - 1, '[') +
+                     std::string(limit - 1, ']') + " >> endobj";
+  PdfLexer deep_lex(deep);
+  EXPECT_THROW(util::parse_pdf_obj(deep_lex), std::runtime_error);
+
+  // Far past the limit, which would run off the stack without it
+  std::string huge = "1 0 obj << /X " + std::string(200000, '[') + " >> endobj";
+  size_t next = huge.size();
+  huge += " [[1]]";
+  PdfLexer huge_lex(huge);
+  PdfEventParser events(huge_lex);
+  PdfEventHandler ignore;
+  try {
+    events.parse_object(ignore);
+    FAIL() << "expected a parse error";
+  } catch (const std::runtime_error &e) {
+    EXPECT_NE(std::string(e.what()).find("nested too deep"),
+              std::string::npos);
+  }
+
+  // The depth is back to zero after the error, so the parser can go on
+  huge_lex.seek(next);
+  Recorder recorder;
+  events.parse_object(recorder);
+  EXPECT_EQ(recorder.log, "[ [ int:1 ] ]");
+}
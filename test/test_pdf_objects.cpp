@@ -123,3 +123,19 @@ TEST(PdfTopLevel, DoesItWriteItsValueToTheStream) {
                          "endobj\n";
   EXPECT_EQ(os.str(), expected);
 }
+
+TEST(PdfObj, DoesItCompareAndCastByTypeTag) {
+  PdfArray array;
+  PdfDict dict;
+  PdfInt num(1);
+  EXPECT_EQ(array.type, PdfType::Array);
+  EXPECT_FALSE(array == dict);
+  EXPECT_FALSE(dict == array);
+  EXPECT_FALSE(num == PdfReal(1));
+  EXPECT_TRUE(num == PdfInt(1));
+
+  const PdfObj &obj = num;
+  EXPECT_EQ(obj.as<PdfInt>(), &num);
+  EXPECT_EQ(obj.as<PdfReal>(), nullptr);
+  EXPECT_EQ(obj.as<PdfDict>(), nullptr);
+}
@@ -1,5 +1,7 @@
 #include "pdf_parser.h"
+#include "test_helpers.h"
 #include "utility.h"
+#include <atomic>
 #include <gtest/gtest.h>
 #include <memory>
 #include <sstream>
@@ -135,3 +137,186 @@ TEST(ParsePdfObj, DoesItReadAWellFormedTopLevelObjFromTheStartOfTheStream) {
 }
 
 }; // namespace util
+
+// Streaming inflate //////////////////////////////////////////////////////////
+
+TEST(PdfParserInflate, DoesItInflateStreamsBiggerThanOneBuffer) {
+  std::string content;
+  while (content.size() < 300 * 1024)
+    content += "BT /F1 12 Tf (" + std::to_string(content.size()) + ") Tj ET\n";
+
+  std::string doc =
+      "%PDF-1.7\n1 0 obj\n<< /Filter /FlateDecode >>\nstream\r\n" +
+      deflate_string(content) + "\nendstream\nendobj\n%%EOF\n";
+  std::ostringstream os;
+  PdfParser(doc).inflate_to(os);
+
+  std::string expected = "%PDF-1.7\n1 0 obj\n<< /Filter /FlateDecode >>\n"
+                         "stream\r\n" +
+                         content + "\nendstream\nendobj\n%%EOF\n";
+  EXPECT_EQ(os.str(), expected);
+  EXPECT_EQ(PdfParser(doc).naive_inflate(), expected);
+}
+
+TEST(PdfParserInflate, DoesItPassThroughStreamsThatAreNotDeflate) {
+  std::string doc = "1 0 obj\n<< >>\nstream\nplain text\nendstream\nendobj\n"
+                    "2 0 obj\n<< >>\nstream\n" +
+                    deflate_string("small") + "\nendstream\nendobj\n";
+  std::ostringstream os;
+  PdfParser(doc).inflate_to(os);
+  EXPECT_EQ(os.str(), "1 0 obj\n<< >>\nstream\nplain text\nendstream\nendobj\n"
+                      "2 0 obj\n<< >>\nstream\nsmall\nendstream\nendobj\n");
+}
+
+TEST(PdfParserInflate, DoesTheParallelVersionMatchTheSequentialOne) {
+  std::string doc = "%PDF-1.7\n";
+  for (int i = 0; i < 50; ++i) {
+    std::string content(1000 * i, static_cast<char>('a' + i % 26));
+    doc += std::to_string(i + 1) + " 0 obj\n<< >>\nstream\n" +
+           (i % 7 == 0 ? content : deflate_string(content)) +
+           "\nendstream\nendobj\n";
+  }
+  doc += "%%EOF\n";
+
+  std::ostringstream sequential;
+  PdfParser(doc).inflate_to(sequential);
+  for (size_t threads : {1, 3}) {
+    std::ostringstream parallel;
+    PdfParser(doc).parallel_inflate_to(parallel, threads);
+    EXPECT_EQ(parallel.str(), sequential.str());
+  }
+}
+
+TEST(PdfParserInflate, DoesItOnlyTakeStreamKeywordsAfterADict) {
+  // The word stream in a string, and a payload that holds endstream, used to
+  // throw the text search off
+  std::string content = "BT (page) Tj ET";
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Note (upstream and endstream) >>");
+  pdf.add_stream(2, "/Filter /FlateDecode", deflate_string(content));
+  pdf.add_stream(3, "", "raw endstream bytes");
+  std::string doc = pdf.finish_with_table("/Root 1 0 R");
+
+  std::string expected = doc;
+  std::string payload = deflate_string(content);
+  expected.replace(expected.find(payload), payload.size(), content);
+  std::ostringstream sequential;
+  PdfParser(doc).inflate_to(sequential);
+  EXPECT_EQ(sequential.str(), expected);
+  for (size_t threads : {1, 4}) {
+    std::ostringstream parallel;
+    PdfParser(doc).parallel_inflate_to(parallel, threads);
+    EXPECT_EQ(parallel.str(), expected);
+  }
+}
+
+namespace {
+
+// The table holds graph values, so compare them as the PdfObj the parser
+// would give for the same object
+void expect_same_object(const ObjectTable &table, PdfParser &parser,
+                        int64_t num) {
+  const ObjectTable::Object *obj = table.get(num);
+  ASSERT_NE(obj, nullptr);
+  EXPECT_EQ(obj->num, num);
+  std::unique_ptr<util::PdfObj> value(obj->graph->to_obj(obj->value));
+  EXPECT_EQ(*value, *parser.get_object(num)->obj);
+}
+
+} // namespace
+
+TEST(PdfParserParseAll, DoesItParseEveryObjectInTheXref) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+  pdf.add(3, "<< /Type /Page /Parent 2 0 R >>");
+  pdf.add(4, "42");
+  pdf.add_stream(5, "/Length 4 0 R", "not really 42 bytes");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  ObjectTable table = parser.parse_all(2);
+  EXPECT_EQ(table.size(), 5u);
+  EXPECT_TRUE(table.damaged().empty());
+  for (int64_t num = 1; num <= 5; ++num)
+    expect_same_object(table, parser, num);
+  EXPECT_EQ(table.get(0), nullptr);
+  EXPECT_EQ(table.get(6), nullptr);
+}
+
+TEST(PdfParserParseAll, DoesItUnpackObjectStreams) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 3 0 R >>");
+  auto placed = pdf.add_object_stream(
+      2, {{3, "<< /Type /Pages /Kids [4 0 R] /Count 1 >>"},
+          {4, "<< /Type /Page /Parent 3 0 R >>"}});
+  std::string data = pdf.finish_with_stream(5, "/Root 1 0 R", placed);
+
+  PdfParser parser(data);
+  ThreadPool pool(3);
+  ObjectTable table = parser.parse_all(pool);
+  expect_same_object(table, parser, 4);
+  expect_same_object(table, parser, 3);
+  EXPECT_NE(table.get(5), nullptr);
+  EXPECT_TRUE(table.damaged().empty());
+}
+
+namespace {
+
+// Counts the bytes it hands out so a test can see who allocates from it
+class CountingResource : public std::pmr::memory_resource {
+public:
+  std::atomic<size_t> allocated{0};
+
+private:
+  void *do_allocate(size_t bytes, size_t align) override {
+    allocated += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, align);
+  }
+  void do_deallocate(void *p, size_t bytes, size_t align) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+  }
+  bool do_is_equal(const memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+} // namespace
+
+TEST(PdfParserParseAll, DoesItParseIntoTheParsersMemory) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 3 0 R >>");
+  auto placed = pdf.add_object_stream(
+      2, {{3, "<< /Type /Pages /Kids [4 0 R] /Count 1 >>"},
+          {4, "<< /Type /Page /Parent 3 0 R >>"}});
+  std::string data = pdf.finish_with_stream(5, "/Root 1 0 R", placed);
+
+  CountingResource memory;
+  PdfParser parser(data, &memory);
+  parser.xref();
+  size_t before = memory.allocated;
+  {
+    ObjectTable table = parser.parse_all(2);
+    ASSERT_NE(table.get(4), nullptr);
+    EXPECT_TRUE(table.damaged().empty());
+  }
+  // One chunk of direct objects and one object stream, each with a graph that
+  // keeps its nodes there
+  EXPECT_GE(memory.allocated - before, 2u * sizeof(PdfValue));
+}
+
+TEST(PdfParserParseAll, DoesItListDamagedObjectsAndKeepGoing) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog >>");
+  pdf.add(2, "<< /Broken [1 2 >>");
+  pdf.add(3, "(fine)");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  ObjectTable table = parser.parse_all(1);
+  EXPECT_EQ(table.size(), 2u);
+  EXPECT_EQ(table.damaged(), std::vector<int64_t>{2});
+  EXPECT_EQ(table.get(2), nullptr);
+  ASSERT_NE(table.get(3), nullptr);
+  EXPECT_EQ(table.get(3)->value.str(), "fine");
+}
@@ -0,0 +1,207 @@
+#include "lexer.h"
+#include "pdf_events.h"
+#include "pdf_value.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+TEST(PdfValue, ParsesScalarsInline) {
+  PdfGraph graph;
+  PdfLexer lex("42 -1.5 true null /Name (str) 12 0 R");
+
+  PdfValue v = graph.parse(lex);
+  EXPECT_EQ(v.type, util::PdfType::Int);
+  EXPECT_EQ(v.integer, 42);
+
+  v = graph.parse(lex);
+  EXPECT_EQ(v.type, util::PdfType::Real);
+  EXPECT_EQ(v.real, -1.5);
+
+  v = graph.parse(lex);
+  EXPECT_EQ(v.type, util::PdfType::Bool);
+  EXPECT_TRUE(v.boolean);
+
+  EXPECT_EQ(graph.parse(lex).type, util::PdfType::Null);
+
+  v = graph.parse(lex);
+  EXPECT_EQ(v.type, util::PdfType::Name);
+  EXPECT_EQ(v.str(), "/Name");
+
+  v = graph.parse(lex);
+  EXPECT_EQ(v.type, util::PdfType::String);
+  EXPECT_EQ(v.str(), "str");
+
+  v = graph.parse(lex);
+  EXPECT_EQ(v.type, util::PdfType::Ref);
+  EXPECT_EQ(v.integer, 12);
+  EXPECT_EQ(v.gen, 0);
+
+  // None of the scalars needed any child storage
+  EXPECT_EQ(graph.node_count(), 0);
+}
+
+TEST(PdfValue, StoresChildrenContiguously) {
+  PdfGraph graph;
+  PdfLexer lex("<< /Kids [ 1 0 R 2 0 R [ 3 ] ] /Count 2 >>");
+  PdfValue dict = graph.parse(lex);
+  ASSERT_EQ(dict.type, util::PdfType::Dict);
+  EXPECT_EQ(dict.size, 2);
+
+  const PdfValue *kids = graph.find(dict, "/Kids");
+  ASSERT_NE(kids, nullptr);
+  PdfArrayValue items = graph.array(*kids);
+  ASSERT_EQ(items.size, 3);
+  EXPECT_EQ(items.items[1].integer, 2);
+  EXPECT_EQ(graph.array(items.items[2]).items[0].integer, 3);
+
+  EXPECT_EQ(graph.find(dict, "/Count")->integer, 2);
+  EXPECT_EQ(graph.find(dict, "/Missing"), nullptr);
+}
+
+TEST(PdfValue, WritesLikeTheObjectClasses) {
+  PdfGraph graph;
+  PdfLexer lex("<< /A [ null true 1.5 (a\\)b) ] /B 3 0 R >>");
+  PdfValue v = graph.parse(lex);
+
+  std::stringstream os;
+  graph.write(os, v);
+  EXPECT_EQ(os.str(), "<< /A [ null true 1.5 (a\\)b) ] /B 3 0 R >>");
+}
+
+TEST(PdfValue, ParsesStreamsAsADictAndAPayload) {
+  PdfGraph graph;
+  PdfLexer lex("<< /Length 5 >>\nstream\nHello\nendstream");
+  PdfValue v = graph.parse(lex);
+  ASSERT_EQ(v.type, util::PdfType::Stream);
+  EXPECT_EQ(graph.stream(v).payload, "Hello");
+  EXPECT_EQ(graph.find(v, "/Length")->integer, 5);
+}
+
+TEST(PdfValue, ComparesAcrossGraphsIgnoringKeyOrder) {
+  PdfGraph a, b;
+  PdfLexer la("<< /X 1 /Y [ /Z ] >>");
+  PdfLexer lb("<< /Y [ /Z ] /X 1 >>");
+  PdfLexer lc("<< /Y [ /Z ] /X 2 >>");
+  PdfValue va = a.parse(la);
+  PdfValue vb = b.parse(lb);
+  PdfValue vc = b.parse(lc);
+  EXPECT_TRUE(values_equal(a, va, b, vb));
+  EXPECT_FALSE(values_equal(a, va, b, vc));
+}
+
+struct ValueCounter {
+  int ints = 0, reals = 0, others = 0;
+  void operator()(int64_t) { ++ints; }
+  void operator()(double) { ++reals; }
+  template <typename T> void operator()(const T &) { ++others; }
+};
+
+TEST(PdfValue, VisitsByType) {
+  PdfGraph graph;
+  PdfLexer lex("[ 1 2.5 /N ]");
+  PdfValue v = graph.parse(lex);
+
+  ValueCounter counter;
+  for (const PdfValue &item : graph.array(v))
+    graph.visit(item, counter);
+  EXPECT_EQ(counter.ints, 1);
+  EXPECT_EQ(counter.reals, 1);
+  EXPECT_EQ(counter.others, 1);
+}
+
+TEST(PdfValue, ConvertsToTheObjectClasses) {
+  PdfGraph graph;
+  PdfLexer lex("[ 1 /N (s) ]");
+  util::PdfObj *obj = graph.to_obj(graph.parse(lex));
+
+  util::PdfArray expected;
+  expected.objects.push_back(new util::PdfInt(1));
+  expected.objects.push_back(new util::PdfName("/N"));
+  expected.objects.push_back(new util::PdfString("s"));
+  EXPECT_EQ(*obj, expected);
+  delete obj;
+}
+
+TEST(PdfValue, ParsesIndirectObjects) {
+  PdfGraph graph;
+  PdfLexer lex("7 2 obj\n[ 1 2 ]\nendobj");
+  PdfValue v = graph.parse(lex);
+  ASSERT_EQ(v.type, util::PdfType::TopLevel);
+  PdfObjectValue top = graph.object(v);
+  EXPECT_EQ(top.num, 7);
+  EXPECT_EQ(top.gen, 2);
+  EXPECT_EQ(graph.array(top.value).size, 2);
+
+  std::stringstream os;
+  graph.write(os, v);
+  EXPECT_EQ(os.str(), "7 2 obj\n[ 1 2 ]\nendobj\n");
+}
+
+TEST(PdfValue, CopiesTextWhenTheInputIsNotStable) {
+  PdfGraph graph;
+  std::string data = "[ (abc) (a\\)b) ]";
+  PdfLexer lex(data, false);
+  PdfValue v = graph.parse(lex);
+  data.assign(data.size(), 'x');
+
+  PdfArrayValue items = graph.array(v);
+  ASSERT_EQ(items.size, 2);
+  EXPECT_EQ(items.items[0].str(), "abc");
+  EXPECT_EQ(items.items[1].str(), "a)b");
+}
+
+TEST(PdfValue, JoinsStreamPayloadsBackTogether) {
+  PdfGraph graph;
+  std::string payload(PdfEventParser::STREAM_CHUNK_SIZE * 2 + 10, 'z');
+  std::string data = "<< /Length " + std::to_string(payload.size()) +
+                     " >>\nstream\n" + payload + "\nendstream";
+  PdfLexer lex(data);
+  PdfValue v = graph.parse(lex);
+  PdfStreamValue s = graph.stream(v);
+  EXPECT_EQ(s.payload, payload);
+  // Borrowed from the input rather than copied
+  EXPECT_EQ(s.payload.data(), data.data() + data.find('z'));
+}
+
+TEST(PdfValue, UsesTheLastOfARepeatedKey) {
+  PdfGraph graph;
+  PdfLexer lex("<< /A 1 /A 2 >>");
+  PdfValue v = graph.parse(lex);
+  EXPECT_EQ(graph.find(v, "/A")->integer, 2);
+
+  std::unique_ptr<util::PdfObj> obj(graph.to_obj(v));
+  util::PdfDict expected;
+  expected.pairs[util::PdfName("/A")] = new util::PdfInt(2);
+  EXPECT_EQ(*obj, expected);
+}
+
+TEST(PdfValue, ThrowsOnBadInput) {
+  PdfGraph graph;
+  PdfLexer unclosed("[ 1 2");
+  EXPECT_THROW(graph.parse(unclosed), std::runtime_error);
+  PdfLexer big_gen("1 70000 R");
+  EXPECT_THROW(graph.parse(big_gen), std::runtime_error);
+  std::string deep(PdfEventParser::MAX_NESTING_DEPTH + 1, '[');
+  PdfLexer nested(deep);
+  EXPECT_THROW(graph.parse(nested), std::runtime_error);
+
+  // The graph is still usable after a failed parse
+  PdfLexer fine("[ 3 ]");
+  PdfValue v = graph.parse(fine);
+  ASSERT_EQ(graph.array(v).size, 1);
+  EXPECT_EQ(graph.array(v).items[0].integer, 3);
+}
+
+TEST(PdfValue, GivesEmptyViewsForTheWrongKind) {
+  PdfGraph graph;
+  PdfLexer lex("42");
+  PdfValue v = graph.parse(lex);
+  EXPECT_EQ(graph.array(v).size, 0);
+  EXPECT_EQ(graph.dict(v).size, 0);
+  EXPECT_EQ(graph.stream(v).payload, "");
+  EXPECT_EQ(graph.stream(v).dict.type, util::PdfType::Null);
+  EXPECT_EQ(graph.object(v).value.type, util::PdfType::Null);
+  EXPECT_EQ(graph.find(v, "/A"), nullptr);
+}
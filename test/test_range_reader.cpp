@@ -0,0 +1,220 @@
+#include "pdf_parser.h"
+#include "range_reader.h"
+#include "test_helpers.h"
+#include "text_extract.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+
+namespace {
+
+// A backend over bytes in memory that remembers what it was asked for, the
+// way a test double for an HTTP backend would look
+class MemoryReader : public RangeReader {
+public:
+  explicit MemoryReader(std::string bytes) : data(std::move(bytes)) {}
+
+  uint64_t size() const override { return data.size(); }
+  void read(const std::vector<ReadRequest> &requests) override {
+    ++batches;
+    for (const ReadRequest &request : requests) {
+      EXPECT_LE(request.offset + request.length, data.size());
+      data.copy(request.dest, request.length, request.offset);
+      reads.push_back({request.offset, request.length});
+    }
+  }
+
+  std::string data;
+  size_t batches = 0;
+  std::vector<ByteRange> reads;
+};
+
+struct TempFile {
+  std::string path;
+  TempFile(const std::string &name, const std::string &data)
+      : path(::testing::TempDir() + name) {
+    std::ofstream os(path, std::ios::binary | std::ios::trunc);
+    os << data;
+  }
+  ~TempFile() { std::remove(path.c_str()); }
+};
+
+std::string numbered_bytes(size_t size) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; ++i)
+    data[i] = static_cast<char>('a' + (i * 7) % 26);
+  return data;
+}
+
+// Pages with their own fonts and content, padded so each object lands in a
+// different block of a small block size
+std::string paged_document(int pages) {
+  TestPdf pdf;
+  std::string padding(200, ' ');
+  std::string kids;
+  for (int i = 0; i < pages; ++i)
+    kids += std::to_string(10 + i * 3) + " 0 R ";
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [" + kids + "] /Count " +
+                 std::to_string(pages) + " >>");
+  for (int i = 0; i < pages; ++i) {
+    int page = 10 + i * 3;
+    pdf.add(page, "<< /Type /Page /Parent 2 0 R /Resources << /Font << /F1 " +
+                      std::to_string(page + 1) + " 0 R >> >> /Contents " +
+                      std::to_string(page + 2) + " 0 R >>" + padding);
+    pdf.add(page + 1, "<< /Type /Font /BaseFont /Helvetica >>" + padding);
+    pdf.add_stream(page + 2, "/Filter /FlateDecode",
+                   deflate_string("BT (page " + std::to_string(i + 1) +
+                                  ") Tj ET"));
+  }
+  return pdf.finish_with_table("/Root 1 0 R");
+}
+
+} // namespace
+
+TEST(RangedSource, DoesItOnlyReadTheBlocksAskedFor) {
+  auto reader = std::make_unique<MemoryReader>(numbered_bytes(1000));
+  MemoryReader *backend = reader.get();
+  RangedSource source(std::move(reader), 100);
+
+  source.fetch({{150, 10}, {420, 100}});
+  EXPECT_TRUE(source.has(100, 100));
+  EXPECT_TRUE(source.has(400, 200));
+  EXPECT_FALSE(source.has(0, 1));
+  EXPECT_FALSE(source.complete());
+  EXPECT_EQ(source.bytes().substr(150, 10), backend->data.substr(150, 10));
+  EXPECT_EQ(source.bytes()[0], '\0');
+  // Both ranges go out in one batch, and the two neighbouring blocks of the
+  // second range are one read
+  EXPECT_EQ(backend->batches, 1u);
+  ASSERT_EQ(backend->reads.size(), 2u);
+  EXPECT_EQ(backend->reads[1].offset, 400u);
+  EXPECT_EQ(backend->reads[1].length, 200u);
+
+  // Blocks that are there are never read again
+  source.fetch(180, 20);
+  EXPECT_EQ(backend->batches, 1u);
+  source.fetch_all();
+  EXPECT_TRUE(source.complete());
+  EXPECT_EQ(source.bytes(), backend->data);
+  EXPECT_EQ(source.bytes_fetched(), 1000u);
+}
+
+TEST(RangedSource, DoesItReadFilesWithEveryBackend) {
+  std::string data = numbered_bytes(300000);
+  TempFile file("range_reader_file.bin", data);
+
+  std::vector<std::unique_ptr<RangeReader>> readers;
+  readers.push_back(std::make_unique<FileRangeReader>(file.path));
+#ifdef __linux__
+  // A small queue depth so the batch has to be refilled as reads complete
+  if (auto uring = UringRangeReader::open(file.path, 4))
+    readers.push_back(std::move(uring));
+#endif
+  readers.push_back(open_range_reader(file.path));
+
+  for (auto &reader : readers) {
+    EXPECT_EQ(reader->size(), data.size());
+    RangedSource source(std::move(reader), 4096);
+    std::vector<ByteRange> scattered;
+    for (uint64_t offset = 0; offset < data.size(); offset += 25000)
+      scattered.push_back({offset, 10});
+    source.fetch(scattered);
+    for (const ByteRange &range : scattered)
+      EXPECT_EQ(source.bytes().substr(range.offset, 10),
+                data.substr(range.offset, 10));
+    source.fetch_all();
+    EXPECT_EQ(source.bytes(), data);
+  }
+}
+
+TEST(RangedSource, DoesItThrowWhenTheFileIsMissing) {
+  EXPECT_THROW(open_range_reader("test/assets/not_a_file.pdf"),
+               std::ios_base::failure);
+}
+
+TEST(RangedParser, DoesItLoadObjectsWithoutReadingTheWholeFile) {
+  std::string data = paged_document(20);
+  auto reader = std::make_unique<MemoryReader>(data);
+  RangedSource source(std::move(reader), 256);
+  PdfParser ranged(source);
+  PdfParser plain(data);
+
+  ObjectCache::ObjPtr font = ranged.get_object(41);
+  ASSERT_NE(font, nullptr);
+  EXPECT_EQ(*font->obj, *plain.get_object(41)->obj);
+  EXPECT_LT(source.bytes_fetched(), data.size() / 2);
+  EXPECT_EQ(ranged.xref().size(), plain.xref().size());
+}
+
+TEST(RangedParser, DoesItPrefetchAPageInABatchPerLevel) {
+  std::string data = paged_document(20);
+  auto reader = std::make_unique<MemoryReader>(data);
+  MemoryReader *backend = reader.get();
+  RangedSource source(std::move(reader), 256);
+  PdfParser parser(source);
+  parser.xref();
+
+  size_t before = backend->batches;
+  // The page, then its font and contents together. The page tree above it is
+  // not followed.
+  parser.prefetch_closure({13});
+  EXPECT_EQ(backend->batches - before, 2u);
+  EXPECT_FALSE(source.has(data.find("2 0 obj"), 1));
+
+  before = backend->batches;
+  ASSERT_NE(parser.get_object(14), nullptr);
+  ASSERT_NE(parser.get_object(15), nullptr);
+  EXPECT_EQ(backend->batches, before);
+}
+
+TEST(RangedParser, DoesItExtractTheSameTextAsAMappedParser) {
+  std::string data = paged_document(12);
+  RangedSource source(std::make_unique<MemoryReader>(data), 128);
+  PdfParser ranged(source);
+  PdfParser plain(data);
+
+  std::ostringstream from_ranged, from_plain;
+  extract_text(ranged, from_ranged, PageRange::parse("3-5"));
+  extract_text(plain, from_plain, PageRange::parse("3-5"));
+  EXPECT_EQ(from_ranged.str(), from_plain.str());
+  EXPECT_EQ(from_ranged.str(), "page 3\n\fpage 4\n\fpage 5\n\f");
+  EXPECT_FALSE(source.complete());
+
+  // Whole document work reads the rest first
+  ObjectTable table = ranged.parse_all(2);
+  EXPECT_TRUE(source.complete());
+  EXPECT_EQ(table.damaged().size(), 0u);
+}
+
+TEST(RangedParser, DoesItFallBackWhenAnObjectRunsPastItsNeighbour) {
+  // Object 2 is listed at its offset but its stream runs over the place where
+  // the xref says object 3 starts, so its first fetch is too short. The end
+  // of its stream is in the tail that was fetched for the xref, so it would
+  // parse with zeros for a payload if nothing checked.
+  std::string payload(20000, 'x');
+  std::string data = "%PDF-1.7\n";
+  size_t one = data.size();
+  data += "1 0 obj\n<< /Type /Catalog >>\nendobj\n";
+  size_t two = data.size();
+  data += "2 0 obj\n<< /Length " + std::to_string(payload.size()) +
+          " >>\nstream\n" + payload + "\nendstream\nendobj\n";
+  size_t xref = data.size();
+  char line[64];
+  data += "xref\n0 4\n0000000000 65535 f\r\n";
+  std::snprintf(line, sizeof(line), "%010zu 00000 n\r\n", one);
+  data += line;
+  std::snprintf(line, sizeof(line), "%010zu 00000 n\r\n", two);
+  data += line;
+  std::snprintf(line, sizeof(line), "%010zu 00000 n\r\n", two + 40);
+  data += line;
+  data += "trailer\n<< /Size 4 /Root 1 0 R >>\nstartxref\n" +
+          std::to_string(xref) + "\n%%EOF\n";
+
+  RangedSource source(std::make_unique<MemoryReader>(data), 16);
+  PdfParser parser(source);
+  ObjectCache::ObjPtr stream = parser.get_object(2);
+  ASSERT_NE(stream, nullptr);
+  EXPECT_EQ(stream->obj->as<util::PdfStream>()->bytes(), payload);
+}
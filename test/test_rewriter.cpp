@@ -0,0 +1,129 @@
+#include "filters.h"
+#include "pdf_parser.h"
+#include "rewriter.h"
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+TEST(RewriteDocument, DoesItFlattenObjectStreamsIntoAClassicXref) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 3 0 R >>");
+  auto placed = pdf.add_object_stream(
+      2, {{3, "<< /Type /Pages /Kids [4 0 R] /Count 1 >>"},
+          {4, "<< /Type /Page /Parent 3 0 R /Rotate 90.5 >>"}});
+  pdf.add_stream(6, "", "binary\r\n(data)");
+  std::string data = pdf.finish_with_stream(5, "/Root 1 0 R", placed);
+
+  PdfParser original(data);
+  std::ostringstream os;
+  rewrite_document(original, os);
+  std::string rewritten = os.str();
+  EXPECT_EQ(rewritten.find("/ObjStm"), std::string::npos);
+  EXPECT_EQ(rewritten.find("/XRef"), std::string::npos);
+
+  PdfParser parser(rewritten);
+  EXPECT_EQ(parser.xref().size(), original.xref().size());
+  EXPECT_EQ(*parser.xref().trailer().pairs.get(atom::Root),
+            util::PdfRef(1, 0));
+  for (int64_t num : {1, 3, 4, 6}) {
+    ASSERT_NE(parser.get_object(num), nullptr) << num;
+    EXPECT_EQ(*parser.get_object(num), *original.get_object(num)) << num;
+  }
+  // The object stream and xref stream are gone
+  EXPECT_EQ(parser.get_object(2), nullptr);
+  EXPECT_EQ(parser.get_object(5), nullptr);
+}
+
+TEST(RewriteDocument, DoesItDropObjectsThatDoNotParse) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog >>");
+  pdf.add(2, "<< /Broken [ >>");
+  pdf.add(3, "(fine)");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser original(data);
+  std::ostringstream os;
+  rewrite_document(original, os);
+
+  std::string rewritten = os.str();
+  PdfParser parser(rewritten);
+  EXPECT_EQ(parser.get_object(2), nullptr);
+  EXPECT_EQ(*parser.get_object(3)->obj, util::PdfString("fine"));
+  EXPECT_EQ(parser.xref().find(2)->type, XrefType::Free);
+}
+
+namespace {
+
+std::string sample_pdf() {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+  pdf.add(3, "<< /Type /Page /Parent 2 0 R /Contents 4 0 R >>");
+  std::string text;
+  for (int i = 0; i < 200; ++i)
+    text += "BT /F1 12 Tf 72 700 Td (Some repetitive text) Tj ET\n";
+  pdf.add_stream(4, "", text);
+  pdf.add_stream(5, "/Filter /FlateDecode",
+                 deflate_string("already small enough"));
+  pdf.add_stream(6, "/Filter /DCTDecode", "not really a jpeg");
+  pdf.add(7, "(a string with \\) in it)");
+  return pdf.finish_with_table("/Root 1 0 R");
+}
+
+std::string rewrite_with(const std::string &data,
+                         const RewriteOptions &options) {
+  PdfParser parser(data);
+  ThreadPool pool(2);
+  std::ostringstream os;
+  rewrite_document(parser, os, pool, options);
+  return os.str();
+}
+
+} // namespace
+
+TEST(RewriteDocument, DoesItDeflateStreamsThatGetSmaller) {
+  std::string data = sample_pdf();
+  RewriteOptions options;
+  options.compress_level = 9;
+  std::string rewritten = rewrite_with(data, options);
+  EXPECT_LT(rewritten.size(), data.size());
+
+  PdfParser original(data);
+  PdfParser parser(rewritten);
+  auto content = parser.get_object(4);
+  const util::PdfStream *stream = content->obj->as<util::PdfStream>();
+  ASSERT_NE(stream, nullptr);
+  EXPECT_EQ(*stream->dict->pairs.get(atom::Filter),
+            util::PdfName(atom::FlateDecode));
+  EXPECT_EQ(util::decode_stream(*stream),
+            util::decode_stream(
+                *original.get_object(4)->obj->as<util::PdfStream>()));
+
+  // Images are left alone
+  EXPECT_EQ(*parser.get_object(6), *original.get_object(6));
+  EXPECT_EQ(util::decode_stream(
+                *parser.get_object(5)->obj->as<util::PdfStream>()),
+            util::decode_stream(
+                *original.get_object(5)->obj->as<util::PdfStream>()));
+}
+
+TEST(RewriteDocument, DoesItPackObjectsIntoObjectStreams) {
+  std::string data = sample_pdf();
+  RewriteOptions options;
+  options.object_streams = true;
+  options.objects_per_stream = 2;
+  std::string rewritten = rewrite_with(data, options);
+  EXPECT_NE(rewritten.find("/Type /ObjStm"), std::string::npos);
+  EXPECT_EQ(rewritten.find("trailer"), std::string::npos);
+
+  PdfParser original(data);
+  PdfParser parser(rewritten);
+  EXPECT_EQ(parser.xref().find(1)->type, XrefType::Compressed);
+  EXPECT_EQ(parser.xref().find(4)->type, XrefType::InUse);
+  EXPECT_EQ(*parser.xref().trailer().pairs.get(atom::Root),
+            util::PdfRef(1, 0));
+  for (int64_t num = 1; num <= 7; ++num) {
+    ASSERT_NE(parser.get_object(num), nullptr) << num;
+    EXPECT_EQ(*parser.get_object(num), *original.get_object(num)) << num;
+  }
+}
@@ -0,0 +1,51 @@
+#include "serializer.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+using namespace util;
+
+TEST(PdfSerializer, DoesItWriteRealsWithoutAnExponent) {
+  std::ostringstream os;
+  {
+    PdfSerializer out(os);
+    out.real(1e-7);
+    out.put(' ');
+    out.real(-0.5);
+    out.put(' ');
+    out.real(1e21);
+    out.put(' ');
+    out.real(1.0 / 0.0);
+  }
+  EXPECT_EQ(os.str(), "0.0000001 -0.5 1000000000000000000000 0");
+}
+
+TEST(PdfSerializer, DoesItWriteNestedDictsInNameOrder) {
+  PdfDict dict;
+  PdfDict *inner = new PdfDict;
+  inner->pairs[PdfName("/Z")] = new PdfInt(1);
+  inner->pairs[PdfName("/A")] = new PdfString("a\r(b)");
+  dict.pairs[PdfName("/Inner")] = inner;
+  dict.pairs[PdfName("/Also")] = new PdfRef(3, 0);
+
+  std::ostringstream os;
+  PdfSerializer out(os);
+  out.write(dict);
+  out.flush();
+  EXPECT_EQ(os.str(),
+            "<< /Also 3 0 R /Inner << /A (a\\r\\(b\\)) /Z 1 >> >>");
+}
+
+TEST(PdfSerializer, DoesItCountOffsetsAcrossFlushesAndBigWrites) {
+  std::ostringstream os;
+  PdfSerializer out(os, 512);
+  out.raw("12345");
+  EXPECT_EQ(out.offset(), 5u);
+  std::string big(2000, 'x');
+  out.raw(big);
+  EXPECT_EQ(out.offset(), 2005u);
+  out.padded(42, 10);
+  out.flush();
+  EXPECT_EQ(os.str(), "12345" + big + "0000000042");
+  EXPECT_EQ(out.offset(), os.str().size());
+}
@@ -0,0 +1,77 @@
+#include "session.h"
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+namespace {
+
+std::string document(const std::string &text) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+  pdf.add(3, "<< /Type /Page /Parent 2 0 R /Contents 4 0 R >>");
+  pdf.add_stream(4, "/Filter /FlateDecode",
+                 deflate_string("BT (" + text + ") Tj ET"));
+  return pdf.finish_with_table("/Root 1 0 R");
+}
+
+} // namespace
+
+TEST(Session, DoesItOpenManyDocumentsOneAfterAnother) {
+  Session::Options options;
+  options.threads = 2;
+  Session session(options);
+  for (int i = 0; i < 50; ++i) {
+    std::string data = document("page " + std::to_string(i));
+    Document doc = session.view(data);
+    EXPECT_EQ(session.open_documents(), 1u);
+    EXPECT_EQ(doc.page_count(), 1u);
+    std::ostringstream os;
+    doc.extract_text(os);
+    EXPECT_EQ(os.str(), "page " + std::to_string(i) + "\n\f");
+  }
+  EXPECT_EQ(session.open_documents(), 0u);
+}
+
+TEST(Session, DoesItRunInlineOnItsOwnPool) {
+  Session::Options options;
+  options.threads = 1;
+  Session session(options);
+  std::string data = document("from a task");
+  // With one thread, waiting on the pool from inside a task would hang
+  std::string text = session.pool()
+                         .submit([&] {
+                           Document doc = session.view(data);
+                           std::ostringstream os;
+                           doc.extract_text(os);
+                           return os.str();
+                         })
+                         .get();
+  EXPECT_EQ(text, "from a task\n\f");
+}
+
+TEST(Session, DoesItCloseDocumentsWhenMovedOver) {
+  Session session;
+  std::string first = document("one"), second = document("two");
+  Document doc = session.view(first);
+  Document other = session.view(second);
+  EXPECT_EQ(session.open_documents(), 2u);
+  doc = std::move(other);
+  EXPECT_EQ(session.open_documents(), 1u);
+  EXPECT_EQ(doc.bytes().data(), second.data());
+  doc.close();
+  EXPECT_FALSE(doc.is_open());
+  EXPECT_EQ(session.open_documents(), 0u);
+  EXPECT_THROW(doc.parser(), std::logic_error);
+}
+
+TEST(Session, DoesItReadDocumentsFromStreams) {
+  Session session;
+  std::istringstream is(document("streamed"));
+  Document doc = session.open(is);
+  std::ostringstream os;
+  doc.info(os);
+  EXPECT_NE(os.str().find("pages: 1\n"), std::string::npos);
+  EXPECT_THROW(session.open("test/assets/not_a_file.pdf"),
+               std::ios_base::failure);
+}
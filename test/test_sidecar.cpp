@@ -0,0 +1,162 @@
+#include "page_tree.h"
+#include "pdf_parser.h"
+#include "sidecar.h"
+#include "test_helpers.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+
+namespace {
+
+std::string sample_document() {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R 4 0 R] /Count 2 "
+             "/MediaBox [0 0 612 792] >>");
+  pdf.add(3, "<< /Type /Page /Parent 2 0 R >>");
+  pdf.add(4, "<< /Type /Page /Parent 2 0 R /Rotate 90 >>");
+  return pdf.finish_with_table("/Root 1 0 R /ID [(abc) (def)]");
+}
+
+// A document written to the test temp dir, removed along with its sidecar
+struct TempDocument {
+  std::string path;
+  explicit TempDocument(const std::string &name, const std::string &data)
+      : path(::testing::TempDir() + name) {
+    write(data);
+  }
+  ~TempDocument() {
+    std::remove(path.c_str());
+    std::remove(SidecarIndex::path_for(path).c_str());
+  }
+  void write(const std::string &data) {
+    std::ofstream os(path, std::ios::binary | std::ios::trunc);
+    os << data;
+  }
+};
+
+} // namespace
+
+TEST(Sidecar, DoesItRoundTripTheIndex) {
+  std::string data = sample_document();
+  TempDocument doc("sidecar_round_trip.pdf", data);
+  PdfParser parser(data);
+  FileStamp stamp = FileStamp::of(doc.path, data);
+
+  SidecarIndex built = SidecarIndex::build(parser, stamp);
+  std::string sidecar = SidecarIndex::path_for(doc.path);
+  built.save(sidecar);
+  auto loaded = SidecarIndex::load(sidecar, stamp);
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(loaded->pages(), (std::vector<int64_t>{3, 4}));
+  ASSERT_EQ(loaded->entries().size(), parser.xref().size());
+  for (size_t i = 0; i < loaded->entries().size(); ++i) {
+    EXPECT_EQ(loaded->entries()[i].type, parser.xref().all()[i].type);
+    EXPECT_EQ(loaded->entries()[i].offset, parser.xref().all()[i].offset);
+  }
+}
+
+TEST(Sidecar, DoesItIgnoreASidecarForAnotherStamp) {
+  std::string data = sample_document();
+  TempDocument doc("sidecar_stale.pdf", data);
+  PdfParser parser(data);
+  FileStamp stamp = FileStamp::of(doc.path, data);
+  std::string sidecar = SidecarIndex::path_for(doc.path);
+  SidecarIndex::build(parser, stamp).save(sidecar);
+
+  FileStamp changed = stamp;
+  changed.mtime += 1;
+  EXPECT_FALSE(SidecarIndex::load(sidecar, changed).has_value());
+  changed = stamp;
+  changed.hash ^= 1;
+  EXPECT_FALSE(SidecarIndex::load(sidecar, changed).has_value());
+}
+
+TEST(Sidecar, DoesItIgnoreMissingAndDamagedFiles) {
+  std::string data = sample_document();
+  TempDocument doc("sidecar_damaged.pdf", data);
+  FileStamp stamp = FileStamp::of(doc.path, data);
+  std::string sidecar = SidecarIndex::path_for(doc.path);
+  EXPECT_FALSE(SidecarIndex::load(sidecar, stamp).has_value());
+
+  PdfParser parser(data);
+  SidecarIndex::build(parser, stamp).save(sidecar);
+  std::string bytes;
+  {
+    std::ifstream is(sidecar, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(is), {});
+  }
+  // Cut off part of the entries
+  std::ofstream(sidecar, std::ios::binary | std::ios::trunc)
+      << bytes.substr(0, 80);
+  EXPECT_FALSE(SidecarIndex::load(sidecar, stamp).has_value());
+}
+
+TEST(Sidecar, DoesAParserOpenThroughTheSidecar) {
+  std::string data = sample_document();
+  TempDocument doc("sidecar_open.pdf", data);
+
+  PdfParser first(data);
+  EXPECT_FALSE(open_with_sidecar(first, doc.path));
+  PdfParser second(data);
+  EXPECT_TRUE(open_with_sidecar(second, doc.path));
+
+  EXPECT_EQ(second.page_index(), (std::vector<int64_t>{3, 4}));
+  EXPECT_NE(second.xref().trailer().pairs.get(atom::ID), nullptr);
+  PageTree pages(second);
+  ASSERT_EQ(pages.count(), 2u);
+  PageTree::Page page = pages.page(1);
+  EXPECT_EQ(page.obj->num, 4);
+  ASSERT_NE(page.media_box, nullptr);
+  EXPECT_EQ(page.media_box->as<util::PdfArray>()->objects.size(), 4u);
+  ASSERT_NE(page.rotate, nullptr);
+  EXPECT_EQ(page.rotate->as<util::PdfInt>()->data, 90);
+}
+
+TEST(Sidecar, DoesItRebuildWhenTheFileChanges) {
+  std::string data = sample_document();
+  TempDocument doc("sidecar_rebuild.pdf", data);
+  {
+    PdfParser parser(data);
+    open_with_sidecar(parser, doc.path);
+  }
+
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+  pdf.add(3, "<< /Type /Page /Parent 2 0 R >>");
+  std::string changed = pdf.finish_with_table("/Root 1 0 R");
+  doc.write(changed);
+
+  PdfParser parser(changed);
+  EXPECT_FALSE(open_with_sidecar(parser, doc.path));
+  EXPECT_EQ(parser.page_index(), (std::vector<int64_t>{3}));
+  EXPECT_EQ(PageTree(parser).count(), 1u);
+}
+
+TEST(Sidecar, DoesTheSampleHashSeeChanges) {
+  std::string big(3 * 1024 * 1024, 'a');
+  uint64_t before = sample_hash(big);
+  EXPECT_EQ(sample_hash(big), before);
+  big[10] = 'b';
+  EXPECT_NE(sample_hash(big), before);
+  EXPECT_NE(sample_hash("abc"), sample_hash("abd"));
+}
+
+TEST(Sidecar, DoesARangedParserOnlyReadTheSamples) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+  pdf.add(3, "<< /Type /Page /Parent 2 0 R >>");
+  pdf.add_stream(4, "", std::string(8 * 1024 * 1024, 'x'));
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+  TempDocument doc("sidecar_ranged.pdf", data);
+
+  for (bool built : {false, true}) {
+    RangedSource source(open_range_reader(doc.path), 4096);
+    PdfParser parser(source);
+    EXPECT_EQ(open_with_sidecar(parser, doc.path), built);
+    EXPECT_EQ(parser.page_index(), std::vector<int64_t>{3});
+    EXPECT_LT(source.bytes_fetched(), data.size() / 4);
+  }
+}
@@ -0,0 +1,87 @@
+#include "pdf_parser.h"
+#include "stats.h"
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+namespace {
+
+std::string sample_document() {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [] /Count 0 >>");
+  pdf.add_stream(3, "/Filter /FlateDecode", deflate_string("Hello, World!"));
+  return pdf.finish_with_table("/Root 1 0 R");
+}
+
+// Turns stats on from a clean slate and off again after the test
+struct StatsOn {
+  StatsOn() {
+    stats::reset();
+    stats::enable();
+  }
+  ~StatsOn() {
+    stats::enable(false);
+    stats::reset();
+  }
+};
+
+} // namespace
+
+#ifdef PDFCLI_STATS
+
+TEST(Stats, DoesItCountPhasesObjectsAndTheCache) {
+  StatsOn on;
+  std::string data = sample_document();
+  PdfParser parser(data);
+  parser.get_object(1);
+  parser.get_object(1);
+  std::ostringstream os;
+  parser.inflate_to(os);
+
+  stats::Snapshot snap = stats::snapshot();
+  EXPECT_EQ(snap.calls_of(stats::Phase::XrefLoad), 1u);
+  EXPECT_GE(snap.calls_of(stats::Phase::ObjectParse), 1u);
+  EXPECT_GE(snap.calls_of(stats::Phase::FilterDecode), 1u);
+  EXPECT_GE(snap.calls_of(stats::Phase::OutputWrite), 1u);
+  EXPECT_EQ(snap.count_of(stats::Counter::BytesInflated), 13u);
+  EXPECT_EQ(snap.count_of(stats::Counter::CacheHits), 1u);
+  EXPECT_GE(snap.count_of(stats::Counter::CacheMisses), 1u);
+  EXPECT_GE(snap.objects_of(util::PdfType::Dict), 1u);
+  EXPECT_GE(snap.objects_of(util::PdfType::TopLevel), 1u);
+}
+
+TEST(Stats, DoesItCollectNothingWhenOff) {
+  stats::reset();
+  std::string data = sample_document();
+  PdfParser parser(data);
+  parser.get_object(1);
+
+  stats::Snapshot snap = stats::snapshot();
+  EXPECT_EQ(snap.calls_of(stats::Phase::XrefLoad), 0u);
+  EXPECT_EQ(snap.count_of(stats::Counter::CacheMisses), 0u);
+  EXPECT_EQ(snap.objects_of(util::PdfType::Dict), 0u);
+}
+
+#endif
+
+TEST(Stats, DoesItWriteATableAndJson) {
+  StatsOn on;
+  stats::add(stats::Counter::BytesRead, 1234);
+  stats::add_time(stats::Phase::OutputWrite, 1500000000);
+  stats::add_object(util::PdfType::Name);
+
+  std::ostringstream table;
+  stats::write_table(table, stats::snapshot());
+  EXPECT_NE(table.str().find("bytes_read"), std::string::npos);
+  EXPECT_NE(table.str().find("1234"), std::string::npos);
+  EXPECT_NE(table.str().find("1.500000"), std::string::npos);
+
+  std::ostringstream json;
+  stats::write_json(json, stats::snapshot());
+  EXPECT_NE(json.str().find("\"bytes_read\": 1234"), std::string::npos);
+  EXPECT_NE(json.str().find("\"output_write\": "
+                            "{\"calls\": 1, \"seconds\": 1.500000}"),
+            std::string::npos);
+  EXPECT_NE(json.str().find("\"name\": 1"), std::string::npos);
+}
@@ -0,0 +1,100 @@
+#include "pdf_parser.h"
+#include "test_helpers.h"
+#include "text_extract.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+namespace {
+
+// A document with one page per entry, each showing its text with Tj
+std::string pages_pdf(const std::vector<std::string> &texts) {
+  TestPdf pdf;
+  std::string kids;
+  for (size_t i = 0; i < texts.size(); ++i) {
+    int64_t page = 10 + 2 * i;
+    kids += std::to_string(page) + " 0 R ";
+    pdf.add(page, "<< /Type /Page /Parent 2 0 R /Contents " +
+                      std::to_string(page + 1) + " 0 R >>");
+    pdf.add_stream(page + 1, "/Filter /FlateDecode",
+                   deflate_string("BT /F1 12 Tf 72 700 Td (" + texts[i] +
+                                  ") Tj ET"));
+  }
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [" + kids + "] /Count " +
+                 std::to_string(texts.size()) + " >>");
+  return pdf.finish_with_table("/Root 1 0 R");
+}
+
+} // namespace
+
+TEST(ContentText, DoesItJoinShownStringsIntoLines) {
+  std::string text = content_text(
+      "BT 1 0 0 1 72 700 Tm (Hello) Tj 10 0 Td (there) Tj 0 -14 Td "
+      "[(W) 80 (orld) -300 <21>] TJ T* (again) Tj (x) ' ET");
+  EXPECT_EQ(text, "Hello there\nWorld !\nagain\nx\n");
+}
+
+TEST(PageRange, DoesItParseListsAndOpenRanges) {
+  PageRange range = PageRange::parse("100-200,7,10-");
+  ASSERT_EQ(range.ranges().size(), 3u);
+  EXPECT_EQ(range.ranges()[0], std::make_pair(size_t(99), size_t(199)));
+  EXPECT_EQ(range.ranges()[1], std::make_pair(size_t(6), size_t(6)));
+  EXPECT_EQ(range.ranges()[2], std::make_pair(size_t(9), SIZE_MAX));
+  EXPECT_THROW(PageRange::parse("5-3"), std::runtime_error);
+  EXPECT_THROW(PageRange::parse("0"), std::runtime_error);
+  EXPECT_THROW(PageRange::parse("1,,2"), std::runtime_error);
+  EXPECT_THROW(PageRange::parse("a-b"), std::runtime_error);
+}
+
+TEST(ExtractText, DoesItWritePagesInOrder) {
+  std::vector<std::string> texts;
+  for (int i = 0; i < 40; ++i)
+    texts.push_back("page " + std::to_string(i + 1));
+  std::string data = pages_pdf(texts);
+
+  PdfParser parser(data);
+  ThreadPool pool(3);
+  std::ostringstream os;
+  extract_text(parser, os, pool);
+
+  std::string expected;
+  for (const std::string &text : texts)
+    expected += text + "\n\f";
+  EXPECT_EQ(os.str(), expected);
+}
+
+TEST(ExtractText, DoesItOnlyWriteThePagesInRange) {
+  std::string data = pages_pdf({"one", "two", "three", "four"});
+  PdfParser parser(data);
+  ThreadPool pool(2);
+  std::ostringstream os;
+  extract_text(parser, os, pool, PageRange::parse("3-,1"));
+  EXPECT_EQ(os.str(), "three\n\ffour\n\fone\n\f");
+}
+
+TEST(ExtractText, DoesItCarryOnPastAPageThatWillNotDecode) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [10 0 R 12 0 R 14 0 R] /Count 3 >>");
+  pdf.add(10, "<< /Type /Page /Parent 2 0 R /Contents 11 0 R >>");
+  pdf.add_stream(11, "", "BT (one) Tj ET");
+  pdf.add(12, "<< /Type /Page /Parent 2 0 R /Contents 13 0 R >>");
+  pdf.add_stream(13, "/Filter /FlateDecode", "not deflate at all");
+  pdf.add(14, "<< /Type /Page /Parent 2 0 R /Contents 15 0 R >>");
+  pdf.add_stream(15, "", "BT (three) Tj ET");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  PdfParser parser(data);
+  ThreadPool pool(2);
+  std::ostringstream parallel, serial;
+  std::vector<PageError> errors = extract_text(parser, parallel, pool);
+  EXPECT_EQ(parallel.str(), "one\n\f\fthree\n\f");
+  ASSERT_EQ(errors.size(), 1u);
+  EXPECT_EQ(errors[0].page, 2u);
+  EXPECT_FALSE(errors[0].message.empty());
+
+  errors = extract_text(parser, serial);
+  EXPECT_EQ(serial.str(), parallel.str());
+  ASSERT_EQ(errors.size(), 1u);
+  EXPECT_EQ(errors[0].page, 2u);
+}
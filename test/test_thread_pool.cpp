@@ -0,0 +1,40 @@
+#include "thread_pool.h"
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+TEST(ThreadPool, DoesItRunEveryTaskAndReturnResults) {
+  ThreadPool pool(4);
+  EXPECT_EQ(pool.size(), 4u);
+  std::vector<std::future<int>> results;
+  for (int i = 0; i < 200; ++i)
+    results.push_back(pool.submit([i]() { return i * i; }));
+  for (int i = 0; i < 200; ++i)
+    EXPECT_EQ(results[i].get(), i * i);
+}
+
+TEST(ThreadPool, DoesItPassExceptionsThroughTheFuture) {
+  ThreadPool pool(2);
+  auto result = pool.submit([]() -> int { throw std::runtime_error("boom"); });
+  EXPECT_THROW(result.get(), std::runtime_error);
+}
+
+TEST(ThreadPool, DoesItRunTasksSubmittedFromTasks) {
+  std::atomic<int> count{0};
+  {
+    ThreadPool pool(3);
+    for (int i = 0; i < 10; ++i) {
+      pool.submit([&pool, &count]() {
+        for (int j = 0; j < 10; ++j)
+          pool.submit([&count]() { ++count; });
+      });
+    }
+    // The destructor waits for everything, including the nested tasks
+  }
+  EXPECT_EQ(count, 100);
+}
+
+TEST(ThreadPool, DoesZeroThreadsMeanEveryCore) {
+  ThreadPool pool;
+  EXPECT_EQ(pool.size(), ThreadPool::default_threads());
+  EXPECT_GE(pool.size(), 1u);
+}
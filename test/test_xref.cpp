@@ -0,0 +1,159 @@
+#include "filters.h"
+#include "pdf_parser.h"
+#include "test_helpers.h"
+#include "xref.h"
+#include <gtest/gtest.h>
+
+TEST(XrefTable, DoesItFindStartxrefAtTheEndOfTheFile) {
+  std::string data = "junk\nstartxref\n3\n%%EOF\n";
+  EXPECT_EQ(util::find_startxref(data), 3u);
+  EXPECT_THROW(util::find_startxref("startxref 999"), std::runtime_error);
+  EXPECT_THROW(util::find_startxref("no trailer here"), std::runtime_error);
+}
+
+TEST(XrefTable, DoesItLoadAClassicXrefTable) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "<< /Type /Pages /Kids [] /Count 0 >>");
+  pdf.add(4, "(skipped 3)");
+  std::string data = pdf.finish_with_table("/Root 1 0 R");
+
+  XrefTable table = XrefTable::load(data);
+  EXPECT_EQ(table.size(), 5u);
+  EXPECT_EQ(table.object_count(), 3u);
+  ASSERT_NE(table.find(2), nullptr);
+  EXPECT_EQ(table.find(2)->type, XrefType::InUse);
+  EXPECT_EQ(table.find(2)->offset, pdf.offsets[2]);
+  EXPECT_EQ(table.find(3)->type, XrefType::Free);
+  EXPECT_EQ(table.find(9), nullptr);
+
+  auto root = table.trailer().pairs.get(atom::Root);
+  ASSERT_NE(root, nullptr);
+  EXPECT_EQ(*root, util::PdfRef(1, 0));
+}
+
+TEST(XrefTable, DoesItLoadACompressedXrefStream) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog >>");
+  pdf.add(2, "42");
+  std::string data = pdf.finish_with_stream(3, "/Root 1 0 R", {{5, {4, 7}}});
+
+  XrefTable table = XrefTable::load(data);
+  EXPECT_EQ(table.find(2)->offset, pdf.offsets[2]);
+  ASSERT_NE(table.find(5), nullptr);
+  EXPECT_EQ(table.find(5)->type, XrefType::Compressed);
+  EXPECT_EQ(table.find(5)->offset, 4u);
+  EXPECT_EQ(table.find(5)->index, 7u);
+  EXPECT_NE(table.trailer().pairs.get(atom::Root), nullptr);
+}
+
+TEST(XrefTable, DoNewerSectionsWinOverPrevSections) {
+  TestPdf pdf;
+  pdf.add(1, "(old)");
+  pdf.add(2, "(kept)");
+  std::string data = pdf.finish_with_table("/Info 2 0 R");
+  size_t first_xref = util::find_startxref(data);
+
+  // Append an update that replaces object 1
+  size_t updated = data.size();
+  data += "1 0 obj\n(new)\nendobj\n";
+  size_t xref = data.size();
+  char line[32];
+  snprintf(line, sizeof(line), "%010zu 00000 n\r\n", updated);
+  data += "xref\n1 1\n" + std::string(line) + "trailer\n<< /Size 3 /Prev " +
+          std::to_string(first_xref) + " >>\nstartxref\n" +
+          std::to_string(xref) + "\n%%EOF\n";
+
+  XrefTable table = XrefTable::load(data);
+  EXPECT_EQ(table.sections().size(), 2u);
+  EXPECT_EQ(table.find(1)->offset, updated);
+  EXPECT_EQ(table.find(2)->offset, pdf.offsets[2]);
+  // Keys only in the older trailer are still there
+  EXPECT_NE(table.trailer().pairs.get(atom::Info), nullptr);
+}
+
+TEST(XrefTable, DoesItStopOnAPrevLoop) {
+  std::string data = "%PDF-1.7\n";
+  size_t xref = data.size();
+  data += "xref\n0 1\n0000000000 65535 f\r\ntrailer\n<< /Size 1 /Prev " +
+          std::to_string(xref) + " >>\nstartxref\n" + std::to_string(xref) +
+          "\n%%EOF\n";
+  XrefTable table = XrefTable::load(data);
+  EXPECT_EQ(table.sections().size(), 1u);
+}
+
+TEST(XrefTable, DoesItRejectObjectNumbersPastTheSize) {
+  // A tiny file asking for an object four billion slots in must not make the
+  // table grow to match
+  std::string data = "%PDF-1.7\nxref\n4000000000 1\n0000000009 00000 n\r\n"
+                     "trailer\n<< /Size 3 >>\nstartxref\n9\n%%EOF\n";
+  EXPECT_THROW(XrefTable::load(data), std::runtime_error);
+
+  // Past /Size, and past the cap when there is no /Size at all
+  std::string past = "%PDF-1.7\nxref\n40 1\n0000000009 00000 n\r\n"
+                     "trailer\n<< /Size 3 >>\nstartxref\n9\n%%EOF\n";
+  EXPECT_THROW(XrefTable::load(past), std::runtime_error);
+  std::string capped =
+      "%PDF-1.7\nxref\n9000000 1\n0000000009 00000 n\r\n"
+      "trailer\n<< >>\nstartxref\n9\n%%EOF\n";
+  EXPECT_THROW(XrefTable::load(capped), std::runtime_error);
+
+  // A /Size that is one short is common and still loads
+  std::string short_size = "%PDF-1.7\nxref\n0 3\n0000000000 65535 f\r\n"
+                           "0000000009 00000 n\r\n0000000009 00000 n\r\n"
+                           "trailer\n<< /Size 2 >>\nstartxref\n9\n%%EOF\n";
+  EXPECT_EQ(XrefTable::load(short_size).size(), 3u);
+}
+
+TEST(PdfParserGetObject, DoesItLoadObjectsThroughTheXref) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.add(2, "[1 2 3]");
+  std::string data = pdf.finish_with_stream(3, "/Root 1 0 R");
+
+  PdfParser parser(data);
+  ObjectCache::ObjPtr obj = parser.get_object(2);
+  ASSERT_NE(obj, nullptr);
+  EXPECT_EQ(obj->num, 2);
+  ASSERT_NE(obj->obj->as<util::PdfArray>(), nullptr);
+  EXPECT_EQ(obj->obj->as<util::PdfArray>()->objects.size(), 3u);
+
+  // The second load is the same object, not a fresh parse
+  EXPECT_EQ(parser.get_object(2).get(), obj.get());
+  EXPECT_EQ(parser.get_object(2, 1), nullptr);
+  EXPECT_EQ(parser.get_object(17), nullptr);
+}
+
+TEST(Filters, DoesItUndoThePngUpPredictor) {
+  util::PdfDict params;
+  params.pairs[util::PdfName(atom::Predictor)] = new util::PdfInt(12);
+  params.pairs[util::PdfName(atom::Columns)] = new util::PdfInt(2);
+  std::vector<char> rows = {2, 1, 2, 2, 1, 1, 2, 1, 1};
+  std::vector<char> expected = {1, 2, 2, 3, 3, 4};
+  EXPECT_EQ(util::unpredict(rows, &params), expected);
+}
+
+TEST(PdfParserGetObject, DoesItUseIndirectStreamLengths) {
+  TestPdf pdf;
+  std::string payload = "binary endstream inside";
+  pdf.add(1, "<< /Length 2 0 R >>\nstream\n" + payload + "\nendstream");
+  pdf.add(2, std::to_string(payload.size()));
+  std::string data = pdf.finish_with_table("");
+
+  PdfParser parser(data);
+  auto obj = parser.get_object(1);
+  ASSERT_NE(obj, nullptr);
+  ASSERT_NE(obj->obj->as<util::PdfStream>(), nullptr);
+  EXPECT_EQ(obj->obj->as<util::PdfStream>()->bytes(), payload);
+}
+
+TEST(PdfParserGetObject, DoesASelfReferencingLengthFallBackToSearching) {
+  TestPdf pdf;
+  pdf.add(1, "<< /Length 1 0 R >>\nstream\nabc\nendstream");
+  std::string data = pdf.finish_with_table("");
+
+  PdfParser parser(data);
+  auto obj = parser.get_object(1);
+  ASSERT_NE(obj, nullptr);
+  EXPECT_EQ(obj->obj->as<util::PdfStream>()->bytes(), "abc");
+}